@@ -0,0 +1,450 @@
+#include "AABBTree.h"
+#include <cassert>
+
+
+AABBTree::AABBTree(float a_margin)
+{
+	m_margin = a_margin;
+	m_root = NULL_NODE;
+	m_freeList = NULL_NODE;
+	m_proxyCount = 0;
+}
+
+
+int AABBTree::createProxy(const AABB& a_bounds, unsigned int a_userData)
+{
+	int leaf = allocateNode();
+	m_nodes[leaf].m_bounds = AABB(a_bounds.m_min - glm::vec3(m_margin), a_bounds.m_max + glm::vec3(m_margin));
+	m_nodes[leaf].m_userData = a_userData;
+	m_nodes[leaf].m_height = 0;
+
+	insertLeaf(leaf);
+	m_proxyCount++;
+	return leaf;
+}
+
+void AABBTree::destroyProxy(int a_proxy)
+{
+	assert(a_proxy >= 0 && a_proxy < (int)m_nodes.size() && m_nodes[a_proxy].isLeaf());
+
+	removeLeaf(a_proxy);
+	freeNode(a_proxy);
+	m_proxyCount--;
+}
+
+bool AABBTree::moveProxy(int a_proxy, const AABB& a_bounds)
+{
+	//still inside the enlarged box, so nothing changes
+	const AABB& fatBounds = m_nodes[a_proxy].m_bounds;
+	if (glm::all(glm::lessThanEqual(fatBounds.m_min, a_bounds.m_min)) && glm::all(glm::lessThanEqual(a_bounds.m_max, fatBounds.m_max)))
+	{
+		return false;
+	}
+
+	removeLeaf(a_proxy);
+	m_nodes[a_proxy].m_bounds = AABB(a_bounds.m_min - glm::vec3(m_margin), a_bounds.m_max + glm::vec3(m_margin));
+	insertLeaf(a_proxy);
+	return true;
+}
+
+void AABBTree::setProxyBounds(int a_proxy, const AABB& a_bounds)
+{
+	m_nodes[a_proxy].m_bounds = AABB(a_bounds.m_min - glm::vec3(m_margin), a_bounds.m_max + glm::vec3(m_margin));
+}
+
+void AABBTree::refit()
+{
+	if (m_root == NULL_NODE)
+	{
+		return;
+	}
+
+	//nodes aren't stored in any order, so list them breadth first
+	std::vector<int> order;
+	order.reserve(m_nodes.size());
+	order.push_back(m_root);
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const Node& node = m_nodes[order[i]];
+		if (!node.isLeaf())
+		{
+			order.push_back(node.m_children[0]);
+			order.push_back(node.m_children[1]);
+		}
+	}
+
+	//children come after their parents in the list, so going backwards fixes children first
+	for (auto iter = order.rbegin(); iter != order.rend(); ++iter)
+	{
+		Node& node = m_nodes[*iter];
+		if (!node.isLeaf())
+		{
+			node.m_bounds = m_nodes[node.m_children[0]].m_bounds;
+			node.m_bounds.expand(m_nodes[node.m_children[1]].m_bounds);
+		}
+	}
+}
+
+void AABBTree::clear()
+{
+	m_nodes.clear();
+	m_root = NULL_NODE;
+	m_freeList = NULL_NODE;
+	m_proxyCount = 0;
+}
+
+
+void AABBTree::queryFrustum(const Frustum& a_frustum, std::vector<unsigned int>& a_results) const
+{
+	if (m_root == NULL_NODE)
+	{
+		return;
+	}
+
+	int stack[256];
+	int stackSize = 0;
+	stack[stackSize++] = m_root;
+	while (stackSize > 0)
+	{
+		int index = stack[--stackSize];
+		const Node& node = m_nodes[index];
+		Frustum::Containment containment = a_frustum.classify(node.m_bounds);
+		if (containment == Frustum::OUTSIDE)
+		{
+			continue;
+		}
+
+		//everything below is visible, so there's no need to test it
+		if (containment == Frustum::INSIDE || node.isLeaf())
+		{
+			addLeaves(index, a_results);
+			continue;
+		}
+
+		assert(stackSize + 2 <= 256 && "AABB tree is too unbalanced to query");
+		stack[stackSize++] = node.m_children[0];
+		stack[stackSize++] = node.m_children[1];
+	}
+}
+
+void AABBTree::querySphere(const BoundingSphere& a_sphere, std::vector<unsigned int>& a_results) const
+{
+	if (m_root == NULL_NODE)
+	{
+		return;
+	}
+
+	int stack[256];
+	int stackSize = 0;
+	stack[stackSize++] = m_root;
+	while (stackSize > 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+
+		//distance from the sphere to the closest point in the box
+		glm::vec3 closest = glm::clamp(a_sphere.m_center, node.m_bounds.m_min, node.m_bounds.m_max);
+		glm::vec3 offset = closest - a_sphere.m_center;
+		if (glm::dot(offset, offset) > a_sphere.m_radius * a_sphere.m_radius)
+		{
+			continue;
+		}
+
+		if (node.isLeaf())
+		{
+			a_results.push_back(node.m_userData);
+			continue;
+		}
+
+		assert(stackSize + 2 <= 256 && "AABB tree is too unbalanced to query");
+		stack[stackSize++] = node.m_children[0];
+		stack[stackSize++] = node.m_children[1];
+	}
+}
+
+void AABBTree::queryRay(const glm::vec3& a_origin, const glm::vec3& a_direction, float a_maxDistance, std::vector<unsigned int>& a_results) const
+{
+	if (m_root == NULL_NODE)
+	{
+		return;
+	}
+
+	//division by zero gives infinity, which the slab test handles
+	glm::vec3 inverseDirection = 1.f / a_direction;
+
+	int stack[256];
+	int stackSize = 0;
+	stack[stackSize++] = m_root;
+	while (stackSize > 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+
+		//slab test, the ray hits if it enters every slab before leaving any of them
+		glm::vec3 t0 = (node.m_bounds.m_min - a_origin) * inverseDirection;
+		glm::vec3 t1 = (node.m_bounds.m_max - a_origin) * inverseDirection;
+		glm::vec3 tMin = glm::min(t0, t1);
+		glm::vec3 tMax = glm::max(t0, t1);
+		float enter = glm::max(glm::max(tMin.x, tMin.y), glm::max(tMin.z, 0.f));
+		float exit = glm::min(glm::min(tMax.x, tMax.y), glm::min(tMax.z, a_maxDistance));
+		if (enter > exit)
+		{
+			continue;
+		}
+
+		if (node.isLeaf())
+		{
+			a_results.push_back(node.m_userData);
+			continue;
+		}
+
+		assert(stackSize + 2 <= 256 && "AABB tree is too unbalanced to query");
+		stack[stackSize++] = node.m_children[0];
+		stack[stackSize++] = node.m_children[1];
+	}
+}
+
+void AABBTree::addLeaves(int a_node, std::vector<unsigned int>& a_results) const
+{
+	int stack[256];
+	int stackSize = 0;
+	stack[stackSize++] = a_node;
+	while (stackSize > 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (node.isLeaf())
+		{
+			a_results.push_back(node.m_userData);
+			continue;
+		}
+
+		assert(stackSize + 2 <= 256 && "AABB tree is too unbalanced to query");
+		stack[stackSize++] = node.m_children[0];
+		stack[stackSize++] = node.m_children[1];
+	}
+}
+
+
+int AABBTree::allocateNode()
+{
+	//grow the pool when there are no free nodes
+	if (m_freeList == NULL_NODE)
+	{
+		Node node;
+		node.m_parent = NULL_NODE;
+		node.m_children[0] = NULL_NODE;
+		node.m_children[1] = NULL_NODE;
+		node.m_height = 0;
+		node.m_userData = 0;
+		m_nodes.push_back(node);
+		return (int)m_nodes.size() - 1;
+	}
+
+	int node = m_freeList;
+	m_freeList = m_nodes[node].m_parent;
+	m_nodes[node].m_parent = NULL_NODE;
+	m_nodes[node].m_children[0] = NULL_NODE;
+	m_nodes[node].m_children[1] = NULL_NODE;
+	m_nodes[node].m_height = 0;
+	return node;
+}
+
+void AABBTree::freeNode(int a_node)
+{
+	m_nodes[a_node].m_parent = m_freeList;
+	m_nodes[a_node].m_height = -1;
+	m_freeList = a_node;
+}
+
+
+void AABBTree::insertLeaf(int a_leaf)
+{
+	if (m_root == NULL_NODE)
+	{
+		m_root = a_leaf;
+		m_nodes[a_leaf].m_parent = NULL_NODE;
+		return;
+	}
+
+	//walk down the tree, going whichever way adds the least surface area
+	AABB leafBounds = m_nodes[a_leaf].m_bounds;
+	int index = m_root;
+	while (!m_nodes[index].isLeaf())
+	{
+		const Node& node = m_nodes[index];
+		float area = getArea(node.m_bounds);
+
+		AABB combined = node.m_bounds;
+		combined.expand(leafBounds);
+		float combinedArea = getArea(combined);
+
+		//cost of making a new parent for this node and the leaf
+		float cost = 2 * combinedArea;
+		//every node below here grows by at least this much if the leaf goes further down
+		float inheritanceCost = 2 * (combinedArea - area);
+
+		float childCosts[2];
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = m_nodes[node.m_children[i]];
+			AABB childCombined = child.m_bounds;
+			childCombined.expand(leafBounds);
+			childCosts[i] = child.isLeaf() ? getArea(childCombined) + inheritanceCost
+				: getArea(childCombined) - getArea(child.m_bounds) + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+		{
+			break;
+		}
+		index = childCosts[0] < childCosts[1] ? node.m_children[0] : node.m_children[1];
+	}
+
+	//make a new parent for the sibling and the leaf
+	int sibling = index;
+	int oldParent = m_nodes[sibling].m_parent;
+	int newParent = allocateNode();
+	m_nodes[newParent].m_parent = oldParent;
+	m_nodes[newParent].m_bounds = leafBounds;
+	m_nodes[newParent].m_bounds.expand(m_nodes[sibling].m_bounds);
+	m_nodes[newParent].m_height = m_nodes[sibling].m_height + 1;
+	m_nodes[newParent].m_children[0] = sibling;
+	m_nodes[newParent].m_children[1] = a_leaf;
+	m_nodes[sibling].m_parent = newParent;
+	m_nodes[a_leaf].m_parent = newParent;
+
+	if (oldParent == NULL_NODE)
+	{
+		m_root = newParent;
+	}
+	else if (m_nodes[oldParent].m_children[0] == sibling)
+	{
+		m_nodes[oldParent].m_children[0] = newParent;
+	}
+	else
+	{
+		m_nodes[oldParent].m_children[1] = newParent;
+	}
+
+	fixUpwards(m_nodes[a_leaf].m_parent);
+}
+
+void AABBTree::removeLeaf(int a_leaf)
+{
+	if (a_leaf == m_root)
+	{
+		m_root = NULL_NODE;
+		return;
+	}
+
+	//the sibling takes the parents place
+	int parent = m_nodes[a_leaf].m_parent;
+	int grandParent = m_nodes[parent].m_parent;
+	int sibling = m_nodes[parent].m_children[0] == a_leaf ? m_nodes[parent].m_children[1] : m_nodes[parent].m_children[0];
+
+	if (grandParent == NULL_NODE)
+	{
+		m_root = sibling;
+		m_nodes[sibling].m_parent = NULL_NODE;
+		freeNode(parent);
+		return;
+	}
+
+	if (m_nodes[grandParent].m_children[0] == parent)
+	{
+		m_nodes[grandParent].m_children[0] = sibling;
+	}
+	else
+	{
+		m_nodes[grandParent].m_children[1] = sibling;
+	}
+	m_nodes[sibling].m_parent = grandParent;
+	freeNode(parent);
+
+	fixUpwards(grandParent);
+}
+
+void AABBTree::fixUpwards(int a_node)
+{
+	int index = a_node;
+	while (index != NULL_NODE)
+	{
+		index = balance(index);
+
+		Node& node = m_nodes[index];
+		const Node& child0 = m_nodes[node.m_children[0]];
+		const Node& child1 = m_nodes[node.m_children[1]];
+		node.m_height = 1 + glm::max(child0.m_height, child1.m_height);
+		node.m_bounds = child0.m_bounds;
+		node.m_bounds.expand(child1.m_bounds);
+
+		index = node.m_parent;
+	}
+}
+
+int AABBTree::balance(int a_node)
+{
+	Node& a = m_nodes[a_node];
+	if (a.isLeaf() || a.m_height < 2)
+	{
+		return a_node;
+	}
+
+	int b = a.m_children[0];
+	int c = a.m_children[1];
+	int heightDifference = m_nodes[c].m_height - m_nodes[b].m_height;
+	if (heightDifference >= -1 && heightDifference <= 1)
+	{
+		return a_node;
+	}
+
+	//promote the taller child, moving its shorter child down to a
+	int tall = heightDifference > 1 ? c : b;
+	int shortSide = heightDifference > 1 ? 0 : 1;
+	Node& t = m_nodes[tall];
+	int f = t.m_children[0];
+	int g = t.m_children[1];
+
+	//the taller child takes a's place
+	t.m_children[0] = a_node;
+	t.m_parent = a.m_parent;
+	a.m_parent = tall;
+	if (t.m_parent != NULL_NODE)
+	{
+		Node& parent = m_nodes[t.m_parent];
+		if (parent.m_children[0] == a_node)
+		{
+			parent.m_children[0] = tall;
+		}
+		else
+		{
+			parent.m_children[1] = tall;
+		}
+	}
+	else
+	{
+		m_root = tall;
+	}
+
+	//the taller grandchild stays under the promoted node, the shorter one replaces it under a
+	int keep = m_nodes[f].m_height > m_nodes[g].m_height ? f : g;
+	int move = keep == f ? g : f;
+	t.m_children[1] = keep;
+	a.m_children[shortSide == 0 ? 1 : 0] = move;
+	m_nodes[move].m_parent = a_node;
+
+	Node& other = m_nodes[a.m_children[shortSide]];
+	a.m_bounds = other.m_bounds;
+	a.m_bounds.expand(m_nodes[move].m_bounds);
+	a.m_height = 1 + glm::max(other.m_height, m_nodes[move].m_height);
+
+	t.m_bounds = a.m_bounds;
+	t.m_bounds.expand(m_nodes[keep].m_bounds);
+	t.m_height = 1 + glm::max(a.m_height, m_nodes[keep].m_height);
+
+	return tall;
+}
+
+float AABBTree::getArea(const AABB& a_box)
+{
+	glm::vec3 size = a_box.m_max - a_box.m_min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Dynamic bounding volume hierarchy of AABBs. Leaves store a slightly enlarged box, so
+ *	small movements don't change the tree, and larger ones remove and reinsert the leaf.
+ *	The tree is kept balanced with rotations as leaves are inserted and removed.
+ */
+#pragma once
+#include <vector>
+#include "Bounds.h"
+
+#define NULL_NODE -1
+
+
+class AABBTree
+{
+public:
+	// a_margin is how far leaf boxes are grown on each side
+	AABBTree(float a_margin = 0.1f);
+	~AABBTree() {};
+
+	// Add a leaf, returning its proxy ID
+	int createProxy(const AABB& a_bounds, unsigned int a_userData);
+	void destroyProxy(int a_proxy);
+	// Move a leaf, reinserting it if it no longer fits in its enlarged box
+	// Returns true if it was reinserted
+	bool moveProxy(int a_proxy, const AABB& a_bounds);
+	// Change a leaf's box without changing the tree. refit() must be called before the next query
+	void setProxyBounds(int a_proxy, const AABB& a_bounds);
+	// Recalculate every internal box from its children, cheaper than reinserting but the tree gets worse over time
+	void refit();
+	void clear();
+
+	unsigned int getUserData(int a_proxy) const { return m_nodes[a_proxy].m_userData; }
+	const AABB& getFatBounds(int a_proxy) const { return m_nodes[a_proxy].m_bounds; }
+
+	///queries, each adds the user data of every leaf found to a_results
+	// Leaves touching the frustum. Leaves under a node fully inside the frustum aren't tested
+	void queryFrustum(const Frustum& a_frustum, std::vector<unsigned int>& a_results) const;
+	void querySphere(const BoundingSphere& a_sphere, std::vector<unsigned int>& a_results) const;
+	// Leaves whose boxes are hit by a ray within a_maxDistance. a_direction must be normalised
+	void queryRay(const glm::vec3& a_origin, const glm::vec3& a_direction, float a_maxDistance, std::vector<unsigned int>& a_results) const;
+
+	unsigned int getProxyCount() const { return m_proxyCount; }
+	int getHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].m_height; }
+
+protected:
+	struct Node
+	{
+		AABB m_bounds;
+		// Parent node, or the next free node when unused
+		int m_parent;
+		int m_children[2];
+		// 0 for leaves, -1 for free nodes
+		int m_height;
+		unsigned int m_userData;
+
+		bool isLeaf() const { return m_children[0] == NULL_NODE; }
+	};
+
+	int allocateNode();
+	void freeNode(int a_node);
+
+	void insertLeaf(int a_leaf);
+	void removeLeaf(int a_leaf);
+	// Rotate the tree around a_node if its children's heights are too different, returning the new root of the subtree
+	int balance(int a_node);
+	// Walk up from a_node fixing boxes and heights, balancing on the way
+	void fixUpwards(int a_node);
+
+	// Add every leaf below a_node without testing them
+	void addLeaves(int a_node, std::vector<unsigned int>& a_results) const;
+
+	// Surface area, used as the cost of a box when picking where to insert
+	static float getArea(const AABB& a_box);
+
+
+	std::vector<Node> m_nodes;
+	int m_root;
+	int m_freeList;
+	unsigned int m_proxyCount;
+	float m_margin;
+};
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "Bounds.h"
+
+//use the widest vector instructions the compiler is targeting
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULL_SSE
+#endif
+
+
+Frustum::Frustum(const glm::mat4& a_projectionView)
+{
+	//each plane is the last row of the matrix plus or minus one of the others
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(a_projectionView[0][i], a_projectionView[1][i], a_projectionView[2][i], a_projectionView[3][i]);
+	}
+	m_planes[PLANE_LEFT] = rows[3] + rows[0];
+	m_planes[PLANE_RIGHT] = rows[3] - rows[0];
+	m_planes[PLANE_BOTTOM] = rows[3] + rows[1];
+	m_planes[PLANE_TOP] = rows[3] - rows[1];
+	m_planes[PLANE_NEAR] = rows[3] + rows[2];
+	m_planes[PLANE_FAR] = rows[3] - rows[2];
+
+	//normalise so distances from the planes can be compared with radii
+	for (auto& plane : m_planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+
+bool Frustum::intersects(const BoundingSphere& a_sphere) const
+{
+	for (auto& plane : m_planes)
+	{
+		if (glm::dot(glm::vec3(plane), a_sphere.m_center) + plane.w < -a_sphere.m_radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersects(const AABB& a_box) const
+{
+	glm::vec3 center = a_box.getCenter();
+	glm::vec3 extents = a_box.getExtents();
+	for (auto& plane : m_planes)
+	{
+		//how far the box reaches towards the plane
+		float reach = glm::dot(glm::abs(glm::vec3(plane)), extents);
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -reach)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+Frustum::Containment Frustum::classify(const AABB& a_box) const
+{
+	glm::vec3 center = a_box.getCenter();
+	glm::vec3 extents = a_box.getExtents();
+	Containment result = INSIDE;
+	for (auto& plane : m_planes)
+	{
+		float reach = glm::dot(glm::abs(glm::vec3(plane)), extents);
+		float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		if (distance < -reach)
+		{
+			return OUTSIDE;
+		}
+		//crosses this plane, but could still be outside another
+		if (distance < reach)
+		{
+			result = INTERSECTING;
+		}
+	}
+	return result;
+}
+
+unsigned int Frustum::cullSpheres(const float* a_x, const float* a_y, const float* a_z, const float* a_radius, unsigned int a_count, unsigned char* a_visible) const
+{
+	unsigned int visibleCount = 0;
+	unsigned int i = 0;
+
+#if defined(CULL_AVX)
+	//8 spheres at a time, a sphere is outside if it is fully behind any plane
+	for (; i + 8 <= a_count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(a_x + i);
+		__m256 y = _mm256_loadu_ps(a_y + i);
+		__m256 z = _mm256_loadu_ps(a_z + i);
+		__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(a_radius + i));
+
+		__m256 outside = _mm256_setzero_ps();
+		for (auto& plane : m_planes)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+				_mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negRadius, _CMP_LT_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(outside);
+		for (int j = 0; j < 8; j++)
+		{
+			a_visible[i + j] = (mask >> j & 1) ? 0 : 1;
+			visibleCount += a_visible[i + j];
+		}
+	}
+#elif defined(CULL_SSE)
+	//4 spheres at a time, a sphere is outside if it is fully behind any plane
+	for (; i + 4 <= a_count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(a_x + i);
+		__m128 y = _mm_loadu_ps(a_y + i);
+		__m128 z = _mm_loadu_ps(a_z + i);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(a_radius + i));
+
+		__m128 outside = _mm_setzero_ps();
+		for (auto& plane : m_planes)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negRadius));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (int j = 0; j < 4; j++)
+		{
+			a_visible[i + j] = (mask >> j & 1) ? 0 : 1;
+			visibleCount += a_visible[i + j];
+		}
+	}
+#endif
+
+	//whatever is left over, or everything if there's no simd
+	for (; i < a_count; i++)
+	{
+		a_visible[i] = intersects(BoundingSphere(glm::vec3(a_x[i], a_y[i], a_z[i]), a_radius[i])) ? 1 : 0;
+		visibleCount += a_visible[i];
+	}
+	return visibleCount;
+}
\ No newline at end of file
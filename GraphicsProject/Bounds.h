@@ -0,0 +1,100 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Bounding volumes used for meshes and instances, and the view frustum they are culled
+ *	against. Frustum can test many spheres at once using SSE or AVX where available.
+ */
+#pragma once
+#include <glm/glm.hpp>
+#include <cfloat>
+
+
+// Axis aligned bounding box
+struct AABB
+{
+	AABB(glm::vec3 a_min = glm::vec3(FLT_MAX), glm::vec3 a_max = glm::vec3(-FLT_MAX))
+	{
+		m_min = a_min;
+		m_max = a_max;
+	}
+
+	// Grow the box to contain a point
+	void expand(const glm::vec3& a_point)
+	{
+		m_min = glm::min(m_min, a_point);
+		m_max = glm::max(m_max, a_point);
+	}
+	// Grow the box to contain another box
+	void expand(const AABB& a_other)
+	{
+		m_min = glm::min(m_min, a_other.m_min);
+		m_max = glm::max(m_max, a_other.m_max);
+	}
+
+	bool isEmpty() const { return m_min.x > m_max.x; }
+	glm::vec3 getCenter() const { return (m_min + m_max) * 0.5f; }
+	glm::vec3 getExtents() const { return (m_max - m_min) * 0.5f; }
+
+	// Box containing this one after it has been transformed
+	AABB transformed(const glm::mat4& a_transform) const
+	{
+		//the extents of the new box are the absolute value of the rotated extents
+		glm::vec3 center = glm::vec3(a_transform * glm::vec4(getCenter(), 1));
+		glm::vec3 extents = getExtents();
+		glm::vec3 newExtents = glm::abs(glm::vec3(a_transform[0])) * extents.x
+			+ glm::abs(glm::vec3(a_transform[1])) * extents.y
+			+ glm::abs(glm::vec3(a_transform[2])) * extents.z;
+		return AABB(center - newExtents, center + newExtents);
+	}
+
+	glm::vec3 m_min;
+	glm::vec3 m_max;
+};
+
+// Sphere around a mesh or instance, cheaper than an AABB to test against planes
+struct BoundingSphere
+{
+	BoundingSphere(glm::vec3 a_center = glm::vec3(0), float a_radius = 0)
+	{
+		m_center = a_center;
+		m_radius = a_radius;
+	}
+
+	// Sphere containing this one after it has been transformed
+	BoundingSphere transformed(const glm::mat4& a_transform) const
+	{
+		//scale the radius by the largest axis scale so it still contains everything
+		float scale = glm::max(glm::max(glm::length(glm::vec3(a_transform[0])), glm::length(glm::vec3(a_transform[1]))), glm::length(glm::vec3(a_transform[2])));
+		return BoundingSphere(glm::vec3(a_transform * glm::vec4(m_center, 1)), m_radius * scale);
+	}
+
+	glm::vec3 m_center;
+	float m_radius;
+};
+
+
+// Six planes facing in to a view volume, stored as (normal, distance)
+struct Frustum
+{
+	enum Side { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR };
+	enum Containment { OUTSIDE, INTERSECTING, INSIDE };
+
+	Frustum() {}
+	// Extract the planes of a projection view matrix. They are in the space the matrix transforms from,
+	// so passing projection * view * model gives a frustum in the model's local space
+	Frustum(const glm::mat4& a_projectionView);
+
+	// Does the volume touch the frustum?
+	bool intersects(const BoundingSphere& a_sphere) const;
+	bool intersects(const AABB& a_box) const;
+	// Is the box outside, partly inside, or fully inside the frustum?
+	Containment classify(const AABB& a_box) const;
+
+	// Test spheres stored as separate arrays, 8 or 4 at a time when AVX or SSE is available
+	// Sets a_visible[i] to 1 for spheres touching the frustum and 0 for the rest, and returns how many are visible
+	unsigned int cullSpheres(const float* a_x, const float* a_y, const float* a_z, const float* a_radius, unsigned int a_count, unsigned char* a_visible) const;
+
+	glm::vec4 m_planes[6];
+};
\ No newline at end of file
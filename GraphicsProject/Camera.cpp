@@ -9,6 +9,8 @@ Camera::Camera(glm::vec3 a_position, bool a_isStatic, float a_phi, float a_theta
 	m_phi = a_phi;
 	m_theta = a_theta;
 	m_isStatic = a_isStatic;
+	m_nearPlane = 0.1f;
+	m_farPlane = 1000.f;
 
 	m_lastMouseX = 0;
 	m_lastMouseY = 0;
@@ -93,5 +95,24 @@ glm::mat4 Camera::getViewMatrix() const
 
 glm::mat4 Camera::getProjectionMatrix(float a_windowWidth, float a_windowHeight) const
 {
-	return glm::perspective(glm::pi<float>() * 0.25f, a_windowWidth / a_windowHeight, 0.1f, 1000.f);
+	return glm::perspective(glm::pi<float>() * 0.25f, a_windowWidth / a_windowHeight, m_nearPlane, m_farPlane);
+}
+
+FrameContext Camera::getFrameContext(glm::vec2 a_windowSize) const
+{
+	FrameContext frame;
+	frame.m_view = getViewMatrix();
+	frame.m_projection = getProjectionMatrix(a_windowSize);
+	frame.m_projectionView = frame.m_projection * frame.m_view;
+	//the view matrix is a rotation and translation, so its inverse is the camera's transform
+	frame.m_inverseView = glm::inverse(frame.m_view);
+	frame.m_inverseProjection = glm::inverse(frame.m_projection);
+	frame.m_inverseProjectionView = frame.m_inverseView * frame.m_inverseProjection;
+	frame.m_frustum = Frustum(frame.m_projectionView);
+	frame.m_cameraPosition = m_position;
+	frame.m_cameraForward = -glm::vec3(frame.m_inverseView[2]);
+	frame.m_nearPlane = m_nearPlane;
+	frame.m_farPlane = m_farPlane;
+	frame.m_windowSize = a_windowSize;
+	return frame;
 }
@@ -1,10 +1,14 @@
 /*  Created: 11/3/2021
  *  Author: Thomas Dufresne
  *
- *  Last Modified: 8/4/2021
+ *  Last Modified: 19/10/2026
  */
 #pragma once
 #include <glm/glm.hpp>
+#include "Bounds.h"
+
+
+struct FrameContext;
 
 
 class Camera
@@ -22,16 +26,46 @@ public:
 	glm::mat4 getProjectionMatrix(float a_windowWidth, float a_windowHeight) const;
 	// Matrix used to project into clip space
 	glm::mat4 getProjectionMatrix(glm::vec2 a_windowSize) const { return getProjectionMatrix(a_windowSize.x, a_windowSize.y); }
+	// World space planes of the volume the camera can see
+	Frustum getFrustum(glm::vec2 a_windowSize) const { return Frustum(getProjectionMatrix(a_windowSize) * getViewMatrix()); }
+	// Every matrix and plane derived from the camera this frame, calculated together
+	FrameContext getFrameContext(glm::vec2 a_windowSize) const;
 
 	bool isCameraStatic() const { return m_isStatic; }
+	// Distances to the near and far clip planes
+	float getNearPlane() const { return m_nearPlane; }
+	float getFarPlane() const { return m_farPlane; }
 	
 private:
 	float m_theta;	//in degrees
 	float m_phi;	//in degrees
 
 	glm::vec3 m_position;
+	float m_nearPlane;
+	float m_farPlane;
 	// A static camera can not move or rotate
 	bool m_isStatic;
 
 	float m_lastMouseX, m_lastMouseY;
-};
\ No newline at end of file
+};
+
+
+// Camera matrices for a frame, built once and read by everything drawn with that camera
+// instead of each recalculating them
+struct FrameContext
+{
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+	glm::mat4 m_projectionView;
+	glm::mat4 m_inverseView;
+	glm::mat4 m_inverseProjection;
+	glm::mat4 m_inverseProjectionView;
+	// World space planes of the volume the camera can see
+	Frustum m_frustum;
+	glm::vec3 m_cameraPosition;
+	// Direction the camera is facing, with view depth measured along it
+	glm::vec3 m_cameraForward;
+	float m_nearPlane;
+	float m_farPlane;
+	glm::vec2 m_windowSize;
+};
@@ -0,0 +1,145 @@
+#include "FileWatcher.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+//how often modification times are compared when inotify isn't available
+static const std::chrono::milliseconds pollInterval(250);
+
+
+FileWatcher::FileWatcher()
+{
+	m_inotify = -1;
+#ifdef __linux__
+	//non-blocking, so reading with no events waiting returns straight away
+	m_inotify = inotify_init1(IN_NONBLOCK);
+#endif
+	m_lastPoll = std::chrono::steady_clock::now();
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (m_inotify >= 0)
+	{
+		close(m_inotify);
+	}
+#endif
+}
+
+
+void FileWatcher::addFile(const std::string& a_path)
+{
+	for (auto& file : m_files)
+	{
+		if (file.m_path == a_path)
+		{
+			return;
+		}
+	}
+
+	WatchedFile file;
+	file.m_path = a_path;
+	size_t split = a_path.find_last_of("/\\");
+	file.m_directory = split == std::string::npos ? "." : a_path.substr(0, split);
+	file.m_name = split == std::string::npos ? a_path : a_path.substr(split + 1);
+	file.m_lastModified = getModifiedTime(a_path);
+	m_files.push_back(file);
+
+#ifdef __linux__
+	//inotify watches folders, since editors often replace files instead of writing to them
+	if (m_inotify >= 0)
+	{
+		for (auto& watch : m_directoryWatches)
+		{
+			if (watch.second == file.m_directory)
+			{
+				return;
+			}
+		}
+
+		int watch = inotify_add_watch(m_inotify, file.m_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (watch >= 0)
+		{
+			m_directoryWatches.push_back(std::make_pair(watch, file.m_directory));
+		}
+	}
+#endif
+}
+
+std::vector<std::string> FileWatcher::getChangedFiles()
+{
+	std::vector<std::string> changed;
+
+#ifdef __linux__
+	if (m_inotify >= 0)
+	{
+		//read every waiting event
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + ((inotify_event*)ptr)->len)
+			{
+				inotify_event* event = (inotify_event*)ptr;
+				if (event->len == 0)
+				{
+					continue;
+				}
+
+				//find the folder the event came from, then the file in it
+				for (auto& watch : m_directoryWatches)
+				{
+					if (watch.first != event->wd)
+					{
+						continue;
+					}
+					for (auto& file : m_files)
+					{
+						if (file.m_directory == watch.second && file.m_name == event->name &&
+							std::find(changed.begin(), changed.end(), file.m_path) == changed.end())
+						{
+							changed.push_back(file.m_path);
+						}
+					}
+				}
+			}
+		}
+		return changed;
+	}
+#endif
+
+	//without inotify, compare modification times every so often
+	auto now = std::chrono::steady_clock::now();
+	if (now - m_lastPoll < pollInterval)
+	{
+		return changed;
+	}
+	m_lastPoll = now;
+
+	for (auto& file : m_files)
+	{
+		long long modified = getModifiedTime(file.m_path);
+		if (modified != file.m_lastModified)
+		{
+			file.m_lastModified = modified;
+			changed.push_back(file.m_path);
+		}
+	}
+	return changed;
+}
+
+long long FileWatcher::getModifiedTime(const std::string& a_path)
+{
+	struct stat info;
+	if (stat(a_path.c_str(), &info) != 0)
+	{
+		return -1;
+	}
+	return (long long)info.st_mtime;
+}
\ No newline at end of file
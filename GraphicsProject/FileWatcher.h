@@ -0,0 +1,50 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Reports when watched files are written to. Uses inotify on Linux so nothing is
+ *	checked until the OS reports a change, other platforms compare modification times
+ *	a few times a second.
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+
+
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	// Start watching a file. Adding the same file twice does nothing
+	void addFile(const std::string& a_path);
+
+	// Get every watched file that has changed since the last call
+	std::vector<std::string> getChangedFiles();
+
+protected:
+	struct WatchedFile
+	{
+		std::string m_path;
+		//folder and name, used to match inotify events
+		std::string m_directory;
+		std::string m_name;
+		long long m_lastModified;
+	};
+
+	// Modification time of a file, or -1 if it can't be read
+	static long long getModifiedTime(const std::string& a_path);
+
+
+	std::vector<WatchedFile> m_files;
+
+	//inotify handle and a watch for each folder, unused on other platforms
+	int m_inotify;
+	std::vector<std::pair<int, std::string>> m_directoryWatches;
+
+	// Used to limit how often modification times are checked
+	std::chrono::steady_clock::time_point m_lastPoll;
+};
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "GBuffer.h"
+#include "ShaderLibrary.h"
+#include "Shader.h"
+#include "Camera.h"
+#include <gl_core_4_4.h>
+#include <cstdio>
+
+//formats of each target, in the order of GBuffer::Target
+static const GLenum g_targetFormats[] = { GL_RGBA8, GL_RGBA8, GL_RG16F, GL_R11F_G11F_B10F };
+static const unsigned int g_targetBytes[] = { 4, 4, 4, 4 };
+//depth is sampled when lighting to find each pixel's position
+#define DEPTH_FORMAT GL_DEPTH_COMPONENT32F
+#define DEPTH_BYTES 4
+
+
+GBuffer::GBuffer()
+{
+	m_program = ShaderLibrary::getInstance()->load("Deferred Lighting", "./shaders/deferred.vert", "./shaders/deferred.frag");
+	aie::PipelineState::Desc state;
+	state.blend = aie::PipelineState::BLEND_NONE;
+	state.depthTest = aie::PipelineState::DEPTH_ALWAYS;
+	m_lightState = aie::PipelineState(state);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	for (auto& target : m_targets)
+	{
+		target = 0;
+	}
+	m_depthTexture = 0;
+	m_size = glm::ivec2(0);
+	glGenVertexArrays(1, &m_emptyVertexArray);
+
+	glGenQueries(3, m_timestamps);
+	m_timerPending = false;
+	m_timing = false;
+	m_geometryMS = 0;
+	m_lightingMS = 0;
+}
+
+GBuffer::~GBuffer()
+{
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteTextures(TARGET_COUNT, m_targets);
+	glDeleteTextures(1, &m_depthTexture);
+	glDeleteVertexArrays(1, &m_emptyVertexArray);
+	glDeleteQueries(3, m_timestamps);
+}
+
+bool GBuffer::isReady() const
+{
+	return m_program->isReady();
+}
+
+
+void GBuffer::begin(glm::ivec2 a_size)
+{
+	if (a_size != m_size)
+	{
+		resize(a_size);
+	}
+
+	//timestamps can be written while the app's elapsed time query is running, unlike a second query
+	updateTimers();
+	m_timing = !m_timerPending;
+	if (m_timing)
+	{
+		glQueryCounter(m_timestamps[0], GL_TIMESTAMP);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::light(unsigned int a_framebuffer, const FrameContext& a_frame)
+{
+	if (m_timing)
+	{
+		glQueryCounter(m_timestamps[1], GL_TIMESTAMP);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, a_framebuffer);
+	for (unsigned int i = 0; i < TARGET_COUNT; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, m_targets[i]);
+	}
+	glActiveTexture(GL_TEXTURE0 + TARGET_COUNT);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+
+	m_program->bind();
+	m_program->bindUniform(m_program->getUniform("AlbedoTexture"), (int)TARGET_ALBEDO);
+	m_program->bindUniform(m_program->getUniform("SpecularTexture"), (int)TARGET_SPECULAR);
+	m_program->bindUniform(m_program->getUniform("NormalTexture"), (int)TARGET_NORMAL);
+	m_program->bindUniform(m_program->getUniform("EmissiveTexture"), (int)TARGET_EMISSIVE);
+	m_program->bindUniform(m_program->getUniform("DepthTexture"), (int)TARGET_COUNT);
+	m_program->bindUniform(m_program->getUniform("InverseProjectionView"), a_frame.m_inverseProjectionView);
+
+	m_lightState.apply();
+	glBindVertexArray(m_emptyVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	//unbound so nothing samples the targets while they're drawn to next frame
+	for (unsigned int i = 0; i <= TARGET_COUNT; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	if (m_timing)
+	{
+		glQueryCounter(m_timestamps[2], GL_TIMESTAMP);
+		m_timing = false;
+		m_timerPending = true;
+	}
+}
+
+unsigned int GBuffer::getBytesPerPixel()
+{
+	unsigned int bytes = DEPTH_BYTES;
+	for (auto targetBytes : g_targetBytes)
+	{
+		bytes += targetBytes;
+	}
+	return bytes;
+}
+
+
+void GBuffer::resize(glm::ivec2 a_size)
+{
+	glDeleteTextures(TARGET_COUNT, m_targets);
+	glDeleteTextures(1, &m_depthTexture);
+	m_size = a_size;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	GLenum drawBuffers[TARGET_COUNT];
+	glGenTextures(TARGET_COUNT, m_targets);
+	for (unsigned int i = 0; i < TARGET_COUNT; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, m_targets[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, g_targetFormats[i], m_size.x, m_size.y);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, m_targets[i], 0);
+		drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+	}
+	glDrawBuffers(TARGET_COUNT, drawBuffers);
+
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, DEPTH_FORMAT, m_size.x, m_size.y);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("G-buffer framebuffer incomplete\n");
+	}
+}
+
+void GBuffer::updateTimers()
+{
+	if (!m_timerPending)
+	{
+		return;
+	}
+
+	//the last timestamp is written last, so the others are ready once it is
+	GLint available = 0;
+	glGetQueryObjectiv(m_timestamps[2], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		return;
+	}
+	GLuint64 times[3];
+	for (int i = 0; i < 3; i++)
+	{
+		glGetQueryObjectui64v(m_timestamps[i], GL_QUERY_RESULT, &times[i]);
+	}
+	m_geometryMS = (times[1] - times[0]) / 1000000.f;
+	m_lightingMS = (times[2] - times[1]) / 1000000.f;
+	m_timerPending = false;
+}
\ No newline at end of file
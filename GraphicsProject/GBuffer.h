@@ -0,0 +1,85 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Render targets and lighting pass for deferred shading. Opaque instances are drawn with
+ *	the DEFERRED variants of their shaders, which write albedo, specular, an octahedral
+ *	normal, and their ambient and emissive light in to compact targets instead of lighting.
+ *	A full screen pass then lights every pixel once, using the light clusters to find the
+ *	point lights reaching it, and writes the result and depth in to the target framebuffer.
+ *	Both passes are timed on the GPU with timestamps, read back once they're available.
+ */
+#pragma once
+#include <glm/glm.hpp>
+#include "PipelineState.h"
+
+struct FrameContext;
+namespace aie
+{
+	class ShaderProgram;
+}
+
+
+class GBuffer
+{
+public:
+	GBuffer();
+	~GBuffer();
+
+	// The lighting program is compiled through the shader library, nothing can be lit until it links
+	bool isReady() const;
+
+	// Bind the targets for drawing opaque geometry, resizing them to a_size if needed
+	// Only depth is cleared, pixels nothing was drawn to are skipped when lighting
+	void begin(glm::ivec2 a_size);
+	// Light every drawn pixel in to a_framebuffer, writing their depth too, and leave it bound
+	// Light clusters and the frame and light uniform blocks must be bound
+	void light(unsigned int a_framebuffer, const FrameContext& a_frame);
+
+	// Bytes written per pixel when drawing, including depth. Lighting reads the same again
+	static unsigned int getBytesPerPixel();
+	glm::ivec2 getSize() const { return m_size; }
+	// GPU time of each pass, from a frame or more ago
+	float getGeometryTime() const { return m_geometryMS; }
+	float getLightingTime() const { return m_lightingMS; }
+
+protected:
+	// Create the targets and framebuffer at a new size
+	void resize(glm::ivec2 a_size);
+	// Pick up the last timestamps once the GPU has written them. Never waits
+	void updateTimers();
+
+	// Targets, in the order of the deferred shaders' outputs
+	enum Target
+	{
+		// rgb albedo, a log encoded specular power
+		TARGET_ALBEDO,
+		// rgb specular color
+		TARGET_SPECULAR,
+		// octahedral encoded world space normal
+		TARGET_NORMAL,
+		// ambient and emissive light, which don't depend on any light source
+		TARGET_EMISSIVE,
+		TARGET_COUNT
+	};
+
+	aie::ShaderProgram* m_program;
+	// The lighting pass writes the depth it read, so forward draws after it are hidden correctly
+	aie::PipelineState m_lightState;
+	unsigned int m_framebuffer;
+	unsigned int m_targets[TARGET_COUNT];
+	unsigned int m_depthTexture;
+	glm::ivec2 m_size;
+	// Full screen triangles are made in the vertex shader, but something must be bound to draw
+	unsigned int m_emptyVertexArray;
+
+	///timing
+	// Before the geometry pass, between the passes, and after lighting
+	unsigned int m_timestamps[3];
+	bool m_timerPending;
+	// Set while a frame's timestamps are being written
+	bool m_timing;
+	float m_geometryMS;
+	float m_lightingMS;
+};
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "GPUCuller.h"
+#include "InstanceStore.h"
+#include "ShaderLibrary.h"
+#include "Shader.h"
+#include <gl_core_4_4.h>
+#include <algorithm>
+
+//must match local_size_x in cull.comp
+#define CULL_GROUP_SIZE 64
+
+
+GPUCuller::GPUCuller()
+{
+	//the command pass is the same file, so both compile while the scene loads
+	m_cullProgram = ShaderLibrary::getInstance()->loadCompute("GPU Cull", "./shaders/cull.comp");
+	m_commandProgram = ShaderLibrary::getInstance()->loadCompute("GPU Cull Commands", "./shaders/cull.comp", { "WRITE_COMMANDS" });
+
+	unsigned int* buffers[] = { &m_transformBuffer, &m_tintBuffer, &m_sphereBuffer, &m_instanceInfoBuffer, &m_batchGroupBuffer,
+		&m_groupBuffer, &m_commandGroupBuffer, &m_commandBuffer, &m_visibleIndexBuffer };
+	for (auto buffer : buffers)
+	{
+		glGenBuffers(1, buffer);
+	}
+	m_transformCapacity = 0;
+	m_tintCapacity = 0;
+	m_sphereCapacity = 0;
+	m_instanceInfoCapacity = 0;
+	m_batchGroupCapacity = 0;
+	m_groupCapacity = 0;
+	m_commandGroupCapacity = 0;
+	m_commandCapacity = 0;
+	m_visibleIndexCapacity = 0;
+	m_outputCapacity = 0;
+	m_instanceCount = 0;
+}
+
+GPUCuller::~GPUCuller()
+{
+	unsigned int buffers[] = { m_transformBuffer, m_tintBuffer, m_sphereBuffer, m_instanceInfoBuffer, m_batchGroupBuffer,
+		m_groupBuffer, m_commandGroupBuffer, m_commandBuffer, m_visibleIndexBuffer };
+	glDeleteBuffers(9, buffers);
+}
+
+
+bool GPUCuller::isReady() const
+{
+	return m_cullProgram->isReady() && m_commandProgram->isReady();
+}
+
+void GPUCuller::setInstances(const InstanceStore& a_instances, const std::vector<unsigned int>& a_batches, bool a_batchesChanged)
+{
+	m_instanceCount = a_instances.getCount();
+	if (m_instanceCount == 0)
+	{
+		return;
+	}
+
+	//the store's arrays are already laid out the way the shader reads them
+	uploadBuffer(m_transformBuffer, m_transformCapacity, m_instanceCount * sizeof(glm::mat4), a_instances.getTransforms().data());
+	uploadBuffer(m_tintBuffer, m_tintCapacity, m_instanceCount * sizeof(glm::vec4), a_instances.getDiffuseTints().data());
+
+	//sphere arrays go one after the other in a single buffer
+	const std::vector<float>* sphereArrays[] = { &a_instances.getSphereX(), &a_instances.getSphereY(), &a_instances.getSphereZ(), &a_instances.getSphereRadius() };
+	unsigned int arraySize = m_instanceCount * sizeof(float);
+	uploadBuffer(m_sphereBuffer, m_sphereCapacity, arraySize * 4, nullptr);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_sphereBuffer);
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		glBufferSubData(GL_COPY_WRITE_BUFFER, arraySize * i, arraySize, sphereArrays[i]->data());
+	}
+
+	//batches only change with the store's layout, flags are written every time
+	if (a_batchesChanged || m_batches.size() != m_instanceCount)
+	{
+		m_batches = a_batches;
+		uploadBuffer(m_instanceInfoBuffer, m_instanceInfoCapacity, arraySize * 2, nullptr);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_instanceInfoBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, arraySize, m_batches.data());
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_instanceInfoBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, arraySize, arraySize, a_instances.getFlags().data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GPUCuller::setGroups(const std::vector<unsigned int>& a_batchGroups, const std::vector<unsigned int>& a_groupSizes)
+{
+	m_batchGroups = a_batchGroups;
+	if (!m_batchGroups.empty())
+	{
+		uploadBuffer(m_batchGroupBuffer, m_batchGroupCapacity, (unsigned int)m_batchGroups.size() * sizeof(unsigned int), m_batchGroups.data());
+	}
+
+	//each group gets enough room for every one of its instances
+	m_groups.resize(a_groupSizes.size() * 2);
+	m_outputCapacity = 0;
+	for (unsigned int i = 0; i < a_groupSizes.size(); i++)
+	{
+		m_groups[i * 2] = m_outputCapacity;
+		m_groups[i * 2 + 1] = 0;
+		m_outputCapacity += a_groupSizes[i];
+	}
+}
+
+void GPUCuller::setCommands(const std::vector<DrawElementsIndirectCommand>& a_commands, const std::vector<unsigned int>& a_commandGroups)
+{
+	m_commands = a_commands;
+	m_commandGroups = a_commandGroups;
+	if (m_commands.empty())
+	{
+		return;
+	}
+
+	uploadBuffer(m_commandBuffer, m_commandCapacity, (unsigned int)m_commands.size() * sizeof(DrawElementsIndirectCommand), m_commands.data());
+	uploadBuffer(m_commandGroupBuffer, m_commandGroupCapacity, (unsigned int)m_commandGroups.size() * sizeof(unsigned int), m_commandGroups.data());
+}
+
+void GPUCuller::cull(const Frustum& a_frustum, unsigned int a_instanceBuffer, unsigned int a_outputOffset)
+{
+	m_frustum = a_frustum;
+	if (!isReady() || m_instanceCount == 0 || m_commands.empty() || m_outputCapacity == 0)
+	{
+		return;
+	}
+
+	//group counts start at 0 every cull
+	uploadBuffer(m_groupBuffer, m_groupCapacity, (unsigned int)m_groups.size() * sizeof(unsigned int), m_groups.data());
+	uploadBuffer(m_visibleIndexBuffer, m_visibleIndexCapacity, m_outputCapacity * sizeof(unsigned int), nullptr);
+
+	//one thread per instance
+	m_cullProgram->bind();
+	m_cullProgram->bindUniform(m_cullProgram->getUniform("Planes"), 6, a_frustum.m_planes);
+	m_cullProgram->bindUniform(m_cullProgram->getUniform("InstanceCount"), (int)m_instanceCount);
+	m_cullProgram->bindUniform(m_cullProgram->getUniform("OutputOffset"), (int)a_outputOffset);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_transformBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_tintBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_sphereBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_instanceInfoBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_batchGroupBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_groupBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, a_instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, m_visibleIndexBuffer);
+	glDispatchCompute((m_instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	//group counts have to be final before they're copied
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	//one thread per command
+	unsigned int commandCount = getCommandCount();
+	m_commandProgram->bind();
+	m_commandProgram->bindUniform(m_commandProgram->getUniform("CommandCount"), (int)commandCount);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_commandGroupBuffer);
+	glDispatchCompute((commandCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	//the results are read as vertex attributes and indirect commands
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+	}
+}
+
+unsigned int GPUCuller::verify(const InstanceStore& a_instances) const
+{
+	if (!isReady() || m_commands.empty() || m_outputCapacity == 0 || m_instanceCount != a_instances.getCount())
+	{
+		return 0;
+	}
+
+	//wait for the GPU and read everything back
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	std::vector<DrawElementsIndirectCommand> commands(m_commands.size());
+	std::vector<unsigned int> groups(m_groups.size());
+	std::vector<unsigned int> visibleIndices(m_outputCapacity);
+	glBindBuffer(GL_COPY_READ_BUFFER, m_commandBuffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, m_groupBuffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, groups.size() * sizeof(unsigned int), groups.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, m_visibleIndexBuffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, visibleIndices.size() * sizeof(unsigned int), visibleIndices.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	std::vector<std::vector<unsigned int>> expected;
+	cullReference(a_instances, expected);
+
+	//spheres touching a plane can land either side of it because of float differences, so they don't count
+	auto isBorderline = [&](unsigned int a_index)
+	{
+		glm::vec3 center(a_instances.getSphereX()[a_index], a_instances.getSphereY()[a_index], a_instances.getSphereZ()[a_index]);
+		for (auto& plane : m_frustum.m_planes)
+		{
+			float distance = glm::dot(glm::vec3(plane), center) + plane.w + a_instances.getSphereRadius()[a_index];
+			if (glm::abs(distance) < 1e-3f * (1 + glm::abs(plane.w)))
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	unsigned int differences = 0;
+	for (unsigned int group = 0; group < expected.size(); group++)
+	{
+		//slots are claimed in any order, so the instances are sorted before comparing
+		unsigned int offset = m_groups[group * 2];
+		unsigned int count = glm::min(groups[group * 2 + 1], m_outputCapacity - offset);
+		std::vector<unsigned int> found(visibleIndices.begin() + offset, visibleIndices.begin() + offset + count);
+		std::sort(found.begin(), found.end());
+
+		std::vector<unsigned int> different;
+		std::set_symmetric_difference(found.begin(), found.end(), expected[group].begin(), expected[group].end(), std::back_inserter(different));
+		for (auto index : different)
+		{
+			differences += index < m_instanceCount && isBorderline(index) ? 0 : 1;
+		}
+
+		//every command of the group should draw all of its instances
+		for (unsigned int i = 0; i < commands.size(); i++)
+		{
+			if (m_commandGroups[i] == group && commands[i].m_instanceCount != count)
+			{
+				differences++;
+			}
+		}
+	}
+	return differences;
+}
+
+
+void GPUCuller::cullReference(const InstanceStore& a_instances, std::vector<std::vector<unsigned int>>& a_groupInstances) const
+{
+	a_groupInstances.assign(m_groups.size() / 2, std::vector<unsigned int>());
+	const std::vector<unsigned int>& flags = a_instances.getFlags();
+	for (unsigned int i = 0; i < m_instanceCount; i++)
+	{
+		unsigned int group = m_batchGroups[m_batches[i]];
+		if (group == NO_CULL_GROUP || (flags[i] & INSTANCE_VISIBLE) == 0)
+		{
+			continue;
+		}
+
+		BoundingSphere sphere(glm::vec3(a_instances.getSphereX()[i], a_instances.getSphereY()[i], a_instances.getSphereZ()[i]), a_instances.getSphereRadius()[i]);
+		if (m_frustum.intersects(sphere))
+		{
+			a_groupInstances[group].push_back(i);
+		}
+	}
+}
+
+void GPUCuller::uploadBuffer(unsigned int a_buffer, unsigned int& a_capacity, unsigned int a_size, const void* a_data)
+{
+	//orphaned each time, so the GPU can keep reading the last frame's data
+	a_capacity = glm::max(a_capacity, a_size);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, a_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, a_capacity, nullptr, GL_STREAM_DRAW);
+	if (a_data != nullptr)
+	{
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, a_size, a_data);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Culls instances against the camera in a compute shader. Instances are read straight from
+ *	the instance store's arrays, and visible ones are packed in to the instance buffer by
+ *	group with an atomic counter. A second dispatch copies each group's count in to its
+ *	indirect draw commands, so the CPU never sees which instances are visible. The same cull
+ *	can be run on the CPU to check the results.
+ */
+#pragma once
+#include <vector>
+#include "Bounds.h"
+#include "MeshPool.h"
+
+class InstanceStore;
+namespace aie
+{
+	class ShaderProgram;
+}
+
+// Group of batches that aren't culled on the GPU
+#define NO_CULL_GROUP 0xffffffff
+
+
+class GPUCuller
+{
+public:
+	GPUCuller();
+	~GPUCuller();
+
+	// Compute programs are compiled through the shader library, nothing can be culled until they link
+	bool isReady() const;
+
+	///inputs, set before each cull
+	// Upload every instance in the store. a_batches is the batch of each instance, only uploaded when a_batchesChanged
+	void setInstances(const InstanceStore& a_instances, const std::vector<unsigned int>& a_batches, bool a_batchesChanged);
+	// Group of each batch, NO_CULL_GROUP for batches that aren't culled here. a_groupSizes is the number of instances in each group
+	void setGroups(const std::vector<unsigned int>& a_batchGroups, const std::vector<unsigned int>& a_groupSizes);
+	// Indirect commands and the group each draws. Instance counts are filled in when culling
+	// Base instances must include the output offset passed to cull()
+	void setCommands(const std::vector<DrawElementsIndirectCommand>& a_commands, const std::vector<unsigned int>& a_commandGroups);
+
+	// Write visible instances in to a_instanceBuffer from a_outputOffset, grouped, and fill in the command instance counts
+	void cull(const Frustum& a_frustum, unsigned int a_instanceBuffer, unsigned int a_outputOffset);
+
+	// Buffer of DrawElementsIndirectCommand to draw from after culling
+	unsigned int getCommandBuffer() const { return m_commandBuffer; }
+	unsigned int getCommandCount() const { return (unsigned int)m_commandGroups.size(); }
+	// Number of instances that can be written, the instance buffer needs room for this many after the output offset
+	unsigned int getOutputCapacity() const { return m_outputCapacity; }
+
+	// Run the last cull on the CPU and compare it with what the GPU wrote. Reading the results back
+	// stalls, so this is only for testing. Returns the number of commands and instances that differ
+	unsigned int verify(const InstanceStore& a_instances) const;
+
+protected:
+	// Same test as the compute shader. Fills in the visible instances of each group, in index order
+	void cullReference(const InstanceStore& a_instances, std::vector<std::vector<unsigned int>>& a_groupInstances) const;
+	// Upload to a buffer, growing it if needed. Sizes are in bytes
+	static void uploadBuffer(unsigned int a_buffer, unsigned int& a_capacity, unsigned int a_size, const void* a_data);
+
+
+	aie::ShaderProgram* m_cullProgram;
+	aie::ShaderProgram* m_commandProgram;
+
+	///input buffers, see cull.comp for their layouts
+	unsigned int m_transformBuffer;
+	unsigned int m_tintBuffer;
+	unsigned int m_sphereBuffer;
+	unsigned int m_instanceInfoBuffer;
+	unsigned int m_batchGroupBuffer;
+	unsigned int m_groupBuffer;
+	unsigned int m_commandGroupBuffer;
+	unsigned int m_transformCapacity;
+	unsigned int m_tintCapacity;
+	unsigned int m_sphereCapacity;
+	unsigned int m_instanceInfoCapacity;
+	unsigned int m_batchGroupCapacity;
+	unsigned int m_groupCapacity;
+	unsigned int m_commandGroupCapacity;
+
+	///outputs
+	unsigned int m_commandBuffer;
+	unsigned int m_visibleIndexBuffer;
+	unsigned int m_commandCapacity;
+	unsigned int m_visibleIndexCapacity;
+	unsigned int m_outputCapacity;
+
+	// CPU copies of the inputs, for the reference cull
+	unsigned int m_instanceCount;
+	std::vector<unsigned int> m_batches;
+	std::vector<unsigned int> m_batchGroups;
+	// Offset and count of each group, laid out like the shader's Group struct
+	std::vector<unsigned int> m_groups;
+	std::vector<DrawElementsIndirectCommand> m_commands;
+	std::vector<unsigned int> m_commandGroups;
+	Frustum m_frustum;
+};
\ No newline at end of file
@@ -2,14 +2,23 @@
 #include "Gizmos.h"
 #include "Input.h"
 #include <imgui.h>
+#include <gl_core_4_4.h>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
+#include <chrono>
+#include <thread>
 
 #include "Scene.h"
 #include "Instance.h"
 #include "Camera.h"
 #include "Shader.h"
+#include "ShaderLibrary.h"
 #include "ParticleGenerator.h"
+#include "AABBTree.h"
+#include "ThreadPool.h"
+
+//frames each benchmark times once the scene has settled
+#define BENCHMARK_FRAMES 10
 
 
 GraphicsProjectApp::GraphicsProjectApp()
@@ -26,6 +35,8 @@ bool GraphicsProjectApp::startup()
 
 	//initialise gizmo primitive counts
 	aie::Gizmos::create(10000, 10000, 10000, 10000);
+	//shaders are compiled in the background from here on
+	ShaderLibrary::create();
 
 	//create cameras (1 movable, 3 static)
 	std::vector<Camera*> cams = std::vector<Camera*>();
@@ -37,13 +48,23 @@ bool GraphicsProjectApp::startup()
 	//create new scene
 	m_scene = new Scene(cams, glm::vec2(getWindowWidth(), getWindowHeight()), glm::vec3(.5f));
 	//add lights
-	m_scene->addLight(new DirectionalLight(glm::vec3(1, 0, 0), glm::vec3(1)));
+	m_scene->addLight(new DirectionalLight(glm::vec3(1, 0, 0), glm::vec3(1), true));
 	m_scene->addLight(new DirectionalLight(glm::vec3(0, 0, 1), glm::vec3(0, 1, 0)));
 	m_scene->addLight(new PointLight(glm::vec3(0), 30, 2, glm::vec3(1, 0, 0)));
 
 	//create particle generator
 	m_particleGen = new ParticleGenerator(glm::vec3(0, 0, -3), m_scene, 65);
 	m_particleGen->setup(30, 2, glm::vec4(1, 0.2f, 0, 0.8f), glm::vec4(1, 1, 0, 0), glm::vec3(0, 1.2f, 0), 0.5f, 0.6f, 0.1f);
+
+	//scene timers for the instancing benchmark
+	glGenQueries(1, &m_sceneTimerQuery);
+	glGenQueries(1, &m_benchmarkQuery);
+	m_sceneTimerPending = false;
+	m_sceneCpuMS = 0;
+	m_sceneGpuMS = 0;
+	m_gpuCullingDifferences = -1;
+	m_pipelineApplyCount = 0;
+	m_pipelineChangeCount = 0;
 	
 	//create mesh objects
 	return loadShaderAndMeshLogic();
@@ -54,7 +75,11 @@ void GraphicsProjectApp::shutdown()
 	aie::Gizmos::destroy();
 	delete m_scene;
 
+	glDeleteQueries(1, &m_sceneTimerQuery);
+	glDeleteQueries(1, &m_benchmarkQuery);
+
 	delete m_particleGen;
+	ShaderLibrary::destroy();
 }
 
 
@@ -62,12 +87,19 @@ void GraphicsProjectApp::update(float a_deltaTime)
 {
 	aie::Input* input = aie::Input::getInstance();
 
+	//check on shaders that are still compiling
+	ShaderLibrary::getInstance()->update();
+
 	//update GUI tools
 	IMGUI_Logic();
 
-	//rotate light
+	//rotate light, unless it casts shadows. Turning the shadow light redraws every cached shadow tile
 	float time = getTime();
-	m_scene->getDirectionalLights()[0]->m_direction = glm::normalize(glm::vec3(glm::cos(time * 2), 0, glm::sin(time * 2)));
+	DirectionalLight* rotatingLight = m_scene->getDirectionalLights()[0];
+	if (!rotatingLight->m_castShadows)
+	{
+		rotatingLight->m_direction = glm::normalize(glm::vec3(glm::cos(time * 2), 0, glm::sin(time * 2)));
+	}
 
 	//update current camera
 	m_scene->getCurrentCamera()->update(a_deltaTime);
@@ -84,29 +116,114 @@ void GraphicsProjectApp::update(float a_deltaTime)
 void GraphicsProjectApp::draw()
 {
 	//clear the screen
+	aie::PipelineState::resetCounts();
 	clearScreen();
 	aie::Gizmos::clear();
 
-	//get camera matrices
-	glm::mat4 projectionMatrix = m_scene->getCurrentCamera()->getProjectionMatrix(getWindowWidth(), getWindowHeight());
-	glm::mat4 viewMatrix = m_scene->getCurrentCamera()->getViewMatrix();
-
 	//draw gizmo for point lights
 	for (auto pointLight : m_scene->getPointLights())
 	{
 		aie::Gizmos::addSphere(pointLight->m_position, 0.2f, 6, 6, glm::vec4(pointLight->m_color, 1));
 	}
 
+	//collect the gpu time from an earlier frame once it's available
+	if (m_sceneTimerPending)
+	{
+		int available = 0;
+		glGetQueryObjectiv(m_sceneTimerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(m_sceneTimerQuery, GL_QUERY_RESULT, &nanoseconds);
+			m_sceneGpuMS = nanoseconds / 1000000.f;
+			m_sceneTimerPending = false;
+		}
+	}
+	bool startTimer = !m_sceneTimerPending;
+	if (startTimer)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_sceneTimerQuery);
+	}
+
 	//draw
+	auto drawStart = std::chrono::high_resolution_clock::now();
 	m_scene->draw();
+	m_sceneCpuMS = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - drawStart).count();
+
+	if (startTimer)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_sceneTimerPending = true;
+	}
 	m_particleGen->draw();
 
-	aie::Gizmos::draw(projectionMatrix * viewMatrix);
+	//gizmos use the matrices the scene was drawn with
+	aie::Gizmos::draw(m_scene->getFrameContext().m_projectionView);
+
+	m_pipelineApplyCount = aie::PipelineState::getApplyCount();
+	m_pipelineChangeCount = aie::PipelineState::getChangeCount();
+}
+
+int GraphicsProjectApp::test()
+{
+	//nothing is culled on the GPU until the compute and instanced programs have linked
+	while (ShaderLibrary::getInstance()->isCompiling())
+	{
+		ShaderLibrary::getInstance()->update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	m_scene->setCullMode(Scene::CULL_GPU);
+
+	int differences = 0;
+	unsigned int counts[] = { 1000, 10000, 100000 };
+	for (auto count : counts)
+	{
+		//the first draw uploads the new instances, the second culls them with nothing left to change
+		setBenchmarkInstanceCount(count);
+		m_scene->draw();
+		m_scene->draw();
+		if (m_scene->getGPUCulledCount() == 0)
+		{
+			printf("GPU culling, %d instances: nothing was culled on the GPU\n", count);
+			return -1;
+		}
+		unsigned int found = m_scene->verifyGPUCulling();
+		printf("GPU culling, %d instances: %d differences from the CPU\n", m_scene->getGPUCulledCount(), found);
+		differences += (int)found;
+	}
+	return differences;
 }
 
 
 bool GraphicsProjectApp::loadShaderAndMeshLogic()
 {
+#pragma region Shaders
+	//submit shaders first so they compile while the meshes load
+	aie::ShaderProgram* phongShader = ShaderLibrary::getInstance()->load("Phong", "./shaders/phong.vert", "./shaders/phong.frag");
+	aie::ShaderProgram* normalShader = ShaderLibrary::getInstance()->load("Normal Map", "./shaders/normalMap.vert", "./shaders/normalMap.frag");
+	//instanced variants, used by the scene to draw instances sharing a mesh together
+	aie::ShaderProgram* phongInstanced = ShaderLibrary::getInstance()->load("Phong Instanced", "./shaders/phong.vert", "./shaders/phong.frag", { "INSTANCED" });
+	aie::ShaderProgram* normalInstanced = ShaderLibrary::getInstance()->load("Normal Map Instanced", "./shaders/normalMap.vert", "./shaders/normalMap.frag", { "INSTANCED" });
+	//instanced variants reading materials from the scene's table, so draws of different materials combine
+	aie::ShaderProgram* phongTable = ShaderLibrary::getInstance()->load("Phong Material Table", "./shaders/phong.vert", "./shaders/phong.frag", { "INSTANCED", "MATERIAL_TABLE" });
+	aie::ShaderProgram* normalTable = ShaderLibrary::getInstance()->load("Normal Map Material Table", "./shaders/normalMap.vert", "./shaders/normalMap.frag", { "INSTANCED", "MATERIAL_TABLE" });
+	m_litShaders[0] = phongShader;
+	m_litShaders[1] = normalShader;
+	m_instancedShaders[0] = phongInstanced;
+	m_instancedShaders[1] = normalInstanced;
+	m_tableShaders[0] = phongTable;
+	m_tableShaders[1] = normalTable;
+	setMaterialTableEnabled(true);
+	//deferred variants write to the g-buffer instead of lighting
+	m_scene->setDeferredShader(phongShader, ShaderLibrary::getInstance()->load("Phong Deferred", "./shaders/phong.vert", "./shaders/phong.frag", { "DEFERRED" }));
+	m_scene->setDeferredShader(normalShader, ShaderLibrary::getInstance()->load("Normal Map Deferred", "./shaders/normalMap.vert", "./shaders/normalMap.frag", { "DEFERRED" }));
+	m_scene->setDeferredShader(phongInstanced, ShaderLibrary::getInstance()->load("Phong Instanced Deferred", "./shaders/phong.vert", "./shaders/phong.frag", { "INSTANCED", "DEFERRED" }));
+	m_scene->setDeferredShader(normalInstanced, ShaderLibrary::getInstance()->load("Normal Map Instanced Deferred", "./shaders/normalMap.vert", "./shaders/normalMap.frag", { "INSTANCED", "DEFERRED" }));
+	m_scene->setDeferredShader(phongTable, ShaderLibrary::getInstance()->load("Phong Material Table Deferred", "./shaders/phong.vert", "./shaders/phong.frag", { "INSTANCED", "MATERIAL_TABLE", "DEFERRED" }));
+	m_scene->setDeferredShader(normalTable, ShaderLibrary::getInstance()->load("Normal Map Material Table Deferred", "./shaders/normalMap.vert", "./shaders/normalMap.frag", { "INSTANCED", "MATERIAL_TABLE", "DEFERRED" }));
+	m_benchmarkShader = normalShader;
+#pragma endregion
+
 #pragma region Meshes
 	//load bunny mesh
 	if (!m_bunny.m_mesh.load("./stanford/bunny.obj"))
@@ -129,49 +246,42 @@ bool GraphicsProjectApp::loadShaderAndMeshLogic()
 		return false;
 	}
 	m_m1Carbine.m_material = &m_m1Carbine.m_mesh.getMaterial(0);
-#pragma endregion
-
-#pragma region Shaders
-	//phong shader
-	aie::ShaderProgram* phongShader = new aie::ShaderProgram();
-	phongShader->loadShader(aie::eShaderStage::VERTEX, "./shaders/phong.vert");
-	phongShader->loadShader(aie::eShaderStage::FRAGMENT, "./shaders/phong.frag");
-	if (!phongShader->link())
-	{
-		printf("Phong shader has an error: %s\n", phongShader->getLastError());
-		return false;
-	}
-	//normal map shader
-	aie::ShaderProgram* normalShader = new aie::ShaderProgram();
-	normalShader->loadShader(aie::eShaderStage::VERTEX, "./shaders/normalMap.vert");
-	normalShader->loadShader(aie::eShaderStage::FRAGMENT, "./shaders/normalMap.frag");
-	if (!normalShader->link())
+	//the full spear is small enough to rasterize on the CPU
+	if (!m_soulSpearOccluder.load("./soulspear/soulspear.obj"))
 	{
-		printf("Normal map shader has an error: %s\n", normalShader->getLastError());
+		printf("SoulSpear occluder failed\n");
 		return false;
 	}
 #pragma endregion
 
-	Instance* instance;
-	//add soul spears
+	TransformHierarchy& hierarchy = m_scene->getHierarchy();
+	InstanceHandle instance;
+	unsigned int node;
+	//add soul spears, on a rack that moves them all together
+	unsigned int rack = hierarchy.create();
+	m_transforms.push_back({ "Spear Rack", rack, glm::vec3(0), glm::vec3(0), glm::vec3(1) });
 	for (int i = 0; i < 10; i++)
 	{
-		instance = new Instance(glm::vec3(i * 2, 0, 0), glm::vec3(0, i * 30, 0), glm::vec3(1), &m_soulSpear.m_mesh, normalShader);
-		m_transforms.push_back({ "Soul Spear " + std::to_string(i), instance->getTransform(),
+		instance = m_scene->addInstance(Instance(glm::mat4(1), &m_soulSpear.m_mesh, normalShader));
+		node = hierarchy.create(glm::vec3(i * 2, 0, 0), TransformHierarchy::fromEulerAngles(glm::vec3(0, i * 30, 0)), glm::vec3(1), rack);
+		m_scene->attachInstance(instance, node);
+		m_transforms.push_back({ "Soul Spear " + std::to_string(i), node,
 								glm::vec3(i * 2, 0, 0), glm::vec3(0, i * 30, 0), glm::vec3(1) });
-		m_scene->addInstance(instance);
+		m_scene->addOccluder(instance, &m_soulSpearOccluder);
 	}
 
 	//add m1carbine
-	instance = new Instance(glm::vec3(-2, 0, 0), glm::vec3(0, 90, 0), glm::vec3(.1f), &m_m1Carbine.m_mesh, normalShader);
-	m_transforms.push_back({ "M1 Carbine", instance->getTransform(), 
+	instance = m_scene->addInstance(Instance(glm::mat4(1), &m_m1Carbine.m_mesh, normalShader));
+	node = hierarchy.create(glm::vec3(-2, 0, 0), TransformHierarchy::fromEulerAngles(glm::vec3(0, 90, 0)), glm::vec3(.1f));
+	m_scene->attachInstance(instance, node);
+	m_transforms.push_back({ "M1 Carbine", node, 
 							glm::vec3(-2, 0, 0), glm::vec3(0, 90, 0), glm::vec3(.1f) });
-	m_scene->addInstance(instance);
 	//add bunny
-	instance = new Instance(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(.2f), &m_bunny.m_mesh, phongShader);
-	m_transforms.push_back({ "Bunny", instance->getTransform(),
+	instance = m_scene->addInstance(Instance(glm::mat4(1), &m_bunny.m_mesh, phongShader));
+	node = hierarchy.create(glm::vec3(0, 0, 3), glm::quat(1, 0, 0, 0), glm::vec3(.2f));
+	m_scene->attachInstance(instance, node);
+	m_transforms.push_back({ "Bunny", node,
 							glm::vec3(0, 0, 3), glm::vec3(0), glm::vec3(.2f) });
-	m_scene->addInstance(instance);
 
 
 	return true;
@@ -222,6 +332,8 @@ void GraphicsProjectApp::IMGUI_Logic()
 	ImGui::Text(("Current Dir Light: " + std::to_string(currentDirLight + 1)).c_str());
 	ImGui::DragFloat3("Dir Light Direction", &directionalLights[currentDirLight]->m_direction[0], 0.1f, -1.f, 1.f);
 	ImGui::ColorEdit3("Dir Light Color", &directionalLights[currentDirLight]->m_color[0]);
+	//only the first light casting shadows has them drawn
+	ImGui::Checkbox("Dir Light Cast Shadows", &directionalLights[currentDirLight]->m_castShadows);
 	//nav buttons
 	if (currentDirLight != 0)
 	{
@@ -320,9 +432,9 @@ void GraphicsProjectApp::IMGUI_Logic()
 	
 	ImGui::Text(trans.m_name.c_str());
 	//editor for transform
-	ImGui::DragFloat3("Position", &trans.m_position[0], 0.25f);
-	ImGui::DragFloat3("Rotation", &trans.m_rotation[0], 0.25f);
-	ImGui::DragFloat3("Scale", &trans.m_scale[0], 0.25f);
+	bool transformChanged = ImGui::DragFloat3("Position", &trans.m_position[0], 0.25f);
+	transformChanged |= ImGui::DragFloat3("Rotation", &trans.m_rotation[0], 0.25f);
+	transformChanged |= ImGui::DragFloat3("Scale", &trans.m_scale[0], 0.25f);
 	//nav buttons
 	if (ImGui::Button("Prev"))
 	{
@@ -337,14 +449,17 @@ void GraphicsProjectApp::IMGUI_Logic()
 	if (ImGui::Button("Next"))
 	{
 		currentTransform++;
-		if (currentTransform > m_transforms.size() + 1)
+		if (currentTransform >= (int)m_transforms.size())
 		{
 			currentTransform = 0;
 		}
 	}
 
-	//update transform with new pos, rot, and scale
-	trans.m_transform = Instance::createTransform(trans.m_position, trans.m_rotation, trans.m_scale);
+	//update the node with new pos, rot, and scale. Only when edited, so only its subtree is recalculated
+	if (transformChanged)
+	{
+		m_scene->getHierarchy().setLocal(trans.m_node, trans.m_position, TransformHierarchy::fromEulerAngles(trans.m_rotation), trans.m_scale);
+	}
 	ImGui::End();
 
 	//	--------------------------------------------------
@@ -374,6 +489,20 @@ void GraphicsProjectApp::IMGUI_Logic()
 		}
 	}
 	ImGui::End();
+
+	//	--------------------------------------------------
+
+	imguiShaderDiagnostics();
+	//benchmarked features each get their own window, with their settings, stats, and results
+	imguiInstancingBenchmark();
+	imguiSpatialIndexBenchmark();
+	imguiThreadingBenchmark();
+	imguiOcclusionBenchmark();
+	imguiLightingBenchmark();
+	imguiShadowBenchmark();
+	imguiPointShadowBenchmark();
+	imguiDepthPrePassBenchmark();
+	imguiMaterialBenchmark();
 }
 
 void GraphicsProjectApp::imguiMaterialTool(std::string a_name, MeshObject& a_obj)
@@ -388,4 +517,1055 @@ void GraphicsProjectApp::imguiMaterialTool(std::string a_name, MeshObject& a_obj
 	ImGui::SliderFloat((a_name + " Visibility").c_str(), &a_obj.m_material->opacity, 0, 1);
 	ImGui::DragFloat((a_name + " Specular Power").c_str(), &a_obj.m_material->specularPower, 1, 1, 100);
 	ImGui::Unindent(25.f);
+}
+
+void GraphicsProjectApp::imguiShaderDiagnostics()
+{
+	ShaderLibrary* library = ShaderLibrary::getInstance();
+
+	ImGui::Begin("Shader Diagnostics");
+	ImGui::Text("Parallel compile: %s", aie::ShaderProgram::hasParallelCompile() ? "yes" : "no");
+
+	//find the slowest program so it stands out
+	float slowest = 0;
+	for (unsigned int i = 0; i < library->getProgramCount(); i++)
+	{
+		const ShaderLibrary::ProgramDiagnostics& diagnostics = library->getDiagnostics(i);
+		slowest = glm::max(slowest, diagnostics.m_readyTime - diagnostics.m_submitStart);
+	}
+
+	for (unsigned int i = 0; i < library->getProgramCount(); i++)
+	{
+		const ShaderLibrary::ProgramDiagnostics& diagnostics = library->getDiagnostics(i);
+		float totalTime = diagnostics.m_readyTime - diagnostics.m_submitStart;
+
+		//red for failed, yellow for the slowest or anything with warnings, otherwise white
+		bool hasWarnings = !diagnostics.m_linkLog.empty();
+		for (auto& stage : diagnostics.m_stages)
+		{
+			hasWarnings = hasWarnings || !stage.m_infoLog.empty();
+		}
+		ImVec4 color(1, 1, 1, 1);
+		if (diagnostics.m_readyTime < 0)
+		{
+			color = ImVec4(0.6f, 0.6f, 0.6f, 1);
+		}
+		else if (!diagnostics.m_linked)
+		{
+			color = ImVec4(1, 0.3f, 0.3f, 1);
+		}
+		else if (hasWarnings || totalTime == slowest)
+		{
+			color = ImVec4(1, 1, 0.3f, 1);
+		}
+
+		ImGui::PushStyleColor(ImGuiCol_Text, color);
+		bool open = ImGui::TreeNode((void*)(size_t)i, "%s  %.2fms  %s", diagnostics.m_name.c_str(), glm::max(totalTime, 0.f),
+			diagnostics.m_readyTime < 0 ? "(compiling)" : diagnostics.m_linked ? "" : "(failed)");
+		ImGui::PopStyleColor();
+		if (!open)
+		{
+			continue;
+		}
+
+		//variant defines
+		std::string defines;
+		for (auto& define : diagnostics.m_defines)
+		{
+			defines += define + " ";
+		}
+		ImGui::Text("Defines: %s", defines.empty() ? "none" : defines.c_str());
+		ImGui::Text("Link: %.2fms", diagnostics.m_linkMS);
+		if (!diagnostics.m_linkLog.empty())
+		{
+			ImGui::TextWrapped("%s", diagnostics.m_linkLog.c_str());
+		}
+
+		//per stage results
+		for (auto& stage : diagnostics.m_stages)
+		{
+			ImGui::Separator();
+			ImGui::Text("%s", stage.m_filename.c_str());
+			ImGui::Text("Hash: %016llx", stage.m_sourceHash);
+			ImGui::Text("Submit: %.2fms  Compile: %.2fms  %s", stage.m_submitMS, stage.m_compileMS,
+				!stage.m_isComplete ? "(compiling)" : stage.m_compiled ? "" : "(failed)");
+			if (!stage.m_infoLog.empty())
+			{
+				ImGui::TextWrapped("%s", stage.m_infoLog.c_str());
+			}
+		}
+		ImGui::TreePop();
+	}
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiInstancingBenchmark()
+{
+	ImGui::Begin("Instancing Benchmark");
+
+	bool instancing = m_scene->isInstancingEnabled();
+	if (ImGui::Checkbox("Hardware instancing", &instancing))
+	{
+		m_scene->setInstancingEnabled(instancing);
+	}
+	bool meshPool = m_scene->isMeshPoolEnabled();
+	if (ImGui::Checkbox("Mesh pool and multi draw", &meshPool))
+	{
+		m_scene->setMeshPoolEnabled(meshPool);
+	}
+	int cullMode = m_scene->getCullMode();
+	ImGui::Text("Culling:");
+	ImGui::SameLine();
+	ImGui::RadioButton("None", &cullMode, Scene::CULL_NONE);
+	ImGui::SameLine();
+	ImGui::RadioButton("Linear", &cullMode, Scene::CULL_LINEAR);
+	ImGui::SameLine();
+	ImGui::RadioButton("AABB Tree", &cullMode, Scene::CULL_TREE);
+	ImGui::SameLine();
+	ImGui::RadioButton("GPU", &cullMode, Scene::CULL_GPU);
+	m_scene->setCullMode((Scene::CullMode)cullMode);
+	int occlusionMode = m_scene->getOcclusionMode();
+	ImGui::Text("Occlusion:");
+	ImGui::SameLine();
+	ImGui::RadioButton("Off", &occlusionMode, Scene::OCCLUSION_NONE);
+	ImGui::SameLine();
+	ImGui::RadioButton("Hi-Z", &occlusionMode, Scene::OCCLUSION_HIZ);
+	ImGui::SameLine();
+	ImGui::RadioButton("Software", &occlusionMode, Scene::OCCLUSION_SOFTWARE);
+	m_scene->setOcclusionMode((Scene::OcclusionMode)occlusionMode);
+
+	//counts go up by 10x to show how each path scales
+	ImGui::Text("Benchmark soul spears: %d", (int)m_benchmarkInstances.size());
+	unsigned int counts[] = { 0, 10, 100, 1000, 10000, 100000 };
+	for (int i = 0; i < 6; i++)
+	{
+		if (i > 0)
+		{
+			ImGui::SameLine();
+		}
+		if (ImGui::Button(std::to_string(counts[i]).c_str()))
+		{
+			setBenchmarkInstanceCount(counts[i]);
+		}
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Instances: %d", m_scene->getInstanceCount());
+	ImGui::Text("Visible: %d  Culled: %d  Hidden: %d", m_scene->getVisibleCount(), m_scene->getCulledCount(), m_scene->getHiddenCount());
+	if (m_scene->getCullMode() == Scene::CULL_GPU)
+	{
+		//the cpu never finds out which of these are visible
+		ImGui::Text("Culled on the GPU: %d", m_scene->getGPUCulledCount());
+		if (ImGui::Button("Check GPU culling against the CPU"))
+		{
+			m_gpuCullingDifferences = (int)m_scene->verifyGPUCulling();
+		}
+		if (m_gpuCullingDifferences >= 0)
+		{
+			ImGui::SameLine();
+			ImGui::Text("Differences: %d", m_gpuCullingDifferences);
+		}
+	}
+	if (m_scene->getOcclusionMode() != Scene::OCCLUSION_NONE)
+	{
+		ImGui::Text("Occluded: %d  Draws saved: %d", m_scene->getOccludedCount(), m_scene->getOccludedDrawCount());
+	}
+	if (m_scene->getOcclusionMode() == Scene::OCCLUSION_HIZ)
+	{
+		//depth arrives a frame or more late, and is ignored while the camera moves too far from it
+		glm::ivec2 readbackSize = m_scene->getHiZBuffer().getReadbackSize();
+		ImGui::Text("Hi-Z readback: %dx%d", readbackSize.x, readbackSize.y);
+	}
+	ImGui::Text("Draws: %d  Draw calls: %d", m_scene->getRenderQueue().getCount(), m_scene->getDrawCallCount());
+
+	//how much sorting the render queue saves
+	const RenderQueue::StateChanges& submitted = m_scene->getRenderQueue().getSubmittedChanges();
+	const RenderQueue::StateChanges& sorted = m_scene->getRenderQueue().getSortedChanges();
+	ImGui::Text("State changes, submitted -> sorted");
+	ImGui::Indent(25.f);
+	ImGui::Text("Programs: %d -> %d", submitted.m_programs, sorted.m_programs);
+	ImGui::Text("Materials: %d -> %d", submitted.m_materials, sorted.m_materials);
+	ImGui::Text("Vertex arrays: %d -> %d", submitted.m_vertexArrays, sorted.m_vertexArrays);
+	ImGui::Unindent(25.f);
+	//states are applied before every draw, but only what differs from the last is set
+	ImGui::Text("Pipeline states applied: %d  GL state calls: %d", m_pipelineApplyCount, m_pipelineChangeCount);
+	ImGui::Text("Scene CPU: %.3fms", m_sceneCpuMS);
+	ImGui::Text("Scene GPU: %.3fms", m_sceneGpuMS);
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiThreadingBenchmark()
+{
+	ImGui::Begin("Threading Benchmark");
+
+	int threadCount = m_scene->getThreadCount();
+	ImGui::Text("Threads:");
+	unsigned int threadCounts[] = { 1, 2, 4, 8 };
+	for (auto count : threadCounts)
+	{
+		ImGui::SameLine();
+		ImGui::RadioButton(std::to_string(count).c_str(), &threadCount, count);
+	}
+	if (threadCount != (int)m_scene->getThreadCount())
+	{
+		m_scene->setThreadCount(threadCount);
+	}
+
+	ImGui::Text("Build draws: %.3fms  Submit: %.3fms", m_scene->getPrepareTime(), m_scene->getSubmitTime());
+
+	if (ImGui::Button("Run threading benchmark"))
+	{
+		runThreadingBenchmark();
+	}
+	for (auto& result : m_threadingResults)
+	{
+		ImGui::Text("%d instances, %d threads: %.3fms (build %.3fms, submit %.3fms)", result.m_count, result.m_threadCount, result.m_drawMS, result.m_prepareMS, result.m_submitMS);
+	}
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiOcclusionBenchmark()
+{
+	ImGui::Begin("Occlusion Benchmark");
+
+	//occlusion is picked with the other culling options, this shows the software buffer's last frame
+	if (m_scene->getOcclusionMode() == Scene::OCCLUSION_SOFTWARE)
+	{
+		const OcclusionRasterizer& rasterizer = m_scene->getOcclusionRasterizer();
+		ImGui::Text("Occluders: %d  Triangles: %d  (%dx%d)", rasterizer.getOccluderCount(), rasterizer.getTriangleCount(), rasterizer.getWidth(), rasterizer.getHeight());
+	}
+
+	if (ImGui::Button("Run software occlusion benchmark"))
+	{
+		runOcclusionBenchmark();
+	}
+	for (auto& result : m_occlusionResults)
+	{
+		ImGui::Text("%d occluders, %d threads: %.1f occluders/ms", result.m_occluderCount, result.m_threadCount, result.m_occludersPerMS);
+		ImGui::Indent(25.f);
+		ImGui::Text("%d triangles, bin %.3fms, rasterize %.3fms", result.m_triangleCount, result.m_binMS, result.m_rasterizeMS);
+		ImGui::Text("%d boxes tested in %.3fms, %d occluded", result.m_testCount, result.m_testMS, result.m_occludedCount);
+		ImGui::Unindent(25.f);
+	}
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiLightingBenchmark()
+{
+	ImGui::Begin("Lighting Benchmark");
+
+	int shadingMode = m_scene->getShadingMode();
+	ImGui::Text("Shading:");
+	ImGui::SameLine();
+	ImGui::RadioButton("Forward", &shadingMode, Scene::SHADING_FORWARD);
+	ImGui::SameLine();
+	ImGui::RadioButton("Deferred", &shadingMode, Scene::SHADING_DEFERRED);
+	m_scene->setShadingMode((Scene::ShadingMode)shadingMode);
+	if (m_scene->getShadingMode() == Scene::SHADING_DEFERRED)
+	{
+		//every target is written once per covered pixel, more with overdraw, and read once when lighting
+		const GBuffer& gBuffer = m_scene->getGBuffer();
+		glm::ivec2 size = gBuffer.getSize();
+		float megabytes = size.x * size.y * GBuffer::getBytesPerPixel() / (1024.f * 1024.f);
+		ImGui::Text("G-buffer: %dx%d, %d bytes per pixel, %.1fMB written and read", size.x, size.y, GBuffer::getBytesPerPixel(), megabytes);
+		unsigned int pointLightCount = (unsigned int)m_scene->getPointLights().size();
+		ImGui::Text("Geometry: %.3fms  Lighting: %.3fms (%.4fms per point light)", gBuffer.getGeometryTime(), gBuffer.getLightingTime(),
+			gBuffer.getLightingTime() / glm::max(pointLightCount, 1u));
+	}
+	LightClusters& lightClusters = m_scene->getLightClusters();
+	bool clustered = lightClusters.isEnabled();
+	if (ImGui::Checkbox("Clustered point lights", &clustered))
+	{
+		lightClusters.setEnabled(clustered);
+	}
+	bool instanceLights = m_scene->isInstanceLightsEnabled();
+	if (ImGui::Checkbox("Per instance light lists", &instanceLights))
+	{
+		m_scene->setInstanceLightsEnabled(instanceLights);
+	}
+	glm::ivec3 clusterCounts = lightClusters.getClusterCounts();
+	ImGui::Text("Point lights: %d  Clusters: %dx%dx%d", lightClusters.getLightCount(), clusterCounts.x, clusterCounts.y, clusterCounts.z);
+	ImGui::Text("Light indices: %d  Binning: %.3fms", lightClusters.getIndexCount(), lightClusters.getBuildTime());
+	if (instanceLights)
+	{
+		ImGui::Text("Instance lights: %d in view, %.2f per visible instance", m_scene->getViewLightCount(),
+			m_scene->getInstanceLightCount() / (float)glm::max(m_scene->getVisibleCount(), 1u));
+	}
+	if (ImGui::Button("Run lighting benchmark"))
+	{
+		runLightingBenchmark();
+	}
+	for (auto& result : m_lightingResults)
+	{
+		ImGui::Text("%d lights, %s %s: frame %.3fms, GPU %.3fms (%.5fms per light)", result.m_lightCount, result.m_deferred ? "deferred" : "forward",
+			result.m_instanceLights ? "per instance" : result.m_clustered ? "clustered" : "every light", result.m_frameMS, result.m_gpuMS, result.m_perLightMS);
+		ImGui::Indent(25.f);
+		ImGui::Text("Binning %.3fms, preparing draws %.3fms, %d light indices", result.m_binMS, result.m_prepareMS, result.m_indexCount);
+		ImGui::Unindent(25.f);
+	}
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiShadowBenchmark()
+{
+	ImGui::Begin("Shadow Benchmark");
+
+	ShadowCascades& shadows = m_scene->getShadowCascades();
+	bool shadowCaching = shadows.isCachingEnabled();
+	if (ImGui::Checkbox("Cache static shadow casters", &shadowCaching))
+	{
+		shadows.setCachingEnabled(shadowCaching);
+	}
+	if (shadows.isActive())
+	{
+		ImGui::Text("Shadow tiles redrawn, static: %d  dynamic: %d  Update: %.3fms", shadows.getStaticTileCount(), shadows.getDynamicTileCount(), shadows.getUpdateTime());
+		ImGui::Text("Casters drawn: %d in %d draw calls, %d moving", shadows.getCasterCount(), shadows.getDrawCallCount(), shadows.getDynamicCasterCount());
+	}
+	if (ImGui::Button("Run shadow benchmark"))
+	{
+		runShadowBenchmark();
+	}
+	for (auto& result : m_shadowResults)
+	{
+		ImGui::Text("%s, %s: frame %.3fms, GPU %.3fms", !result.m_shadows ? "no shadows" : result.m_cached ? "cached" : "uncached",
+			result.m_moving ? "one caster moving" : "nothing moving", result.m_frameMS, result.m_gpuMS);
+		ImGui::Indent(25.f);
+		ImGui::Text("Update %.3fms, tiles redrawn static %.1f dynamic %.1f, %.1f draw calls, %.0f casters", result.m_updateMS, result.m_staticTiles, result.m_dynamicTiles,
+			result.m_drawCalls, result.m_casters);
+		ImGui::Unindent(25.f);
+	}
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiPointShadowBenchmark()
+{
+	ImGui::Begin("Point Shadow Benchmark");
+
+	PointShadows& pointShadows = m_scene->getPointShadows();
+	bool pointShadowsEnabled = pointShadows.isEnabled();
+	if (ImGui::Checkbox("Point light shadows", &pointShadowsEnabled))
+	{
+		pointShadows.setEnabled(pointShadowsEnabled);
+	}
+	ImGui::SameLine();
+	bool pointShadowCaching = pointShadows.isCachingEnabled();
+	if (ImGui::Checkbox("Cache faces", &pointShadowCaching))
+	{
+		pointShadows.setCachingEnabled(pointShadowCaching);
+	}
+	int faceBudget = (int)pointShadows.getFaceBudget();
+	if (ImGui::SliderInt("Faces per frame", &faceBudget, 1, POINT_SHADOW_SLOTS * 6))
+	{
+		pointShadows.setFaceBudget((unsigned int)faceBudget);
+	}
+	if (pointShadowsEnabled)
+	{
+		ImGui::Text("Shadowed point lights: %d of %d  Update: %.3fms", pointShadows.getShadowedCount(), POINT_SHADOW_SLOTS, pointShadows.getUpdateTime());
+		ImGui::Text("Faces drawn: %d, %d waiting  Casters drawn: %d", pointShadows.getFacesDrawn(), pointShadows.getFacesWaiting(), pointShadows.getCasterCount());
+	}
+	if (ImGui::Button("Run point shadow benchmark"))
+	{
+		runPointShadowBenchmark();
+	}
+	for (auto& result : m_pointShadowResults)
+	{
+		ImGui::Text("%d lights, %s: frame %.3fms, GPU %.3fms", result.m_lightCount, !result.m_shadows ? "no shadows" : result.m_cached ? "cached" : "uncached",
+			result.m_frameMS, result.m_gpuMS);
+		ImGui::Indent(25.f);
+		ImGui::Text("Budget %d, update %.3fms, %.1f faces drawn, %.1f waiting, %.1f lights shadowed", result.m_budget, result.m_updateMS, result.m_facesDrawn,
+			result.m_facesWaiting, result.m_shadowedLights);
+		ImGui::Unindent(25.f);
+	}
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiDepthPrePassBenchmark()
+{
+	ImGui::Begin("Depth Pre-Pass Benchmark");
+
+	bool prePass = m_scene->isDepthPrePassEnabled();
+	if (ImGui::Checkbox("Depth pre-pass", &prePass))
+	{
+		m_scene->setDepthPrePassEnabled(prePass);
+	}
+	//without the pre-pass every fragment in front of what was drawn before it is shaded, so this is the overdraw it saves
+	glm::vec2 windowSize = m_scene->getWindowSize();
+	ImGui::Text("Opaque fragments shaded: %d, %.2f per pixel", m_scene->getShadedFragmentCount(), m_scene->getOverdraw());
+	if (prePass)
+	{
+		ImGui::Text("Pre-pass fragments: %d, %.2f per pixel", m_scene->getPrePassFragmentCount(), m_scene->getPrePassFragmentCount() / (windowSize.x * windowSize.y));
+	}
+	if (ImGui::Button("Run depth pre-pass benchmark"))
+	{
+		runDepthPrePassBenchmark();
+	}
+	for (auto& result : m_depthPrePassResults)
+	{
+		ImGui::Text("%d instances, %s %s: frame %.3fms, GPU %.3fms", result.m_instanceCount, result.m_deferred ? "deferred" : "forward",
+			result.m_prePass ? "with pre-pass" : "no pre-pass", result.m_frameMS, result.m_gpuMS);
+		ImGui::Indent(25.f);
+		ImGui::Text("Fragments per pixel, shaded %.2f, pre-pass %.2f", result.m_shadedFragments, result.m_prePassFragments);
+		ImGui::Unindent(25.f);
+	}
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiMaterialBenchmark()
+{
+	ImGui::Begin("Material Benchmark");
+
+	bool materialTable = m_materialTableEnabled;
+	if (ImGui::Checkbox("Material table", &materialTable))
+	{
+		setMaterialTableEnabled(materialTable);
+	}
+	const MaterialTable& materials = m_scene->getMaterialTable();
+	ImGui::Text("Materials: %d  Texture arrays: %d, %d layers", materials.getMaterialCount(), materials.getArrayCount(), materials.getLayerCount());
+	ImGui::Text("Material binds: %d  Draw calls: %d", m_scene->getMaterialBindCount(), m_scene->getDrawCallCount());
+	if (ImGui::Button("Run material benchmark"))
+	{
+		runMaterialBenchmark();
+	}
+	for (auto& result : m_materialResults)
+	{
+		ImGui::Text("%s %s: frame %.3fms, GPU %.3fms, %d draw calls, %d material binds", result.m_table ? "table" : "per draw", result.m_deferred ? "deferred" : "forward",
+			result.m_frameMS, result.m_gpuMS, result.m_drawCalls, result.m_materialBinds);
+	}
+	ImGui::End();
+}
+
+void GraphicsProjectApp::imguiSpatialIndexBenchmark()
+{
+	ImGui::Begin("Spatial Index Benchmark");
+
+	if (ImGui::Button("Run spatial index benchmark"))
+	{
+		runSpatialIndexBenchmark();
+	}
+	for (auto& result : m_spatialResults)
+	{
+		ImGui::Text("%d boxes, tree height %d", result.m_count, result.m_height);
+		ImGui::Indent(25.f);
+		ImGui::Text("Insert all: %.3fms", result.m_insertMS);
+		ImGui::Text("Move all, small: %.3fms  large: %.3fms  refit: %.3fms", result.m_smallMoveMS, result.m_largeMoveMS, result.m_refitMS);
+		ImGui::Text("Frustum, tree: %.3fms  linear: %.3fms  (%d found)", result.m_frustumMS, result.m_linearMS, result.m_frustumCount);
+		ImGui::Text("Sphere: %.4fms  Ray: %.4fms", result.m_sphereMS, result.m_rayMS);
+		ImGui::Unindent(25.f);
+	}
+	ImGui::End();
+}
+
+GraphicsProjectApp::BenchmarkTiming GraphicsProjectApp::timeBenchmark(const std::function<void()>& a_configure, const std::function<bool()>& a_settling,
+	const std::function<void(int)>& a_beforeDraw, const std::function<void()>& a_afterDraw)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	a_configure();
+
+	//the first draws rebuild batches and grow buffers, and caches can take more to fill, so they aren't timed
+	m_scene->draw();
+	m_scene->draw();
+	for (int i = 0; i < 100 && a_settling && a_settling(); i++)
+	{
+		m_scene->draw();
+	}
+	glFinish();
+
+	//the GPU time of every timed frame is summed in one query
+	BenchmarkTiming timing;
+	glBeginQuery(GL_TIME_ELAPSED, m_benchmarkQuery);
+	auto start = Clock::now();
+	for (int i = 0; i < BENCHMARK_FRAMES; i++)
+	{
+		if (a_beforeDraw)
+		{
+			a_beforeDraw(i);
+		}
+		m_scene->draw();
+		if (a_afterDraw)
+		{
+			a_afterDraw();
+		}
+	}
+	timing.m_drawMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count() / BENCHMARK_FRAMES;
+	glEndQuery(GL_TIME_ELAPSED);
+	//waiting for the GPU also keeps the work from this run from slowing down the next one
+	glFinish();
+	timing.m_frameMS = std::chrono::duration<float, std::milli>(Clock::now() - start).count() / BENCHMARK_FRAMES;
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(m_benchmarkQuery, GL_QUERY_RESULT, &nanoseconds);
+	timing.m_gpuMS = nanoseconds / (BENCHMARK_FRAMES * 1000000.f);
+	return timing;
+}
+
+void GraphicsProjectApp::runThreadingBenchmark()
+{
+	unsigned int startCount = (unsigned int)m_benchmarkInstances.size();
+	unsigned int startThreads = m_scene->getThreadCount();
+	m_threadingResults.clear();
+
+	unsigned int counts[] = { 1000, 10000, 100000 };
+	unsigned int threadCounts[] = { 1, 2, 4, 8 };
+	for (auto count : counts)
+	{
+		setBenchmarkInstanceCount(count);
+		for (auto threads : threadCounts)
+		{
+			ThreadingBenchmarkResult result;
+			result.m_count = count;
+			result.m_threadCount = threads;
+			result.m_prepareMS = 0;
+			result.m_submitMS = 0;
+			BenchmarkTiming timing = timeBenchmark([&]() { m_scene->setThreadCount(threads); }, nullptr, nullptr, [&]()
+			{
+				result.m_prepareMS += m_scene->getPrepareTime() / BENCHMARK_FRAMES;
+				result.m_submitMS += m_scene->getSubmitTime() / BENCHMARK_FRAMES;
+			});
+			result.m_drawMS = timing.m_drawMS;
+
+			m_threadingResults.push_back(result);
+		}
+	}
+
+	setBenchmarkInstanceCount(startCount);
+	m_scene->setThreadCount(startThreads);
+}
+
+void GraphicsProjectApp::runLightingBenchmark()
+{
+	auto randomFloat = [](float a_min, float a_max) { return a_min + (a_max - a_min) * (rand() / (float)RAND_MAX); };
+
+	LightClusters& lightClusters = m_scene->getLightClusters();
+	bool startClustered = lightClusters.isEnabled();
+	bool startInstanceLights = m_scene->isInstanceLightsEnabled();
+	Scene::ShadingMode startShading = m_scene->getShadingMode();
+	std::vector<PointLight*>& pointLights = m_scene->getPointLights();
+	size_t startLights = pointLights.size();
+	m_lightingResults.clear();
+
+	unsigned int counts[] = { 16, 256, 4096 };
+	for (auto count : counts)
+	{
+		//small lights scattered around the demo objects
+		while (pointLights.size() < startLights + count)
+		{
+			glm::vec3 position(randomFloat(-10, 25), randomFloat(-2, 6), randomFloat(-10, 10));
+			glm::vec3 color(randomFloat(0, 1), randomFloat(0, 1), randomFloat(0, 1));
+			pointLights.push_back(new PointLight(position, randomFloat(1, 4), 1, color));
+		}
+
+		//forward every light, clustered, and per instance, then deferred every light and clustered
+		for (int mode = 0; mode < 5; mode++)
+		{
+			LightingBenchmarkResult result;
+			result.m_lightCount = count;
+			result.m_deferred = mode >= 3;
+			result.m_instanceLights = mode == 2;
+			//instances culled on the GPU have no list of their own, so they still use clusters
+			result.m_clustered = mode == 1 || mode == 2 || mode == 4;
+			result.m_binMS = 0;
+			result.m_prepareMS = 0;
+			BenchmarkTiming timing = timeBenchmark([&]()
+			{
+				m_scene->setShadingMode(result.m_deferred ? Scene::SHADING_DEFERRED : Scene::SHADING_FORWARD);
+				lightClusters.setEnabled(result.m_clustered);
+				m_scene->setInstanceLightsEnabled(result.m_instanceLights);
+			}, nullptr, nullptr, [&]()
+			{
+				result.m_binMS += lightClusters.getBuildTime() / BENCHMARK_FRAMES;
+				result.m_prepareMS += m_scene->getPrepareTime() / BENCHMARK_FRAMES;
+			});
+			result.m_frameMS = timing.m_frameMS;
+			result.m_gpuMS = timing.m_gpuMS;
+			result.m_indexCount = result.m_instanceLights ? m_scene->getInstanceLightCount() : lightClusters.getIndexCount();
+			//compared with the same mode at the first count
+			result.m_perLightMS = 0;
+			if (count != counts[0])
+			{
+				const LightingBenchmarkResult& first = m_lightingResults[mode];
+				result.m_perLightMS = (result.m_gpuMS - first.m_gpuMS) / (count - first.m_lightCount);
+			}
+
+			m_lightingResults.push_back(result);
+		}
+	}
+
+	for (size_t i = startLights; i < pointLights.size(); i++)
+	{
+		delete pointLights[i];
+	}
+	pointLights.resize(startLights);
+	lightClusters.setEnabled(startClustered);
+	m_scene->setInstanceLightsEnabled(startInstanceLights);
+	m_scene->setShadingMode(startShading);
+}
+
+void GraphicsProjectApp::runShadowBenchmark()
+{
+	std::vector<DirectionalLight*>& directionalLights = m_scene->getDirectionalLights();
+	if (directionalLights.empty())
+	{
+		return;
+	}
+	ShadowCascades& shadows = m_scene->getShadowCascades();
+	bool startCaching = shadows.isCachingEnabled();
+	DirectionalLight startLight = *directionalLights[0];
+	unsigned int startCount = (unsigned int)m_benchmarkInstances.size();
+	m_shadowResults.clear();
+
+	//the first light shines down at the benchmark grid, so every soul spear casts on to its neighbours
+	setBenchmarkInstanceCount(1000);
+	directionalLights[0]->m_direction = glm::vec3(0.3f, -1, 0.2f);
+	InstanceStore& instances = m_scene->getInstances();
+	InstanceHandle mover = m_benchmarkInstances[0];
+	glm::mat4 moverTransform = instances.getTransform(mover);
+
+	//no shadows, then shadows redrawn every frame, then cached. Each with nothing moving, then one soul spear moving
+	for (int mode = 0; mode < 6; mode++)
+	{
+		ShadowBenchmarkResult result;
+		result.m_shadows = mode >= 2;
+		result.m_cached = mode >= 4;
+		result.m_moving = mode % 2 == 1;
+		result.m_updateMS = 0;
+		result.m_staticTiles = 0;
+		result.m_dynamicTiles = 0;
+		result.m_drawCalls = 0;
+		result.m_casters = 0;
+		BenchmarkTiming timing = timeBenchmark([&]()
+		{
+			directionalLights[0]->m_castShadows = result.m_shadows;
+			shadows.setCachingEnabled(result.m_cached);
+		}, [&]()
+		{
+			//casters moved by the last mode are settled first, so nothing moving really means nothing is redrawn
+			return result.m_shadows && !result.m_moving && shadows.getDynamicCasterCount() > 0;
+		}, [&](int a_frame)
+		{
+			if (result.m_moving)
+			{
+				instances.setTransform(mover, glm::translate(moverTransform, glm::vec3(0, 0.2f * (a_frame + 1), 0)));
+			}
+		}, [&]()
+		{
+			result.m_updateMS += shadows.getUpdateTime() / BENCHMARK_FRAMES;
+			result.m_staticTiles += shadows.getStaticTileCount() / (float)BENCHMARK_FRAMES;
+			result.m_dynamicTiles += shadows.getDynamicTileCount() / (float)BENCHMARK_FRAMES;
+			result.m_drawCalls += shadows.getDrawCallCount() / (float)BENCHMARK_FRAMES;
+			result.m_casters += shadows.getCasterCount() / (float)BENCHMARK_FRAMES;
+		});
+		result.m_frameMS = timing.m_frameMS;
+		result.m_gpuMS = timing.m_gpuMS;
+		instances.setTransform(mover, moverTransform);
+
+		m_shadowResults.push_back(result);
+	}
+
+	*directionalLights[0] = startLight;
+	shadows.setCachingEnabled(startCaching);
+	setBenchmarkInstanceCount(startCount);
+}
+
+void GraphicsProjectApp::runPointShadowBenchmark()
+{
+	auto randomFloat = [](float a_min, float a_max) { return a_min + (a_max - a_min) * (rand() / (float)RAND_MAX); };
+
+	PointShadows& pointShadows = m_scene->getPointShadows();
+	bool startEnabled = pointShadows.isEnabled();
+	bool startCaching = pointShadows.isCachingEnabled();
+	unsigned int startBudget = pointShadows.getFaceBudget();
+	std::vector<PointLight*>& pointLights = m_scene->getPointLights();
+	size_t startLights = pointLights.size();
+	unsigned int startCount = (unsigned int)m_benchmarkInstances.size();
+	m_pointShadowResults.clear();
+
+	//lights among the front of the benchmark grid, with one soul spear moving through them every frame
+	setBenchmarkInstanceCount(1000);
+	InstanceStore& instances = m_scene->getInstances();
+	InstanceHandle mover = m_benchmarkInstances[0];
+	glm::mat4 moverTransform = instances.getTransform(mover);
+
+	unsigned int counts[] = { 8, 64 };
+	for (auto count : counts)
+	{
+		while (pointLights.size() < startLights + count)
+		{
+			glm::vec3 position(randomFloat(0, 40), randomFloat(0.5f, 3), randomFloat(-12, -4));
+			glm::vec3 color(randomFloat(0, 1), randomFloat(0, 1), randomFloat(0, 1));
+			pointLights.push_back(new PointLight(position, randomFloat(3, 8), 1, color));
+		}
+
+		//no shadows, every face redrawn every frame, then cached with a small and a large budget
+		for (int mode = 0; mode < 4; mode++)
+		{
+			PointShadowBenchmarkResult result;
+			result.m_lightCount = count;
+			result.m_shadows = mode >= 1;
+			result.m_cached = mode >= 2;
+			result.m_budget = mode == 2 ? 6 : POINT_SHADOW_SLOTS * 6;
+			result.m_updateMS = 0;
+			result.m_facesDrawn = 0;
+			result.m_facesWaiting = 0;
+			result.m_shadowedLights = 0;
+			BenchmarkTiming timing = timeBenchmark([&]()
+			{
+				pointShadows.setEnabled(result.m_shadows);
+				pointShadows.setCachingEnabled(result.m_cached);
+				pointShadows.setFaceBudget(result.m_budget);
+			}, [&]()
+			{
+				//every slot is filled before timing, so only faces the moving soul spear passes through are redrawn
+				return result.m_shadows && pointShadows.getFacesWaiting() > 0;
+			}, [&](int a_frame)
+			{
+				instances.setTransform(mover, glm::translate(moverTransform, glm::vec3(0.5f * (a_frame + 1), 0, 0)));
+			}, [&]()
+			{
+				result.m_updateMS += pointShadows.getUpdateTime() / BENCHMARK_FRAMES;
+				result.m_facesDrawn += pointShadows.getFacesDrawn() / (float)BENCHMARK_FRAMES;
+				result.m_facesWaiting += pointShadows.getFacesWaiting() / (float)BENCHMARK_FRAMES;
+				result.m_shadowedLights += pointShadows.getShadowedCount() / (float)BENCHMARK_FRAMES;
+			});
+			result.m_frameMS = timing.m_frameMS;
+			result.m_gpuMS = timing.m_gpuMS;
+			instances.setTransform(mover, moverTransform);
+
+			m_pointShadowResults.push_back(result);
+		}
+	}
+
+	for (size_t i = startLights; i < pointLights.size(); i++)
+	{
+		delete pointLights[i];
+	}
+	pointLights.resize(startLights);
+	pointShadows.setEnabled(startEnabled);
+	pointShadows.setCachingEnabled(startCaching);
+	pointShadows.setFaceBudget(startBudget);
+	setBenchmarkInstanceCount(startCount);
+}
+
+void GraphicsProjectApp::runDepthPrePassBenchmark()
+{
+	auto randomFloat = [](float a_min, float a_max) { return a_min + (a_max - a_min) * (rand() / (float)RAND_MAX); };
+
+	bool startPrePass = m_scene->isDepthPrePassEnabled();
+	Scene::ShadingMode startMode = m_scene->getShadingMode();
+	std::vector<PointLight*>& pointLights = m_scene->getPointLights();
+	size_t startLights = pointLights.size();
+	unsigned int startCount = (unsigned int)m_benchmarkInstances.size();
+	m_depthPrePassResults.clear();
+
+	//lights among the benchmark grid make each shaded fragment expensive, which is what the pre-pass saves
+	while (pointLights.size() < startLights + 64)
+	{
+		glm::vec3 position(randomFloat(0, 40), randomFloat(0.5f, 3), randomFloat(-20, -4));
+		glm::vec3 color(randomFloat(0, 1), randomFloat(0, 1), randomFloat(0, 1));
+		pointLights.push_back(new PointLight(position, randomFloat(3, 8), 1, color));
+	}
+	glm::vec2 windowSize = m_scene->getWindowSize();
+	float pixels = windowSize.x * windowSize.y;
+
+	unsigned int counts[] = { 1000, 4000 };
+	for (auto count : counts)
+	{
+		setBenchmarkInstanceCount(count);
+		for (int mode = 0; mode < 4; mode++)
+		{
+			DepthPrePassBenchmarkResult result;
+			result.m_instanceCount = count;
+			result.m_deferred = mode >= 2;
+			result.m_prePass = mode % 2 == 1;
+			BenchmarkTiming timing = timeBenchmark([&]()
+			{
+				m_scene->setShadingMode(result.m_deferred ? Scene::SHADING_DEFERRED : Scene::SHADING_FORWARD);
+				m_scene->setDepthPrePassEnabled(result.m_prePass);
+			});
+			result.m_frameMS = timing.m_frameMS;
+			result.m_gpuMS = timing.m_gpuMS;
+
+			//the fragment counts are read back a draw late, so one more draw picks up the last timed one's
+			m_scene->draw();
+			result.m_prePassFragments = m_scene->getPrePassFragmentCount() / pixels;
+			result.m_shadedFragments = m_scene->getShadedFragmentCount() / pixels;
+
+			m_depthPrePassResults.push_back(result);
+		}
+	}
+
+	for (size_t i = startLights; i < pointLights.size(); i++)
+	{
+		delete pointLights[i];
+	}
+	pointLights.resize(startLights);
+	m_scene->setDepthPrePassEnabled(startPrePass);
+	m_scene->setShadingMode(startMode);
+	setBenchmarkInstanceCount(startCount);
+}
+
+void GraphicsProjectApp::runMaterialBenchmark()
+{
+	bool startTable = m_materialTableEnabled;
+	Scene::ShadingMode startMode = m_scene->getShadingMode();
+	m_materialResults.clear();
+
+	//the three meshes take turns through a grid, so materials change between most draws
+	aie::OBJMesh* meshes[] = { &m_soulSpear.m_mesh, &m_m1Carbine.m_mesh, &m_bunny.m_mesh };
+	aie::ShaderProgram* shaders[] = { m_litShaders[1], m_litShaders[1], m_litShaders[0] };
+	float scales[] = { 0.5f, 0.05f, 0.1f };
+	std::vector<InstanceHandle> instances;
+	for (unsigned int i = 0; i < 1500; i++)
+	{
+		glm::vec3 position((float)(i % 50) * 1.5f, 0, -5 - (float)(i / 50) * 1.5f);
+		instances.push_back(m_scene->addInstance(Instance(position, glm::vec3(0, (float)(i * 37 % 360), 0), glm::vec3(scales[i % 3]), meshes[i % 3], shaders[i % 3])));
+	}
+
+	for (int mode = 0; mode < 4; mode++)
+	{
+		MaterialBenchmarkResult result;
+		result.m_table = mode % 2 == 1;
+		result.m_deferred = mode >= 2;
+		BenchmarkTiming timing = timeBenchmark([&]()
+		{
+			setMaterialTableEnabled(result.m_table);
+			m_scene->setShadingMode(result.m_deferred ? Scene::SHADING_DEFERRED : Scene::SHADING_FORWARD);
+		});
+		result.m_frameMS = timing.m_frameMS;
+		result.m_gpuMS = timing.m_gpuMS;
+		result.m_drawCalls = m_scene->getDrawCallCount();
+		result.m_materialBinds = m_scene->getMaterialBindCount();
+
+		m_materialResults.push_back(result);
+	}
+
+	for (auto instance : instances)
+	{
+		m_scene->removeInstance(instance);
+	}
+	setMaterialTableEnabled(startTable);
+	m_scene->setShadingMode(startMode);
+}
+
+void GraphicsProjectApp::runOcclusionBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto elapsedMS = [](Clock::time_point a_start) { return std::chrono::duration<float, std::milli>(Clock::now() - a_start).count(); };
+	auto randomFloat = [](float a_min, float a_max) { return a_min + (a_max - a_min) * (rand() / (float)RAND_MAX); };
+
+	m_occlusionResults.clear();
+	FrameContext frame = m_scene->getCurrentCamera()->getFrameContext(m_scene->getWindowSize());
+	const glm::mat4& projectionView = frame.m_projectionView;
+	const glm::mat4& cameraTransform = frame.m_inverseView;
+
+	//occluders and boxes are spread through the space in front of the camera
+	auto randomInView = [&](float a_near, float a_far)
+	{
+		float distance = randomFloat(a_near, a_far);
+		glm::vec3 local(randomFloat(-0.6f, 0.6f) * distance, randomFloat(-0.3f, 0.3f) * distance, -distance);
+		return glm::vec3(cameraTransform * glm::vec4(local, 1));
+	};
+	std::vector<AABB> boxes(10000);
+	for (auto& box : boxes)
+	{
+		glm::vec3 center = randomInView(5, 40);
+		box = AABB(center - glm::vec3(0.25f), center + glm::vec3(0.25f));
+	}
+
+	//nothing here touches opengl, so this runs the same without a GPU
+	OcclusionRasterizer rasterizer;
+	unsigned int counts[] = { 10, 100, 1000 };
+	unsigned int threadCounts[] = { 1, 2, 4, 8 };
+	for (auto count : counts)
+	{
+		std::vector<glm::mat4> transforms(count);
+		for (auto& transform : transforms)
+		{
+			transform = glm::translate(glm::mat4(1), randomInView(2, 20)) * glm::rotate(glm::mat4(1), randomFloat(0, glm::two_pi<float>()), glm::vec3(0, 1, 0));
+		}
+
+		for (auto threads : threadCounts)
+		{
+			ThreadPool pool(threads);
+			OcclusionBenchmarkResult result;
+			result.m_occluderCount = count;
+			result.m_threadCount = threads;
+			result.m_binMS = 0;
+			result.m_rasterizeMS = 0;
+			for (int i = 0; i < 10; i++)
+			{
+				Clock::time_point start = Clock::now();
+				rasterizer.begin(projectionView, threads);
+				for (auto& transform : transforms)
+				{
+					rasterizer.addOccluder(m_soulSpearOccluder, transform);
+				}
+				pool.run([&](unsigned int a_thread) { rasterizer.bin(a_thread); });
+				result.m_binMS += elapsedMS(start) / 10;
+
+				start = Clock::now();
+				pool.run([&](unsigned int a_thread) { rasterizer.rasterize(a_thread); });
+				result.m_rasterizeMS += elapsedMS(start) / 10;
+			}
+			result.m_triangleCount = rasterizer.getTriangleCount();
+			result.m_occludersPerMS = count / (result.m_binMS + result.m_rasterizeMS);
+
+			result.m_testCount = (unsigned int)boxes.size();
+			result.m_occludedCount = 0;
+			Clock::time_point start = Clock::now();
+			for (auto& box : boxes)
+			{
+				result.m_occludedCount += rasterizer.isOccluded(box) ? 1 : 0;
+			}
+			result.m_testMS = elapsedMS(start);
+
+			m_occlusionResults.push_back(result);
+		}
+	}
+}
+
+void GraphicsProjectApp::runSpatialIndexBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto elapsedMS = [](Clock::time_point a_start) { return std::chrono::duration<float, std::milli>(Clock::now() - a_start).count(); };
+	auto randomFloat = [](float a_min, float a_max) { return a_min + (a_max - a_min) * (rand() / (float)RAND_MAX); };
+
+	m_spatialResults.clear();
+	Frustum frustum = m_scene->getCurrentCamera()->getFrustum(m_scene->getWindowSize());
+
+	unsigned int counts[] = { 1000, 10000, 100000 };
+	for (auto count : counts)
+	{
+		SpatialBenchmarkResult result;
+		result.m_count = count;
+
+		//the area grows with the count, so the number of boxes near each other stays about the same
+		float halfSize = glm::pow((float)count, 1 / 3.f) * 2;
+		std::vector<glm::vec3> centers(count);
+		std::vector<AABB> boxes(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			centers[i] = glm::vec3(randomFloat(-halfSize, halfSize), randomFloat(-halfSize, halfSize), randomFloat(-halfSize, halfSize));
+			boxes[i] = AABB(centers[i] - glm::vec3(0.5f), centers[i] + glm::vec3(0.5f));
+		}
+
+		AABBTree tree;
+		std::vector<int> proxies(count);
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			proxies[i] = tree.createProxy(boxes[i], i);
+		}
+		result.m_insertMS = elapsedMS(start);
+
+		//small moves stay inside the leaves margin
+		for (unsigned int i = 0; i < count; i++)
+		{
+			boxes[i] = AABB(boxes[i].m_min + glm::vec3(0.05f), boxes[i].m_max + glm::vec3(0.05f));
+		}
+		start = Clock::now();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			tree.moveProxy(proxies[i], boxes[i]);
+		}
+		result.m_smallMoveMS = elapsedMS(start);
+
+		//large moves reinsert every leaf
+		for (unsigned int i = 0; i < count; i++)
+		{
+			glm::vec3 offset(randomFloat(-2, 2), randomFloat(-2, 2), randomFloat(-2, 2));
+			centers[i] += offset;
+			boxes[i] = AABB(centers[i] - glm::vec3(0.5f), centers[i] + glm::vec3(0.5f));
+		}
+		start = Clock::now();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			tree.moveProxy(proxies[i], boxes[i]);
+		}
+		result.m_largeMoveMS = elapsedMS(start);
+
+		//refitting keeps the structure, so it is compared against the large moves
+		start = Clock::now();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			tree.setProxyBounds(proxies[i], boxes[i]);
+		}
+		tree.refit();
+		result.m_refitMS = elapsedMS(start);
+		result.m_height = tree.getHeight();
+
+		//queries are repeated and averaged, since single ones are too quick to time well
+		std::vector<unsigned int> found;
+		start = Clock::now();
+		for (int i = 0; i < 10; i++)
+		{
+			found.clear();
+			tree.queryFrustum(frustum, found);
+		}
+		result.m_frustumMS = elapsedMS(start) / 10;
+		result.m_frustumCount = (unsigned int)found.size();
+
+		//the same boxes culled as spheres with simd, like the linear cull mode
+		std::vector<float> x(count), y(count), z(count), radius(count, glm::length(glm::vec3(0.5f)));
+		for (unsigned int i = 0; i < count; i++)
+		{
+			x[i] = centers[i].x;
+			y[i] = centers[i].y;
+			z[i] = centers[i].z;
+		}
+		std::vector<unsigned char> visible(count);
+		start = Clock::now();
+		for (int i = 0; i < 10; i++)
+		{
+			frustum.cullSpheres(x.data(), y.data(), z.data(), radius.data(), count, visible.data());
+		}
+		result.m_linearMS = elapsedMS(start) / 10;
+
+		start = Clock::now();
+		for (int i = 0; i < 100; i++)
+		{
+			found.clear();
+			tree.querySphere(BoundingSphere(centers[rand() % count], 5), found);
+		}
+		result.m_sphereMS = elapsedMS(start) / 100;
+
+		start = Clock::now();
+		for (int i = 0; i < 100; i++)
+		{
+			found.clear();
+			glm::vec3 direction = glm::normalize(glm::vec3(randomFloat(-1, 1), randomFloat(-1, 1), randomFloat(-1, 1)) + glm::vec3(0.001f));
+			tree.queryRay(centers[rand() % count], direction, halfSize * 2, found);
+		}
+		result.m_rayMS = elapsedMS(start) / 100;
+
+		m_spatialResults.push_back(result);
+	}
+}
+
+void GraphicsProjectApp::setMaterialTableEnabled(bool a_enabled)
+{
+	m_materialTableEnabled = a_enabled;
+	for (int i = 0; i < 2; i++)
+	{
+		m_scene->setInstancedShader(m_litShaders[i], a_enabled ? m_tableShaders[i] : m_instancedShaders[i]);
+	}
+}
+
+void GraphicsProjectApp::setBenchmarkInstanceCount(unsigned int a_count)
+{
+	//remove extras from the end
+	while (a_count < m_benchmarkInstances.size())
+	{
+		m_scene->removeInstance(m_benchmarkInstances.back());
+		m_benchmarkInstances.pop_back();
+	}
+
+	//lay new ones out in a grid behind the scene, with a tint so each one is visibly separate
+	const unsigned int columns = 250;
+	for (unsigned int i = (unsigned int)m_benchmarkInstances.size(); i < a_count; i++)
+	{
+		glm::vec3 position((float)(i % columns) * 1.5f, 0, -5 - (float)(i / columns) * 1.5f);
+		Instance instance(position, glm::vec3(0, (float)(i * 37 % 360), 0), glm::vec3(0.5f), &m_soulSpear.m_mesh, m_benchmarkShader);
+		instance.setDiffuseTint(glm::vec4(0.5f + 0.5f * glm::sin(i * 0.1f), 0.5f + 0.5f * glm::sin(i * 0.13f + 2), 0.5f + 0.5f * glm::sin(i * 0.17f + 4), 1));
+		m_benchmarkInstances.push_back(m_scene->addInstance(instance));
+	}
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 /*  Created: 10/3/2021
  *  Author: Thomas Dufresne
  *
- *  Last Modified: 8/4/2021
+ *  Last Modified: 19/10/2026
  *
  *	Used as the entry point for the graphics application
  */
@@ -9,7 +9,10 @@
 #include "Application.h"
 #include <glm/mat4x4.hpp>
 #include <vector>
+#include <functional>
 #include "OBJMesh.h"
+#include "InstanceStore.h"
+#include "OcclusionRasterizer.h"
 
 class Scene;
 class ParticleGenerator;
@@ -26,6 +29,8 @@ public:
 
 	virtual void update(float a_deltaTime);
 	virtual void draw();
+	// Check GPU culling against the CPU with 1k, 10k, and 100k soul spears. Returns the number of differences, or -1 if it never ran
+	virtual int test();
 
 	bool loadShaderAndMeshLogic();
 	
@@ -41,15 +46,69 @@ protected:
 	struct EditorTransform
 	{
 		std::string m_name;
-		glm::mat4& m_transform;
+		// Node in the scene's hierarchy, whose attached instance follows it
+		unsigned int m_node;
 
 		glm::vec3 m_position;
 		glm::vec3 m_rotation;
 		glm::vec3 m_scale;
 	};
 
+	// Average times of one benchmark's timed frames
+	struct BenchmarkTiming
+	{
+		// CPU time issuing the draws, then the whole frame once the GPU has finished, and the GPU's share of it
+		float m_drawMS;
+		float m_frameMS;
+		float m_gpuMS;
+	};
+
 	// Create ImGui components to edit a mesh object
 	void imguiMaterialTool(std::string a_name, MeshObject& a_obj);
+	// Create ImGui window showing compile results for every shader
+	void imguiShaderDiagnostics();
+	// Create ImGui window for timing the scene with different instance counts
+	void imguiInstancingBenchmark();
+	// Create ImGui window for timing the AABB tree against the linear cull
+	void imguiSpatialIndexBenchmark();
+	// Create ImGui window for drawing the scene on more threads, and timing it
+	void imguiThreadingBenchmark();
+	// Create ImGui window for timing the software occlusion rasterizer
+	void imguiOcclusionBenchmark();
+	// Create ImGui window for clustered lighting, and timing it against lighting with every light
+	void imguiLightingBenchmark();
+	// Create ImGui window for cascaded shadow caching, and timing it
+	void imguiShadowBenchmark();
+	// Create ImGui window for budgeted point light shadows, and timing them
+	void imguiPointShadowBenchmark();
+	// Create ImGui window for the depth pre-pass and overdraw, and timing it
+	void imguiDepthPrePassBenchmark();
+	// Create ImGui window for the material table, and timing it against binding materials per draw
+	void imguiMaterialBenchmark();
+	// Apply a benchmark's settings with a_configure, draw until the scene settles, then time BENCHMARK_FRAMES draws.
+	// Settling is two draws, then more while a_settling returns true. a_beforeDraw is given each timed frame's index
+	BenchmarkTiming timeBenchmark(const std::function<void()>& a_configure, const std::function<bool()>& a_settling = nullptr,
+		const std::function<void(int)>& a_beforeDraw = nullptr, const std::function<void()>& a_afterDraw = nullptr);
+	// Add or remove benchmark soul spears until there are a_count of them
+	void setBenchmarkInstanceCount(unsigned int a_count);
+	// Draw instanced batches with the variants that read materials from the scene's table, or bind them per draw
+	void setMaterialTableEnabled(bool a_enabled);
+	// Time building, updating, and querying AABB trees of 1k, 10k, and 100k random boxes
+	void runSpatialIndexBenchmark();
+	// Time Scene::draw with 1k, 10k, and 100k instances on 1, 2, 4, and 8 threads
+	void runThreadingBenchmark();
+	// Time rasterizing 10, 100, and 1000 soul spear occluders on 1, 2, 4, and 8 threads, and testing boxes against them
+	void runOcclusionBenchmark();
+	// Time frames lit by 16, 256, and 4096 point lights, forward and deferred, with and without clustering
+	void runLightingBenchmark();
+	// Time frames of 1000 soul spears without shadows, then with shadows cached and not, with and without a caster moving
+	void runShadowBenchmark();
+	// Time frames with 8 and 64 point lights and one soul spear moving, without point light shadows, then with them redrawn every frame and cached under two budgets
+	void runPointShadowBenchmark();
+	// Time frames of 1000 and 4000 soul spears lit by 64 point lights, forward and deferred, with and without the depth pre-pass
+	void runDepthPrePassBenchmark();
+	// Time frames of 1500 soul spears, carbines, and bunnies with materials bound per draw, then read from the material table
+	void runMaterialBenchmark();
 
 
 	Scene* m_scene;
@@ -60,6 +119,147 @@ protected:
 	MeshObject m_bunny;
 	MeshObject m_soulSpear;
 	MeshObject m_m1Carbine;
+	// Soul spear geometry for the software occlusion buffer
+	OccluderMesh m_soulSpearOccluder;
 
 	std::vector<EditorTransform> m_transforms;
+
+	///instancing benchmark
+	std::vector<InstanceHandle> m_benchmarkInstances;
+	aie::ShaderProgram* m_benchmarkShader;
+	// Phong and normal map shaders, with their instanced variants binding materials per draw or reading the table
+	aie::ShaderProgram* m_litShaders[2];
+	aie::ShaderProgram* m_instancedShaders[2];
+	aie::ShaderProgram* m_tableShaders[2];
+	bool m_materialTableEnabled;
+	// Time spent in Scene::draw on the CPU and GPU
+	float m_sceneCpuMS;
+	float m_sceneGpuMS;
+	// The GPU time is read a frame or more later, so a new query isn't started until it has a result
+	unsigned int m_sceneTimerQuery;
+	bool m_sceneTimerPending;
+	// Sums the GPU time of a benchmark's timed frames
+	unsigned int m_benchmarkQuery;
+	// Results that differed in the last GPU culling check, -1 before it's run
+	int m_gpuCullingDifferences;
+	// Pipeline states applied over the last frame, and the gl calls they needed
+	unsigned int m_pipelineApplyCount;
+	unsigned int m_pipelineChangeCount;
+
+	struct SpatialBenchmarkResult
+	{
+		unsigned int m_count;
+		int m_height;
+		float m_insertMS;
+		float m_smallMoveMS;
+		float m_largeMoveMS;
+		float m_refitMS;
+		float m_frustumMS;
+		float m_linearMS;
+		unsigned int m_frustumCount;
+		float m_sphereMS;
+		float m_rayMS;
+	};
+	std::vector<SpatialBenchmarkResult> m_spatialResults;
+
+	struct ThreadingBenchmarkResult
+	{
+		unsigned int m_count;
+		unsigned int m_threadCount;
+		// Average time for the whole draw, and the parts building and submitting draws
+		float m_drawMS;
+		float m_prepareMS;
+		float m_submitMS;
+	};
+	std::vector<ThreadingBenchmarkResult> m_threadingResults;
+
+	struct OcclusionBenchmarkResult
+	{
+		unsigned int m_occluderCount;
+		unsigned int m_threadCount;
+		// Triangles left after dropping those off screen or crossing the near plane
+		unsigned int m_triangleCount;
+		float m_binMS;
+		float m_rasterizeMS;
+		float m_occludersPerMS;
+		float m_testMS;
+		unsigned int m_testCount;
+		unsigned int m_occludedCount;
+	};
+	std::vector<OcclusionBenchmarkResult> m_occlusionResults;
+
+	struct LightingBenchmarkResult
+	{
+		unsigned int m_lightCount;
+		bool m_deferred;
+		bool m_clustered;
+		bool m_instanceLights;
+		// Average frame time on the CPU, waiting for the GPU to finish, and the GPU's share of it
+		float m_frameMS;
+		float m_gpuMS;
+		float m_binMS;
+		// Time building draws, which includes finding each instance's lights
+		float m_prepareMS;
+		// Lights in every cluster combined, or in every instance's list
+		unsigned int m_indexCount;
+		// GPU time each light above the first 16 added, 0 for the first count
+		float m_perLightMS;
+	};
+	std::vector<LightingBenchmarkResult> m_lightingResults;
+
+	struct ShadowBenchmarkResult
+	{
+		bool m_shadows;
+		bool m_cached;
+		bool m_moving;
+		float m_frameMS;
+		float m_gpuMS;
+		// Averages per frame of the shadow update
+		float m_updateMS;
+		float m_staticTiles;
+		float m_dynamicTiles;
+		float m_drawCalls;
+		float m_casters;
+	};
+	std::vector<ShadowBenchmarkResult> m_shadowResults;
+
+	struct PointShadowBenchmarkResult
+	{
+		unsigned int m_lightCount;
+		bool m_shadows;
+		bool m_cached;
+		unsigned int m_budget;
+		float m_frameMS;
+		float m_gpuMS;
+		// Averages per frame of the point shadow update
+		float m_updateMS;
+		float m_facesDrawn;
+		float m_facesWaiting;
+		float m_shadowedLights;
+	};
+	std::vector<PointShadowBenchmarkResult> m_pointShadowResults;
+
+	struct DepthPrePassBenchmarkResult
+	{
+		unsigned int m_instanceCount;
+		bool m_deferred;
+		bool m_prePass;
+		float m_frameMS;
+		float m_gpuMS;
+		// Fragments for each pixel of the window in the last frame timed
+		float m_prePassFragments;
+		float m_shadedFragments;
+	};
+	std::vector<DepthPrePassBenchmarkResult> m_depthPrePassResults;
+
+	struct MaterialBenchmarkResult
+	{
+		bool m_table;
+		bool m_deferred;
+		float m_frameMS;
+		float m_gpuMS;
+		unsigned int m_drawCalls;
+		unsigned int m_materialBinds;
+	};
+	std::vector<MaterialBenchmarkResult> m_materialResults;
 };
\ No newline at end of file
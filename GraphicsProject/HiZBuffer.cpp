@@ -0,0 +1,228 @@
+#include "HiZBuffer.h"
+#include "ShaderLibrary.h"
+#include "Shader.h"
+#include "Camera.h"
+#include <gl_core_4_4.h>
+#include <cstring>
+
+//must match local_size_x and local_size_y in hiz.comp
+#define HIZ_GROUP_SIZE 8
+
+
+HiZBuffer::HiZBuffer(unsigned int a_readbackWidth)
+{
+	m_program = ShaderLibrary::getInstance()->loadCompute("Depth Pyramid", "./shaders/hiz.comp");
+
+	m_depthTexture = 0;
+	m_pyramid = 0;
+	m_size = glm::ivec2(0);
+	m_levelCount = 0;
+
+	m_readbackWidth = a_readbackWidth;
+	m_readbackLevel = 0;
+	glGenBuffers(1, &m_pixelBuffer);
+	m_fence = nullptr;
+	m_readbackSize = glm::ivec2(0);
+	m_readbackScale = 1;
+
+	m_maxCameraMove = 1;
+	m_maxCameraTurn = 5;
+}
+
+HiZBuffer::~HiZBuffer()
+{
+	glDeleteTextures(1, &m_depthTexture);
+	glDeleteTextures(1, &m_pyramid);
+	glDeleteBuffers(1, &m_pixelBuffer);
+	if (m_fence != nullptr)
+	{
+		glDeleteSync((GLsync)m_fence);
+	}
+}
+
+
+void HiZBuffer::build(glm::ivec2 a_size, const FrameContext& a_frame)
+{
+	//only one readback is in flight at a time, so there's nothing to build until it arrives
+	if (!m_program->isReady() || m_fence != nullptr || a_size.x <= 0 || a_size.y <= 0)
+	{
+		return;
+	}
+	if (a_size != m_size)
+	{
+		resize(a_size);
+	}
+
+	//the default framebuffer's depth can't be sampled, so it's copied first
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, m_size.x, m_size.y);
+
+	//each level is built from the one before it
+	m_program->bind();
+	m_program->bindUniform(m_program->getUniform("Source"), 0);
+	int sourceLevel = m_program->getUniform("SourceLevel");
+	glm::ivec2 levelSize = m_size;
+	for (unsigned int level = 0; level < m_levelCount; level++)
+	{
+		glBindTexture(GL_TEXTURE_2D, level == 0 ? m_depthTexture : m_pyramid);
+		m_program->bindUniform(sourceLevel, level == 0 ? 0 : (int)level - 1);
+		glBindImageTexture(0, m_pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((levelSize.x + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (levelSize.y + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+	}
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	//copy a small level in to a pixel buffer, which is read once the fence says it's done
+	m_pendingSize = glm::max(m_size / (1 << m_readbackLevel), glm::ivec2(1));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, m_pendingSize.x * m_pendingSize.y * sizeof(float), nullptr, GL_STREAM_READ);
+	glBindTexture(GL_TEXTURE_2D, m_pyramid);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glGetTexImage(GL_TEXTURE_2D, m_readbackLevel, GL_RED, GL_FLOAT, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_pendingProjectionView = a_frame.m_projectionView;
+	m_pendingCameraTransform = a_frame.m_inverseView;
+}
+
+void HiZBuffer::update()
+{
+	if (m_fence == nullptr)
+	{
+		return;
+	}
+
+	//a timeout of 0 only checks the fence
+	GLenum result = glClientWaitSync((GLsync)m_fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		return;
+	}
+	glDeleteSync((GLsync)m_fence);
+	m_fence = nullptr;
+	if (result == GL_WAIT_FAILED)
+	{
+		return;
+	}
+
+	unsigned int count = m_pendingSize.x * m_pendingSize.y;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+	void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+	if (data != nullptr)
+	{
+		m_depths.resize(count);
+		memcpy(m_depths.data(), data, count * sizeof(float));
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		m_readbackSize = m_pendingSize;
+		m_readbackScale = 1 << m_readbackLevel;
+		m_projectionView = m_pendingProjectionView;
+		m_cameraTransform = m_pendingCameraTransform;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool HiZBuffer::canTest(const FrameContext& a_frame) const
+{
+	if (m_depths.empty())
+	{
+		return false;
+	}
+
+	//compare the camera's position and forward axis with when the depth was drawn
+	const glm::mat4& camera = a_frame.m_inverseView;
+	float moved = glm::length(glm::vec3(camera[3]) - glm::vec3(m_cameraTransform[3]));
+	float turned = glm::degrees(glm::acos(glm::clamp(glm::dot(glm::vec3(camera[2]), glm::vec3(m_cameraTransform[2])), -1.f, 1.f)));
+	return moved <= m_maxCameraMove && turned <= m_maxCameraTurn;
+}
+
+bool HiZBuffer::isOccluded(const glm::vec3& a_center, float a_radius) const
+{
+	//project the corners of the box around the sphere with the camera the depth was drawn with
+	glm::vec2 minUV(1);
+	glm::vec2 maxUV(0);
+	float nearest = 1;
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner = a_center + a_radius * glm::vec3(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1);
+		glm::vec4 clip = m_projectionView * glm::vec4(corner, 1);
+
+		//crossing the camera can't be projected, so it's treated as visible
+		if (clip.w <= 0.0001f)
+		{
+			return false;
+		}
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		minUV = glm::min(minUV, glm::vec2(ndc) * 0.5f + 0.5f);
+		maxUV = glm::max(maxUV, glm::vec2(ndc) * 0.5f + 0.5f);
+		nearest = glm::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+	if (nearest <= 0)
+	{
+		return false;
+	}
+
+	//off screen parts are left to frustum culling
+	minUV = glm::clamp(minUV, glm::vec2(0), glm::vec2(1));
+	maxUV = glm::clamp(maxUV, glm::vec2(0), glm::vec2(1));
+	if (minUV.x >= maxUV.x || minUV.y >= maxUV.y)
+	{
+		return false;
+	}
+
+	//texels covering the box, each holding the furthest depth under it. The last texel in a row also covers any leftover pixels
+	glm::ivec2 baseSize = m_readbackSize * (int)m_readbackScale;
+	glm::ivec2 minTexel = glm::min(glm::ivec2(minUV * glm::vec2(baseSize)) / (int)m_readbackScale, m_readbackSize - 1);
+	glm::ivec2 maxTexel = glm::min(glm::ivec2(maxUV * glm::vec2(baseSize)) / (int)m_readbackScale, m_readbackSize - 1);
+	for (int y = minTexel.y; y <= maxTexel.y; y++)
+	{
+		for (int x = minTexel.x; x <= maxTexel.x; x++)
+		{
+			//something behind the sphere's nearest point shows through
+			if (m_depths[y * m_readbackSize.x + x] >= nearest)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+void HiZBuffer::resize(glm::ivec2 a_size)
+{
+	glDeleteTextures(1, &m_depthTexture);
+	glDeleteTextures(1, &m_pyramid);
+	m_size = a_size;
+
+	m_levelCount = 1;
+	while ((m_size.x >> m_levelCount) > 0 || (m_size.y >> m_levelCount) > 0)
+	{
+		m_levelCount++;
+	}
+
+	//the first level narrow enough is read back
+	m_readbackLevel = 0;
+	while ((unsigned int)(m_size.x >> m_readbackLevel) > m_readbackWidth && m_readbackLevel + 1 < m_levelCount)
+	{
+		m_readbackLevel++;
+	}
+
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, m_size.x, m_size.y);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &m_pyramid);
+	glBindTexture(GL_TEXTURE_2D, m_pyramid);
+	glTexStorage2D(GL_TEXTURE_2D, m_levelCount, GL_R32F, m_size.x, m_size.y);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Depth pyramid for occlusion culling. After a frame is drawn its depth is copied and
+ *	reduced in a compute shader, each level keeping the furthest depth of the four texels
+ *	below it. A small level is read back without stalling, and once it arrives instances can
+ *	be tested against it on the CPU using the camera it was drawn with. Tests are
+ *	conservative, anything that can't be proven hidden counts as visible.
+ */
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+struct FrameContext;
+namespace aie
+{
+	class ShaderProgram;
+}
+
+
+class HiZBuffer
+{
+public:
+	// a_readbackWidth is the largest level width read back for testing on the CPU
+	HiZBuffer(unsigned int a_readbackWidth = 160);
+	~HiZBuffer();
+
+	// Copy the depth of the bound framebuffer and build the pyramid from it, then start reading it back
+	// a_frame is the camera the frame was drawn with
+	void build(glm::ivec2 a_size, const FrameContext& a_frame);
+	// Pick up a readback once the GPU has finished it. Called once per frame, never waits
+	void update();
+
+	// Is there read back depth that can be tested against this frame's camera?
+	// Depth is ignored after cuts and large camera movements, since too much might have been revealed
+	bool canTest(const FrameContext& a_frame) const;
+	// Is a world space sphere fully behind the read back depth?
+	bool isOccluded(const glm::vec3& a_center, float a_radius) const;
+
+	unsigned int getTexture() const { return m_pyramid; }
+	unsigned int getLevelCount() const { return m_levelCount; }
+	// Size of the level used for CPU tests, 0 until one has been read back
+	glm::ivec2 getReadbackSize() const { return m_readbackSize; }
+
+	// How far the camera can move or turn before read back depth is ignored
+	void setMaxCameraChange(float a_distance, float a_degrees) { m_maxCameraMove = a_distance; m_maxCameraTurn = a_degrees; }
+
+protected:
+	// Remake the textures for a new framebuffer size
+	void resize(glm::ivec2 a_size);
+
+
+	aie::ShaderProgram* m_program;
+
+	// Copy of the depth buffer, and the pyramid built from it
+	unsigned int m_depthTexture;
+	unsigned int m_pyramid;
+	glm::ivec2 m_size;
+	unsigned int m_levelCount;
+
+	///readback
+	unsigned int m_readbackWidth;
+	unsigned int m_readbackLevel;
+	unsigned int m_pixelBuffer;
+	// Signalled once the GPU has written the pixel buffer, nullptr when nothing is being read
+	void* m_fence;
+	glm::ivec2 m_pendingSize;
+	glm::mat4 m_pendingProjectionView;
+	glm::mat4 m_pendingCameraTransform;
+
+	// Last level to arrive, and the camera it was drawn with
+	std::vector<float> m_depths;
+	glm::ivec2 m_readbackSize;
+	// Level 0 texels covered by each read back texel on each axis
+	unsigned int m_readbackScale;
+	glm::mat4 m_projectionView;
+	glm::mat4 m_cameraTransform;
+
+	float m_maxCameraMove;
+	float m_maxCameraTurn;
+};
\ No newline at end of file
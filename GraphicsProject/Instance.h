@@ -1,16 +1,14 @@
 /*  Created: 18/3/2021
  *  Author: Thomas Dufresne
  *
- *  Last Modified: 8/4/2021
+ *  Last Modified: 19/10/2026
  *	
- *	Used by Scene to contain meshes and their shaders
+ *	Describes a mesh, its shader, and where to draw it. Scene copies these in to its
+ *	InstanceStore, so they can be created on the stack
  */
 #pragma once
 #include <glm/glm.hpp>
 
-class Camera;
-class Scene;
-
 namespace aie
 {
 	class OBJMesh;
@@ -25,18 +23,20 @@ public:
 	// Uses a transform using position, eulerAngles, and scale
 	Instance(const glm::vec3& a_position, const glm::vec3& a_eulerAngles, const glm::vec3& a_scale, aie::OBJMesh* a_mesh, aie::ShaderProgram* a_shader);
 
-	// Draw the instance's mesh using the scenes active camera
-	// Assumes the shader's lighting and camera position are bound
-	void draw(Scene* a_scene);
-
 	// Create a transform with a set position, rotation, and scale
 	static glm::mat4 createTransform(const glm::vec3& a_position, const glm::vec3& a_eulerAngles, const glm::vec3& a_scale);
 
-	glm::mat4& getTransform() { return m_transform; }
+	const glm::mat4& getTransform() const { return m_transform; }
 	aie::ShaderProgram* getShader() const { return m_shader; }
+	aie::OBJMesh* getMesh() const { return m_mesh; }
+
+	// Colour multiplied with the material's diffuse, lets instances sharing a mesh look different
+	const glm::vec4& getDiffuseTint() const { return m_diffuseTint; }
+	void setDiffuseTint(const glm::vec4& a_tint) { m_diffuseTint = a_tint; }
 	
 protected:
 	glm::mat4 m_transform;
+	glm::vec4 m_diffuseTint;
 	aie::OBJMesh* m_mesh; 
 	aie::ShaderProgram* m_shader;
 };
@@ -0,0 +1,154 @@
+#include "InstanceLights.h"
+#include "Scene.h"
+#include <gl_core_4_4.h>
+#include <algorithm>
+
+//4 lights at a time, using the same check as Bounds.cpp
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHTS_SSE
+#endif
+
+
+InstanceLights::InstanceLights()
+{
+	m_maxRadius = 0;
+	glGenBuffers(1, &m_buffer);
+	m_capacity = 0;
+}
+
+InstanceLights::~InstanceLights()
+{
+	glDeleteBuffers(1, &m_buffer);
+}
+
+
+void InstanceLights::prepare(const Frustum& a_frustum, const std::vector<PointLight*>& a_lights)
+{
+	//lights out of view can't reach anything drawn, so they are culled like instances first
+	unsigned int count = (unsigned int)a_lights.size();
+	m_unsorted.resize(count * 4);
+	m_visible.resize(count);
+	float* x = m_unsorted.data();
+	float* y = x + count;
+	float* z = y + count;
+	float* radius = z + count;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		x[i] = a_lights[i]->m_position.x;
+		y[i] = a_lights[i]->m_position.y;
+		z[i] = a_lights[i]->m_position.z;
+		radius[i] = a_lights[i]->m_range;
+	}
+	if (count > 0)
+	{
+		a_frustum.cullSpheres(x, y, z, radius, count, m_visible.data());
+	}
+
+	m_indices.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (m_visible[i] != 0)
+		{
+			m_indices.push_back(i);
+		}
+	}
+	std::sort(m_indices.begin(), m_indices.end(), [x](unsigned int a_left, unsigned int a_right) { return x[a_left] < x[a_right]; });
+
+	unsigned int visibleCount = (unsigned int)m_indices.size();
+	m_x.resize(visibleCount);
+	m_y.resize(visibleCount);
+	m_z.resize(visibleCount);
+	m_radius.resize(visibleCount);
+	m_maxRadius = 0;
+	for (unsigned int i = 0; i < visibleCount; i++)
+	{
+		unsigned int light = m_indices[i];
+		m_x[i] = x[light];
+		m_y[i] = y[light];
+		m_z[i] = z[light];
+		m_radius[i] = radius[light];
+		m_maxRadius = glm::max(m_maxRadius, radius[light]);
+	}
+}
+
+unsigned int InstanceLights::assign(const AABB& a_bounds, std::vector<unsigned int>& a_indices) const
+{
+	//only lights whose centers are within the largest range of the box's x range can touch it
+	unsigned int i = (unsigned int)(std::lower_bound(m_x.begin(), m_x.end(), a_bounds.m_min.x - m_maxRadius) - m_x.begin());
+	unsigned int end = (unsigned int)(std::upper_bound(m_x.begin() + i, m_x.end(), a_bounds.m_max.x + m_maxRadius) - m_x.begin());
+	unsigned int added = 0;
+
+#if defined(LIGHTS_SSE)
+	//a light touches the box if the distance from its center to the closest point in the box is within its range
+	__m128 zero = _mm_setzero_ps();
+	__m128 minX = _mm_set1_ps(a_bounds.m_min.x);
+	__m128 minY = _mm_set1_ps(a_bounds.m_min.y);
+	__m128 minZ = _mm_set1_ps(a_bounds.m_min.z);
+	__m128 maxX = _mm_set1_ps(a_bounds.m_max.x);
+	__m128 maxY = _mm_set1_ps(a_bounds.m_max.y);
+	__m128 maxZ = _mm_set1_ps(a_bounds.m_max.z);
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&m_x[i]);
+		__m128 y = _mm_loadu_ps(&m_y[i]);
+		__m128 z = _mm_loadu_ps(&m_z[i]);
+		__m128 radius = _mm_loadu_ps(&m_radius[i]);
+
+		__m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)));
+		__m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)));
+		__m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)));
+		__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_mul_ps(radius, radius)));
+		for (int j = 0; j < 4; j++)
+		{
+			if (mask >> j & 1)
+			{
+				a_indices.push_back(m_indices[i + j]);
+				added++;
+			}
+		}
+	}
+#endif
+
+	//whatever is left over, or everything if there's no simd
+	for (; i < end; i++)
+	{
+		glm::vec3 center(m_x[i], m_y[i], m_z[i]);
+		glm::vec3 offset = center - glm::clamp(center, a_bounds.m_min, a_bounds.m_max);
+		if (glm::dot(offset, offset) <= m_radius[i] * m_radius[i])
+		{
+			a_indices.push_back(m_indices[i]);
+			added++;
+		}
+	}
+	return added;
+}
+
+
+void InstanceLights::resize(unsigned int a_count)
+{
+	//the lists change every frame, so the buffer is orphaned instead of waiting on the last frames draws
+	//storage buffers can't be bound empty, so there's always room for a few indices
+	m_capacity = glm::max(m_capacity, glm::max(a_count * (unsigned int)sizeof(unsigned int), 16u));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void InstanceLights::write(unsigned int a_offset, const std::vector<unsigned int>& a_indices)
+{
+	if (a_indices.empty())
+	{
+		return;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, a_offset * sizeof(unsigned int), a_indices.size() * sizeof(unsigned int), a_indices.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void InstanceLights::bind() const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_LIGHT_STORAGE_BINDING, m_buffer);
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Point light lists for each drawn instance. Each frame the lights touching the camera's
+ *	view are sorted along x, so an instance only tests the lights whose x range can reach
+ *	its box, found with a binary search. Those are tested against the box several at a
+ *	time with SIMD. Threads fill their own lists while culling, and the lists are written
+ *	one after the other in to a shader storage buffer the lit shaders index in to.
+ */
+#pragma once
+#include <vector>
+#include "Bounds.h"
+
+struct PointLight;
+
+// Light count of instances without a list, such as ones culled on the GPU. Their fragments use the light clusters
+#define NO_INSTANCE_LIGHTS 0xffffffff
+
+
+class InstanceLights
+{
+public:
+	InstanceLights();
+	~InstanceLights();
+
+	// Sort the lights touching a_frustum along x, ready for assign()
+	void prepare(const Frustum& a_frustum, const std::vector<PointLight*>& a_lights);
+	// Add the index of every prepared light touching a_bounds to a_indices, returning how many were added
+	// Only reads the prepared lights, so it can be called from several threads at once
+	unsigned int assign(const AABB& a_bounds, std::vector<unsigned int>& a_indices) const;
+
+	// Orphan the index buffer, making room for a_count indices to be written in parts
+	void resize(unsigned int a_count);
+	void write(unsigned int a_offset, const std::vector<unsigned int>& a_indices);
+	// Bind the index buffer to its storage binding
+	void bind() const;
+
+	// Lights touching the view in the last prepare, the only ones instances are tested against
+	unsigned int getPreparedCount() const { return (unsigned int)m_indices.size(); }
+
+protected:
+	///prepared lights, sorted by x and stored as separate arrays for simd
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+	std::vector<float> m_radius;
+	// Index of each prepared light in the scene's point lights
+	std::vector<unsigned int> m_indices;
+	// Largest range of any prepared light, how far past a box's x range lights are searched for
+	float m_maxRadius;
+
+	// Kept to reuse their memory
+	std::vector<unsigned char> m_visible;
+	std::vector<float> m_unsorted;
+
+	unsigned int m_buffer;
+	unsigned int m_capacity;
+};
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "InstanceStore.h"
+#include "OBJMesh.h"
+#include <cassert>
+
+#define INVALID_SLOT 0xffffffff
+
+
+InstanceStore::InstanceStore()
+{
+	m_freeSlot = INVALID_SLOT;
+	m_layoutVersion = 0;
+}
+
+
+InstanceHandle InstanceStore::add(const glm::mat4& a_transform, aie::OBJMesh* a_mesh, aie::ShaderProgram* a_shader, const glm::vec4& a_diffuseTint)
+{
+	//reuse a free slot if there is one
+	unsigned int slot = m_freeSlot;
+	if (slot != INVALID_SLOT)
+	{
+		m_freeSlot = m_slots[slot].m_index;
+	}
+	else
+	{
+		slot = (unsigned int)m_slots.size();
+		m_slots.push_back({ 0, 0 });
+	}
+
+	//new instances always go on the end
+	unsigned int index = getCount();
+	m_slots[slot].m_index = index;
+
+	m_transforms.push_back(a_transform);
+	m_diffuseTints.push_back(a_diffuseTint);
+	m_meshIDs.push_back(getMeshID(a_mesh));
+	m_shaderIDs.push_back(getShaderID(a_shader));
+	m_worldBounds.push_back(AABB());
+	m_sphereX.push_back(0);
+	m_sphereY.push_back(0);
+	m_sphereZ.push_back(0);
+	m_sphereRadius.push_back(0);
+	m_flags.push_back(INSTANCE_VISIBLE);
+	m_slotIndices.push_back(slot);
+	calculateBounds(index);
+
+	m_layoutVersion++;
+
+	InstanceHandle handle;
+	handle.m_slot = slot;
+	handle.m_generation = m_slots[slot].m_generation;
+	return handle;
+}
+
+void InstanceStore::remove(InstanceHandle a_handle)
+{
+	if (!isValid(a_handle))
+	{
+		return;
+	}
+
+	//move the last instance in to the removed ones place
+	unsigned int index = getIndex(a_handle);
+	unsigned int last = getCount() - 1;
+	if (index != last)
+	{
+		m_transforms[index] = m_transforms[last];
+		m_diffuseTints[index] = m_diffuseTints[last];
+		m_meshIDs[index] = m_meshIDs[last];
+		m_shaderIDs[index] = m_shaderIDs[last];
+		m_worldBounds[index] = m_worldBounds[last];
+		m_sphereX[index] = m_sphereX[last];
+		m_sphereY[index] = m_sphereY[last];
+		m_sphereZ[index] = m_sphereZ[last];
+		m_sphereRadius[index] = m_sphereRadius[last];
+		m_flags[index] = m_flags[last];
+		m_slotIndices[index] = m_slotIndices[last];
+		m_slots[m_slotIndices[index]].m_index = index;
+	}
+	m_transforms.pop_back();
+	m_diffuseTints.pop_back();
+	m_meshIDs.pop_back();
+	m_shaderIDs.pop_back();
+	m_worldBounds.pop_back();
+	m_sphereX.pop_back();
+	m_sphereY.pop_back();
+	m_sphereZ.pop_back();
+	m_sphereRadius.pop_back();
+	m_flags.pop_back();
+	m_slotIndices.pop_back();
+
+	//invalidate handles to the slot and add it to the free list
+	Slot& slot = m_slots[a_handle.m_slot];
+	slot.m_generation++;
+	slot.m_index = m_freeSlot;
+	m_freeSlot = a_handle.m_slot;
+
+	m_layoutVersion++;
+}
+
+void InstanceStore::clear()
+{
+	//every slot is freed, keeping their generations so old handles stay invalid
+	for (auto slot : m_slotIndices)
+	{
+		m_slots[slot].m_generation++;
+		m_slots[slot].m_index = m_freeSlot;
+		m_freeSlot = slot;
+	}
+
+	m_transforms.clear();
+	m_diffuseTints.clear();
+	m_meshIDs.clear();
+	m_shaderIDs.clear();
+	m_worldBounds.clear();
+	m_sphereX.clear();
+	m_sphereY.clear();
+	m_sphereZ.clear();
+	m_sphereRadius.clear();
+	m_flags.clear();
+	m_slotIndices.clear();
+
+	m_layoutVersion++;
+}
+
+bool InstanceStore::isValid(InstanceHandle a_handle) const
+{
+	return a_handle.m_slot < m_slots.size() && m_slots[a_handle.m_slot].m_generation == a_handle.m_generation;
+}
+
+InstanceHandle InstanceStore::getHandle(unsigned int a_index) const
+{
+	InstanceHandle handle;
+	handle.m_slot = m_slotIndices[a_index];
+	handle.m_generation = m_slots[handle.m_slot].m_generation;
+	return handle;
+}
+
+
+void InstanceStore::setTransform(InstanceHandle a_handle, const glm::mat4& a_transform)
+{
+	unsigned int index = getIndex(a_handle);
+	m_transforms[index] = a_transform;
+	m_flags[index] |= INSTANCE_BOUNDS_DIRTY;
+}
+
+void InstanceStore::setVisible(InstanceHandle a_handle, bool a_visible)
+{
+	unsigned int index = getIndex(a_handle);
+	m_flags[index] = a_visible ? m_flags[index] | INSTANCE_VISIBLE : m_flags[index] & ~INSTANCE_VISIBLE;
+}
+
+void InstanceStore::updateBounds(std::vector<unsigned int>* a_changed)
+{
+	unsigned int count = getCount();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if ((m_flags[i] & INSTANCE_BOUNDS_DIRTY) == 0)
+		{
+			continue;
+		}
+
+		calculateBounds(i);
+		m_flags[i] &= ~INSTANCE_BOUNDS_DIRTY;
+		if (a_changed != nullptr)
+		{
+			a_changed->push_back(i);
+		}
+	}
+}
+
+void InstanceStore::calculateBounds(unsigned int a_index)
+{
+	aie::OBJMesh* mesh = m_meshes[m_meshIDs[a_index]];
+	m_worldBounds[a_index] = mesh->getBounds().transformed(m_transforms[a_index]);
+
+	BoundingSphere sphere = mesh->getBoundingSphere().transformed(m_transforms[a_index]);
+	m_sphereX[a_index] = sphere.m_center.x;
+	m_sphereY[a_index] = sphere.m_center.y;
+	m_sphereZ[a_index] = sphere.m_center.z;
+	m_sphereRadius[a_index] = sphere.m_radius;
+}
+
+
+unsigned short InstanceStore::getMeshID(aie::OBJMesh* a_mesh)
+{
+	auto iter = m_meshLookup.find(a_mesh);
+	if (iter != m_meshLookup.end())
+	{
+		return iter->second;
+	}
+
+	assert(m_meshes.size() < 0xffff && "Too many unique meshes");
+	unsigned short id = (unsigned short)m_meshes.size();
+	m_meshes.push_back(a_mesh);
+	m_meshLookup[a_mesh] = id;
+	return id;
+}
+
+unsigned short InstanceStore::getShaderID(aie::ShaderProgram* a_shader)
+{
+	auto iter = m_shaderLookup.find(a_shader);
+	if (iter != m_shaderLookup.end())
+	{
+		return iter->second;
+	}
+
+	assert(m_shaders.size() < 0xffff && "Too many unique shaders");
+	unsigned short id = (unsigned short)m_shaders.size();
+	m_shaders.push_back(a_shader);
+	m_shaderLookup[a_shader] = id;
+	return id;
+}
\ No newline at end of file
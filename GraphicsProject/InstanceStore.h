@@ -0,0 +1,135 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Stores instances as a structure of arrays, so loops over every instance only touch the
+ *	data they need and read it in order. Instances are packed at the front of each array,
+ *	and removing one moves the last instance in to its place. Handles stay valid while
+ *	instances move around, and become invalid once their instance is removed.
+ */
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+namespace aie
+{
+	class OBJMesh;
+	class ShaderProgram;
+}
+
+
+// Refers to an instance in an InstanceStore
+struct InstanceHandle
+{
+	unsigned int m_slot = 0xffffffff;
+	// Incremented each time the slot is reused, so old handles can be detected
+	unsigned int m_generation = 0;
+};
+
+enum InstanceFlags : unsigned int
+{
+	INSTANCE_VISIBLE = 1 << 0,
+	// Set when the transform changes, cleared once the world bounds are recalculated
+	INSTANCE_BOUNDS_DIRTY = 1 << 1
+};
+
+
+class InstanceStore
+{
+public:
+	InstanceStore();
+	~InstanceStore() {};
+
+	// Add an instance, taking O(1). Meshes and shaders are given an ID the first time they are seen
+	InstanceHandle add(const glm::mat4& a_transform, aie::OBJMesh* a_mesh, aie::ShaderProgram* a_shader, const glm::vec4& a_diffuseTint = glm::vec4(1));
+	// Remove an instance, taking O(1). The last instance is moved in to its place
+	void remove(InstanceHandle a_handle);
+	// Remove every instance. Mesh and shader IDs are kept
+	void clear();
+
+	// Is the handle for an instance that hasn't been removed?
+	bool isValid(InstanceHandle a_handle) const;
+	// Position of the instance in the arrays. Only valid until the next add or remove
+	unsigned int getIndex(InstanceHandle a_handle) const { return m_slots[a_handle.m_slot].m_index; }
+	// Position of the instance using a slot, for things that store slots instead of whole handles
+	unsigned int getSlotIndex(unsigned int a_slot) const { return m_slots[a_slot].m_index; }
+	// Handle for the instance at a position in the arrays
+	InstanceHandle getHandle(unsigned int a_index) const;
+
+	const glm::mat4& getTransform(InstanceHandle a_handle) const { return m_transforms[getIndex(a_handle)]; }
+	void setTransform(InstanceHandle a_handle, const glm::mat4& a_transform);
+	const glm::vec4& getDiffuseTint(InstanceHandle a_handle) const { return m_diffuseTints[getIndex(a_handle)]; }
+	void setDiffuseTint(InstanceHandle a_handle, const glm::vec4& a_tint) { m_diffuseTints[getIndex(a_handle)] = a_tint; }
+	void setVisible(InstanceHandle a_handle, bool a_visible);
+
+	// Recalculate the world bounds of every instance whose transform changed
+	// The index of each one is added to a_changed if it isn't nullptr
+	void updateBounds(std::vector<unsigned int>* a_changed = nullptr);
+
+	///arrays, indexed from 0 to getCount() - 1
+	unsigned int getCount() const { return (unsigned int)m_transforms.size(); }
+	const std::vector<glm::mat4>& getTransforms() const { return m_transforms; }
+	const std::vector<glm::vec4>& getDiffuseTints() const { return m_diffuseTints; }
+	const std::vector<unsigned short>& getMeshIDs() const { return m_meshIDs; }
+	const std::vector<unsigned short>& getShaderIDs() const { return m_shaderIDs; }
+	const std::vector<AABB>& getWorldBounds() const { return m_worldBounds; }
+	// World bounding spheres, split in to one array per component so they can be culled with simd
+	const std::vector<float>& getSphereX() const { return m_sphereX; }
+	const std::vector<float>& getSphereY() const { return m_sphereY; }
+	const std::vector<float>& getSphereZ() const { return m_sphereZ; }
+	const std::vector<float>& getSphereRadius() const { return m_sphereRadius; }
+	const std::vector<unsigned int>& getFlags() const { return m_flags; }
+
+	// Meshes and shaders by ID
+	aie::OBJMesh* getMesh(unsigned short a_id) const { return m_meshes[a_id]; }
+	aie::ShaderProgram* getShader(unsigned short a_id) const { return m_shaders[a_id]; }
+	unsigned int getMeshCount() const { return (unsigned int)m_meshes.size(); }
+	unsigned int getShaderCount() const { return (unsigned int)m_shaders.size(); }
+
+	// Incremented whenever instances are added or removed, so anything built from the arrays knows to rebuild
+	unsigned int getLayoutVersion() const { return m_layoutVersion; }
+
+protected:
+	struct Slot
+	{
+		// Index in to the arrays, or the next free slot when unused
+		unsigned int m_index;
+		unsigned int m_generation;
+	};
+
+	// Recalculate the world bounds of the instance at a_index
+	void calculateBounds(unsigned int a_index);
+	// Get the ID of a mesh or shader, adding it if needed
+	unsigned short getMeshID(aie::OBJMesh* a_mesh);
+	unsigned short getShaderID(aie::ShaderProgram* a_shader);
+
+
+	///per instance arrays
+	std::vector<glm::mat4> m_transforms;
+	std::vector<glm::vec4> m_diffuseTints;
+	std::vector<unsigned short> m_meshIDs;
+	std::vector<unsigned short> m_shaderIDs;
+	std::vector<AABB> m_worldBounds;
+	std::vector<float> m_sphereX;
+	std::vector<float> m_sphereY;
+	std::vector<float> m_sphereZ;
+	std::vector<float> m_sphereRadius;
+	std::vector<unsigned int> m_flags;
+	// Slot that refers to each instance, used to fix up handles when instances move
+	std::vector<unsigned int> m_slotIndices;
+
+	std::vector<Slot> m_slots;
+	// Head of the free slot list, 0xffffffff if empty
+	unsigned int m_freeSlot;
+
+	///mesh and shader tables, looked up with a hash map instead of searching
+	std::vector<aie::OBJMesh*> m_meshes;
+	std::vector<aie::ShaderProgram*> m_shaders;
+	std::unordered_map<aie::OBJMesh*, unsigned short> m_meshLookup;
+	std::unordered_map<aie::ShaderProgram*, unsigned short> m_shaderLookup;
+
+	unsigned int m_layoutVersion;
+};
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "LightClusters.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include <gl_core_4_4.h>
+#include <chrono>
+#include <cstring>
+
+
+LightClusters::LightClusters()
+{
+	m_enabled = true;
+	m_counts = glm::ivec3(1);
+	m_scale = glm::vec4(0);
+
+	glGenBuffers(1, &m_lightBuffer);
+	glGenBuffers(1, &m_clusterBuffer);
+	glGenBuffers(1, &m_indexBuffer);
+	m_lightCapacity = 0;
+	m_clusterCapacity = 0;
+	m_indexCapacity = 0;
+
+	m_buildMS = 0;
+}
+
+LightClusters::~LightClusters()
+{
+	glDeleteBuffers(1, &m_lightBuffer);
+	glDeleteBuffers(1, &m_clusterBuffer);
+	glDeleteBuffers(1, &m_indexBuffer);
+}
+
+
+void LightClusters::build(const FrameContext& a_frame, const std::vector<PointLight*>& a_lights, ThreadPool& a_threadPool)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	m_frame = a_frame;
+
+	//slices are spaced evenly in log(depth), so a fragment's slice is log(depth) * scale + bias
+	m_counts = m_enabled ? glm::ivec3(CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z) : glm::ivec3(1);
+	float logRatio = glm::log(m_frame.m_farPlane / m_frame.m_nearPlane);
+	m_scale.x = m_counts.x / m_frame.m_windowSize.x;
+	m_scale.y = m_counts.y / m_frame.m_windowSize.y;
+	m_scale.z = m_enabled ? m_counts.z / logRatio : 0;
+	m_scale.w = m_enabled ? -m_counts.z * glm::log(m_frame.m_nearPlane) / logRatio : 0;
+
+	unsigned int lightCount = (unsigned int)a_lights.size();
+	m_lights.resize(lightCount);
+	m_viewLights.resize(lightCount);
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		const PointLight& light = *a_lights[i];
+		m_lights[i].m_position = light.m_position;
+		m_lights[i].m_range = light.m_range;
+		m_lights[i].m_color = light.m_color;
+		m_lights[i].m_brightness = light.m_brightness;
+
+		glm::vec3 viewPosition = glm::vec3(m_frame.m_view * glm::vec4(light.m_position, 1));
+		m_viewLights[i] = glm::vec4(viewPosition.x, viewPosition.y, -viewPosition.z, light.m_range);
+	}
+
+	//lights are edited through pointers, so they are compared instead of tracking edits
+	if (m_lightCapacity == 0 || m_lights.size() != m_uploadedLights.size() || memcmp(m_lights.data(), m_uploadedLights.data(), lightCount * sizeof(GPULight)) != 0)
+	{
+		m_uploadedLights = m_lights;
+		uploadBuffer(m_lightBuffer, m_lightCapacity, lightCount * sizeof(GPULight), m_lights.data());
+	}
+
+	unsigned int clusterCount = m_counts.x * m_counts.y * m_counts.z;
+	m_clusterLights.resize(clusterCount);
+	for (auto& lights : m_clusterLights)
+	{
+		lights.clear();
+	}
+	if (m_enabled)
+	{
+		//each thread takes every nth slice, so nearby slices with more lights are spread out
+		unsigned int threadCount = a_threadPool.getThreadCount();
+		a_threadPool.run([this, threadCount](unsigned int a_thread)
+		{
+			for (unsigned int slice = a_thread; slice < (unsigned int)m_counts.z; slice += threadCount)
+			{
+				binSlice(slice);
+			}
+		});
+	}
+	else
+	{
+		for (unsigned int i = 0; i < lightCount; i++)
+		{
+			m_clusterLights[0].push_back(i);
+		}
+	}
+
+	//combine every cluster's list in to one
+	m_clusters.resize(clusterCount);
+	m_indices.clear();
+	for (unsigned int i = 0; i < clusterCount; i++)
+	{
+		m_clusters[i] = glm::uvec2((unsigned int)m_indices.size(), (unsigned int)m_clusterLights[i].size());
+		m_indices.insert(m_indices.end(), m_clusterLights[i].begin(), m_clusterLights[i].end());
+	}
+	uploadBuffer(m_clusterBuffer, m_clusterCapacity, clusterCount * sizeof(glm::uvec2), m_clusters.data());
+	uploadBuffer(m_indexBuffer, m_indexCapacity, (unsigned int)m_indices.size() * sizeof(unsigned int), m_indices.data());
+
+	m_buildMS = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::bind() const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_STORAGE_BINDING, m_lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTER_STORAGE_BINDING, m_clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_STORAGE_BINDING, m_indexBuffer);
+}
+
+
+void LightClusters::binSlice(unsigned int a_slice)
+{
+	float ratio = m_frame.m_farPlane / m_frame.m_nearPlane;
+	float sliceNear = m_frame.m_nearPlane * glm::pow(ratio, a_slice / (float)m_counts.z);
+	float sliceFar = m_frame.m_nearPlane * glm::pow(ratio, (a_slice + 1) / (float)m_counts.z);
+	float scaleX = m_frame.m_projection[0][0];
+	float scaleY = m_frame.m_projection[1][1];
+
+	for (unsigned int i = 0; i < (unsigned int)m_viewLights.size(); i++)
+	{
+		const glm::vec4& light = m_viewLights[i];
+		if (light.z + light.w <= sliceNear || light.z - light.w >= sliceFar)
+		{
+			continue;
+		}
+
+		//project the box around the sphere, cut to the slice. x / depth is smallest at the far end
+		//for positive x and at the near end for negative x, and the other way around for the largest
+		float zNear = glm::max(sliceNear, light.z - light.w);
+		float zFar = glm::min(sliceFar, light.z + light.w);
+		glm::vec2 minimum = glm::vec2(light) - light.w;
+		glm::vec2 maximum = glm::vec2(light) + light.w;
+		glm::vec2 minNDC(scaleX * minimum.x / (minimum.x >= 0 ? zFar : zNear), scaleY * minimum.y / (minimum.y >= 0 ? zFar : zNear));
+		glm::vec2 maxNDC(scaleX * maximum.x / (maximum.x >= 0 ? zNear : zFar), scaleY * maximum.y / (maximum.y >= 0 ? zNear : zFar));
+		if (maxNDC.x < -1 || maxNDC.y < -1 || minNDC.x > 1 || minNDC.y > 1)
+		{
+			continue;
+		}
+
+		//clamped before converting, since lights beside the camera can project very far off screen
+		glm::vec2 counts = glm::vec2(m_counts.x, m_counts.y);
+		glm::ivec2 minTile = glm::ivec2(glm::clamp(minNDC * 0.5f + 0.5f, glm::vec2(0), glm::vec2(1)) * counts);
+		glm::ivec2 maxTile = glm::ivec2(glm::clamp(maxNDC * 0.5f + 0.5f, glm::vec2(0), glm::vec2(1)) * counts);
+		minTile = glm::min(minTile, glm::ivec2(m_counts.x - 1, m_counts.y - 1));
+		maxTile = glm::min(maxTile, glm::ivec2(m_counts.x - 1, m_counts.y - 1));
+		for (int y = minTile.y; y <= maxTile.y; y++)
+		{
+			for (int x = minTile.x; x <= maxTile.x; x++)
+			{
+				m_clusterLights[(a_slice * m_counts.y + y) * m_counts.x + x].push_back(i);
+			}
+		}
+	}
+}
+
+void LightClusters::uploadBuffer(unsigned int a_buffer, unsigned int& a_capacity, unsigned int a_size, const void* a_data)
+{
+	//orphaned each time, so the GPU can keep reading the last frame's data
+	//storage buffers can't be bound empty, so there is always room for something
+	a_capacity = glm::max(a_capacity, glm::max(a_size, 16u));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, a_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, a_capacity, nullptr, GL_STREAM_DRAW);
+	if (a_size > 0)
+	{
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, a_size, a_data);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Clustered point lights. The camera's view is split in to a grid of screen tiles and
+ *	depth slices, and each frame every point light is binned in to the clusters its sphere
+ *	touches. Lights, each cluster's range of the light index list, and the list itself are
+ *	uploaded to shader storage buffers, so fragments only loop over their own cluster's
+ *	lights. Slices are binned in parallel, each thread writing only its own slices.
+ */
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Camera.h"
+
+struct PointLight;
+class ThreadPool;
+
+// Clusters across, up, and in to the view. Depth slices grow exponentially from the near plane
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 9
+#define CLUSTER_COUNT_Z 24
+
+// Shader storage bindings read by the lit shaders. Compute passes bind their own buffers to the
+// same points, so these are bound again before drawing
+enum LightStorageBinding : unsigned int
+{
+	POINT_LIGHT_STORAGE_BINDING = 0,
+	LIGHT_CLUSTER_STORAGE_BINDING = 1,
+	LIGHT_INDEX_STORAGE_BINDING = 2,
+	// Lists of each drawn instance, see InstanceLights
+	INSTANCE_LIGHT_STORAGE_BINDING = 3,
+	// Shadow cube of each light, see PointShadows
+	POINT_SHADOW_STORAGE_BINDING = 4
+};
+
+
+class LightClusters
+{
+public:
+	LightClusters();
+	~LightClusters();
+
+	// Bin every light in to the clusters of a_frame's view and upload the results
+	// Slices are split between a_threadPool's threads
+	void build(const FrameContext& a_frame, const std::vector<PointLight*>& a_lights, ThreadPool& a_threadPool);
+	// Bind the light, cluster, and index buffers to their storage bindings
+	void bind() const;
+
+	// With clustering off every light is put in a single cluster, so fragments loop over all of them
+	void setEnabled(bool a_enabled) { m_enabled = a_enabled; }
+	bool isEnabled() const { return m_enabled; }
+
+	// Number of clusters on each axis
+	glm::ivec3 getClusterCounts() const { return m_counts; }
+	// Fragments find their cluster with pixel * xy, and log(view depth) * z + w
+	glm::vec4 getClusterScale() const { return m_scale; }
+	unsigned int getLightCount() const { return (unsigned int)m_lights.size(); }
+	// Light indices in every cluster combined, how many lights fragments are tested against overall
+	unsigned int getIndexCount() const { return (unsigned int)m_indices.size(); }
+	// Time the last build spent binning and uploading
+	float getBuildTime() const { return m_buildMS; }
+
+protected:
+	// std430 layout of PointLight in the shaders
+	struct GPULight
+	{
+		glm::vec3 m_position;
+		float m_range;
+		glm::vec3 m_color;
+		float m_brightness;
+	};
+
+	// Add every light touching a cluster in a depth slice to that cluster's list
+	void binSlice(unsigned int a_slice);
+	// Upload to a buffer, growing it if needed. Sizes are in bytes
+	static void uploadBuffer(unsigned int a_buffer, unsigned int& a_capacity, unsigned int a_size, const void* a_data);
+
+
+	bool m_enabled;
+	glm::ivec3 m_counts;
+	glm::vec4 m_scale;
+	// Camera the clusters are built for, read by the workers
+	FrameContext m_frame;
+
+	///cpu side data, kept between frames to reuse their memory
+	std::vector<GPULight> m_lights;
+	// Lights as of the last upload, so unchanged lights aren't uploaded again
+	std::vector<GPULight> m_uploadedLights;
+	// View space x and y of each light, then its depth along the camera's forward axis and its range
+	std::vector<glm::vec4> m_viewLights;
+	// Lights touching each cluster, written by the thread binning the cluster's slice
+	std::vector<std::vector<unsigned int>> m_clusterLights;
+	// Offset in to the index list and light count of each cluster, laid out like the shaders' uvec2
+	std::vector<glm::uvec2> m_clusters;
+	std::vector<unsigned int> m_indices;
+
+	///buffers
+	unsigned int m_lightBuffer;
+	unsigned int m_clusterBuffer;
+	unsigned int m_indexBuffer;
+	unsigned int m_lightCapacity;
+	unsigned int m_clusterCapacity;
+	unsigned int m_indexCapacity;
+
+	float m_buildMS;
+};
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "MaterialTable.h"
+#include "OBJMesh.h"
+#include <gl_core_4_4.h>
+#include <cstdio>
+#include <cstring>
+
+//gl formats of each aie::Texture::Format, which start at 1
+static const GLenum s_formats[] = { 0, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+static const GLenum s_internalFormats[] = { 0, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+
+
+MaterialTable::MaterialTable()
+{
+	//the first material is for chunks without one, with the same values as a default constructed material
+	GPUMaterial material;
+	material.m_ambient = glm::vec4(1);
+	material.m_diffuse = glm::vec4(1);
+	material.m_specular = glm::vec4(0);
+	material.m_emissive = glm::vec4(0);
+	material.m_textures = glm::uvec4(NO_MATERIAL_TEXTURE);
+	m_materials.push_back(material);
+
+	//allocated on the first update
+	glGenBuffers(1, &m_buffer);
+	m_capacity = 0;
+}
+
+MaterialTable::~MaterialTable()
+{
+	glDeleteBuffers(1, &m_buffer);
+	for (auto& array : m_arrays)
+	{
+		glDeleteTextures(1, &array.m_handle);
+	}
+}
+
+
+void MaterialTable::addMesh(aie::OBJMesh* a_mesh)
+{
+	if (contains(a_mesh))
+	{
+		return;
+	}
+
+	//only the textures are filled in here, the values are packed each update
+	m_meshes[a_mesh] = (unsigned int)m_materials.size();
+	for (unsigned int i = 0; i < a_mesh->getMaterialCount(); i++)
+	{
+		const aie::OBJMesh::Material& material = a_mesh->getMaterial(i);
+		GPUMaterial packed;
+		memset(&packed, 0, sizeof(GPUMaterial));
+		packed.m_textures = glm::uvec4(addTexture(material.diffuseTexture), addTexture(material.specularTexture), addTexture(material.normalTexture), NO_MATERIAL_TEXTURE);
+		m_materials.push_back(packed);
+		m_sources.push_back(std::make_pair(a_mesh, i));
+	}
+}
+
+void MaterialTable::update()
+{
+	//materials can be edited at any time, and there are few enough to pack every frame
+	for (unsigned int i = 0; i < m_sources.size(); i++)
+	{
+		const aie::OBJMesh::Material& material = m_sources[i].first->getMaterial(m_sources[i].second);
+		GPUMaterial& packed = m_materials[i + 1];
+		packed.m_ambient = glm::vec4(material.ambient, material.opacity);
+		packed.m_diffuse = glm::vec4(material.diffuse, material.specularPower);
+		packed.m_specular = glm::vec4(material.specular, 0);
+		packed.m_emissive = glm::vec4(material.emissive, 0);
+	}
+
+	unsigned int size = (unsigned int)(m_materials.size() * sizeof(GPUMaterial));
+	if (m_uploaded.size() == m_materials.size() && memcmp(m_uploaded.data(), m_materials.data(), size) == 0)
+	{
+		return;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+	if (size > m_capacity)
+	{
+		m_capacity = glm::max(size, m_capacity * 2);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, m_capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, m_materials.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	m_uploaded = m_materials;
+}
+
+void MaterialTable::bind() const
+{
+	for (unsigned int i = 0; i < m_arrays.size(); i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT + i);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[i].m_handle);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_STORAGE_BINDING, m_buffer);
+}
+
+
+unsigned int MaterialTable::addTexture(const aie::Texture& a_texture)
+{
+	//the pixels are kept by the texture after loading, so they're uploaded again instead of copied on the gpu
+	if (a_texture.getPixels() == nullptr)
+	{
+		return NO_MATERIAL_TEXTURE;
+	}
+	auto layer = m_layers.find(a_texture.getFilename());
+	if (layer != m_layers.end())
+	{
+		return layer->second;
+	}
+
+	unsigned int index = 0;
+	while (index < m_arrays.size() && (m_arrays[index].m_width != a_texture.getWidth() || m_arrays[index].m_height != a_texture.getHeight() ||
+		m_arrays[index].m_format != a_texture.getFormat()))
+	{
+		index++;
+	}
+	if (index == m_arrays.size())
+	{
+		if (m_arrays.size() == MATERIAL_ARRAY_COUNT)
+		{
+			printf("Texture [%s] left out of the material table, every texture array is in use\n", a_texture.getFilename().c_str());
+			return NO_MATERIAL_TEXTURE;
+		}
+		TextureArray array;
+		array.m_handle = 0;
+		array.m_width = a_texture.getWidth();
+		array.m_height = a_texture.getHeight();
+		array.m_format = a_texture.getFormat();
+		array.m_layerCount = 0;
+		array.m_layerCapacity = 0;
+		m_arrays.push_back(array);
+	}
+
+	TextureArray& array = m_arrays[index];
+	if (array.m_layerCount == array.m_layerCapacity)
+	{
+		reserve(array, glm::max(array.m_layerCapacity * 2, 4u));
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array.m_handle);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, array.m_layerCount, array.m_width, array.m_height, 1, s_formats[array.m_format], GL_UNSIGNED_BYTE, a_texture.getPixels());
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	unsigned int reference = index << 16 | array.m_layerCount;
+	array.m_layerCount++;
+	m_layers[a_texture.getFilename()] = reference;
+	return reference;
+}
+
+void MaterialTable::reserve(TextureArray& a_array, unsigned int a_capacity)
+{
+	//a new array is made at the larger size, and the old layers copied over
+	unsigned int handle;
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, s_internalFormats[a_array.m_format], a_array.m_width, a_array.m_height, a_capacity);
+	//filtered like aie::Texture, which only ever samples its first level
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	if (a_array.m_layerCount > 0)
+	{
+		glCopyImageSubData(a_array.m_handle, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, handle, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, a_array.m_width, a_array.m_height, a_array.m_layerCount);
+	}
+
+	//deleting 0 does nothing, so this is safe the first time
+	glDeleteTextures(1, &a_array.m_handle);
+	a_array.m_handle = handle;
+	a_array.m_layerCapacity = a_capacity;
+}
\ No newline at end of file
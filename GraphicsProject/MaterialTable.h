@@ -0,0 +1,105 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Every material of the scene's meshes packed in to one shader storage buffer, so draws
+ *	with different materials need nothing bound between them. Shaders read their material
+ *	with an index from the mesh pool's material stream. Textures the lit shaders sample are
+ *	copied in to texture arrays, one per size and format, and materials refer to them by
+ *	array and layer. Textures loaded from the same file share a layer.
+ */
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <glm/glm.hpp>
+
+namespace aie
+{
+	class OBJMesh;
+	class Texture;
+}
+
+// Shader storage binding of the materials, after the lighting bindings
+#define MATERIAL_STORAGE_BINDING 5
+// Vertex attribute location of the material index, after the instance attributes
+#define MATERIAL_ATTRIBUTE_LOCATION 10
+// Must match MATERIAL_ARRAY_COUNT in the lit shaders. Textures that don't fit in an existing array once every array is used are skipped
+#define MATERIAL_ARRAY_COUNT 8
+// First texture unit of the arrays, each on the unit after the last
+#define MATERIAL_TEXTURE_UNIT 10
+// Texture reference of a material without that texture, which reads black like an unbound texture
+#define NO_MATERIAL_TEXTURE 0xffffffff
+
+
+class MaterialTable
+{
+public:
+	MaterialTable();
+	~MaterialTable();
+
+	// Add every material of a mesh, copying its textures in to the arrays. Adding the same mesh twice does nothing
+	// The mesh's materials are read every update, so it must stay alive as long as the table
+	void addMesh(aie::OBJMesh* a_mesh);
+	bool contains(aie::OBJMesh* a_mesh) const { return m_meshes.count(a_mesh) > 0; }
+	// Index of a mesh's material in the table. Chunks without a material (-1) use a plain white one
+	unsigned int getIndex(aie::OBJMesh* a_mesh, int a_materialID) const { return a_materialID < 0 ? 0 : m_meshes.at(a_mesh) + a_materialID; }
+
+	// Pack the values of every material, uploading them only if one changed since the last update
+	void update();
+	// Bind the materials to their storage binding and the arrays to their texture units
+	void bind() const;
+
+	unsigned int getMaterialCount() const { return (unsigned int)m_materials.size(); }
+	unsigned int getArrayCount() const { return (unsigned int)m_arrays.size(); }
+	unsigned int getLayerCount() const { return (unsigned int)m_layers.size(); }
+
+protected:
+	// Layout of a material in the lit shaders' storage block
+	struct GPUMaterial
+	{
+		// opacity in w
+		glm::vec4 m_ambient;
+		// specular power in w
+		glm::vec4 m_diffuse;
+		glm::vec4 m_specular;
+		glm::vec4 m_emissive;
+		// array << 16 | layer of the diffuse, specular, and normal textures
+		glm::uvec4 m_textures;
+	};
+	// Textures of one size and format, each a layer
+	struct TextureArray
+	{
+		unsigned int m_handle;
+		unsigned int m_width;
+		unsigned int m_height;
+		unsigned int m_format;
+		unsigned int m_layerCount;
+		unsigned int m_layerCapacity;
+	};
+
+	// Copy a texture's pixels in to the array of its size and format, returning its reference
+	// Textures that didn't load, or have no room, are NO_MATERIAL_TEXTURE
+	unsigned int addTexture(const aie::Texture& a_texture);
+	// Make room in an array for at least a_capacity layers, keeping the ones already there
+	void reserve(TextureArray& a_array, unsigned int a_capacity);
+
+
+	// Index of each mesh's first material
+	std::unordered_map<aie::OBJMesh*, unsigned int> m_meshes;
+	// Mesh and material ID of each material after the default, read when packing
+	std::vector<std::pair<aie::OBJMesh*, unsigned int>> m_sources;
+	// Texture references are filled in when a mesh is added, the values each update
+	std::vector<GPUMaterial> m_materials;
+	// Contents of the storage buffer, compared against to skip uploads
+	std::vector<GPUMaterial> m_uploaded;
+
+	std::vector<TextureArray> m_arrays;
+	// Reference of each texture copied in, keyed by the file it was loaded from
+	std::unordered_map<std::string, unsigned int> m_layers;
+
+	unsigned int m_buffer;
+	unsigned int m_capacity;
+};
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "MeshPool.h"
+#include "OBJMesh.h"
+#include "MaterialTable.h"
+#include <gl_core_4_4.h>
+#include <glm/glm.hpp>
+
+//vertex buffer binding the depth vertex array reads model matrices from
+#define DEPTH_INSTANCE_BINDING 1
+
+
+MeshPool::MeshPool(unsigned int a_vertexCapacity, unsigned int a_indexCapacity)
+{
+	m_vertexCount = 0;
+	m_indexCount = 0;
+	m_vertexCapacity = 0;
+	m_indexCapacity = 0;
+	m_vbo = 0;
+	m_ibo = 0;
+	m_instanceBuffer = 0;
+	m_positionBuffer = 0;
+	m_materialBuffer = 0;
+
+	glGenVertexArrays(1, &m_vao);
+	glGenVertexArrays(1, &m_depthVao);
+	reserve(a_vertexCapacity, a_indexCapacity);
+}
+
+MeshPool::~MeshPool()
+{
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteVertexArrays(1, &m_depthVao);
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteBuffers(1, &m_ibo);
+	glDeleteBuffers(1, &m_positionBuffer);
+	glDeleteBuffers(1, &m_materialBuffer);
+}
+
+
+void MeshPool::addMesh(aie::OBJMesh* a_mesh, const MaterialTable& a_materials)
+{
+	if (contains(a_mesh))
+	{
+		return;
+	}
+
+	//grow once for the whole mesh
+	unsigned int vertexCount = 0;
+	unsigned int indexCount = 0;
+	for (unsigned int i = 0; i < a_mesh->getChunkCount(); i++)
+	{
+		vertexCount += a_mesh->getChunkVertexCount(i);
+		indexCount += a_mesh->getChunkIndexCount(i);
+	}
+	if (m_vertexCount + vertexCount > m_vertexCapacity || m_indexCount + indexCount > m_indexCapacity)
+	{
+		reserve(glm::max(m_vertexCapacity * 2, m_vertexCount + vertexCount), glm::max(m_indexCapacity * 2, m_indexCount + indexCount));
+	}
+
+	m_meshes[a_mesh] = (unsigned int)m_chunks.size();
+	std::vector<aie::OBJMesh::Vertex> vertices;
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> materials;
+	for (unsigned int i = 0; i < a_mesh->getChunkCount(); i++)
+	{
+		PoolChunk chunk;
+		chunk.m_firstIndex = m_indexCount;
+		chunk.m_indexCount = a_mesh->getChunkIndexCount(i);
+		chunk.m_baseVertex = (int)m_vertexCount;
+		m_chunks.push_back(chunk);
+
+		//the chunk's data is already on the gpu, so it's copied from its own buffers. Indices stay
+		//relative to the chunk, the base vertex offsets them when drawing
+		unsigned int vertexSize = a_mesh->getChunkVertexCount(i) * sizeof(aie::OBJMesh::Vertex);
+		unsigned int indexSize = chunk.m_indexCount * sizeof(unsigned int);
+		glBindBuffer(GL_COPY_READ_BUFFER, a_mesh->getChunkVertexBuffer(i));
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, m_vertexCount * sizeof(aie::OBJMesh::Vertex), vertexSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, a_mesh->getChunkIndexBuffer(i));
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, m_indexCount * sizeof(unsigned int), indexSize);
+
+		//positions are read back once to pack them, meshes are only added while loading
+		vertices.resize(a_mesh->getChunkVertexCount(i));
+		positions.resize(vertices.size());
+		glBindBuffer(GL_COPY_READ_BUFFER, a_mesh->getChunkVertexBuffer(i));
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, vertexSize, vertices.data());
+		for (unsigned int j = 0; j < vertices.size(); j++)
+		{
+			positions[j] = glm::vec3(vertices[j].position);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_positionBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, m_vertexCount * sizeof(glm::vec3), positions.size() * sizeof(glm::vec3), positions.data());
+		materials.assign(vertices.size(), a_materials.getIndex(a_mesh, a_mesh->getChunkMaterialID(i)));
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_materialBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, m_vertexCount * sizeof(unsigned int), materials.size() * sizeof(unsigned int), materials.data());
+
+		m_vertexCount += a_mesh->getChunkVertexCount(i);
+		m_indexCount += chunk.m_indexCount;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+DrawElementsIndirectCommand MeshPool::getDrawCommand(aie::OBJMesh* a_mesh, unsigned int a_chunk, unsigned int a_instanceCount, unsigned int a_baseInstance) const
+{
+	const PoolChunk& chunk = getChunk(a_mesh, a_chunk);
+	DrawElementsIndirectCommand command;
+	command.m_count = chunk.m_indexCount;
+	command.m_instanceCount = a_instanceCount;
+	command.m_firstIndex = chunk.m_firstIndex;
+	command.m_baseVertex = chunk.m_baseVertex;
+	command.m_baseInstance = a_baseInstance;
+	return command;
+}
+
+void MeshPool::setInstanceBuffer(unsigned int a_buffer)
+{
+	m_instanceBuffer = a_buffer;
+	setupVertexArray();
+}
+
+void MeshPool::bind() const
+{
+	glBindVertexArray(m_vao);
+}
+
+void MeshPool::bindDepth(unsigned int a_instanceBuffer, unsigned int a_stride) const
+{
+	glBindVertexArray(m_depthVao);
+	glBindVertexBuffer(DEPTH_INSTANCE_BINDING, a_instanceBuffer, 0, a_stride);
+}
+
+void MeshPool::reserve(unsigned int a_vertexCapacity, unsigned int a_indexCapacity)
+{
+	//new buffers are made at the larger size, and the old contents copied over
+	unsigned int buffers[4];
+	glGenBuffers(4, buffers);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]);
+	glBufferData(GL_COPY_WRITE_BUFFER, a_vertexCapacity * sizeof(aie::OBJMesh::Vertex), nullptr, GL_STATIC_DRAW);
+	if (m_vertexCount > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_vbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_vertexCount * sizeof(aie::OBJMesh::Vertex));
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+	glBufferData(GL_COPY_WRITE_BUFFER, a_indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+	if (m_indexCount > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_ibo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_indexCount * sizeof(unsigned int));
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[2]);
+	glBufferData(GL_COPY_WRITE_BUFFER, a_vertexCapacity * sizeof(glm::vec3), nullptr, GL_STATIC_DRAW);
+	if (m_vertexCount > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_positionBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_vertexCount * sizeof(glm::vec3));
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[3]);
+	glBufferData(GL_COPY_WRITE_BUFFER, a_vertexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+	if (m_vertexCount > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_materialBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_vertexCount * sizeof(unsigned int));
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	//deleting 0 does nothing, so this is safe the first time
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteBuffers(1, &m_ibo);
+	glDeleteBuffers(1, &m_positionBuffer);
+	glDeleteBuffers(1, &m_materialBuffer);
+	m_vbo = buffers[0];
+	m_ibo = buffers[1];
+	m_positionBuffer = buffers[2];
+	m_materialBuffer = buffers[3];
+	m_vertexCapacity = a_vertexCapacity;
+	m_indexCapacity = a_indexCapacity;
+
+	setupVertexArray();
+}
+
+void MeshPool::setupVertexArray()
+{
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+
+	//same layout as OBJMesh chunks, so the same shaders can draw both
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(aie::OBJMesh::Vertex), 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(aie::OBJMesh::Vertex), (void*)(sizeof(glm::vec4) * 1));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(aie::OBJMesh::Vertex), (void*)(sizeof(glm::vec4) * 2));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(aie::OBJMesh::Vertex), (void*)(sizeof(glm::vec4) * 2 + sizeof(glm::vec2)));
+	//OBJMesh chunks don't have this, shaders reading it from them get the value set with glVertexAttribI1ui instead
+	glBindBuffer(GL_ARRAY_BUFFER, m_materialBuffer);
+	glEnableVertexAttribArray(MATERIAL_ATTRIBUTE_LOCATION);
+	glVertexAttribIPointer(MATERIAL_ATTRIBUTE_LOCATION, 1, GL_UNSIGNED_INT, sizeof(unsigned int), 0);
+
+	if (m_instanceBuffer != 0)
+	{
+		//a mat4 attribute takes up four locations, one per column
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		for (unsigned int column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(4 + column);
+			glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(aie::OBJMesh::InstanceData), (void*)(sizeof(glm::vec4) * column));
+			glVertexAttribDivisor(4 + column, 1);
+		}
+		glEnableVertexAttribArray(8);
+		glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(aie::OBJMesh::InstanceData), (void*)sizeof(glm::mat4));
+		glVertexAttribDivisor(8, 1);
+		glEnableVertexAttribArray(9);
+		glVertexAttribIPointer(9, 2, GL_UNSIGNED_INT, sizeof(aie::OBJMesh::InstanceData), (void*)(sizeof(glm::mat4) + sizeof(glm::vec4)));
+		glVertexAttribDivisor(9, 1);
+	}
+
+	//positions and model matrices only, sharing the same indices
+	glBindVertexArray(m_depthVao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_positionBuffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+	//the model matrices use a separate binding, so each depth pass can point it at its own buffer when binding
+	for (unsigned int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(4 + column);
+		glVertexAttribFormat(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * column);
+		glVertexAttribBinding(4 + column, DEPTH_INSTANCE_BINDING);
+	}
+	glVertexBindingDivisor(DEPTH_INSTANCE_BINDING, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Shared vertex and index buffers that every mesh chunk is copied in to, drawn through a
+ *	single vertex array. Chunks are found with their first index and base vertex, so draws of
+ *	different meshes don't need to change any state between them, and many instanced draws
+ *	can be made with one glMultiDrawElementsIndirect call. Positions are also kept in a
+ *	separate tightly packed stream, so depth only passes read a third of the vertex data, and
+ *	each vertex's material index in another, so draws of different materials can combine.
+ */
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+namespace aie
+{
+	class OBJMesh;
+}
+class MaterialTable;
+
+// Layout of the commands read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	unsigned int m_count;
+	unsigned int m_instanceCount;
+	unsigned int m_firstIndex;
+	int m_baseVertex;
+	unsigned int m_baseInstance;
+};
+
+
+class MeshPool
+{
+public:
+	// Where a mesh chunk is in the pool's buffers
+	struct PoolChunk
+	{
+		unsigned int m_firstIndex;
+		unsigned int m_indexCount;
+		int m_baseVertex;
+	};
+
+	// Capacities are in vertices and indices, the buffers grow when they run out
+	MeshPool(unsigned int a_vertexCapacity = 1 << 16, unsigned int a_indexCapacity = 1 << 18);
+	~MeshPool();
+
+	// Copy every chunk of a mesh in to the pool, with each chunk's material index from a_materials, which must
+	// already have the mesh. Adding the same mesh twice does nothing
+	void addMesh(aie::OBJMesh* a_mesh, const MaterialTable& a_materials);
+	bool contains(aie::OBJMesh* a_mesh) const { return m_meshes.count(a_mesh) > 0; }
+	// Get a chunk of a mesh that has been added
+	const PoolChunk& getChunk(aie::OBJMesh* a_mesh, unsigned int a_chunk) const { return m_chunks[m_meshes.at(a_mesh) + a_chunk]; }
+	// Fill in an indirect command for a chunk, drawing a_instanceCount instances from a_baseInstance
+	DrawElementsIndirectCommand getDrawCommand(aie::OBJMesh* a_mesh, unsigned int a_chunk, unsigned int a_instanceCount, unsigned int a_baseInstance) const;
+
+	// Point the per-instance attributes (locations 4 to 9) at an instance buffer of OBJMesh::InstanceData
+	void setInstanceBuffer(unsigned int a_buffer);
+	// Bind the vertex array that every pooled chunk is drawn with
+	void bind() const;
+	// Bind the vertex array with only positions (location 0) and model matrices (locations 4 to 7),
+	// for depth only passes. Model matrices are read from a_instanceBuffer, a_stride bytes apart
+	void bindDepth(unsigned int a_instanceBuffer, unsigned int a_stride = sizeof(glm::mat4)) const;
+
+	unsigned int getVertexCount() const { return m_vertexCount; }
+	unsigned int getIndexCount() const { return m_indexCount; }
+	unsigned int getMeshCount() const { return (unsigned int)m_meshes.size(); }
+
+protected:
+	// Make room for at least this many vertices and indices, keeping what is already there
+	void reserve(unsigned int a_vertexCapacity, unsigned int a_indexCapacity);
+	// Point the vertex array at the current buffers
+	void setupVertexArray();
+
+
+	unsigned int m_vao;
+	unsigned int m_vbo;
+	unsigned int m_ibo;
+	// Instance buffer attached to the vertex array, 0 if there isn't one
+	unsigned int m_instanceBuffer;
+	///depth only drawing
+	unsigned int m_depthVao;
+	// A vec3 position for every vertex in m_vbo
+	unsigned int m_positionBuffer;
+	// The material table index of every vertex in m_vbo, the same for a whole chunk
+	unsigned int m_materialBuffer;
+
+	unsigned int m_vertexCount;
+	unsigned int m_indexCount;
+	unsigned int m_vertexCapacity;
+	unsigned int m_indexCapacity;
+
+	std::vector<PoolChunk> m_chunks;
+	// Index of each mesh's first chunk in m_chunks
+	std::unordered_map<aie::OBJMesh*, unsigned int> m_meshes;
+};
\ No newline at end of file
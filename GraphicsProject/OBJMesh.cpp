@@ -1,4 +1,5 @@
 #include "OBJMesh.h"
+#include "Shader.h"
 #include "gl_core_4_4.h"
 #include <glm/geometric.hpp>
 
@@ -63,6 +64,9 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		++index;
 	}
 
+	// attributes are only valid if every chunk has them
+	m_attributeMask = shapes.empty() ? 0 : 0xf;
+
 	// copy shapes
 	m_meshChunks.reserve(shapes.size());
 	for (auto& s : shapes) {
@@ -90,14 +94,17 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		std::vector<Vertex> vertices;
 		vertices.resize(s.mesh.positions.size() / 3);
 		size_t vertCount = vertices.size();
+		chunk.vertexCount = (unsigned int)vertCount;
 
 		bool hasPosition = s.mesh.positions.empty() == false;
 		bool hasNormal = s.mesh.normals.empty() == false;
 		bool hasTexture = s.mesh.texcoords.empty() == false;
 
 		for (size_t i = 0; i < vertCount; ++i) {
-			if (hasPosition)
+			if (hasPosition) {
 				vertices[i].position = glm::vec4(s.mesh.positions[i * 3 + 0], s.mesh.positions[i * 3 + 1], s.mesh.positions[i * 3 + 2], 1);
+				chunk.bounds.expand(glm::vec3(vertices[i].position));
+			}
 			if (hasNormal)
 				vertices[i].normal = glm::vec4(s.mesh.normals[i * 3 + 0], s.mesh.normals[i * 3 + 1], s.mesh.normals[i * 3 + 2], 0);
 
@@ -106,10 +113,26 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 				vertices[i].texcoord = glm::vec2(s.mesh.texcoords[i * 2 + 0], flipTextureV ? 1.0f - s.mesh.texcoords[i * 2 + 1] : s.mesh.texcoords[i * 2 + 1]);
 		}
 
+		// sphere around the middle of the box, as small as the vertices allow
+		if (hasPosition) {
+			chunk.boundingSphere.m_center = chunk.bounds.getCenter();
+			float radiusSqr = 0;
+			for (auto& v : vertices) {
+				glm::vec3 offset = glm::vec3(v.position) - chunk.boundingSphere.m_center;
+				radiusSqr = glm::max(radiusSqr, glm::dot(offset, offset));
+			}
+			chunk.boundingSphere.m_radius = glm::sqrt(radiusSqr);
+			m_bounds.expand(chunk.bounds);
+		}
+
 		// calculate for normal mapping
 		if (hasNormal && hasTexture)
 			calculateTangents(vertices, s.mesh.indices);
 
+		// position, normal, texcoord, tangent
+		unsigned int chunkMask = (hasPosition ? 1 : 0) | (hasNormal ? 2 : 0) | (hasTexture ? 4 : 0) | (hasNormal && hasTexture ? 8 : 0);
+		m_attributeMask &= chunkMask;
+
 		// bind vertex buffer
 		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
 
@@ -142,115 +165,33 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 
 		m_meshChunks.push_back(chunk);
 	}
+
+	// sphere around every chunk's sphere
+	if (m_bounds.isEmpty() == false) {
+		m_boundingSphere.m_center = m_bounds.getCenter();
+		for (auto& c : m_meshChunks)
+			m_boundingSphere.m_radius = glm::max(m_boundingSphere.m_radius, glm::length(c.boundingSphere.m_center - m_boundingSphere.m_center) + c.boundingSphere.m_radius);
+	}
 	
 	// load obj
 	return true;
 }
 
-void OBJMesh::draw(bool usePatches /* = false */) const {
-
-	int program = -1;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
-
-	if (program == -1) {
-		printf("No shader bound!\n");
-		return;
-	}
-
-	// pull uniforms from the shader
-	int kaUniform = glGetUniformLocation(program, "Ka");
-	int kdUniform = glGetUniformLocation(program, "Kd");
-	int ksUniform = glGetUniformLocation(program, "Ks");
-	int keUniform = glGetUniformLocation(program, "Ke");
-	int opacityUniform = glGetUniformLocation(program, "opacity");
-	int specPowUniform = glGetUniformLocation(program, "Ns");
-
-	int alphaTexUniform = glGetUniformLocation(program, "alphaTexture");
-	int ambientTexUniform = glGetUniformLocation(program, "ambientTexture");
-	int diffuseTexUniform = glGetUniformLocation(program, "diffuseTexture");
-	int specTexUniform = glGetUniformLocation(program, "specularTexture");
-	int specHighlightTexUniform = glGetUniformLocation(program, "specularHighlightTexture");
-	int normalTexUniform = glGetUniformLocation(program, "normalTexture");
-	int dispTexUniform = glGetUniformLocation(program, "displacementTexture");
-
-	// set texture slots (these don't change per material)
-	if (diffuseTexUniform >= 0)
-		glUniform1i(diffuseTexUniform, 0);
-	if (alphaTexUniform >= 0)
-		glUniform1i(alphaTexUniform, 1);
-	if (ambientTexUniform >= 0)
-		glUniform1i(ambientTexUniform, 2);
-	if (specTexUniform >= 0)
-		glUniform1i(specTexUniform, 3);
-	if (specHighlightTexUniform >= 0)
-		glUniform1i(specHighlightTexUniform, 4);
-	if (normalTexUniform >= 0)
-		glUniform1i(normalTexUniform, 5);
-	if (dispTexUniform >= 0)
-		glUniform1i(dispTexUniform, 6);
+unsigned int OBJMesh::draw(const ShaderProgram& program, bool usePatches /* = false */, const Frustum* localFrustum /* = nullptr */) const {
 
 	int currentMaterial = -1;
+	unsigned int drawCount = 0;
 
 	// draw the mesh chunks
 	for (auto& c : m_meshChunks) {
 
-		// bind material
-		if (currentMaterial != c.materialID) {
+		if (localFrustum != nullptr && localFrustum->intersects(c.bounds) == false)
+			continue;
+
+		// bind material, unless the program doesn't read any of it
+		if (currentMaterial != c.materialID && c.materialID >= 0 && program.usesMaterial()) {
 			currentMaterial = c.materialID;
-			if (kaUniform >= 0)
-				glUniform3fv(kaUniform, 1, &m_materials[currentMaterial].ambient[0]);
-			if (kdUniform >= 0)
-				glUniform3fv(kdUniform, 1, &m_materials[currentMaterial].diffuse[0]);
-			if (ksUniform >= 0)
-				glUniform3fv(ksUniform, 1, &m_materials[currentMaterial].specular[0]);
-			if (keUniform >= 0)
-				glUniform3fv(keUniform, 1, &m_materials[currentMaterial].emissive[0]);
-			if (opacityUniform >= 0)
-				glUniform1f(opacityUniform, m_materials[currentMaterial].opacity);
-			if (specPowUniform >= 0)
-				glUniform1f(specPowUniform, m_materials[currentMaterial].specularPower);
-
-			glActiveTexture(GL_TEXTURE0);
-			if (m_materials[currentMaterial].diffuseTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].diffuseTexture.getHandle());
-			else if (diffuseTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE1);
-			if (m_materials[currentMaterial].alphaTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].alphaTexture.getHandle());
-			else if (alphaTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE2);
-			if (m_materials[currentMaterial].ambientTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].ambientTexture.getHandle());
-			else if (ambientTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE3);
-			if (m_materials[currentMaterial].specularTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularTexture.getHandle());
-			else if (specTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE4);
-			if (m_materials[currentMaterial].specularHighlightTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularHighlightTexture.getHandle());
-			else if (specHighlightTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE5);
-			if (m_materials[currentMaterial].normalTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].normalTexture.getHandle());
-			else if (normalTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE6);
-			if (m_materials[currentMaterial].displacementTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].displacementTexture.getHandle());
-			else if (dispTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
+			bindMaterial(program, currentMaterial);
 		}
 
 		// bind and draw geometry
@@ -259,6 +200,109 @@ void OBJMesh::draw(bool usePatches /* = false */) const {
 			glDrawElements(GL_PATCHES, c.indexCount, GL_UNSIGNED_INT, 0);
 		else
 			glDrawElements(GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0);
+		++drawCount;
+	}
+
+	return drawCount;
+}
+
+void OBJMesh::setInstanceBuffer(unsigned int buffer) {
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (auto& c : m_meshChunks) {
+		glBindVertexArray(c.vao);
+
+		// a mat4 attribute takes up four locations, one per column
+		for (unsigned int column = 0; column < 4; ++column) {
+			glEnableVertexAttribArray(4 + column);
+			glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(sizeof(glm::vec4) * column));
+			glVertexAttribDivisor(4 + column, 1);
+		}
+
+		// diffuse tint
+		glEnableVertexAttribArray(8);
+		glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)sizeof(glm::mat4));
+		glVertexAttribDivisor(8, 1);
+
+		// point light list
+		glEnableVertexAttribArray(9);
+		glVertexAttribIPointer(9, 2, GL_UNSIGNED_INT, sizeof(InstanceData), (void*)(sizeof(glm::mat4) + sizeof(glm::vec4)));
+		glVertexAttribDivisor(9, 1);
+	}
+
+	// bind 0 for safety
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OBJMesh::drawInstanced(const ShaderProgram& program, unsigned int instanceCount, unsigned int baseInstance, bool usePatches /* = false */) const {
+
+	int currentMaterial = -1;
+
+	// each chunk is one draw call for every instance
+	for (auto& c : m_meshChunks) {
+
+		if (currentMaterial != c.materialID && c.materialID >= 0 && program.usesMaterial()) {
+			currentMaterial = c.materialID;
+			bindMaterial(program, currentMaterial);
+		}
+
+		// base instance offsets in to the shared instance buffer, so the vao doesn't need changing
+		glBindVertexArray(c.vao);
+		glDrawElementsInstancedBaseInstance(usePatches ? GL_PATCHES : GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0, instanceCount, baseInstance);
+	}
+}
+
+void OBJMesh::bindChunk(size_t index) const {
+	glBindVertexArray(m_meshChunks[index].vao);
+}
+
+void OBJMesh::drawChunk(size_t index, unsigned int instanceCount /* = 0 */, unsigned int baseInstance /* = 0 */, bool usePatches /* = false */) const {
+	const MeshChunk& c = m_meshChunks[index];
+	if (instanceCount == 0)
+		glDrawElements(usePatches ? GL_PATCHES : GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0);
+	else
+		glDrawElementsInstancedBaseInstance(usePatches ? GL_PATCHES : GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0, instanceCount, baseInstance);
+}
+
+void OBJMesh::bindMaterial(const ShaderProgram& program, int materialID) const {
+
+	// uniform locations and texture slots come from the program's reflection data,
+	// so nothing needs to be queried from opengl here
+	int kaUniform = program.getMaterialUniform(MATERIAL_AMBIENT);
+	int kdUniform = program.getMaterialUniform(MATERIAL_DIFFUSE);
+	int ksUniform = program.getMaterialUniform(MATERIAL_SPECULAR);
+	int keUniform = program.getMaterialUniform(MATERIAL_EMISSIVE);
+	int opacityUniform = program.getMaterialUniform(MATERIAL_OPACITY);
+	int specPowUniform = program.getMaterialUniform(MATERIAL_SPECULAR_POWER);
+
+	const Material& material = m_materials[materialID];
+
+	if (kaUniform >= 0)
+		glUniform3fv(kaUniform, 1, &material.ambient[0]);
+	if (kdUniform >= 0)
+		glUniform3fv(kdUniform, 1, &material.diffuse[0]);
+	if (ksUniform >= 0)
+		glUniform3fv(ksUniform, 1, &material.specular[0]);
+	if (keUniform >= 0)
+		glUniform3fv(keUniform, 1, &material.emissive[0]);
+	if (opacityUniform >= 0)
+		glUniform1f(opacityUniform, material.opacity);
+	if (specPowUniform >= 0)
+		glUniform1f(specPowUniform, material.specularPower);
+
+	// textures are in slot order, only bind the ones the program samples
+	const Texture* textures[] = {
+		&material.diffuseTexture, &material.alphaTexture, &material.ambientTexture,
+		&material.specularTexture, &material.specularHighlightTexture,
+		&material.normalTexture, &material.displacementTexture,
+	};
+	for (unsigned int slot = 0; slot < 7; ++slot) {
+		if (program.getMaterialUniform((eMaterialUniform)(MATERIAL_DIFFUSE_TEXTURE + slot)) < 0)
+			continue;
+
+		glActiveTexture(GL_TEXTURE0 + slot);
+		glBindTexture(GL_TEXTURE_2D, textures[slot]->getHandle());
 	}
 }
 
@@ -3,12 +3,16 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
 #include <string>
 #include <vector>
 #include "Texture.h"
+#include "Bounds.h"
 
 namespace aie {
 
+class ShaderProgram;
+
 // a simple triangle mesh wrapper
 class OBJMesh {
 public:
@@ -23,6 +27,14 @@ public:
 		glm::vec4 tangent;	// added to attrib location 3
 	};
 
+	// per-instance data read by the INSTANCED shader variants
+	struct InstanceData {
+		glm::mat4 modelMatrix;	// added to attrib locations 4 to 7
+		glm::vec4 diffuseTint;	// added to attrib location 8, multiplies the material's diffuse
+		glm::uvec2 lights;	// added to attrib location 9, offset and count of the instance's point light list
+		glm::uvec2 padding;	// keeps the size a multiple of 16, like the std430 struct the GPU culler writes
+	};
+
 	// a basic material
 	class Material {
 	public:
@@ -54,7 +66,46 @@ public:
 	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false);
 
 	// allow option to draw as patches for tessellation
-	void draw(bool usePatches = false) const;
+	// material uniforms and textures that the program doesn't read are skipped
+	// chunks outside localFrustum are skipped, it must be in the mesh's local space
+	// returns the number of chunks drawn
+	unsigned int draw(const ShaderProgram& program, bool usePatches = false, const Frustum* localFrustum = nullptr) const;
+
+	// point the per-instance attributes (locations 4 to 8) of every chunk at an instance buffer
+	// the buffer holds an InstanceData for each instance, and can be resized without calling this again
+	void setInstanceBuffer(unsigned int buffer);
+
+	// draw instanceCount copies of each chunk, reading per-instance data from baseInstance onwards
+	// requires setInstanceBuffer to have been called
+	void drawInstanced(const ShaderProgram& program, unsigned int instanceCount, unsigned int baseInstance, bool usePatches = false) const;
+
+	// number of draw calls each draw makes
+	size_t getChunkCount() const { return m_meshChunks.size(); }
+	// material of a chunk, -1 if it has none
+	int getChunkMaterialID(size_t index) const { return m_meshChunks[index].materialID; }
+
+	// bind the uniforms and textures of a material that the program reads
+	void bindMaterial(const ShaderProgram& program, int materialID) const;
+	// bind a single chunk's vertex array, to draw it with drawChunk
+	void bindChunk(size_t index) const;
+	// draw the bound chunk, optionally instanced. used by render queues that track state themselves
+	void drawChunk(size_t index, unsigned int instanceCount = 0, unsigned int baseInstance = 0, bool usePatches = false) const;
+
+	// a chunk's buffers and sizes, used to copy it in to a shared mesh pool
+	unsigned int getChunkVertexBuffer(size_t index) const { return m_meshChunks[index].vbo; }
+	unsigned int getChunkIndexBuffer(size_t index) const { return m_meshChunks[index].ibo; }
+	unsigned int getChunkVertexCount(size_t index) const { return m_meshChunks[index].vertexCount; }
+	unsigned int getChunkIndexCount(size_t index) const { return m_meshChunks[index].indexCount; }
+
+	// bit mask of the vertex attribute locations that hold real data for every chunk
+	unsigned int getAttributeMask() const { return m_attributeMask; }
+
+	// local space volumes around every chunk
+	const AABB& getBounds() const { return m_bounds; }
+	const BoundingSphere& getBoundingSphere() const { return m_boundingSphere; }
+	// local space volumes around a single chunk
+	const AABB& getChunkBounds(size_t index) const { return m_meshChunks[index].bounds; }
+	const BoundingSphere& getChunkBoundingSphere(size_t index) const { return m_meshChunks[index].boundingSphere; }
 
 	// access to the filename that was loaded
 	const std::string& getFilename() const { return m_filename; }
@@ -70,12 +121,18 @@ private:
 	struct MeshChunk {
 		unsigned int	vao, vbo, ibo;
 		unsigned int	indexCount;
+		unsigned int	vertexCount;
 		int				materialID;
+		AABB			bounds;
+		BoundingSphere	boundingSphere;
 	};
 
 	std::string				m_filename;
 	std::vector<MeshChunk>	m_meshChunks;
 	std::vector<Material>	m_materials;
+	unsigned int			m_attributeMask = 0;
+	AABB					m_bounds;
+	BoundingSphere			m_boundingSphere;
 };
 
 } // namespace aie
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "OcclusionRasterizer.h"
+#include "tiny_obj_loader.h"
+#include <algorithm>
+#include <cstdio>
+
+//use the widest vector instructions the compiler is targeting
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RASTER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RASTER_SSE
+#endif
+
+//vertices closer than this to the camera plane can't be projected
+#define OCCLUSION_MIN_W 0.0001f
+
+
+bool OccluderMesh::load(const char* a_filename)
+{
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string error = "";
+	std::string file = a_filename;
+	if (!tinyobj::LoadObj(shapes, materials, error, a_filename, file.substr(0, file.find_last_of('/') + 1).c_str()))
+	{
+		printf("%s\n", error.c_str());
+		return false;
+	}
+
+	//shapes are appended, offsetting their indices past the vertices already added
+	m_positions.clear();
+	m_indices.clear();
+	for (auto& shape : shapes)
+	{
+		unsigned int first = (unsigned int)m_positions.size();
+		for (size_t i = 0; i + 2 < shape.mesh.positions.size(); i += 3)
+		{
+			m_positions.push_back(glm::vec3(shape.mesh.positions[i], shape.mesh.positions[i + 1], shape.mesh.positions[i + 2]));
+		}
+		for (auto index : shape.mesh.indices)
+		{
+			m_indices.push_back(first + index);
+		}
+	}
+	return true;
+}
+
+OccluderMesh OccluderMesh::box(const AABB& a_bounds)
+{
+	OccluderMesh mesh;
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		mesh.m_positions.push_back(glm::vec3(i & 1 ? a_bounds.m_max.x : a_bounds.m_min.x, i & 2 ? a_bounds.m_max.y : a_bounds.m_min.y,
+			i & 4 ? a_bounds.m_max.z : a_bounds.m_min.z));
+	}
+
+	//two counter clockwise triangles for each face
+	unsigned int indices[] = { 0, 2, 3, 0, 3, 1,  4, 5, 7, 4, 7, 6,  0, 1, 5, 0, 5, 4,  2, 6, 7, 2, 7, 3,  0, 4, 6, 0, 6, 2,  1, 3, 7, 1, 7, 5 };
+	mesh.m_indices.assign(indices, indices + 36);
+	return mesh;
+}
+
+
+OcclusionRasterizer::OcclusionRasterizer(unsigned int a_width, unsigned int a_height)
+{
+	m_threadCount = 1;
+	m_simdEnabled = true;
+	setResolution(a_width, a_height);
+}
+
+void OcclusionRasterizer::setResolution(unsigned int a_width, unsigned int a_height)
+{
+	m_tilesX = glm::max((a_width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH, 1u);
+	m_tilesY = glm::max((a_height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT, 1u);
+	m_width = m_tilesX * OCCLUSION_TILE_WIDTH;
+	m_height = m_tilesY * OCCLUSION_TILE_HEIGHT;
+	m_depth.assign(m_width * m_height, 1.f);
+}
+
+void OcclusionRasterizer::begin(const glm::mat4& a_projectionView, unsigned int a_threadCount)
+{
+	m_projectionView = a_projectionView;
+	m_occluders.clear();
+	m_threadCount = glm::max(a_threadCount, 1u);
+	m_threadBins.resize(m_threadCount);
+	for (auto& bins : m_threadBins)
+	{
+		bins.m_triangles.clear();
+		bins.m_bins.resize(getTileCount());
+		for (auto& bin : bins.m_bins)
+		{
+			bin.clear();
+		}
+	}
+}
+
+void OcclusionRasterizer::addOccluder(const OccluderMesh& a_mesh, const glm::mat4& a_transform)
+{
+	m_occluders.push_back(Occluder{ &a_mesh, a_transform });
+}
+
+unsigned int OcclusionRasterizer::getTriangleCount() const
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < m_threadCount && i < m_threadBins.size(); i++)
+	{
+		count += (unsigned int)m_threadBins[i].m_triangles.size();
+	}
+	return count;
+}
+
+
+void OcclusionRasterizer::bin(unsigned int a_thread)
+{
+	ThreadBins& bins = m_threadBins[a_thread];
+	glm::vec2 screenSize((float)m_width, (float)m_height);
+	for (size_t i = a_thread; i < m_occluders.size(); i += m_threadCount)
+	{
+		//vertices are shared between triangles, so they are only projected once
+		const OccluderMesh& mesh = *m_occluders[i].m_mesh;
+		glm::mat4 transform = m_projectionView * m_occluders[i].m_transform;
+		bins.m_screenPositions.resize(mesh.m_positions.size());
+		for (size_t j = 0; j < mesh.m_positions.size(); j++)
+		{
+			//pixels, with depth in the same 0 to 1 range as the GPU's depth buffer
+			glm::vec4 clip = transform * glm::vec4(mesh.m_positions[j], 1);
+			glm::vec3 ndc = glm::vec3(clip) / glm::max(clip.w, OCCLUSION_MIN_W);
+			bins.m_screenPositions[j] = glm::vec4((glm::vec2(ndc) * 0.5f + 0.5f) * screenSize, ndc.z * 0.5f + 0.5f, clip.w);
+		}
+		//mirroring transforms flip which way triangles face
+		float facing = glm::determinant(glm::mat3(m_occluders[i].m_transform)) < 0 ? -1.f : 1.f;
+
+		for (size_t j = 0; j + 2 < mesh.m_indices.size(); j += 3)
+		{
+			const glm::vec4& p0 = bins.m_screenPositions[mesh.m_indices[j]];
+			const glm::vec4& p1 = bins.m_screenPositions[mesh.m_indices[j + 1]];
+			const glm::vec4& p2 = bins.m_screenPositions[mesh.m_indices[j + 2]];
+			if (p0.w < OCCLUSION_MIN_W || p1.w < OCCLUSION_MIN_W || p2.w < OCCLUSION_MIN_W)
+			{
+				continue;
+			}
+			glm::vec3 v[3] = { glm::vec3(p0), glm::vec3(p1), glm::vec3(p2) };
+
+			//back faces of a closed mesh are always behind its front faces, and slivers with no area can't be drawn
+			float area = facing * ((v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x));
+			if (area < 0.0001f)
+			{
+				continue;
+			}
+			if (facing < 0)
+			{
+				std::swap(v[1], v[2]);
+			}
+
+			//skip triangles that miss the screen, or are small enough to fall between pixel centers
+			Triangle triangle;
+			glm::vec2 minPixel = glm::min(glm::min(glm::vec2(v[0]), glm::vec2(v[1])), glm::vec2(v[2]));
+			glm::vec2 maxPixel = glm::max(glm::max(glm::vec2(v[0]), glm::vec2(v[1])), glm::vec2(v[2]));
+			if (maxPixel.x < 0 || maxPixel.y < 0 || minPixel.x >= m_width || minPixel.y >= m_height ||
+				glm::ceil(minPixel.x - 0.5f) > glm::floor(maxPixel.x - 0.5f) || glm::ceil(minPixel.y - 0.5f) > glm::floor(maxPixel.y - 0.5f))
+			{
+				continue;
+			}
+			triangle.m_min = glm::max(minPixel, glm::vec2(0));
+			triangle.m_max = glm::min(maxPixel, screenSize - 1.f);
+			for (int k = 0; k < 3; k++)
+			{
+				const glm::vec3& from = v[(k + 1) % 3];
+				const glm::vec3& to = v[(k + 2) % 3];
+				triangle.m_edgeA[k] = from.y - to.y;
+				triangle.m_edgeB[k] = to.x - from.x;
+				triangle.m_edgeC[k] = from.x * to.y - from.y * to.x;
+			}
+
+			//each edge function is its opposite vertex's weight times the area, so depth is a plane too
+			triangle.m_depthA = (triangle.m_edgeA[0] * v[0].z + triangle.m_edgeA[1] * v[1].z + triangle.m_edgeA[2] * v[2].z) / area;
+			triangle.m_depthB = (triangle.m_edgeB[0] * v[0].z + triangle.m_edgeB[1] * v[1].z + triangle.m_edgeB[2] * v[2].z) / area;
+			triangle.m_depthC = (triangle.m_edgeC[0] * v[0].z + triangle.m_edgeC[1] * v[1].z + triangle.m_edgeC[2] * v[2].z) / area;
+
+			unsigned int index = (unsigned int)bins.m_triangles.size();
+			bins.m_triangles.push_back(triangle);
+			glm::ivec2 minTile = glm::ivec2(triangle.m_min) / glm::ivec2(OCCLUSION_TILE_WIDTH, OCCLUSION_TILE_HEIGHT);
+			glm::ivec2 maxTile = glm::ivec2(triangle.m_max) / glm::ivec2(OCCLUSION_TILE_WIDTH, OCCLUSION_TILE_HEIGHT);
+			for (int y = minTile.y; y <= maxTile.y; y++)
+			{
+				for (int x = minTile.x; x <= maxTile.x; x++)
+				{
+					bins.m_bins[y * m_tilesX + x].push_back(index);
+				}
+			}
+		}
+	}
+}
+
+void OcclusionRasterizer::rasterize(unsigned int a_thread)
+{
+	//neighbouring tiles tend to have similar amounts of work, so interleaving spreads it evenly
+	for (unsigned int tile = a_thread; tile < getTileCount(); tile += m_threadCount)
+	{
+		rasterizeTile(tile);
+	}
+}
+
+void OcclusionRasterizer::rasterizeAll()
+{
+	for (unsigned int i = 0; i < m_threadCount; i++)
+	{
+		bin(i);
+	}
+	for (unsigned int i = 0; i < m_threadCount; i++)
+	{
+		rasterize(i);
+	}
+}
+
+void OcclusionRasterizer::rasterizeTile(unsigned int a_tile)
+{
+	int tileX = (a_tile % m_tilesX) * OCCLUSION_TILE_WIDTH;
+	int tileY = (a_tile / m_tilesX) * OCCLUSION_TILE_HEIGHT;
+	for (int y = tileY; y < tileY + OCCLUSION_TILE_HEIGHT; y++)
+	{
+		std::fill(m_depth.begin() + y * m_width + tileX, m_depth.begin() + y * m_width + tileX + OCCLUSION_TILE_WIDTH, 1.f);
+	}
+
+	//the closest depth wins, so the order triangles are drawn in doesn't matter
+	for (unsigned int i = 0; i < m_threadCount; i++)
+	{
+		for (auto index : m_threadBins[i].m_bins[a_tile])
+		{
+			rasterizeTriangle(m_threadBins[i].m_triangles[index], tileX, tileY);
+		}
+	}
+}
+
+void OcclusionRasterizer::rasterizeTriangle(const Triangle& a_triangle, int a_tileX, int a_tileY)
+{
+	const float* edgeA = a_triangle.m_edgeA;
+	const float* edgeB = a_triangle.m_edgeB;
+	const float* edgeC = a_triangle.m_edgeC;
+
+	//pixels of the tile inside the triangle's bounds
+	int minX = glm::max((int)a_triangle.m_min.x, a_tileX);
+	int maxX = glm::min((int)a_triangle.m_max.x, a_tileX + OCCLUSION_TILE_WIDTH - 1);
+	int minY = glm::max((int)a_triangle.m_min.y, a_tileY);
+	int maxY = glm::min((int)a_triangle.m_max.y, a_tileY + OCCLUSION_TILE_HEIGHT - 1);
+
+	if (!m_simdEnabled)
+	{
+		rasterizeScalar(a_triangle, minX, maxX, minY, maxY);
+		return;
+	}
+#if defined(RASTER_AVX)
+	//8 pixels at a time, starting on a multiple of 8 so rows never leave the tile
+	minX = a_tileX + ((minX - a_tileX) & ~7);
+	__m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	__m256 zero = _mm256_setzero_ps();
+	for (int y = minY; y <= maxY; y++)
+	{
+		float centerY = y + 0.5f;
+		__m256 rowEdge0 = _mm256_set1_ps(edgeB[0] * centerY + edgeC[0]);
+		__m256 rowEdge1 = _mm256_set1_ps(edgeB[1] * centerY + edgeC[1]);
+		__m256 rowEdge2 = _mm256_set1_ps(edgeB[2] * centerY + edgeC[2]);
+		__m256 rowDepth = _mm256_set1_ps(a_triangle.m_depthB * centerY + a_triangle.m_depthC);
+		float* row = &m_depth[y * m_width];
+		for (int x = minX; x <= maxX; x += 8)
+		{
+			__m256 centerX = _mm256_add_ps(_mm256_set1_ps((float)x), offsets);
+			__m256 inside = _mm256_and_ps(_mm256_and_ps(
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[0]), centerX), rowEdge0), zero, _CMP_GE_OQ),
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[1]), centerX), rowEdge1), zero, _CMP_GE_OQ)),
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edgeA[2]), centerX), rowEdge2), zero, _CMP_GE_OQ));
+
+			//keep the closest depth where the triangle covers the pixel
+			__m256 depth = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a_triangle.m_depthA), centerX), rowDepth);
+			__m256 current = _mm256_loadu_ps(row + x);
+			__m256 closer = _mm256_and_ps(inside, _mm256_cmp_ps(depth, current, _CMP_LT_OQ));
+			_mm256_storeu_ps(row + x, _mm256_blendv_ps(current, depth, closer));
+		}
+	}
+#elif defined(RASTER_SSE)
+	//4 pixels at a time, starting on a multiple of 4 so rows never leave the tile
+	minX = a_tileX + ((minX - a_tileX) & ~3);
+	__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 zero = _mm_setzero_ps();
+	for (int y = minY; y <= maxY; y++)
+	{
+		float centerY = y + 0.5f;
+		__m128 rowEdge0 = _mm_set1_ps(edgeB[0] * centerY + edgeC[0]);
+		__m128 rowEdge1 = _mm_set1_ps(edgeB[1] * centerY + edgeC[1]);
+		__m128 rowEdge2 = _mm_set1_ps(edgeB[2] * centerY + edgeC[2]);
+		__m128 rowDepth = _mm_set1_ps(a_triangle.m_depthB * centerY + a_triangle.m_depthC);
+		float* row = &m_depth[y * m_width];
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			__m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+			__m128 inside = _mm_and_ps(_mm_and_ps(
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[0]), centerX), rowEdge0), zero),
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[1]), centerX), rowEdge1), zero)),
+				_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[2]), centerX), rowEdge2), zero));
+
+			//keep the closest depth where the triangle covers the pixel
+			__m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a_triangle.m_depthA), centerX), rowDepth);
+			__m128 current = _mm_loadu_ps(row + x);
+			__m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(depth, current));
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(closer, depth), _mm_andnot_ps(closer, current)));
+		}
+	}
+#else
+	rasterizeScalar(a_triangle, minX, maxX, minY, maxY);
+#endif
+}
+
+void OcclusionRasterizer::rasterizeScalar(const Triangle& a_triangle, int a_minX, int a_maxX, int a_minY, int a_maxY)
+{
+	const float* edgeA = a_triangle.m_edgeA;
+	const float* edgeB = a_triangle.m_edgeB;
+	const float* edgeC = a_triangle.m_edgeC;
+	for (int y = a_minY; y <= a_maxY; y++)
+	{
+		float centerY = y + 0.5f;
+		float* row = &m_depth[y * m_width];
+		for (int x = a_minX; x <= a_maxX; x++)
+		{
+			//same order of operations as the simd paths, so every path gives the same depth
+			float centerX = x + 0.5f;
+			if (edgeA[0] * centerX + (edgeB[0] * centerY + edgeC[0]) >= 0 && edgeA[1] * centerX + (edgeB[1] * centerY + edgeC[1]) >= 0 &&
+				edgeA[2] * centerX + (edgeB[2] * centerY + edgeC[2]) >= 0)
+			{
+				row[x] = glm::min(row[x], a_triangle.m_depthA * centerX + (a_triangle.m_depthB * centerY + a_triangle.m_depthC));
+			}
+		}
+	}
+}
+
+
+bool OcclusionRasterizer::isOccluded(const AABB& a_bounds) const
+{
+	//screen rectangle and nearest depth of the box's corners
+	glm::vec2 minPixel(FLT_MAX);
+	glm::vec2 maxPixel(-FLT_MAX);
+	float nearest = 1;
+	glm::vec2 screenSize((float)m_width, (float)m_height);
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner(i & 1 ? a_bounds.m_max.x : a_bounds.m_min.x, i & 2 ? a_bounds.m_max.y : a_bounds.m_min.y, i & 4 ? a_bounds.m_max.z : a_bounds.m_min.z);
+		glm::vec4 clip = m_projectionView * glm::vec4(corner, 1);
+		if (clip.w < OCCLUSION_MIN_W)
+		{
+			return false;
+		}
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 pixel = (glm::vec2(ndc) * 0.5f + 0.5f) * screenSize;
+		minPixel = glm::min(minPixel, pixel);
+		maxPixel = glm::max(maxPixel, pixel);
+		nearest = glm::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+	if (nearest <= 0)
+	{
+		return false;
+	}
+
+	//every pixel the box touches, off screen parts are left to frustum culling
+	if (maxPixel.x < 0 || maxPixel.y < 0 || minPixel.x >= m_width || minPixel.y >= m_height)
+	{
+		return false;
+	}
+	int minX = (int)glm::max(minPixel.x, 0.f);
+	int minY = (int)glm::max(minPixel.y, 0.f);
+	int maxX = (int)glm::min(maxPixel.x, m_width - 1.f);
+	int maxY = (int)glm::min(maxPixel.y, m_height - 1.f);
+
+	//visible if any pixel is at or behind the box's nearest point
+	for (int y = minY; y <= maxY; y++)
+	{
+		const float* row = &m_depth[y * m_width];
+		int x = minX;
+#if defined(RASTER_AVX)
+		__m256 nearest8 = _mm256_set1_ps(nearest);
+		for (; x + 8 <= maxX + 1; x += 8)
+		{
+			if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(row + x), nearest8, _CMP_GE_OQ)) != 0)
+			{
+				return false;
+			}
+		}
+#elif defined(RASTER_SSE)
+		__m128 nearest4 = _mm_set1_ps(nearest);
+		for (; x + 4 <= maxX + 1; x += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), nearest4)) != 0)
+			{
+				return false;
+			}
+		}
+#endif
+		for (; x <= maxX; x++)
+		{
+			if (row[x] >= nearest)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
\ No newline at end of file
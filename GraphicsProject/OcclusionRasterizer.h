@@ -0,0 +1,125 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Software depth rasterizer for occlusion culling on the CPU. A few occluder meshes are
+ *	transformed and binned in to screen tiles, then each tile is rasterized with simd in to a
+ *	small depth buffer. Both steps are split between threads, each binning in to its own lists
+ *	and then rasterizing whole tiles. Bounding boxes are tested against the result.
+ *	Nothing here touches OpenGL.
+ */
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+// Size of a tile in pixels. Widths are a multiple of the widest simd row
+#define OCCLUSION_TILE_WIDTH 32
+#define OCCLUSION_TILE_HEIGHT 16
+
+
+// Simplified geometry drawn in to the occlusion buffer. It must sit inside the mesh it stands in for,
+// and be closed and wound counter clockwise since triangles facing away are skipped
+struct OccluderMesh
+{
+	// Load every shape in an obj file as a single mesh, ignoring everything but positions
+	bool load(const char* a_filename);
+	// Box from a_bounds.m_min to a_bounds.m_max
+	static OccluderMesh box(const AABB& a_bounds);
+
+	std::vector<glm::vec3> m_positions;
+	std::vector<unsigned int> m_indices;
+};
+
+
+class OcclusionRasterizer
+{
+public:
+	// The resolution is rounded up to a whole number of tiles
+	OcclusionRasterizer(unsigned int a_width = 320, unsigned int a_height = 180);
+
+	void setResolution(unsigned int a_width, unsigned int a_height);
+	unsigned int getWidth() const { return m_width; }
+	unsigned int getHeight() const { return m_height; }
+
+	// Start a new frame seen through a_projectionView, throwing away the last frame's occluders
+	// a_threadCount is the number of threads binning and rasterizing it
+	void begin(const glm::mat4& a_projectionView, unsigned int a_threadCount = 1);
+	// Queue an occluder to be drawn with a transform. a_mesh must stay alive until the frame is rasterized
+	void addOccluder(const OccluderMesh& a_mesh, const glm::mat4& a_transform);
+
+	// Transform a_thread's share of the occluders to the screen and bin their triangles in to tiles
+	// Triangles crossing the near plane are dropped, so they never hide anything
+	void bin(unsigned int a_thread);
+	// Clear and rasterize a_thread's share of the tiles. Every thread must finish binning first,
+	// and every tile must be done before testing
+	void rasterize(unsigned int a_thread);
+	// Bin and rasterize on this thread alone
+	void rasterizeAll();
+	// Rasterize a pixel at a time instead of with simd. The depth should match either way, so this is the reference the simd paths are checked against
+	void setSimdEnabled(bool a_enabled) { m_simdEnabled = a_enabled; }
+	bool isSimdEnabled() const { return m_simdEnabled; }
+
+	// Is a world space box fully behind the occluders? Depth is sampled at pixel centers, and
+	// boxes crossing the near plane or off the screen are treated as visible
+	bool isOccluded(const AABB& a_bounds) const;
+
+	unsigned int getTileCount() const { return m_tilesX * m_tilesY; }
+	// Occluders added since begin(), and the triangles they binned on screen
+	unsigned int getOccluderCount() const { return (unsigned int)m_occluders.size(); }
+	unsigned int getTriangleCount() const;
+	// Depth buffer from the bottom row up, 0 at the near plane and 1 where nothing was drawn
+	const std::vector<float>& getDepth() const { return m_depth; }
+
+protected:
+	struct Occluder
+	{
+		const OccluderMesh* m_mesh;
+		glm::mat4 m_transform;
+	};
+	// Screen space triangle set up for rasterizing. Edge functions are a * x + b * y + c,
+	// positive inside the triangle, and depth is a plane over the screen
+	struct Triangle
+	{
+		float m_edgeA[3];
+		float m_edgeB[3];
+		float m_edgeC[3];
+		float m_depthA;
+		float m_depthB;
+		float m_depthC;
+		// Pixel bounds, clamped to the screen
+		glm::vec2 m_min;
+		glm::vec2 m_max;
+	};
+	// Everything a thread writes while binning
+	struct ThreadBins
+	{
+		std::vector<Triangle> m_triangles;
+		// Triangles touching each tile
+		std::vector<std::vector<unsigned int>> m_bins;
+		// Pixel positions and depths of the occluder being binned, with clip space w to find those behind the camera
+		std::vector<glm::vec4> m_screenPositions;
+	};
+
+	// Clear and rasterize a single tile from every thread's bins
+	void rasterizeTile(unsigned int a_tile);
+	// Draw a triangle in to the part of the depth buffer inside a tile
+	void rasterizeTriangle(const Triangle& a_triangle, int a_tileX, int a_tileY);
+	// Draw the pixels of a triangle inside a rectangle without simd
+	void rasterizeScalar(const Triangle& a_triangle, int a_minX, int a_maxX, int a_minY, int a_maxY);
+
+
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_tilesX;
+	unsigned int m_tilesY;
+	std::vector<float> m_depth;
+
+	glm::mat4 m_projectionView;
+	std::vector<Occluder> m_occluders;
+	unsigned int m_threadCount;
+	bool m_simdEnabled;
+	// Kept between frames to reuse their memory
+	std::vector<ThreadBins> m_threadBins;
+};
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ParticleGenerator.h"
 #include "Shader.h"
+#include "ShaderLibrary.h"
 #include <glm/ext.hpp>
 #include <gl_core_4_4.h>
 #include "Camera.h"
@@ -73,19 +74,18 @@ ParticleGenerator::ParticleGenerator(const glm::vec3& a_emitterPosition, Scene*
 	glBindVertexArray(0);
 
 
-	//load shader
-	m_shader = new aie::ShaderProgram();
-	m_shader->loadShader(aie::eShaderStage::VERTEX, "./shaders/particle.vert");
-	m_shader->loadShader(aie::eShaderStage::FRAGMENT, "./shaders/particle.frag");
-	if (!m_shader->link())
-	{
-		printf("Particle shader has an error: %s\n", m_shader->getLastError());
-	}
+	//load shader, which will compile in the background
+	m_shader = ShaderLibrary::getInstance()->load("Particle", "./shaders/particle.vert", "./shaders/particle.frag");
+	//the program is left out of the state, since it is swapped for the fallback while compiling
+	aie::PipelineState::Desc state;
+	state.blend = aie::PipelineState::BLEND_ALPHA;
+	state.depthWrite = false;
+	m_state = aie::PipelineState(state);
 }
 
 ParticleGenerator::~ParticleGenerator()
 {
-	delete m_shader;
+	//the shader is owned by the shader library
 	glDeleteVertexArrays(1, &m_particleVAO);
 	glDeleteBuffers(1, &m_particleQuadBuffer);
 	glDeleteBuffers(1, &m_particlePositionBuffer);
@@ -187,22 +187,19 @@ void ParticleGenerator::update(float a_deltaTime)
 
 void ParticleGenerator::draw()
 {
-	if (!m_isEmiting)
+	//the fallback shader cant draw particles, so wait until the particle shader is ready
+	if (!m_isEmiting || !m_shader->isReady())
 	{
 		return;
 	}
 
 	m_shader->bind();
-	//make particles stack with alpha blending
-	glDepthMask(false);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	m_state.apply();
 	//bind VAO
 	glBindVertexArray(m_particleVAO);
 
 
-	//bind uniforms
-	m_shader->bindUniform("CameraPosition", m_scene->getCurrentCamera()->getPosition());
-	m_shader->bindUniform("ProjectionViewMatrix", m_scene->getCurrentCamera()->getProjectionMatrix(m_scene->getWindowSize()) * m_scene->getCurrentCamera()->getViewMatrix());
+	//camera position and projection view are read from the scene's frame uniform buffer
 	
 	//set position buffer to position data
 	glBindBuffer(GL_ARRAY_BUFFER, m_particlePositionBuffer);
@@ -219,9 +216,6 @@ void ParticleGenerator::draw()
 
 	//unbind VAO
 	glBindVertexArray(0);
-	//reset defaults
-	glDepthMask(true);
-	glBlendFunc(GL_ONE, GL_ZERO);
 }
 
 
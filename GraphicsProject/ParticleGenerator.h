@@ -1,7 +1,7 @@
 /*  Created: 19/3/2021
  *  Author: Thomas Dufresne
  *
- *  Last Modified: 8/4/2021
+ *  Last Modified: 19/10/2026
  *
  *	GPU instanced particle generator with billboarding. After instantiating the class, 
  *	setup() is used to start emitting particles, and sets the particle variables.
@@ -9,6 +9,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <vector>
+#include "PipelineState.h"
 
 namespace aie
 {
@@ -68,7 +69,9 @@ protected:
 	float* m_particleColorData;
 
 	aie::ShaderProgram* m_shader;
-	Scene* m_scene;	//used to get camera
+	//particles stack with alpha blending, without hiding the ones behind them
+	aie::PipelineState m_state;
+	Scene* m_scene;	//draws using its frame uniform buffer
 
 
 	float m_emisionRate;
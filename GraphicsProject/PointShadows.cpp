@@ -0,0 +1,434 @@
+#include "PointShadows.h"
+#include "Scene.h"
+#include "ShaderLibrary.h"
+#include "Shader.h"
+#include <gl_core_4_4.h>
+#include <glm/ext.hpp>
+#include <algorithm>
+#include <chrono>
+
+//faces that are needed for a light to have shadows at all are drawn before faces a caster moved through
+#define REQUIRED_FACE_PRIORITY 1000.f
+//distance to the near plane of each face, casters closer to the light than this are clipped
+#define POINT_SHADOW_NEAR 0.05f
+
+//direction and up vector of each cube face, in the order of the cube map's layers
+static const glm::vec3 s_faceDirections[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+static const glm::vec3 s_faceUps[6] = { glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+
+
+PointShadows::PointShadows()
+{
+	m_program = ShaderLibrary::getInstance()->load("Point Shadow Depth", "./shaders/shadow.vert", "./shaders/shadow.frag", { "POINT_LIGHT" });
+	aie::PipelineState::Desc state;
+	state.blend = aie::PipelineState::BLEND_NONE;
+	m_state = aie::PipelineState(state);
+	m_enabled = true;
+	m_cachingEnabled = true;
+	m_faceBudget = 12;
+	m_layoutVersion = 0;
+
+	for (auto& slot : m_slots)
+	{
+		slot.m_light = nullptr;
+		slot.m_complete = false;
+		slot.m_moved = false;
+		for (auto& valid : slot.m_faceValid)
+		{
+			valid = false;
+		}
+	}
+
+	//distance over range is compared when filtered, 16 bits is plenty for a single light's range
+	glGenTextures(1, &m_cubeArray);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, m_cubeArray);
+	glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT16, POINT_SHADOW_SIZE, POINT_SHADOW_SIZE, POINT_SHADOW_SLOTS * 6);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+	//depth only, the face drawn to is attached before each pass
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_cubeArray, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Point shadow framebuffer incomplete\n");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+	//allocated once there are lights and casters
+	glGenBuffers(1, &m_slotBuffer);
+	m_slotCapacity = 0;
+	glGenBuffers(1, &m_instanceBuffer);
+	m_instanceCapacity = 0;
+	glGenBuffers(1, &m_commandBuffer);
+	m_commandCapacity = 0;
+
+	m_shadowedCount = 0;
+	m_facesDrawn = 0;
+	m_facesWaiting = 0;
+	m_casterCount = 0;
+	m_updateMS = 0;
+}
+
+PointShadows::~PointShadows()
+{
+	glDeleteTextures(1, &m_cubeArray);
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteBuffers(1, &m_slotBuffer);
+	glDeleteBuffers(1, &m_instanceBuffer);
+	glDeleteBuffers(1, &m_commandBuffer);
+}
+
+bool PointShadows::isReady() const
+{
+	return m_program->isReady();
+}
+
+
+void PointShadows::markMoved(const AABB& a_oldBounds, const AABB& a_newBounds)
+{
+	for (auto& slot : m_slots)
+	{
+		if (slot.m_light == nullptr)
+		{
+			continue;
+		}
+
+		//most casters are nowhere near most lights, so the light's sphere is checked before its faces
+		glm::vec3 oldOffset = slot.m_position - glm::clamp(slot.m_position, a_oldBounds.m_min, a_oldBounds.m_max);
+		glm::vec3 newOffset = slot.m_position - glm::clamp(slot.m_position, a_newBounds.m_min, a_newBounds.m_max);
+		float rangeSquared = slot.m_range * slot.m_range;
+		bool touchesOld = glm::dot(oldOffset, oldOffset) <= rangeSquared;
+		bool touchesNew = glm::dot(newOffset, newOffset) <= rangeSquared;
+		if (!touchesOld && !touchesNew)
+		{
+			continue;
+		}
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			if ((touchesOld && slot.m_faceFrustums[face].intersects(a_oldBounds)) || (touchesNew && slot.m_faceFrustums[face].intersects(a_newBounds)))
+			{
+				slot.m_faceValid[face] = false;
+			}
+		}
+	}
+}
+
+void PointShadows::update(const FrameContext& a_frame, const std::vector<PointLight*>& a_lights, const InstanceStore& a_instances, const AABBTree& a_tree, const MeshPool& a_meshPool)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	m_shadowedCount = 0;
+	m_facesDrawn = 0;
+	m_facesWaiting = 0;
+	m_casterCount = 0;
+	unsigned int lightCount = (unsigned int)a_lights.size();
+	m_lightSlots.assign(lightCount, -1);
+
+	if (m_enabled && isReady())
+	{
+		//added and removed instances aren't reported as moving, so any change to the layout redraws everything
+		bool layoutChanged = m_layoutVersion != a_instances.getLayoutVersion();
+		m_layoutVersion = a_instances.getLayoutVersion();
+
+		//lights in view, ranked by how much of the screen they could light
+		m_candidates.clear();
+		m_priorities.resize(lightCount);
+		for (unsigned int i = 0; i < lightCount; i++)
+		{
+			const PointLight* light = a_lights[i];
+			if (!a_frame.m_frustum.intersects(BoundingSphere(light->m_position, light->m_range)))
+			{
+				continue;
+			}
+			float distance = glm::distance(light->m_position, a_frame.m_cameraPosition);
+			m_priorities[i] = light->m_brightness * glm::min(light->m_range / glm::max(distance, 0.0001f), 1.f);
+			m_candidates.push_back(i);
+		}
+		if (m_candidates.size() > POINT_SHADOW_SLOTS)
+		{
+			std::nth_element(m_candidates.begin(), m_candidates.begin() + POINT_SHADOW_SLOTS, m_candidates.end(),
+				[this](unsigned int a_left, unsigned int a_right) { return m_priorities[a_left] > m_priorities[a_right]; });
+			m_candidates.resize(POINT_SHADOW_SLOTS);
+		}
+
+		//lights keep their slots while they stay ranked, so their faces can be reused
+		bool kept[POINT_SHADOW_SLOTS] = {};
+		unsigned int unplaced[POINT_SHADOW_SLOTS];
+		unsigned int unplacedCount = 0;
+		for (auto index : m_candidates)
+		{
+			int found = -1;
+			for (int i = 0; i < POINT_SHADOW_SLOTS && found < 0; i++)
+			{
+				found = m_slots[i].m_light == a_lights[index] ? i : -1;
+			}
+			if (found < 0)
+			{
+				unplaced[unplacedCount++] = index;
+				continue;
+			}
+
+			Slot& slot = m_slots[found];
+			kept[found] = true;
+			slot.m_lightIndex = index;
+			slot.m_priority = m_priorities[index];
+			if (slot.m_position != slot.m_light->m_position || slot.m_range != slot.m_light->m_range)
+			{
+				slot.m_moved = true;
+				fit(slot);
+			}
+		}
+		for (unsigned int i = 0, next = 0; i < POINT_SHADOW_SLOTS; i++)
+		{
+			if (kept[i])
+			{
+				continue;
+			}
+			Slot& slot = m_slots[i];
+			slot.m_light = nullptr;
+			if (next < unplacedCount)
+			{
+				unsigned int index = unplaced[next++];
+				slot.m_light = a_lights[index];
+				slot.m_lightIndex = index;
+				slot.m_priority = m_priorities[index];
+				slot.m_complete = false;
+				slot.m_moved = false;
+				fit(slot);
+			}
+		}
+
+		//changed faces, with those a light can't have shadows without first
+		m_faceUpdates.clear();
+		for (unsigned int i = 0; i < POINT_SHADOW_SLOTS; i++)
+		{
+			Slot& slot = m_slots[i];
+			if (slot.m_light == nullptr)
+			{
+				continue;
+			}
+			float priority = slot.m_priority + (!slot.m_complete || slot.m_moved ? REQUIRED_FACE_PRIORITY : 0);
+			for (unsigned int face = 0; face < 6; face++)
+			{
+				if (layoutChanged || !m_cachingEnabled)
+				{
+					slot.m_faceValid[face] = false;
+				}
+				if (!slot.m_faceValid[face])
+				{
+					FaceUpdate update;
+					update.m_slot = i;
+					update.m_face = face;
+					update.m_priority = priority;
+					m_faceUpdates.push_back(update);
+				}
+			}
+		}
+		unsigned int faceCount = m_cachingEnabled ? glm::min(m_faceBudget, (unsigned int)m_faceUpdates.size()) : (unsigned int)m_faceUpdates.size();
+		std::partial_sort(m_faceUpdates.begin(), m_faceUpdates.begin() + faceCount, m_faceUpdates.end(),
+			[](const FaceUpdate& a_left, const FaceUpdate& a_right) { return a_left.m_priority > a_right.m_priority; });
+		m_facesWaiting = (unsigned int)m_faceUpdates.size() - faceCount;
+
+		m_passes.clear();
+		m_transforms.clear();
+		m_commands.clear();
+		for (unsigned int i = 0; i < faceCount; i++)
+		{
+			addPass(m_faceUpdates[i].m_slot, m_faceUpdates[i].m_face, a_instances, a_tree, a_meshPool);
+			m_slots[m_faceUpdates[i].m_slot].m_faceValid[m_faceUpdates[i].m_face] = true;
+		}
+
+		//lights are only shadowed once every face has something in it
+		for (unsigned int i = 0; i < POINT_SHADOW_SLOTS; i++)
+		{
+			Slot& slot = m_slots[i];
+			if (slot.m_light == nullptr)
+			{
+				continue;
+			}
+			if (std::all_of(slot.m_faceValid, slot.m_faceValid + 6, [](bool a_valid) { return a_valid; }))
+			{
+				slot.m_complete = true;
+				slot.m_moved = false;
+			}
+			if (slot.m_complete)
+			{
+				m_lightSlots[slot.m_lightIndex] = (int)i;
+				m_shadowedCount++;
+			}
+		}
+
+		if (!m_passes.empty())
+		{
+			//casters are only known once every face has been picked, so everything is uploaded at once
+			if (!m_transforms.empty())
+			{
+				unsigned int size = (unsigned int)(m_transforms.size() * sizeof(glm::mat4));
+				m_instanceCapacity = glm::max(m_instanceCapacity, size);
+				glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+				glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity, nullptr, GL_STREAM_DRAW);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, size, m_transforms.data());
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+				size = (unsigned int)(m_commands.size() * sizeof(DrawElementsIndirectCommand));
+				m_commandCapacity = glm::max(m_commandCapacity, size);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+				glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commandCapacity, nullptr, GL_STREAM_DRAW);
+				glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, m_commands.data());
+			}
+
+			GLint framebuffer;
+			GLint viewport[4];
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+			glGetIntegerv(GL_VIEWPORT, viewport);
+
+			m_program->bind();
+			m_state.apply();
+			int lightProjectionView = m_program->getUniform("LightProjectionView");
+			int lightPosition = m_program->getUniform("LightPosition");
+			int lightRange = m_program->getUniform("LightRange");
+			a_meshPool.bindDepth(m_instanceBuffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			glViewport(0, 0, POINT_SHADOW_SIZE, POINT_SHADOW_SIZE);
+			for (auto& pass : m_passes)
+			{
+				glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_cubeArray, 0, pass.m_layer);
+				glClear(GL_DEPTH_BUFFER_BIT);
+				if (pass.m_commandCount > 0)
+				{
+					m_program->bindUniform(lightProjectionView, pass.m_projectionView);
+					m_program->bindUniform(lightPosition, pass.m_position);
+					m_program->bindUniform(lightRange, pass.m_range);
+					glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(pass.m_firstCommand * sizeof(DrawElementsIndirectCommand)), pass.m_commandCount, 0);
+				}
+			}
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			glBindVertexArray(0);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			m_facesDrawn = (unsigned int)m_passes.size();
+		}
+	}
+	else
+	{
+		//shadows come back with every face redrawn
+		for (auto& slot : m_slots)
+		{
+			slot.m_light = nullptr;
+		}
+	}
+
+	//the slots rarely change, so they are only uploaded when they do. Storage buffers can't be bound empty
+	if (m_lightSlots != m_uploadedSlots)
+	{
+		unsigned int size = lightCount * (unsigned int)sizeof(int);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_slotBuffer);
+		if (size > m_slotCapacity || m_slotCapacity == 0)
+		{
+			m_slotCapacity = glm::max(glm::max(size, m_slotCapacity * 2), 16u);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, m_slotCapacity, nullptr, GL_DYNAMIC_DRAW);
+		}
+		if (size > 0)
+		{
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, m_lightSlots.data());
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_uploadedSlots = m_lightSlots;
+	}
+
+	m_updateMS = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void PointShadows::bind() const
+{
+	glActiveTexture(GL_TEXTURE0 + POINT_SHADOW_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, m_cubeArray);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_SHADOW_STORAGE_BINDING, m_slotBuffer);
+}
+
+
+void PointShadows::fit(Slot& a_slot)
+{
+	a_slot.m_position = a_slot.m_light->m_position;
+	a_slot.m_range = a_slot.m_light->m_range;
+
+	//a quarter turn each way, so the six faces cover every direction
+	glm::mat4 projection = glm::perspective(glm::half_pi<float>(), 1.f, POINT_SHADOW_NEAR, a_slot.m_range);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		glm::mat4 view = glm::lookAt(a_slot.m_position, a_slot.m_position + s_faceDirections[face], s_faceUps[face]);
+		a_slot.m_faceMatrices[face] = projection * view;
+		a_slot.m_faceFrustums[face] = Frustum(a_slot.m_faceMatrices[face]);
+		a_slot.m_faceValid[face] = false;
+	}
+}
+
+void PointShadows::addPass(unsigned int a_slot, unsigned int a_face, const InstanceStore& a_instances, const AABBTree& a_tree, const MeshPool& a_meshPool)
+{
+	const Slot& slot = m_slots[a_slot];
+	const Frustum& frustum = slot.m_faceFrustums[a_face];
+	FacePass pass;
+	pass.m_layer = a_slot * 6 + a_face;
+	pass.m_position = slot.m_position;
+	pass.m_range = slot.m_range;
+	pass.m_projectionView = slot.m_faceMatrices[a_face];
+	pass.m_firstCommand = (unsigned int)m_commands.size();
+
+	//every visible caster in the face
+	const std::vector<unsigned int>& flags = a_instances.getFlags();
+	const std::vector<AABB>& bounds = a_instances.getWorldBounds();
+	m_queryResults.clear();
+	a_tree.queryFrustum(frustum, m_queryResults);
+	m_casters.clear();
+	for (auto treeSlot : m_queryResults)
+	{
+		unsigned int index = a_instances.getSlotIndex(treeSlot);
+		if ((flags[index] & INSTANCE_VISIBLE) != 0 && frustum.intersects(bounds[index]))
+		{
+			m_casters.push_back(index);
+		}
+	}
+
+	//casters sharing a mesh are drawn as one instanced command per chunk
+	const std::vector<unsigned short>& meshIDs = a_instances.getMeshIDs();
+	const std::vector<glm::mat4>& transforms = a_instances.getTransforms();
+	std::sort(m_casters.begin(), m_casters.end(), [&meshIDs](unsigned int a_left, unsigned int a_right) { return meshIDs[a_left] < meshIDs[a_right]; });
+	for (unsigned int i = 0; i < m_casters.size();)
+	{
+		unsigned short meshID = meshIDs[m_casters[i]];
+		unsigned int baseInstance = (unsigned int)m_transforms.size();
+		for (; i < m_casters.size() && meshIDs[m_casters[i]] == meshID; i++)
+		{
+			m_transforms.push_back(transforms[m_casters[i]]);
+		}
+
+		//meshes are pooled when their batch is first built, anything newer waits a frame
+		aie::OBJMesh* mesh = a_instances.getMesh(meshID);
+		if (!a_meshPool.contains(mesh))
+		{
+			m_transforms.resize(baseInstance);
+			continue;
+		}
+		unsigned int instanceCount = (unsigned int)m_transforms.size() - baseInstance;
+		for (unsigned int chunk = 0; chunk < mesh->getChunkCount(); chunk++)
+		{
+			m_commands.push_back(a_meshPool.getDrawCommand(mesh, chunk, instanceCount, baseInstance));
+		}
+		m_casterCount += instanceCount;
+	}
+
+	pass.m_commandCount = (unsigned int)m_commands.size() - pass.m_firstCommand;
+	m_passes.push_back(pass);
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Shadows for the point lights that matter most on screen. Each frame the lights touching
+ *	the view are ranked by how large and bright they appear, and the highest ranked are
+ *	given a slot in a cube map array, keeping the slot they already had where possible.
+ *	Faces are only redrawn when their light moves, a caster moves through them, or the
+ *	light is new to its slot, and only a budgeted number of faces are drawn each frame,
+ *	the most important first. Every other face keeps what was drawn in to it before, so
+ *	the cost stays bounded however many lights there are. Faces store distance from the
+ *	light over its range, drawn depth only from the mesh pool's position stream.
+ */
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "MeshPool.h"
+#include "PipelineState.h"
+
+struct FrameContext;
+struct PointLight;
+class InstanceStore;
+class AABBTree;
+namespace aie
+{
+	class ShaderProgram;
+}
+
+// Lights that can have shadows at once, each taking one cube of the array
+#define POINT_SHADOW_SLOTS 16
+// Size of each cube face in texels, must match POINT_SHADOW_SIZE in the lit shaders
+#define POINT_SHADOW_SIZE 256
+// Texture unit the cube map array is bound to for the lit shaders
+#define POINT_SHADOW_TEXTURE_UNIT 9
+
+
+class PointShadows
+{
+public:
+	PointShadows();
+	~PointShadows();
+
+	// The depth program is compiled through the shader library, nothing is drawn until it links
+	bool isReady() const;
+
+	// Record an instance moving from somewhere inside a_oldBounds to a_newBounds, so faces it passed through are redrawn
+	void markMoved(const AABB& a_oldBounds, const AABB& a_newBounds);
+	// Pick the lights with shadows for a_frame's view, redraw up to the budget of their changed faces, and upload
+	// each light's slot. Leaves the framebuffer and viewport as they were
+	void update(const FrameContext& a_frame, const std::vector<PointLight*>& a_lights, const InstanceStore& a_instances, const AABBTree& a_tree, const MeshPool& a_meshPool);
+	// Bind the cube map array to POINT_SHADOW_TEXTURE_UNIT, and each light's slot to its storage binding
+	void bind() const;
+
+	void setEnabled(bool a_enabled) { m_enabled = a_enabled; }
+	bool isEnabled() const { return m_enabled; }
+	// Most faces drawn in one update. Faces over the budget wait for a later frame
+	void setFaceBudget(unsigned int a_faces) { m_faceBudget = a_faces; }
+	unsigned int getFaceBudget() const { return m_faceBudget; }
+	// With caching off every face of every slot is redrawn each frame, ignoring the budget, to compare against
+	void setCachingEnabled(bool a_enabled) { m_cachingEnabled = a_enabled; }
+	bool isCachingEnabled() const { return m_cachingEnabled; }
+
+	///stats of the last update
+	// Lights whose every face has been drawn, which the lit shaders read shadows for
+	unsigned int getShadowedCount() const { return m_shadowedCount; }
+	unsigned int getFacesDrawn() const { return m_facesDrawn; }
+	// Changed faces left waiting for a later frame by the budget
+	unsigned int getFacesWaiting() const { return m_facesWaiting; }
+	// Caster instances drawn in every face combined
+	unsigned int getCasterCount() const { return m_casterCount; }
+	float getUpdateTime() const { return m_updateMS; }
+
+protected:
+	struct Slot
+	{
+		// nullptr if the slot is free
+		PointLight* m_light;
+		// Index of the light in the scene's point lights this frame
+		unsigned int m_lightIndex;
+		// Where the light was when its faces were fitted
+		glm::vec3 m_position;
+		float m_range;
+		// Screen contribution this frame, which faces are drawn in order of
+		float m_priority;
+		// Has every face been drawn since the light took the slot?
+		bool m_complete;
+		// Was the light moved since its faces were drawn?
+		bool m_moved;
+		bool m_faceValid[6];
+		glm::mat4 m_faceMatrices[6];
+		Frustum m_faceFrustums[6];
+	};
+	// A face waiting to be drawn
+	struct FaceUpdate
+	{
+		unsigned int m_slot;
+		unsigned int m_face;
+		float m_priority;
+	};
+	// Casters drawn in to one face, as a range of m_commands
+	struct FacePass
+	{
+		unsigned int m_layer;
+		glm::vec3 m_position;
+		float m_range;
+		glm::mat4 m_projectionView;
+		unsigned int m_firstCommand;
+		unsigned int m_commandCount;
+	};
+
+	// Point a slot's faces at its light's current position and range, invalidating them
+	void fit(Slot& a_slot);
+	// Add a pass drawing every visible caster in a face
+	void addPass(unsigned int a_slot, unsigned int a_face, const InstanceStore& a_instances, const AABBTree& a_tree, const MeshPool& a_meshPool);
+
+
+	aie::ShaderProgram* m_program;
+	aie::PipelineState m_state;
+	bool m_enabled;
+	bool m_cachingEnabled;
+	unsigned int m_faceBudget;
+
+	Slot m_slots[POINT_SHADOW_SLOTS];
+	// Instance layout version the faces were drawn with, adding or removing instances changes it
+	unsigned int m_layoutVersion;
+	// Slot of each light, -1 if it has none or isn't complete, as uploaded
+	std::vector<int> m_lightSlots;
+	std::vector<int> m_uploadedSlots;
+
+	///per update data, kept to reuse their memory
+	std::vector<unsigned int> m_candidates;
+	std::vector<float> m_priorities;
+	std::vector<FaceUpdate> m_faceUpdates;
+	std::vector<FacePass> m_passes;
+	std::vector<glm::mat4> m_transforms;
+	std::vector<DrawElementsIndirectCommand> m_commands;
+	std::vector<unsigned int> m_queryResults;
+	std::vector<unsigned int> m_casters;
+
+	///gl objects
+	unsigned int m_cubeArray;
+	unsigned int m_framebuffer;
+	unsigned int m_slotBuffer;
+	unsigned int m_slotCapacity;
+	unsigned int m_instanceBuffer;
+	unsigned int m_instanceCapacity;
+	unsigned int m_commandBuffer;
+	unsigned int m_commandCapacity;
+
+	unsigned int m_shadowedCount;
+	unsigned int m_facesDrawn;
+	unsigned int m_facesWaiting;
+	unsigned int m_casterCount;
+	float m_updateMS;
+};
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "RenderQueue.h"
+#include <glm/glm.hpp>
+#include <cstring>
+
+///key layout, from the highest bits to the lowest
+//opaque:		pass (2) | program (10) | mesh (12) | material (8) | chunk (8) | depth (24)
+//transparent:	pass (2) | inverted depth (24) | program (10) | mesh (12) | material (8) | chunk (8)
+#define PROGRAM_BITS 10
+#define MESH_BITS 12
+#define MATERIAL_BITS 8
+#define CHUNK_BITS 8
+#define DEPTH_BITS 24
+
+#define MASK(bits) ((1ull << (bits)) - 1)
+
+
+RenderQueue::RenderQueue(float a_maxDepth)
+{
+	m_maxDepth = a_maxDepth;
+}
+
+
+void RenderQueue::clear()
+{
+	m_commands.clear();
+	m_keys.clear();
+}
+
+void RenderQueue::add(RenderPass a_pass, const RenderCommand& a_command, unsigned int a_meshID, float a_depth)
+{
+	RenderCommand command = a_command;
+	command.m_programID = getProgramID(a_command.m_program);
+	command.m_meshID = a_meshID;
+
+	m_keys.push_back(makeKey(a_pass, command, a_depth));
+	m_commands.push_back(command);
+}
+
+void RenderQueue::prepareCommand(RenderCommand& a_command, unsigned int a_meshID) const
+{
+	//programs must already have an ID, since adding one isn't thread safe
+	a_command.m_programID = m_programIDs.at(a_command.m_program);
+	a_command.m_meshID = a_meshID;
+}
+
+void RenderQueue::append(const std::vector<RenderCommand>& a_commands, const std::vector<unsigned long long>& a_keys)
+{
+	m_commands.insert(m_commands.end(), a_commands.begin(), a_commands.end());
+	m_keys.insert(m_keys.end(), a_keys.begin(), a_keys.end());
+}
+
+unsigned long long RenderQueue::makeKey(RenderPass a_pass, const RenderCommand& a_command, float a_depth) const
+{
+	//quantise depth so nearer is smaller
+	unsigned long long depth = (unsigned long long)(glm::clamp(a_depth / m_maxDepth, 0.f, 1.f) * MASK(DEPTH_BITS));
+
+	//the material only matters within a mesh, so it sits below the mesh. -1 (no material) wraps to the top
+	unsigned long long state = (unsigned long long)(a_command.m_programID & MASK(PROGRAM_BITS));
+	state = (state << MESH_BITS) | (a_command.m_meshID & MASK(MESH_BITS));
+	state = (state << MATERIAL_BITS) | ((unsigned int)a_command.m_materialID & MASK(MATERIAL_BITS));
+	state = (state << CHUNK_BITS) | (a_command.m_chunk & MASK(CHUNK_BITS));
+
+	unsigned long long key = (unsigned long long)a_pass << 62;
+	if (a_pass == RENDER_PASS_OPAQUE)
+	{
+		//group by state first, then front to back to help early depth testing
+		key |= state << DEPTH_BITS;
+		key |= depth;
+	}
+	else
+	{
+		//back to front so blending is correct, state only breaks ties
+		key |= (MASK(DEPTH_BITS) - depth) << (62 - DEPTH_BITS);
+		key |= state;
+	}
+	return key;
+}
+
+void RenderQueue::sort()
+{
+	unsigned int count = getCount();
+	m_sortedIndices.resize(count);
+	m_tempIndices.resize(count);
+	m_sortKeys.assign(m_keys.begin(), m_keys.end());
+	m_tempKeys.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		m_sortedIndices[i] = i;
+	}
+
+	//the order commands were added in, for comparison
+	m_submittedChanges = countStateChanges(m_sortedIndices);
+
+	//LSD radix sort, 8 bits at a time. Each pass is stable, so earlier passes stay in order within each bucket
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int histogram[256];
+		memset(histogram, 0, sizeof(histogram));
+		for (unsigned int i = 0; i < count; i++)
+		{
+			histogram[(m_sortKeys[i] >> shift) & 0xff]++;
+		}
+
+		//every key has the same byte here, so this pass wouldn't change anything
+		if (count == 0 || histogram[(m_sortKeys[0] >> shift) & 0xff] == count)
+		{
+			continue;
+		}
+
+		//turn counts in to the start of each bucket
+		unsigned int offset = 0;
+		for (unsigned int bucket = 0; bucket < 256; bucket++)
+		{
+			unsigned int bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int destination = histogram[(m_sortKeys[i] >> shift) & 0xff]++;
+			m_tempKeys[destination] = m_sortKeys[i];
+			m_tempIndices[destination] = m_sortedIndices[i];
+		}
+		m_sortKeys.swap(m_tempKeys);
+		m_sortedIndices.swap(m_tempIndices);
+	}
+
+	m_sortedChanges = countStateChanges(m_sortedIndices);
+}
+
+RenderQueue::StateChanges RenderQueue::countStateChanges(const std::vector<unsigned int>& a_order) const
+{
+	StateChanges changes;
+	const RenderCommand* last = nullptr;
+	for (auto index : a_order)
+	{
+		const RenderCommand& command = m_commands[index];
+		changes.m_draws++;
+
+		//binding a program resets the material uniforms, so it counts as a material change too
+		bool programChanged = last == nullptr || last->m_programID != command.m_programID;
+		changes.m_programs += programChanged ? 1 : 0;
+		if (programChanged || last->m_meshID != command.m_meshID || last->m_materialID != command.m_materialID)
+		{
+			changes.m_materials++;
+		}
+		if (last == nullptr || last->m_meshID != command.m_meshID || last->m_chunk != command.m_chunk)
+		{
+			changes.m_vertexArrays++;
+		}
+		last = &command;
+	}
+	return changes;
+}
+
+unsigned int RenderQueue::getProgramID(aie::ShaderProgram* a_program)
+{
+	auto iter = m_programIDs.find(a_program);
+	if (iter != m_programIDs.end())
+	{
+		return iter->second;
+	}
+
+	unsigned int id = (unsigned int)m_programIDs.size();
+	m_programIDs[a_program] = id;
+	return id;
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Collects draw commands for a frame and orders them with 64 bit sort keys. Opaque draws
+ *	are grouped by program, material, and mesh chunk, then drawn front to back. Transparent
+ *	draws are drawn back to front after them. Keys are sorted with an LSD radix sort whose
+ *	buffers are kept between frames. Commands can also be prepared on worker threads and
+ *	appended in one go.
+ */
+#pragma once
+#include <vector>
+#include <unordered_map>
+
+namespace aie
+{
+	class OBJMesh;
+	class ShaderProgram;
+}
+
+
+// One draw call for a single mesh chunk
+struct RenderCommand
+{
+	aie::OBJMesh* m_mesh;
+	unsigned int m_chunk;
+	aie::ShaderProgram* m_program;
+
+	// Index in to the scene's instance store, for draws of a single instance
+	unsigned int m_instanceIndex;
+	// Range of the instance buffer, for instanced draws. m_instanceCount is 0 for single instances
+	unsigned int m_baseInstance;
+	unsigned int m_instanceCount;
+	// Command in the GPU culling command buffer, for draws whose instance count is only known to the GPU. -1 otherwise
+	int m_indirectCommand = -1;
+
+	///state, filled in when the command is added, used to count state changes
+	unsigned int m_programID;
+	unsigned int m_meshID;
+	int m_materialID;
+};
+
+enum RenderPass : unsigned int
+{
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_TRANSPARENT = 1
+};
+
+
+class RenderQueue
+{
+public:
+	// Number of times each kind of state changes when drawing the commands in order
+	struct StateChanges
+	{
+		unsigned int m_draws = 0;
+		unsigned int m_programs = 0;
+		unsigned int m_materials = 0;
+		unsigned int m_vertexArrays = 0;
+	};
+
+	RenderQueue(float a_maxDepth = 1000.f);
+	~RenderQueue() {};
+
+	// Remove every command, keeping the memory for the next frame
+	void clear();
+	// Add a command. a_depth is its distance from the camera, a_meshID identifies the mesh between frames
+	void add(RenderPass a_pass, const RenderCommand& a_command, unsigned int a_meshID, float a_depth);
+	// Sort the commands by their keys
+	void sort();
+
+	///building commands on other threads
+	// Give a program its ID ahead of time, so commands using it can be prepared without changing the queue
+	void registerProgram(aie::ShaderProgram* a_program) { getProgramID(a_program); }
+	// Fill in the state of a command whose program has been registered. Safe to call from several threads
+	void prepareCommand(RenderCommand& a_command, unsigned int a_meshID) const;
+	// Build a 64 bit key, with the most important state in the highest bits
+	unsigned long long makeKey(RenderPass a_pass, const RenderCommand& a_command, float a_depth) const;
+	// Add prepared commands and their keys
+	void append(const std::vector<RenderCommand>& a_commands, const std::vector<unsigned long long>& a_keys);
+
+	unsigned int getCount() const { return (unsigned int)m_commands.size(); }
+	// Commands in sorted order, only valid after sort()
+	const RenderCommand& getSorted(unsigned int a_index) const { return m_commands[m_sortedIndices[a_index]]; }
+	RenderPass getSortedPass(unsigned int a_index) const { return (RenderPass)(m_keys[m_sortedIndices[a_index]] >> 62); }
+
+	// State changes this frame in the order the commands were added, and after sorting
+	const StateChanges& getSubmittedChanges() const { return m_submittedChanges; }
+	const StateChanges& getSortedChanges() const { return m_sortedChanges; }
+
+protected:
+	// Count how often state changes when drawing the commands in a_order
+	StateChanges countStateChanges(const std::vector<unsigned int>& a_order) const;
+	// Get the ID of a program, giving it one if needed. IDs are kept between frames
+	unsigned int getProgramID(aie::ShaderProgram* a_program);
+
+
+	std::vector<RenderCommand> m_commands;
+	std::vector<unsigned long long> m_keys;
+	std::vector<unsigned int> m_sortedIndices;
+	// Ping pong buffers for the radix sort
+	std::vector<unsigned long long> m_tempKeys;
+	std::vector<unsigned long long> m_sortKeys;
+	std::vector<unsigned int> m_tempIndices;
+
+	std::unordered_map<aie::ShaderProgram*, unsigned int> m_programIDs;
+	float m_maxDepth;
+
+	StateChanges m_submittedChanges;
+	StateChanges m_sortedChanges;
+};
\ No newline at end of file
@@ -2,16 +2,77 @@
 #include "Instance.h"
 #include "Shader.h"
 #include "Camera.h"
+#include "OBJMesh.h"
+#include "ShaderLibrary.h"
 #include <string>
+#include <cstring>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
 #include <Gizmos.h>
+#include <gl_core_4_4.h>
 #include <glm/ext.hpp>
 
 
-Scene::Scene(std::vector<Camera*> a_cameras, glm::vec2 a_windowSize, glm::vec3 a_ambientLight)
+Scene::Scene(std::vector<Camera*> a_cameras, glm::vec2 a_windowSize, glm::vec3 a_ambientLight) :
+	m_threadPool(glm::min(ThreadPool::getCoreCount(), 8u)),
+	m_frameUniforms(FRAME_UNIFORM_BINDING, sizeof(FrameUniforms)),
+	m_lightUniforms(LIGHT_UNIFORM_BINDING, sizeof(LightUniforms))
 {
 	m_cameras = a_cameras;
 	m_windowSize = a_windowSize;
 	m_ambientLight = a_ambientLight;
+
+	//padding is compared when checking for changes, so it needs to be zeroed
+	memset(&m_lightData, 0, sizeof(LightUniforms));
+
+	//the instance buffer is allocated once there are instances to put in it
+	glGenBuffers(1, &m_instanceBuffer);
+	m_instanceCapacity = 0;
+	m_meshPool.setInstanceBuffer(m_instanceBuffer);
+	glGenBuffers(1, &m_indirectBuffer);
+	m_indirectCapacity = 0;
+	m_meshPoolEnabled = true;
+	m_batchVersion = m_instances.getLayoutVersion();
+	m_instancingEnabled = true;
+	m_drawCallCount = 0;
+	m_materialBindCount = 0;
+	m_cullMode = CULL_TREE;
+	m_visibleCount = 0;
+	m_culledCount = 0;
+	m_hiddenCount = 0;
+	m_gpuInstanceCount = 0;
+	m_gpuBatchVersion = m_batchVersion - 1;
+	m_occlusionMode = OCCLUSION_NONE;
+	m_testOcclusion = false;
+	m_occludedCount = 0;
+	m_occludedDrawCount = 0;
+	m_shadingMode = SHADING_FORWARD;
+	m_depthProgram = ShaderLibrary::getInstance()->load("Depth Pre-Pass", "./shaders/shadow.vert", "./shaders/shadow.frag", { "CAMERA" });
+	m_depthPrePassEnabled = false;
+	glGenQueries(2, m_fragmentQueries);
+
+	//every state the scene draws with is made up front, and applying one only changes what differs from the last
+	aie::PipelineState::Desc state;
+	state.blend = aie::PipelineState::BLEND_NONE;
+	m_passStates[RENDER_PASS_OPAQUE] = aie::PipelineState(state);
+	state.colorWrite = false;
+	m_depthPrePassState = aie::PipelineState(state);
+	state.colorWrite = true;
+	state.depthTest = aie::PipelineState::DEPTH_EQUAL;
+	state.depthWrite = false;
+	m_prePassedState = aie::PipelineState(state);
+	//transparent draws blend over everything without hiding what's behind them
+	state.blend = aie::PipelineState::BLEND_ALPHA;
+	state.depthTest = aie::PipelineState::DEPTH_LESS;
+	m_passStates[RENDER_PASS_TRANSPARENT] = aie::PipelineState(state);
+	m_fragmentQueryPending = false;
+	m_prePassFragmentCount = 0;
+	m_shadedFragmentCount = 0;
+	m_instanceLightsEnabled = false;
+	m_instanceLightCount = 0;
+	m_prepareMS = 0;
+	m_submitMS = 0;
 }
 
 Scene::~Scene()
@@ -20,10 +81,6 @@ Scene::~Scene()
 	{
 		delete cam;
 	}
-	for (auto shader : m_shaders)
-	{
-		delete shader;
-	}
 
 	for (auto light : m_directionalLights)
 	{
@@ -33,75 +90,1034 @@ Scene::~Scene()
 	{
 		delete light;
 	}
+
+	glDeleteBuffers(1, &m_instanceBuffer);
+	glDeleteBuffers(1, &m_indirectBuffer);
+	glDeleteQueries(2, m_fragmentQueries);
+}
+
+InstanceHandle Scene::addInstance(const Instance& a_instance)
+{
+	//the store gives the mesh and shader IDs, so there's nothing to search for here
+	InstanceHandle handle = m_instances.add(a_instance.getTransform(), a_instance.getMesh(), a_instance.getShader(), a_instance.getDiffuseTint());
+
+	//slots are reused, so the proxy list only grows to the most instances there have been at once
+	if (handle.m_slot >= m_treeProxies.size())
+	{
+		m_treeProxies.resize(handle.m_slot + 1, NULL_NODE);
+	}
+	m_treeProxies[handle.m_slot] = m_tree.createProxy(m_instances.getWorldBounds()[m_instances.getIndex(handle)], handle.m_slot);
+	return handle;
 }
 
-void Scene::addInstance(Instance* a_instance)
+void Scene::removeInstance(InstanceHandle a_handle)
 {
-	m_instances.push_back(a_instance);
+	if (!m_instances.isValid(a_handle))
+	{
+		return;
+	}
 
+	m_tree.destroyProxy(m_treeProxies[a_handle.m_slot]);
+	m_treeProxies[a_handle.m_slot] = NULL_NODE;
+	m_instances.remove(a_handle);
+}
 
-	//check if we have the instances shader yet
-	bool hasShader = false;
-	for (auto shader : m_shaders)
+void Scene::attachInstance(InstanceHandle a_instance, unsigned int a_node)
+{
+	if (!m_hierarchy.isValid(a_node))
 	{
-		if (a_instance->getShader() == shader)
+		return;
+	}
+	if (m_nodeInstances.size() <= a_node)
+	{
+		m_nodeInstances.resize(a_node + 1);
+	}
+	m_nodeInstances[a_node] = a_instance;
+
+	//the node may not be dirty, so the instance is given its current matrix
+	updateHierarchy();
+	if (m_instances.isValid(a_instance))
+	{
+		m_instances.setTransform(a_instance, m_hierarchy.getWorldMatrix(a_node));
+	}
+}
+
+void Scene::findInstances(const BoundingSphere& a_sphere, std::vector<InstanceHandle>& a_results)
+{
+	m_instances.updateBounds(&m_movedInstances);
+	updateTree();
+
+	m_queryResults.clear();
+	m_tree.querySphere(a_sphere, m_queryResults);
+	for (auto slot : m_queryResults)
+	{
+		a_results.push_back(m_instances.getHandle(m_instances.getSlotIndex(slot)));
+	}
+}
+
+void Scene::findInstances(const glm::vec3& a_origin, const glm::vec3& a_direction, float a_maxDistance, std::vector<InstanceHandle>& a_results)
+{
+	m_instances.updateBounds(&m_movedInstances);
+	updateTree();
+
+	m_queryResults.clear();
+	m_tree.queryRay(a_origin, a_direction, a_maxDistance, m_queryResults);
+	for (auto slot : m_queryResults)
+	{
+		a_results.push_back(m_instances.getHandle(m_instances.getSlotIndex(slot)));
+	}
+}
+
+void Scene::setInstancedShader(aie::ShaderProgram* a_shader, aie::ShaderProgram* a_instancedShader)
+{
+	m_instancedShaders[a_shader] = a_instancedShader;
+}
+
+bool Scene::validateMesh(aie::OBJMesh* a_mesh, aie::ShaderProgram* a_shader) const
+{
+	if (a_shader->getStatus() == aie::ShaderProgram::LINKING)
+	{
+		return false;
+	}
+
+	//attributes the shader reads but the mesh doesn't provide would silently read garbage
+	for (auto& attribute : a_shader->getAttributes())
+	{
+		if (attribute.location >= 32 || (a_mesh->getAttributeMask() & (1 << attribute.location)) == 0)
 		{
-			hasShader = true;
-			break;
+			printf("Mesh [%s] is missing attribute [%s] (location %d) used by its shader\n",
+				a_mesh->getFilename().c_str(), attribute.name.c_str(), attribute.location);
 		}
 	}
+	return true;
+}
+
+
+void Scene::draw()
+{
+	//every camera matrix is calculated once here, and everything drawn this frame reads them
+	m_frame = getCurrentCamera()->getFrameContext(m_windowSize);
+
+	updateHierarchy();
+
+	//only instances that moved are updated in the tree
+	m_instances.updateBounds(&m_movedInstances);
+	updateTree();
+	if (m_batchVersion != m_instances.getLayoutVersion())
+	{
+		buildBatches();
+	}
+
+	//camera and lighting are the same for every shader, so they are only uploaded once
+	//shadows are drawn here too, once every instance has moved and every mesh is pooled
+	updateUniforms();
+
+	//validate mesh and shader pairs whose shaders have finished linking since the last frame
+	for (auto& batch : m_batches)
+	{
+		unsigned int pair = (unsigned int)batch.m_meshID << 16 | batch.m_shaderID;
+		if (m_validatedPairs.count(pair) == 0 && validateMesh(m_instances.getMesh(batch.m_meshID), m_instances.getShader(batch.m_shaderID)))
+		{
+			m_validatedPairs.insert(pair);
+		}
+	}
+
+	//draw data is built in two parallel phases, with small serial steps between them
+	auto start = std::chrono::high_resolution_clock::now();
+	prepareDrawData();
+	if (m_testOcclusion && m_occlusionMode == OCCLUSION_SOFTWARE)
+	{
+		m_threadPool.run([this](unsigned int a_thread) { m_rasterizer.bin(a_thread); });
+		m_threadPool.run([this](unsigned int a_thread) { m_rasterizer.rasterize(a_thread); });
+	}
+	m_threadPool.run([this](unsigned int a_thread) { emitPackets(a_thread); });
+	assignInstanceRanges();
+	m_threadPool.run([this](unsigned int a_thread) { writeDrawData(a_thread); });
+	mergeDrawData();
+	m_renderQueue.sort();
+	auto prepared = std::chrono::high_resolution_clock::now();
+
+	//only this thread can talk to opengl. Compute passes share the storage bindings, so the lights are bound last
+	m_lightClusters.bind();
+	if (m_instanceLightsEnabled)
+	{
+		m_instanceLights.bind();
+	}
+	m_shadowCascades.bind();
+	m_pointShadows.bind();
+	m_materials.bind();
+	executeRenderQueue();
 
-	//if not, add it
-	if (!hasShader)
+	//the depth of this frame is tested against in the next few, once it has been read back
+	if (m_occlusionMode == OCCLUSION_HIZ)
 	{
-		m_shaders.push_back(a_instance->getShader());
+		m_hiZ.build(glm::ivec2(m_windowSize), m_frame);
 	}
+	m_prepareMS = std::chrono::duration<float, std::milli>(prepared - start).count();
+	m_submitMS = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - prepared).count();
 }
 
+void Scene::prepareDrawData()
+{
+	unsigned int threadCount = m_threadPool.getThreadCount();
+	m_threadData.resize(threadCount);
+	for (auto& data : m_threadData)
+	{
+		data.m_batchOffsets.assign(m_batches.size(), 0);
+		data.m_nearestDepths.assign(m_batches.size(), FLT_MAX);
+		data.m_batchOccluded.assign(m_batches.size(), 0);
+		data.m_hiddenCount = 0;
+	}
 
-void Scene::draw()
+	m_gpuInstanceCount = 0;
+	for (auto& batch : m_batches)
+	{
+		//batches are only instanced once their instanced shader is ready to draw with
+		batch.m_instancedShader = nullptr;
+		auto iter = m_instancedShaders.find(m_instances.getShader(batch.m_shaderID));
+		if (m_instancingEnabled && iter != m_instancedShaders.end() && iter->second->isReady())
+		{
+			batch.m_instancedShader = iter->second;
+		}
+
+		//the compute shader writes instance data and indirect commands, so it needs both instancing and the pool
+		batch.m_gpuCulled = m_cullMode == CULL_GPU && batch.m_instancedShader != nullptr && m_meshPoolEnabled && m_gpuCuller.isReady();
+		m_gpuInstanceCount += batch.m_gpuCulled ? batch.m_size : 0;
+		//draw with a placeholder until the shader has finished compiling
+		batch.m_drawShader = batch.m_instancedShader != nullptr ? batch.m_instancedShader : ShaderLibrary::getInstance()->getDrawable(m_instances.getShader(batch.m_shaderID));
+
+		//programs are given their sort key IDs here, since workers can't add to the queue's table
+		m_renderQueue.registerProgram(batch.m_drawShader);
+	}
+
+	unsigned int count = m_instances.getCount();
+	m_cullResults.resize(count);
+
+	m_testOcclusion = false;
+	bool cpuCulled = m_cullMode == CULL_LINEAR || m_cullMode == CULL_TREE;
+	if (m_occlusionMode == OCCLUSION_HIZ)
+	{
+		//read back depth is only trusted while the camera stays close to where it was drawn from
+		m_hiZ.update();
+		m_testOcclusion = cpuCulled && m_hiZ.canTest(m_frame);
+	}
+	else if (m_occlusionMode == OCCLUSION_SOFTWARE && cpuCulled)
+	{
+		//occluders of removed instances are dropped, and ones out of view are skipped before transforming their triangles
+		m_occluders.erase(std::remove_if(m_occluders.begin(), m_occluders.end(),
+			[this](const Occluder& a_occluder) { return !m_instances.isValid(a_occluder.m_instance); }), m_occluders.end());
+		m_rasterizer.begin(m_frame.m_projectionView, m_threadPool.getThreadCount());
+		for (auto& occluder : m_occluders)
+		{
+			unsigned int index = m_instances.getIndex(occluder.m_instance);
+			if ((m_instances.getFlags()[index] & INSTANCE_VISIBLE) != 0 && m_frame.m_frustum.intersects(m_instances.getWorldBounds()[index]))
+			{
+				m_rasterizer.addOccluder(*occluder.m_mesh, m_instances.getTransforms()[index]);
+			}
+		}
+		m_testOcclusion = m_rasterizer.getOccluderCount() > 0;
+	}
+
+	//the tree is walked once here, the other modes are split between the workers
+	if (m_cullMode == CULL_TREE)
+	{
+		std::fill(m_cullResults.begin(), m_cullResults.end(), (unsigned char)0);
+		m_queryResults.clear();
+		m_tree.queryFrustum(m_frame.m_frustum, m_queryResults);
+		for (auto slot : m_queryResults)
+		{
+			m_cullResults[m_instances.getSlotIndex(slot)] = 1;
+		}
+	}
+}
+
+void Scene::emitPackets(unsigned int a_thread)
+{
+	ThreadData& data = m_threadData[a_thread];
+	data.m_packets.clear();
+	data.m_lightIndices.clear();
+
+	//each thread takes an even share of the instances
+	unsigned int count = m_instances.getCount();
+	unsigned int begin = (unsigned int)((unsigned long long)count * a_thread / m_threadData.size());
+	unsigned int end = (unsigned int)((unsigned long long)count * (a_thread + 1) / m_threadData.size());
+	if (begin == end)
+	{
+		return;
+	}
+
+	if (m_cullMode == CULL_LINEAR)
+	{
+		//spheres are tested several at a time, straight from the stores arrays
+		m_frame.m_frustum.cullSpheres(&m_instances.getSphereX()[begin], &m_instances.getSphereY()[begin], &m_instances.getSphereZ()[begin],
+			&m_instances.getSphereRadius()[begin], end - begin, &m_cullResults[begin]);
+	}
+	else if (m_cullMode == CULL_NONE || m_cullMode == CULL_GPU)
+	{
+		std::fill(m_cullResults.begin() + begin, m_cullResults.begin() + end, (unsigned char)1);
+	}
+
+	//a packet for every visible instance, counting how many each batch has
+	const std::vector<unsigned int>& flags = m_instances.getFlags();
+	for (unsigned int i = begin; i < end; i++)
+	{
+		if (m_batches[m_instanceBatches[i]].m_gpuCulled)
+		{
+			continue;
+		}
+		//hidden instances are counted on their own, so they aren't mistaken for ones out of view
+		if ((flags[i] & INSTANCE_VISIBLE) == 0)
+		{
+			data.m_hiddenCount++;
+			continue;
+		}
+		if (m_cullResults[i] == 0)
+		{
+			continue;
+		}
+
+		//in view, but possibly behind what was drawn last frame
+		if (m_testOcclusion && isOccluded(i))
+		{
+			data.m_batchOccluded[m_instanceBatches[i]]++;
+			continue;
+		}
+
+		DrawPacket packet;
+		packet.m_index = i;
+		packet.m_batch = m_instanceBatches[i];
+		packet.m_depth = getDepth(i);
+		packet.m_lights = glm::uvec2(0);
+		if (m_instanceLightsEnabled)
+		{
+			//lists are found while the instance's bounds are still in cache
+			packet.m_lights.x = (unsigned int)data.m_lightIndices.size();
+			packet.m_lights.y = m_instanceLights.assign(m_instances.getWorldBounds()[i], data.m_lightIndices);
+		}
+		data.m_packets.push_back(packet);
+
+		data.m_batchOffsets[packet.m_batch]++;
+		data.m_nearestDepths[packet.m_batch] = glm::min(data.m_nearestDepths[packet.m_batch], packet.m_depth);
+	}
+}
+
+void Scene::assignInstanceRanges()
+{
+	//instanced batches get a range of the instance buffer, split between the threads in order
+	unsigned int total = 0;
+	m_visibleCount = 0;
+	m_occludedCount = 0;
+	m_occludedDrawCount = 0;
+	for (unsigned int i = 0; i < m_batches.size(); i++)
+	{
+		InstanceBatch& batch = m_batches[i];
+		batch.m_baseInstance = total;
+		batch.m_nearestDepth = FLT_MAX;
+		unsigned int visible = 0;
+		unsigned int occluded = 0;
+		for (auto& data : m_threadData)
+		{
+			unsigned int count = data.m_batchOffsets[i];
+			visible += count;
+			occluded += data.m_batchOccluded[i];
+			batch.m_nearestDepth = glm::min(batch.m_nearestDepth, data.m_nearestDepths[i]);
+
+			//counts become where the thread starts writing
+			data.m_batchOffsets[i] = total;
+			if (batch.m_instancedShader != nullptr)
+			{
+				total += count;
+			}
+		}
+		batch.m_instanceCount = total - batch.m_baseInstance;
+		m_visibleCount += visible;
+		m_occludedCount += occluded;
+
+		//an instanced batch only saves its draws when every instance in view was occluded
+		unsigned int chunkCount = (unsigned int)m_instances.getMesh(batch.m_meshID)->getChunkCount();
+		if (batch.m_instancedShader == nullptr)
+		{
+			m_occludedDrawCount += occluded * chunkCount;
+		}
+		else if (visible == 0 && occluded > 0)
+		{
+			m_occludedDrawCount += chunkCount;
+		}
+	}
+	m_hiddenCount = 0;
+	for (auto& data : m_threadData)
+	{
+		m_hiddenCount += data.m_hiddenCount;
+	}
+	m_culledCount = m_instances.getCount() - m_visibleCount - m_occludedCount - m_gpuInstanceCount - m_hiddenCount;
+	m_instanceData.resize(total);
+
+	//each thread's light lists go after the last thread's
+	m_instanceLightCount = 0;
+	for (auto& data : m_threadData)
+	{
+		data.m_lightOffset = m_instanceLightCount;
+		m_instanceLightCount += (unsigned int)data.m_lightIndices.size();
+	}
+	m_instanceLightRanges.resize(m_instances.getCount());
+}
+
+void Scene::writeDrawData(unsigned int a_thread)
+{
+	ThreadData& data = m_threadData[a_thread];
+	data.m_commands.clear();
+	data.m_keys.clear();
+
+	const std::vector<glm::mat4>& transforms = m_instances.getTransforms();
+	const std::vector<glm::vec4>& tints = m_instances.getDiffuseTints();
+
+	for (auto& packet : data.m_packets)
+	{
+		const InstanceBatch& batch = m_batches[packet.m_batch];
+		glm::uvec2 lights = packet.m_lights + glm::uvec2(data.m_lightOffset, 0);
+
+		//instanced batches only need their data copied in to the threads part of the instance buffer
+		if (batch.m_instancedShader != nullptr)
+		{
+			m_instanceData[data.m_batchOffsets[packet.m_batch]++] = { transforms[packet.m_index], tints[packet.m_index], lights, glm::uvec2(0) };
+			continue;
+		}
+		m_instanceLightRanges[packet.m_index] = lights;
+
+		//otherwise each visible chunk is its own draw
+		aie::OBJMesh* mesh = m_instances.getMesh(batch.m_meshID);
+		RenderCommand command;
+		command.m_mesh = mesh;
+		command.m_program = batch.m_drawShader;
+		command.m_instanceIndex = packet.m_index;
+		command.m_baseInstance = 0;
+		command.m_instanceCount = 0;
+
+		//meshes with several chunks can skip the ones out of view, using the frustum in the mesh's space
+		bool cullChunks = m_cullMode != CULL_NONE && mesh->getChunkCount() > 1;
+		Frustum localFrustum;
+		if (cullChunks)
+		{
+			localFrustum = Frustum(m_frame.m_projectionView * transforms[packet.m_index]);
+		}
+		for (unsigned int chunk = 0; chunk < mesh->getChunkCount(); chunk++)
+		{
+			if (cullChunks && !localFrustum.intersects(mesh->getChunkBounds(chunk)))
+			{
+				continue;
+			}
+
+			command.m_chunk = chunk;
+			command.m_materialID = mesh->getChunkMaterialID(chunk);
+			m_renderQueue.prepareCommand(command, batch.m_meshID);
+			data.m_commands.push_back(command);
+			data.m_keys.push_back(m_renderQueue.makeKey(getRenderPass(mesh, command.m_materialID), command, packet.m_depth));
+		}
+	}
+}
+
+void Scene::mergeDrawData()
+{
+	m_renderQueue.clear();
+
+	//one command per chunk for each instanced batch
+	for (auto& batch : m_batches)
+	{
+		if (batch.m_instancedShader == nullptr || batch.m_instanceCount == 0)
+		{
+			continue;
+		}
+
+		//meshes read from the instance buffer through their vaos, which only needs setting up once
+		aie::OBJMesh* mesh = m_instances.getMesh(batch.m_meshID);
+		if (m_instancedMeshes.insert(mesh).second)
+		{
+			mesh->setInstanceBuffer(m_instanceBuffer);
+		}
+
+		RenderCommand command;
+		command.m_mesh = mesh;
+		command.m_program = batch.m_instancedShader;
+		command.m_instanceIndex = 0;
+		command.m_baseInstance = batch.m_baseInstance;
+		command.m_instanceCount = batch.m_instanceCount;
+		for (unsigned int chunk = 0; chunk < mesh->getChunkCount(); chunk++)
+		{
+			command.m_chunk = chunk;
+			command.m_materialID = mesh->getChunkMaterialID(chunk);
+			m_renderQueue.add(getRenderPass(mesh, command.m_materialID), command, batch.m_meshID, batch.m_nearestDepth);
+		}
+	}
+
+	//then everything the workers made
+	for (auto& data : m_threadData)
+	{
+		m_renderQueue.append(data.m_commands, data.m_keys);
+	}
+
+	if (m_instanceLightsEnabled)
+	{
+		m_instanceLights.resize(m_instanceLightCount);
+		for (auto& data : m_threadData)
+		{
+			m_instanceLights.write(data.m_lightOffset, data.m_lightIndices);
+		}
+	}
+
+	//gpu culled instances go after the ones from the cpu
+	unsigned int instanceCount = (unsigned int)m_instanceData.size() + m_gpuInstanceCount;
+	if (instanceCount == 0)
+	{
+		return;
+	}
+
+	//transforms can change every frame, so the buffer is orphaned instead of waiting on the last frames draws
+	unsigned int size = (unsigned int)(m_instanceData.size() * sizeof(aie::OBJMesh::InstanceData));
+	m_instanceCapacity = glm::max(m_instanceCapacity, instanceCount * (unsigned int)sizeof(aie::OBJMesh::InstanceData));
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity, nullptr, GL_STREAM_DRAW);
+	if (size > 0)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, m_instanceData.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (m_gpuInstanceCount > 0)
+	{
+		cullOnGPU((unsigned int)m_instanceData.size());
+	}
+}
+
+void Scene::cullOnGPU(unsigned int a_outputOffset)
 {
-	//lambda function to bind lights in a shader
-	auto bindLights = [this](aie::ShaderProgram* a_shader)
+	//each gpu culled batch is a group, with room for all of its instances
+	m_batchGroups.assign(m_batches.size(), NO_CULL_GROUP);
+	m_groupSizes.clear();
+	m_gpuCommands.clear();
+	m_gpuCommandGroups.clear();
+	unsigned int groupOffset = a_outputOffset;
+	for (unsigned int i = 0; i < m_batches.size(); i++)
+	{
+		const InstanceBatch& batch = m_batches[i];
+		if (!batch.m_gpuCulled)
+		{
+			continue;
+		}
+		unsigned int group = (unsigned int)m_groupSizes.size();
+		m_batchGroups[i] = group;
+		m_groupSizes.push_back(batch.m_size);
+
+		//the queue sorts these like any other draw, but their instance counts are filled in by the gpu
+		aie::OBJMesh* mesh = m_instances.getMesh(batch.m_meshID);
+		RenderCommand command;
+		command.m_mesh = mesh;
+		command.m_program = batch.m_instancedShader;
+		command.m_instanceIndex = 0;
+		command.m_baseInstance = groupOffset;
+		command.m_instanceCount = 0;
+		for (unsigned int chunk = 0; chunk < mesh->getChunkCount(); chunk++)
+		{
+			command.m_chunk = chunk;
+			command.m_materialID = mesh->getChunkMaterialID(chunk);
+			command.m_indirectCommand = (int)m_gpuCommands.size();
+			m_gpuCommands.push_back(m_meshPool.getDrawCommand(mesh, chunk, 0, groupOffset));
+			m_gpuCommandGroups.push_back(group);
+			m_renderQueue.add(getRenderPass(mesh, command.m_materialID), command, batch.m_meshID, 0);
+		}
+		groupOffset += batch.m_size;
+	}
+
+	m_gpuCuller.setInstances(m_instances, m_instanceBatches, m_gpuBatchVersion != m_batchVersion);
+	m_gpuBatchVersion = m_batchVersion;
+	m_gpuCuller.setGroups(m_batchGroups, m_groupSizes);
+	m_gpuCuller.setCommands(m_gpuCommands, m_gpuCommandGroups);
+	m_gpuCuller.cull(m_frame.m_frustum, m_instanceBuffer, a_outputOffset);
+}
+
+void Scene::executeRenderQueue()
+{
+	const std::vector<glm::mat4>& transforms = m_instances.getTransforms();
+	const std::vector<glm::vec4>& tints = m_instances.getDiffuseTints();
+
+	//instanced draws of pooled meshes are read from the indirect buffer, in the order they are drawn
+	m_indirectCommands.clear();
+	for (unsigned int i = 0; i < m_renderQueue.getCount() && m_meshPoolEnabled; i++)
+	{
+		const RenderCommand& command = m_renderQueue.getSorted(i);
+		if (command.m_instanceCount > 0 && m_meshPool.contains(command.m_mesh))
+		{
+			m_indirectCommands.push_back(m_meshPool.getDrawCommand(command.m_mesh, command.m_chunk, command.m_instanceCount, command.m_baseInstance));
+		}
+	}
+	if (!m_indirectCommands.empty())
+	{
+		//orphaned like the instance buffer, since the commands change every frame
+		unsigned int size = (unsigned int)(m_indirectCommands.size() * sizeof(DrawElementsIndirectCommand));
+		m_indirectCapacity = glm::max(m_indirectCapacity, size);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_indirectCapacity, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, m_indirectCommands.data());
+	}
+
+	//deferred opaque draws go in to the g-buffer, which is lit in to this framebuffer before transparent draws
+	bool deferred = m_shadingMode == SHADING_DEFERRED && m_gBuffer.isReady();
+	bool lit = !deferred;
+	GLint targetFramebuffer = 0;
+	//the g-buffer's depth is cleared as it begins, which needs depth writes on
+	m_passStates[RENDER_PASS_OPAQUE].apply();
+	if (deferred)
+	{
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+		m_gBuffer.begin(glm::ivec2(m_windowSize));
+	}
+
+	aie::ShaderProgram* program = nullptr;
+	//program that is bound, which differs from the command's when drawing deferred
+	aie::ShaderProgram* drawProgram = nullptr;
+	aie::OBJMesh* materialMesh = nullptr;
+	int materialID = -1;
+	aie::OBJMesh* chunkMesh = nullptr;
+	unsigned int chunk = 0;
+	bool poolBound = false;
+	unsigned int indirectIndex = 0;
+	int modelMatrix = -1;
+	int diffuseTint = -1;
+	int instanceLights = -1;
+	//does the bound program read its material from the table instead of uniforms?
+	bool tableMaterial = false;
+	int tableIndex = -1;
+	RenderPass pass = RENDER_PASS_OPAQUE;
+	m_drawCallCount = 0;
+	m_materialBindCount = 0;
+
+	//the depth of opaque instanced draws is laid down first, and those draws then only pass where they are closest
+	bool prePass = m_depthPrePassEnabled && m_meshPoolEnabled && m_depthProgram->isReady();
+	updateFragmentCounts();
+	bool counting = !m_fragmentQueryPending;
+	if (prePass)
+	{
+		if (counting)
+		{
+			glBeginQuery(GL_SAMPLES_PASSED, m_fragmentQueries[0]);
+		}
+		drawDepthPrePass();
+		if (counting)
+		{
+			glEndQuery(GL_SAMPLES_PASSED);
+		}
+	}
+	else if (counting)
+	{
+		//an empty query still gives a result, so both counts are read the same way
+		glBeginQuery(GL_SAMPLES_PASSED, m_fragmentQueries[0]);
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+	if (counting)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, m_fragmentQueries[1]);
+	}
+
+	for (unsigned int i = 0; i < m_renderQueue.getCount(); i++)
+	{
+		const RenderCommand& command = m_renderQueue.getSorted(i);
+
+		//transparent draws come last, after the g-buffer is lit
+		if (pass != m_renderQueue.getSortedPass(i))
+		{
+			pass = m_renderQueue.getSortedPass(i);
+			if (counting)
+			{
+				glEndQuery(GL_SAMPLES_PASSED);
+				m_fragmentQueryPending = true;
+				counting = false;
+			}
+			if (!lit)
+			{
+				//the lighting pass changes the program and vertex array, so they are bound again
+				m_gBuffer.light(targetFramebuffer, m_frame);
+				lit = true;
+				program = nullptr;
+				poolBound = false;
+				chunkMesh = nullptr;
+			}
+		}
+
+		//only change what is different from the last draw
+		if (command.m_program != program)
+		{
+			program = command.m_program;
+			drawProgram = getPassProgram(program, pass, deferred);
+			drawProgram->bind();
+			//projection view, lighting, and camera pos are in uniform buffers, so only the model data changes
+			modelMatrix = drawProgram->getUniform("ModelMatrix");
+			diffuseTint = drawProgram->getUniform("DiffuseTint");
+			instanceLights = m_instanceLightsEnabled ? drawProgram->getUniform("InstanceLights") : -1;
+			tableMaterial = drawProgram->usesAttribute(MATERIAL_ATTRIBUTE_LOCATION);
+			materialMesh = nullptr;
+		}
+		if ((command.m_mesh != materialMesh || command.m_materialID != materialID) && command.m_materialID >= 0 && drawProgram->usesMaterial())
+		{
+			materialMesh = command.m_mesh;
+			materialID = command.m_materialID;
+			command.m_mesh->bindMaterial(*drawProgram, materialID);
+			m_materialBindCount++;
+		}
+
+		//every pooled mesh shares one vertex array
+		bool pooled = m_meshPoolEnabled && m_meshPool.contains(command.m_mesh);
+		if (pooled && !poolBound)
+		{
+			m_meshPool.bind();
+			poolBound = true;
+			chunkMesh = nullptr;
+		}
+		else if (!pooled && (poolBound || command.m_mesh != chunkMesh || command.m_chunk != chunk))
+		{
+			chunkMesh = command.m_mesh;
+			chunk = command.m_chunk;
+			command.m_mesh->bindChunk(chunk);
+			poolBound = false;
+		}
+		//pooled vertices have their material index, chunks of their own read it from the current attribute value
+		if (tableMaterial && !pooled && (int)m_materials.getIndex(command.m_mesh, command.m_materialID) != tableIndex)
+		{
+			tableIndex = (int)m_materials.getIndex(command.m_mesh, command.m_materialID);
+			glVertexAttribI1ui(MATERIAL_ATTRIBUTE_LOCATION, tableIndex);
+		}
+
+		//draws the pre-pass covered have their depth already, the others are tested and written as usual
+		bool prePassed = prePass && pass == RENDER_PASS_OPAQUE && pooled && (command.m_instanceCount > 0 || command.m_indirectCommand >= 0);
+		(prePassed ? m_prePassedState : m_passStates[pass]).apply();
+
+		if (command.m_indirectCommand >= 0)
+		{
+			//commands filled in by the gpu are next to each other in its buffer, so runs of them draw together
+			unsigned int drawCount = 1;
+			while (i + drawCount < m_renderQueue.getCount())
+			{
+				const RenderCommand& next = m_renderQueue.getSorted(i + drawCount);
+				bool sameMaterial = !drawProgram->usesMaterial() || (next.m_mesh == command.m_mesh && next.m_materialID == command.m_materialID);
+				if (next.m_indirectCommand != command.m_indirectCommand + (int)drawCount || next.m_program != program || !sameMaterial ||
+					m_renderQueue.getSortedPass(i + drawCount) != pass)
+				{
+					break;
+				}
+				drawCount++;
+			}
+
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_gpuCuller.getCommandBuffer());
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(command.m_indirectCommand * sizeof(DrawElementsIndirectCommand)), drawCount, 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+			i += drawCount - 1;
+			m_drawCallCount++;
+			continue;
+		}
+
+		if (pooled && command.m_instanceCount > 0)
+		{
+			//the draws after this one join it, until one needs different state
+			unsigned int drawCount = 1;
+			while (i + drawCount < m_renderQueue.getCount())
+			{
+				const RenderCommand& next = m_renderQueue.getSorted(i + drawCount);
+				bool sameMaterial = !drawProgram->usesMaterial() || (next.m_mesh == command.m_mesh && next.m_materialID == command.m_materialID);
+				if (next.m_instanceCount == 0 || next.m_program != program || !sameMaterial ||
+					m_renderQueue.getSortedPass(i + drawCount) != pass || !m_meshPool.contains(next.m_mesh))
+				{
+					break;
+				}
+				drawCount++;
+			}
+
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(indirectIndex * sizeof(DrawElementsIndirectCommand)), drawCount, 0);
+			indirectIndex += drawCount;
+			i += drawCount - 1;
+			m_drawCallCount++;
+			continue;
+		}
+
+		m_drawCallCount++;
+		if (command.m_instanceCount > 0)
+		{
+			command.m_mesh->drawChunk(chunk, command.m_instanceCount, command.m_baseInstance);
+			continue;
+		}
+
+		drawProgram->bindUniform(modelMatrix, transforms[command.m_instanceIndex]);
+		if (diffuseTint >= 0)
+		{
+			drawProgram->bindUniform(diffuseTint, tints[command.m_instanceIndex]);
+		}
+		if (instanceLights >= 0)
+		{
+			drawProgram->bindUniform(instanceLights, m_instanceLightRanges[command.m_instanceIndex]);
+		}
+		if (pooled)
+		{
+			const MeshPool::PoolChunk& poolChunk = m_meshPool.getChunk(command.m_mesh, command.m_chunk);
+			glDrawElementsBaseVertex(GL_TRIANGLES, poolChunk.m_indexCount, GL_UNSIGNED_INT, (void*)(poolChunk.m_firstIndex * sizeof(unsigned int)), poolChunk.m_baseVertex);
+		}
+		else
+		{
+			command.m_mesh->drawChunk(chunk);
+		}
+	}
+
+	if (counting)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		m_fragmentQueryPending = true;
+	}
+
+	//with nothing transparent, the g-buffer is lit after the last opaque draw
+	if (!lit)
 	{
-		a_shader->bindUniform("AmbientColor", m_ambientLight);
+		m_gBuffer.light(targetFramebuffer, m_frame);
+	}
 
-		//bind how many of each light there are
-		int directionalLightCount = m_directionalLights.size();
-		a_shader->bindUniform("DirectionalLightCount", directionalLightCount);
-		int pointLightCount = m_pointLights.size();
-		a_shader->bindUniform("PointLightCount", pointLightCount);
+	//whatever draws next applies its own state, so only the bindings are put back
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void Scene::drawDepthPrePass()
+{
+	m_depthProgram->bind();
+	m_depthPrePassState.apply();
+	m_meshPool.bindDepth(m_instanceBuffer, sizeof(aie::OBJMesh::InstanceData));
+
+	//the queue is sorted by pass, so the opaque instanced draws are the first commands in the indirect buffer
+	unsigned int commandCount = 0;
+	for (unsigned int i = 0; i < m_renderQueue.getCount() && m_renderQueue.getSortedPass(i) == RENDER_PASS_OPAQUE; i++)
+	{
+		const RenderCommand& command = m_renderQueue.getSorted(i);
+		if (command.m_instanceCount > 0 && m_meshPool.contains(command.m_mesh))
+		{
+			commandCount++;
+		}
+	}
+	if (commandCount > 0)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, commandCount, 0);
+		m_drawCallCount++;
+	}
 
-		//add each light to the shader
-		for (int i = 0; i < directionalLightCount; i++)
+	//commands filled in by the gpu are drawn in runs that are next to each other in its buffer, whatever their material
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_gpuCuller.getCommandBuffer());
+	for (unsigned int i = 0; i < m_renderQueue.getCount() && m_renderQueue.getSortedPass(i) == RENDER_PASS_OPAQUE; i++)
+	{
+		const RenderCommand& command = m_renderQueue.getSorted(i);
+		if (command.m_indirectCommand < 0)
 		{
-			a_shader->bindUniform(("DirectionalLights[" + std::to_string(i) + "].Direction").c_str(), m_directionalLights[i]->m_direction);
-			a_shader->bindUniform(("DirectionalLights[" + std::to_string(i) + "].Color").c_str(), m_directionalLights[i]->m_color);
+			continue;
 		}
-		for (int i = 0; i < pointLightCount; i++)
+		unsigned int drawCount = 1;
+		while (i + drawCount < m_renderQueue.getCount() && m_renderQueue.getSortedPass(i + drawCount) == RENDER_PASS_OPAQUE &&
+			m_renderQueue.getSorted(i + drawCount).m_indirectCommand == command.m_indirectCommand + (int)drawCount)
 		{
-			a_shader->bindUniform(("PointLights[" + std::to_string(i) + "].Position").c_str(), m_pointLights[i]->m_position);
-			a_shader->bindUniform(("PointLights[" + std::to_string(i) + "].Range").c_str(), m_pointLights[i]->m_range);
-			a_shader->bindUniform(("PointLights[" + std::to_string(i) + "].Brightness").c_str(), m_pointLights[i]->m_brightness);
-			a_shader->bindUniform(("PointLights[" + std::to_string(i) + "].Color").c_str(), m_pointLights[i]->m_color);
+			drawCount++;
 		}
-	};
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(command.m_indirectCommand * sizeof(DrawElementsIndirectCommand)), drawCount, 0);
+		i += drawCount - 1;
+		m_drawCallCount++;
+	}
 
-	//setup each shader before drawing
-	for (auto shader : m_shaders)
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+}
+
+void Scene::updateFragmentCounts()
+{
+	if (!m_fragmentQueryPending)
 	{
-		shader->bind();
-		
-		//bind camera position, since all shaders use the same value
-		shader->bindUniform("CameraPosition", m_cameras[m_cameraIndex]->getPosition());
+		return;
+	}
 
-		//bind lighting
-		bindLights(shader);
+	//the opaque draws' query ends last, so the pre-pass's is ready once it is
+	GLint available = 0;
+	glGetQueryObjectiv(m_fragmentQueries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		return;
 	}
-	//draw eah instance
-	for (auto instance : m_instances)
+	glGetQueryObjectuiv(m_fragmentQueries[0], GL_QUERY_RESULT, &m_prePassFragmentCount);
+	glGetQueryObjectuiv(m_fragmentQueries[1], GL_QUERY_RESULT, &m_shadedFragmentCount);
+	m_fragmentQueryPending = false;
+}
+
+aie::ShaderProgram* Scene::getPassProgram(aie::ShaderProgram* a_program, RenderPass a_pass, bool a_deferred) const
+{
+	if (!a_deferred || a_pass != RENDER_PASS_OPAQUE)
+	{
+		return a_program;
+	}
+	//variants still compiling are drawn with the fallback, like any other program
+	auto deferredShader = m_deferredShaders.find(a_program);
+	return deferredShader != m_deferredShaders.end() ? ShaderLibrary::getInstance()->getDrawable(deferredShader->second) : a_program;
+}
+
+RenderPass Scene::getRenderPass(aie::OBJMesh* a_mesh, int a_materialID) const
+{
+	return a_materialID >= 0 && a_mesh->getMaterial(a_materialID).opacity < 1 ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE;
+}
+
+bool Scene::isOccluded(unsigned int a_index) const
+{
+	if (m_occlusionMode == OCCLUSION_SOFTWARE)
 	{
-		//instances have their own shaders
-		instance->draw(this);
+		return m_rasterizer.isOccluded(m_instances.getWorldBounds()[a_index]);
 	}
+	return m_hiZ.isOccluded(glm::vec3(m_instances.getSphereX()[a_index], m_instances.getSphereY()[a_index], m_instances.getSphereZ()[a_index]),
+		m_instances.getSphereRadius()[a_index]);
 }
+
+float Scene::getDepth(unsigned int a_index) const
+{
+	//distance to the nearest point of the bounding sphere
+	glm::vec3 center(m_instances.getSphereX()[a_index], m_instances.getSphereY()[a_index], m_instances.getSphereZ()[a_index]);
+	return glm::max(0.f, glm::distance(center, m_frame.m_cameraPosition) - m_instances.getSphereRadius()[a_index]);
+}
+
+void Scene::buildBatches()
+{
+	//one pass over the mesh and shader IDs, looking up the batch for each pair
+	std::unordered_map<unsigned int, unsigned int> batchLookup;
+	for (unsigned int i = 0; i < m_batches.size(); i++)
+	{
+		batchLookup[(unsigned int)m_batches[i].m_meshID << 16 | m_batches[i].m_shaderID] = i;
+		m_batches[i].m_size = 0;
+	}
+
+	const std::vector<unsigned short>& meshIDs = m_instances.getMeshIDs();
+	const std::vector<unsigned short>& shaderIDs = m_instances.getShaderIDs();
+	unsigned int count = m_instances.getCount();
+	m_instanceBatches.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int pair = (unsigned int)meshIDs[i] << 16 | shaderIDs[i];
+		auto iter = batchLookup.find(pair);
+		if (iter == batchLookup.end())
+		{
+			InstanceBatch batch;
+			batch.m_meshID = meshIDs[i];
+			batch.m_shaderID = shaderIDs[i];
+			batch.m_size = 0;
+			batch.m_instancedShader = nullptr;
+			batch.m_drawShader = nullptr;
+			batch.m_baseInstance = 0;
+			batch.m_instanceCount = 0;
+			batch.m_nearestDepth = 0;
+			//meshes are copied in to the pool the first time they are drawn, after their materials are in the table
+			m_materials.addMesh(m_instances.getMesh(batch.m_meshID));
+			m_meshPool.addMesh(m_instances.getMesh(batch.m_meshID), m_materials);
+			iter = batchLookup.insert(std::make_pair(pair, (unsigned int)m_batches.size())).first;
+			m_batches.push_back(batch);
+		}
+		m_batches[iter->second].m_size++;
+		m_instanceBatches[i] = iter->second;
+	}
+
+	//drop batches that no longer have any instances, then point instances at the new batch indices
+	std::vector<unsigned int> remap(m_batches.size());
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < m_batches.size(); i++)
+	{
+		remap[i] = kept;
+		if (m_batches[i].m_size > 0)
+		{
+			m_batches[kept++] = m_batches[i];
+		}
+	}
+	if (kept != m_batches.size())
+	{
+		m_batches.resize(kept);
+		for (auto& batch : m_instanceBatches)
+		{
+			batch = remap[batch];
+		}
+	}
+
+	m_batchVersion = m_instances.getLayoutVersion();
+}
+
+void Scene::updateTree()
+{
+	//leaves have some room to move, so most small movements don't change the tree
+	const std::vector<AABB>& bounds = m_instances.getWorldBounds();
+	for (auto index : m_movedInstances)
+	{
+		//the leaf's box still holds where the instance was, so point light faces it left are redrawn too
+		int proxy = m_treeProxies[m_instances.getHandle(index).m_slot];
+		m_pointShadows.markMoved(m_tree.getFatBounds(proxy), bounds[index]);
+		m_tree.moveProxy(proxy, bounds[index]);
+	}
+	//moved casters are drawn separately from the cached shadows until they settle
+	m_shadowCascades.markMoved(m_instances, m_movedInstances);
+	m_movedInstances.clear();
+}
+
+void Scene::updateHierarchy()
+{
+	m_hierarchy.update(&m_threadPool);
+	for (auto node : m_hierarchy.getChanged())
+	{
+		if (node < m_nodeInstances.size() && m_instances.isValid(m_nodeInstances[node]))
+		{
+			m_instances.setTransform(m_nodeInstances[node], m_hierarchy.getWorldMatrix(node));
+		}
+	}
+}
+
+void Scene::updateUniforms()
+{
+	//point lights are binned for this frame's view, and read by shaders from storage buffers
+	m_lightClusters.build(m_frame, m_pointLights, m_threadPool);
+	if (m_instanceLightsEnabled)
+	{
+		m_instanceLights.prepare(m_frame.m_frustum, m_pointLights);
+	}
+
+	//camera data changes most frames, but static cameras will skip the upload
+	FrameUniforms frameData;
+	frameData.m_projectionView = m_frame.m_projectionView;
+	frameData.m_cameraPosition = glm::vec4(m_frame.m_cameraPosition, 1);
+	frameData.m_cameraForward = glm::vec4(m_frame.m_cameraForward, 0);
+	frameData.m_clusterScale = m_lightClusters.getClusterScale();
+	frameData.m_clusterCounts = glm::ivec4(m_lightClusters.getClusterCounts(), m_instanceLightsEnabled ? 1 : 0);
+	m_frameUniforms.update(&frameData);
+
+	//lights are edited through pointers, so the block is rebuilt and compared instead of tracking edits
+	int directionalLightCount = glm::min((int)m_directionalLights.size(), MAX_DIRECTIONAL_LIGHTS);
+
+	m_lightData.m_ambientColor = glm::vec4(m_ambientLight, 1);
+	m_lightData.m_directionalLightCount = directionalLightCount;
+	m_lightData.m_shadowLight = -1;
+	for (int i = 0; i < directionalLightCount; i++)
+	{
+		m_lightData.m_directionalLights[i].m_direction = m_directionalLights[i]->m_direction;
+		m_lightData.m_directionalLights[i].m_color = m_directionalLights[i]->m_color;
+		if (m_lightData.m_shadowLight < 0 && m_directionalLights[i]->m_castShadows)
+		{
+			m_lightData.m_shadowLight = i;
+		}
+	}
+
+	//the cascades only move when the view leaves their tiles, so the block still rarely changes
+	DirectionalLight* shadowLight = m_lightData.m_shadowLight >= 0 ? m_directionalLights[m_lightData.m_shadowLight] : nullptr;
+	m_shadowCascades.update(m_frame, shadowLight, m_instances, m_tree, m_meshPool);
+	if (!m_shadowCascades.isActive())
+	{
+		m_lightData.m_shadowLight = -1;
+	}
+	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		m_lightData.m_shadowMatrices[i] = m_shadowCascades.isActive() ? m_shadowCascades.getMatrices()[i] : glm::mat4(0);
+	}
+	m_lightData.m_shadowSplits = m_shadowCascades.isActive() ? m_shadowCascades.getSplits() : glm::vec4(0);
+	m_lightData.m_shadowTexelSizes = m_shadowCascades.isActive() ? m_shadowCascades.getTexelSizes() : glm::vec4(0);
+	m_pointShadows.update(m_frame, m_pointLights, m_instances, m_tree, m_meshPool);
+	m_lightUniforms.update(&m_lightData);
+
+	//materials edited since the last frame are uploaded with everything else
+	m_materials.update();
+}
\ No newline at end of file
@@ -1,17 +1,47 @@
 /*  Created: 18/3/2021
  *  Author: Thomas Dufresne
  *
- *  Last Modified: 8/4/2021
+ *  Last Modified: 19/10/2026
  *	
  *	Used to handle draw calls for meshes with custom shaders. Contains functionality for 
- *	lighting and cameras, with Instance acting as a container for rendered objects.
+ *	lighting and cameras, with rendered objects kept in an InstanceStore.
+ *	Camera and lighting data is shared with every shader through uniform buffers.
+ *	Instances sharing a mesh and shader are batched, and drawn with hardware instancing
+ *	when their shader has an instanced variant. Instances are also kept in an AABB tree,
+ *	used for culling and for finding instances in an area. Culling and building draws is
+ *	split between worker threads, with only the GL calls made on the main thread. Meshes
+ *	are drawn from a shared mesh pool, so instanced draws can be combined in to multi draws.
+ *	Instances hidden behind last frame's depth can be skipped with a hierarchical Z buffer,
+ *	or behind a few occluder meshes rasterized on the CPU. Instances can be attached to nodes
+ *	of a transform hierarchy, and only take new transforms when their node's world matrix changes.
+ *	Point lights are binned in to view clusters, so fragments only light with nearby lights.
+ *	Opaque instances can be shaded forward, or drawn in to a G-buffer and lit in one pass.
  */
 #pragma once
-#include <list>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include <glm/glm.hpp>
+#include "UniformBuffer.h"
+#include "OBJMesh.h"
+#include "InstanceStore.h"
+#include "AABBTree.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include "MeshPool.h"
+#include "GPUCuller.h"
+#include "HiZBuffer.h"
+#include "OcclusionRasterizer.h"
+#include "TransformHierarchy.h"
+#include "Camera.h"
+#include "LightClusters.h"
+#include "InstanceLights.h"
+#include "GBuffer.h"
+#include "ShadowCascades.h"
+#include "PointShadows.h"
+#include "MaterialTable.h"
+#include "PipelineState.h"
 
-class Camera;
 class Instance;
 namespace aie
 {
@@ -20,14 +50,17 @@ namespace aie
 
 struct DirectionalLight
 {
-	DirectionalLight(glm::vec3 a_direction = glm::vec3(0, -1, 0), glm::vec3 a_color = glm::vec3(1))
+	DirectionalLight(glm::vec3 a_direction = glm::vec3(0, -1, 0), glm::vec3 a_color = glm::vec3(1), bool a_castShadows = false)
 	{
 		m_direction = a_direction;
 		m_color = a_color;
+		m_castShadows = a_castShadows;
 	}
 
 	glm::vec3 m_direction;
 	glm::vec3 m_color;
+	// Only the first light casting shadows has them drawn
+	bool m_castShadows;
 };
 struct PointLight
 {
@@ -46,20 +79,98 @@ struct PointLight
 };
 
 
+// Uniform block binding points. Every shader declares its blocks with these bindings
+enum UniformBinding : unsigned int
+{
+	FRAME_UNIFORM_BINDING = 0,
+	LIGHT_UNIFORM_BINDING = 1
+};
+
+// Must match the size of the directional light array in the LightData block
+#define MAX_DIRECTIONAL_LIGHTS 32
+
+// std140 layout of the FrameData uniform block
+struct FrameUniforms
+{
+	glm::mat4 m_projectionView;
+	glm::vec4 m_cameraPosition;
+	glm::vec4 m_cameraForward;
+	// Used to find a fragment's light cluster, see LightClusters
+	glm::vec4 m_clusterScale;
+	// w is 1 when instances are given their own light lists
+	glm::ivec4 m_clusterCounts;
+};
+// std140 layout of the LightData uniform block
+struct LightUniforms
+{
+	struct Directional
+	{
+		glm::vec3 m_direction;
+		float m_padding0;
+		glm::vec3 m_color;
+		float m_padding1;
+	};
+
+	glm::vec4 m_ambientColor;
+	int m_directionalLightCount;
+	// Index of the light with shadows, -1 if there isn't one
+	int m_shadowLight;
+	int m_padding[2];
+	Directional m_directionalLights[MAX_DIRECTIONAL_LIGHTS];
+	// See ShadowCascades
+	glm::mat4 m_shadowMatrices[SHADOW_CASCADE_COUNT];
+	glm::vec4 m_shadowSplits;
+	glm::vec4 m_shadowTexelSizes;
+};
+
+
 class Scene
 {
 public:
 	Scene(std::vector<Camera*> a_cameras, glm::vec2 a_windowSize, glm::vec3 a_ambientLight);
 	~Scene();
 
-	// Add an instance to the scene, registering its shader
-	void addInstance(Instance* a_instance);
+	// Add an instance to the scene, returning a handle used to edit or remove it
+	InstanceHandle addInstance(const Instance& a_instance);
+	// Remove an instance from the scene
+	void removeInstance(InstanceHandle a_handle);
+	// Every instance in the scene, used to edit them through their handles
+	// Instances must be added and removed through the scene so the tree stays in sync
+	InstanceStore& getInstances() { return m_instances; }
+
+	// Parent and child transforms, whose dirty world matrices are recalculated at the start of each draw
+	TransformHierarchy& getHierarchy() { return m_hierarchy; }
+	// Give an instance a node's world matrix now and whenever it changes. Nodes hold one instance each
+	void attachInstance(InstanceHandle a_instance, unsigned int a_node);
+
+	// Find the instances whose bounds touch a sphere
+	void findInstances(const BoundingSphere& a_sphere, std::vector<InstanceHandle>& a_results);
+	// Find the instances whose bounds are hit by a ray. a_direction must be normalised
+	void findInstances(const glm::vec3& a_origin, const glm::vec3& a_direction, float a_maxDistance, std::vector<InstanceHandle>& a_results);
+	// Draw instances using a_shader in batches with a_instancedShader, the INSTANCED variant of a_shader
+	void setInstancedShader(aie::ShaderProgram* a_shader, aie::ShaderProgram* a_instancedShader);
+	// Draw opaque instances using a_shader with a_deferredShader, its DEFERRED variant, when shading is deferred
+	// Instanced shaders need their own deferred variants
+	void setDeferredShader(aie::ShaderProgram* a_shader, aie::ShaderProgram* a_deferredShader) { m_deferredShaders[a_shader] = a_deferredShader; }
 	// Add a directional light source to the scene
 	void addLight(DirectionalLight* a_light) { m_directionalLights.push_back(a_light); }
 	// Add a point light source to the scene
 	void addLight(PointLight* a_light) { m_pointLights.push_back(a_light); }
+	// Point lights binned in to clusters of the camera's view each draw
+	LightClusters& getLightClusters() { return m_lightClusters; }
+	// Give each instance drawn forward a list of the point lights touching its bounds, read instead of its fragments' clusters
+	// Instances culled on the GPU and the deferred lighting pass still use the clusters
+	void setInstanceLightsEnabled(bool a_enabled) { m_instanceLightsEnabled = a_enabled; }
+	bool isInstanceLightsEnabled() const { return m_instanceLightsEnabled; }
+	// Light indices in every instance's list combined in the last draw, and the lights touching the view they were picked from
+	unsigned int getInstanceLightCount() const { return m_instanceLightCount; }
+	unsigned int getViewLightCount() const { return m_instanceLights.getPreparedCount(); }
+	// Shadows of the first directional light casting them, drawn before the instances each draw
+	ShadowCascades& getShadowCascades() { return m_shadowCascades; }
+	// Shadows of the point lights ranked highest on screen, with a budget of faces redrawn each draw
+	PointShadows& getPointShadows() { return m_pointShadows; }
 
-	// Setup instance sahders and draw all instances in the scene
+	// Update the shared uniform buffers and draw all instances in the scene
 	void draw();
 
 
@@ -72,12 +183,161 @@ public:
 	void setCameraIndex(int a_index) { m_cameraIndex = a_index; }
 
 	glm::vec2 getWindowSize() const { return m_windowSize; }
+	// Matrices and frustum of the current camera, built at the start of each draw
+	const FrameContext& getFrameContext() const { return m_frame; }
+
+	// Toggle hardware instancing, used to compare against drawing each instance separately
+	void setInstancingEnabled(bool a_enabled) { m_instancingEnabled = a_enabled; }
+	bool isInstancingEnabled() const { return m_instancingEnabled; }
+	// Draw pooled meshes from shared buffers, with instanced draws combined in to multi draw indirect calls
+	void setMeshPoolEnabled(bool a_enabled) { m_meshPoolEnabled = a_enabled; }
+	bool isMeshPoolEnabled() const { return m_meshPoolEnabled; }
+	// Number of draw calls made by the last draw. A multi draw counts as one
+	unsigned int getDrawCallCount() const { return m_drawCallCount; }
+	// Materials of every pooled mesh, read by shaders with a MATERIAL_TABLE variant instead of uniforms
+	const MaterialTable& getMaterialTable() const { return m_materials; }
+	// Times the last draw bound a material's uniforms and textures. Draws with programs reading the table never need to
+	unsigned int getMaterialBindCount() const { return m_materialBindCount; }
+	// Sorted draws of the last frame, including how much state changed before and after sorting
+	const RenderQueue& getRenderQueue() const { return m_renderQueue; }
+
+	// Number of threads used to cull instances and build draws, including the main thread
+	void setThreadCount(unsigned int a_threadCount) { m_threadPool.setThreadCount(a_threadCount); }
+	unsigned int getThreadCount() const { return m_threadPool.getThreadCount(); }
+	// Time the last draw spent building draws on every thread, and submitting them on this one
+	float getPrepareTime() const { return m_prepareMS; }
+	float getSubmitTime() const { return m_submitMS; }
+
+	// How instances are culled against the camera
+	enum CullMode
+	{
+		CULL_NONE,
+		// Test every instance's sphere with simd
+		CULL_LINEAR,
+		// Walk the AABB tree
+		CULL_TREE,
+		// Cull instanced batches in a compute shader, the others aren't culled
+		CULL_GPU
+	};
+	void setCullMode(CullMode a_mode) { m_cullMode = a_mode; }
+	CullMode getCullMode() const { return m_cullMode; }
+	// Number of instances inside and outside the camera's view in the last draw
+	unsigned int getVisibleCount() const { return m_visibleCount; }
+	unsigned int getCulledCount() const { return m_culledCount; }
+	// Number of instances skipped in the last draw for having INSTANCE_VISIBLE cleared, not counting GPU culled ones
+	unsigned int getHiddenCount() const { return m_hiddenCount; }
+	unsigned int getInstanceCount() const { return m_instances.getCount(); }
+	// Number of instances culled on the GPU in the last draw, whose visibility the CPU never sees
+	unsigned int getGPUCulledCount() const { return m_gpuInstanceCount; }
+	// Compare the last GPU cull with the same cull on the CPU, returning how many results differ. Stalls until the GPU is done
+	unsigned int verifyGPUCulling() const { return m_gpuCuller.verify(m_instances); }
+
+	// How instances in the camera's view are tested for being hidden. Only used when culling on the CPU
+	enum OcclusionMode
+	{
+		OCCLUSION_NONE,
+		// Test against the last frame's depth, read back from the GPU
+		OCCLUSION_HIZ,
+		// Test against the occluder meshes, rasterized on the CPU this frame
+		OCCLUSION_SOFTWARE
+	};
+	void setOcclusionMode(OcclusionMode a_mode) { m_occlusionMode = a_mode; }
+	OcclusionMode getOcclusionMode() const { return m_occlusionMode; }
+	// Draw a_mesh in to the software occlusion buffer with an instance's transform, until the instance is removed
+	// a_mesh must stay alive as long as the instance
+	void addOccluder(InstanceHandle a_instance, const OccluderMesh* a_mesh) { m_occluders.push_back(Occluder{ a_instance, a_mesh }); }
+	// Number of instances in the camera's view that were occluded in the last draw, and the draws that saved
+	unsigned int getOccludedCount() const { return m_occludedCount; }
+	unsigned int getOccludedDrawCount() const { return m_occludedDrawCount; }
+	const HiZBuffer& getHiZBuffer() const { return m_hiZ; }
+	const OcclusionRasterizer& getOcclusionRasterizer() const { return m_rasterizer; }
+
+	// How opaque instances are lit. Transparent ones are always shaded forward
+	enum ShadingMode
+	{
+		// Light every fragment as it's drawn
+		SHADING_FORWARD,
+		// Draw in to the G-buffer, then light each pixel once. Shaders without a deferred variant are drawn unlit
+		SHADING_DEFERRED
+	};
+	void setShadingMode(ShadingMode a_mode) { m_shadingMode = a_mode; }
+	ShadingMode getShadingMode() const { return m_shadingMode; }
+	const GBuffer& getGBuffer() const { return m_gBuffer; }
+	// Draw the depth of opaque instanced pooled draws before anything else, so those draws are then only shaded
+	// where they are visible. Used with either shading mode
+	void setDepthPrePassEnabled(bool a_enabled) { m_depthPrePassEnabled = a_enabled; }
+	bool isDepthPrePassEnabled() const { return m_depthPrePassEnabled; }
+	// Fragments that passed the depth test in the pre-pass and in the opaque draws, counted a few draws ago
+	// since they are read back without waiting for the GPU
+	unsigned int getPrePassFragmentCount() const { return m_prePassFragmentCount; }
+	unsigned int getShadedFragmentCount() const { return m_shadedFragmentCount; }
+	// Opaque fragments shaded for each pixel of the window
+	float getOverdraw() const { return m_shadedFragmentCount / (m_windowSize.x * m_windowSize.y); }
 
 	glm::vec3& getAmbientLight() { return m_ambientLight; }
 	std::vector<DirectionalLight*>& getDirectionalLights() { return m_directionalLights; }
 	std::vector<PointLight*>& getPointLights() { return m_pointLights; }
 
 protected:
+	// Instances sharing a mesh and shader
+	struct InstanceBatch
+	{
+		unsigned short m_meshID;
+		unsigned short m_shaderID;
+		// Number of instances in the batch, visible or not
+		unsigned int m_size;
+		// Instanced variant of the shader, nullptr if the batch is drawn one instance at a time
+		aie::ShaderProgram* m_instancedShader;
+		// Program the batch is drawn with this frame
+		aie::ShaderProgram* m_drawShader;
+		// Culled and packed in to the instance buffer by a compute shader this frame
+		bool m_gpuCulled;
+		// Where the batch starts in the instance buffer, and how many visible instances it has
+		unsigned int m_baseInstance;
+		unsigned int m_instanceCount;
+		// Distance to the closest visible instance, used to sort instanced draws
+		float m_nearestDepth;
+	};
+
+	// Recalculate dirty world matrices and copy them to their attached instances
+	void updateHierarchy();
+	// Bin the point lights and sort them for instance lists, then fill the uniform buffers with this frames camera and lighting data
+	void updateUniforms();
+	// Group the instances by mesh and shader
+	void buildBatches();
+	// Move the tree proxies of instances whose bounds changed
+	void updateTree();
+	// Pick which batches are instanced this frame, and walk the tree if culling with it
+	void prepareDrawData();
+	// Cull a share of the instances, emitting a packet for each visible one. Run on every thread
+	void emitPackets(unsigned int a_thread);
+	// Give each thread a range of the instance buffer for each batch
+	void assignInstanceRanges();
+	// Fill the instance data and build commands for the thread's packets. Run on every thread
+	void writeDrawData(unsigned int a_thread);
+	// Upload the instance buffer and fill the render queue with every thread's commands
+	void mergeDrawData();
+	// Add indirect commands for the batches culled on the GPU, and cull them after the instance data from a_outputOffset
+	void cullOnGPU(unsigned int a_outputOffset);
+	// Draw the sorted render queue, only changing state between draws when it differs
+	void executeRenderQueue();
+	// Draw the depth of every opaque draw the pre-pass covers, with colour writes off
+	void drawDepthPrePass();
+	// Read the fragment counts of an earlier draw, if the GPU has finished it
+	void updateFragmentCounts();
+	// Program an opaque draw is made with, the deferred variant of a_program when shading is deferred
+	aie::ShaderProgram* getPassProgram(aie::ShaderProgram* a_program, RenderPass a_pass, bool a_deferred) const;
+	// Chunks with transparent materials are drawn in the transparent pass
+	RenderPass getRenderPass(aie::OBJMesh* a_mesh, int a_materialID) const;
+	// Is an instance hidden, tested with the current occlusion mode
+	bool isOccluded(unsigned int a_index) const;
+	// Distance from the camera to an instance's bounding sphere
+	float getDepth(unsigned int a_index) const;
+	// Check that a mesh provides every attribute its shader reads
+	// Returns false if the shader hasn't finished linking yet
+	bool validateMesh(aie::OBJMesh* a_mesh, aie::ShaderProgram* a_shader) const;
+
+
 	std::vector<Camera*> m_cameras;
 	int m_cameraIndex = 0;
 	glm::vec2 m_windowSize;
@@ -86,8 +346,153 @@ protected:
 	glm::vec3 m_ambientLight;
 	std::vector<DirectionalLight*> m_directionalLights;
 	std::vector<PointLight*> m_pointLights;
+	LightClusters m_lightClusters;
+	InstanceLights m_instanceLights;
+	bool m_instanceLightsEnabled;
+	// Light list of each instance drawn one at a time, by index in the instance store
+	std::vector<glm::uvec2> m_instanceLightRanges;
+	unsigned int m_instanceLightCount;
+	ShadowCascades m_shadowCascades;
+	PointShadows m_pointShadows;
 	
-	std::list<Instance*> m_instances;
-	// Each unique shader used by the scenes instances
-	std::list<aie::ShaderProgram*> m_shaders;
+	InstanceStore m_instances;
+	// Mesh and shader ID pairs that have been validated, as meshID << 16 | shaderID
+	std::unordered_set<unsigned int> m_validatedPairs;
+
+	///hierarchy
+	TransformHierarchy m_hierarchy;
+	// Instance attached to each node, by node ID
+	std::vector<InstanceHandle> m_nodeInstances;
+
+	///instancing
+	std::vector<InstanceBatch> m_batches;
+	// Layout version of the instance store when the batches were built
+	unsigned int m_batchVersion;
+	// Instanced variant of each shader, keyed by the regular shader
+	std::unordered_map<aie::ShaderProgram*, aie::ShaderProgram*> m_instancedShaders;
+	// Meshes whose chunks have the instance buffer attached
+	std::unordered_set<aie::OBJMesh*> m_instancedMeshes;
+	// Per instance data for every instanced batch, shared so meshes only need it attached once
+	unsigned int m_instanceBuffer;
+	unsigned int m_instanceCapacity;
+	std::vector<aie::OBJMesh::InstanceData> m_instanceData;
+	bool m_instancingEnabled;
+	unsigned int m_drawCallCount;
+	RenderQueue m_renderQueue;
+
+	///mesh pool
+	MeshPool m_meshPool;
+	bool m_meshPoolEnabled;
+	// Indirect commands for every pooled instanced draw this frame, in the order they are drawn
+	std::vector<DrawElementsIndirectCommand> m_indirectCommands;
+	unsigned int m_indirectBuffer;
+	unsigned int m_indirectCapacity;
+	MaterialTable m_materials;
+	unsigned int m_materialBindCount;
+
+	///threading
+	// Visible instance found by a worker
+	struct DrawPacket
+	{
+		unsigned int m_index;
+		unsigned int m_batch;
+		float m_depth;
+		// Offset in to the thread's light indices and number of lights
+		glm::uvec2 m_lights;
+	};
+	// Everything a worker writes to, so threads never share memory they write
+	struct ThreadData
+	{
+		std::vector<DrawPacket> m_packets;
+		// Visible instances in each batch, then where the thread writes each batch's instance data
+		std::vector<unsigned int> m_batchOffsets;
+		std::vector<float> m_nearestDepths;
+		// Instances in each batch that were in view but occluded
+		std::vector<unsigned int> m_batchOccluded;
+		// Instances not culled on the GPU with INSTANCE_VISIBLE cleared
+		unsigned int m_hiddenCount;
+		// Commands for instances that aren't instanced, with their sort keys
+		std::vector<RenderCommand> m_commands;
+		std::vector<unsigned long long> m_keys;
+		// Light lists of the thread's packets, and where they start in the combined list
+		std::vector<unsigned int> m_lightIndices;
+		unsigned int m_lightOffset;
+	};
+	ThreadPool m_threadPool;
+	std::vector<ThreadData> m_threadData;
+	// Batch of each instance, by index in the instance store
+	std::vector<unsigned int> m_instanceBatches;
+	// Camera for this frame, read by the workers
+	FrameContext m_frame;
+	float m_prepareMS;
+	float m_submitMS;
+
+	///culling
+	CullMode m_cullMode;
+	AABBTree m_tree;
+	// Tree proxy of each instance, by its handle's slot
+	std::vector<int> m_treeProxies;
+	// Instances whose bounds changed this frame, and the results of tree queries. Kept to reuse their memory
+	std::vector<unsigned int> m_movedInstances;
+	std::vector<unsigned int> m_queryResults;
+	// 1 for each instance in the camera's view this frame, by index in the instance store
+	std::vector<unsigned char> m_cullResults;
+	unsigned int m_visibleCount;
+	unsigned int m_culledCount;
+	unsigned int m_hiddenCount;
+
+	///gpu culling
+	GPUCuller m_gpuCuller;
+	unsigned int m_gpuInstanceCount;
+	// Batch version last given to the GPU culler
+	unsigned int m_gpuBatchVersion;
+	// Group of each batch and the size of each group, with the indirect commands drawing them. Kept to reuse their memory
+	std::vector<unsigned int> m_batchGroups;
+	std::vector<unsigned int> m_groupSizes;
+	std::vector<DrawElementsIndirectCommand> m_gpuCommands;
+	std::vector<unsigned int> m_gpuCommandGroups;
+
+	///occlusion culling
+	OcclusionMode m_occlusionMode;
+	HiZBuffer m_hiZ;
+	OcclusionRasterizer m_rasterizer;
+	struct Occluder
+	{
+		InstanceHandle m_instance;
+		const OccluderMesh* m_mesh;
+	};
+	std::vector<Occluder> m_occluders;
+	// Whether the depth can be tested against this frame's camera, read by the workers
+	bool m_testOcclusion;
+	unsigned int m_occludedCount;
+	unsigned int m_occludedDrawCount;
+
+	///deferred shading
+	ShadingMode m_shadingMode;
+	GBuffer m_gBuffer;
+	// Deferred variant of each shader, keyed by the forward shader
+	std::unordered_map<aie::ShaderProgram*, aie::ShaderProgram*> m_deferredShaders;
+
+	///depth pre-pass
+	aie::ShaderProgram* m_depthProgram;
+	bool m_depthPrePassEnabled;
+	// Samples passed in the pre-pass and in the opaque draws
+	unsigned int m_fragmentQueries[2];
+	bool m_fragmentQueryPending;
+	unsigned int m_prePassFragmentCount;
+	unsigned int m_shadedFragmentCount;
+
+	///pipeline states
+	// State of each render pass. The pass is the top of the render queue's sort keys, so draws are already grouped by state
+	aie::PipelineState m_passStates[2];
+	// Depth only, for the pre-pass
+	aie::PipelineState m_depthPrePassState;
+	// Opaque draws the pre-pass covered, which only pass where their depth is equal and don't write it
+	aie::PipelineState m_prePassedState;
+
+	///uniform buffers shared by all shaders
+	UniformBuffer m_frameUniforms;
+	UniformBuffer m_lightUniforms;
+	// CPU side copy of the light block, kept to avoid reallocating it every frame
+	LightUniforms m_lightData;
 };
@@ -1,106 +1,223 @@
 #include "Shader.h"
 #include <cstdio>
 #include <cassert>
+#include <cstring>
 #include "gl_core_4_4.h"
+#include "PipelineState.h"
+
+// from GL_KHR_parallel_shader_compile, which the 4.4 core loader doesn't include
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 namespace aie {
 
-Shader::~Shader() {
-	glDeleteShader(m_handle);
+// names of the uniforms in eMaterialUniform
+static const char* materialUniformNames[MATERIAL_UNIFORM_Count] = {
+	"Ka", "Kd", "Ks", "Ke", "opacity", "Ns",
+	"diffuseTexture", "alphaTexture", "ambientTexture", "specularTexture",
+	"specularHighlightTexture", "normalTexture", "displacementTexture",
+};
+
+static bool isSamplerType(unsigned int type) {
+	switch (type) {
+	case GL_SAMPLER_1D:	case GL_SAMPLER_2D:	case GL_SAMPLER_3D:	case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_1D_SHADOW:	case GL_SAMPLER_2D_SHADOW:	case GL_SAMPLER_CUBE_SHADOW:
+	case GL_SAMPLER_1D_ARRAY:	case GL_SAMPLER_2D_ARRAY:	case GL_SAMPLER_CUBE_MAP_ARRAY:
+	case GL_SAMPLER_1D_ARRAY_SHADOW:	case GL_SAMPLER_2D_ARRAY_SHADOW:	case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+	case GL_SAMPLER_2D_RECT:	case GL_SAMPLER_2D_RECT_SHADOW:	case GL_SAMPLER_BUFFER:
+	case GL_SAMPLER_2D_MULTISAMPLE:	case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+	case GL_INT_SAMPLER_1D:	case GL_INT_SAMPLER_2D:	case GL_INT_SAMPLER_3D:	case GL_INT_SAMPLER_CUBE:
+	case GL_INT_SAMPLER_1D_ARRAY:	case GL_INT_SAMPLER_2D_ARRAY:	case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+	case GL_INT_SAMPLER_2D_RECT:	case GL_INT_SAMPLER_BUFFER:
+	case GL_INT_SAMPLER_2D_MULTISAMPLE:	case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+	case GL_UNSIGNED_INT_SAMPLER_1D:	case GL_UNSIGNED_INT_SAMPLER_2D:	case GL_UNSIGNED_INT_SAMPLER_3D:
+	case GL_UNSIGNED_INT_SAMPLER_CUBE:	case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:	case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+	case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:	case GL_UNSIGNED_INT_SAMPLER_2D_RECT:	case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+	case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:	case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		return true;
+	default:
+		return false;
+	};
 }
 
-bool Shader::loadShader(unsigned int stage, const char* filename) {
-	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-
-	m_stage = stage;
-
+static unsigned int createShaderHandle(unsigned int stage) {
 	switch (stage) {
-	case eShaderStage::VERTEX:	m_handle = glCreateShader(GL_VERTEX_SHADER);	break;
-	case eShaderStage::TESSELLATION_EVALUATION:	m_handle = glCreateShader(GL_TESS_EVALUATION_SHADER);	break;
-	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
-	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
-	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
-	default:	break;
+	case eShaderStage::VERTEX:	return glCreateShader(GL_VERTEX_SHADER);
+	case eShaderStage::TESSELLATION_EVALUATION:	return glCreateShader(GL_TESS_EVALUATION_SHADER);
+	case eShaderStage::TESSELLATION_CONTROL:	return glCreateShader(GL_TESS_CONTROL_SHADER);
+	case eShaderStage::GEOMETRY:	return glCreateShader(GL_GEOMETRY_SHADER);
+	case eShaderStage::FRAGMENT:	return glCreateShader(GL_FRAGMENT_SHADER);
+	case eShaderStage::COMPUTE:	return glCreateShader(GL_COMPUTE_SHADER);
+	default:	return 0;
 	};
-	
-	// open file
+}
+
+// reads a whole file, returns false if it can't be opened
+static bool readShaderFile(const char* filename, std::string& source) {
 	FILE* file = nullptr;
 	fopen_s(&file, filename, "rb");
+	if (file == nullptr)
+		return false;
+
 	fseek(file, 0, SEEK_END);
 	unsigned int size = ftell(file);
-	char* source = new char[size + 1];
+	source.resize(size);
 	fseek(file, 0, SEEK_SET);
-	fread_s(source, size + 1, sizeof(char), size, file);
+	fread_s(&source[0], size, sizeof(char), size, file);
 	fclose(file);
-	source[size] = 0;
+	return true;
+}
 
-	glShaderSource(m_handle, 1, (const char**)&source, 0);
-	glCompileShader(m_handle);
+// variant defines have to come after the #version line
+static void insertDefines(std::string& source, const std::vector<std::string>& defines) {
+	if (defines.empty())
+		return;
 
-	delete[] source;
+	std::string lines;
+	for (auto& define : defines)
+		lines += "#define " + define + "\n";
 
-	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+	size_t version = source.find("#version");
+	size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		source.insert(0, lines);
+	else
+		source.insert(lineEnd + 1, lines);
+}
 
-		delete[] m_lastError;
-		m_lastError = new char[infoLogLength];
-		glGetShaderInfoLog(m_handle, infoLogLength, 0, m_lastError);
-		return false;
+// 64bit FNV-1a, used to tell shader sources apart in diagnostics
+static unsigned long long hashSource(const std::string& source) {
+	unsigned long long hash = 14695981039346656037ull;
+	for (char c : source) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ull;
 	}
+	return hash;
+}
 
-	return true;
+Shader::~Shader() {
+	delete[] m_lastError;
+	glDeleteShader(m_handle);
 }
 
-bool Shader::createShader(unsigned int stage, const char* string) {
+bool Shader::loadShader(unsigned int stage, const char* filename, const std::vector<std::string>& defines) {
+	if (submitShader(stage, filename, defines) == false)
+		return false;
+	return checkCompileStatus();
+}
+
+bool Shader::createShader(unsigned int stage, const char* string, const std::vector<std::string>& defines) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
 
 	m_stage = stage;
+	m_handle = createShaderHandle(stage);
+	m_filename = "";
+	m_defines = defines;
 
-	switch (stage) {
-	case eShaderStage::VERTEX:	m_handle = glCreateShader(GL_VERTEX_SHADER);	break;
-	case eShaderStage::TESSELLATION_EVALUATION:	m_handle = glCreateShader(GL_TESS_EVALUATION_SHADER);	break;
-	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
-	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
-	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
-	default:	break;
-	};
+	std::string source = string;
+	insertDefines(source, defines);
+	compileSource(source);
+
+	return checkCompileStatus();
+}
+
+bool Shader::submitShader(unsigned int stage, const char* filename, const std::vector<std::string>& defines) {
+	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+
+	m_stage = stage;
+	m_handle = createShaderHandle(stage);
+	m_filename = filename;
+	m_defines = defines;
 
-	glShaderSource(m_handle, 1, (const char**)&string, 0);
+	std::string source;
+	if (readShaderFile(filename, source) == false) {
+		setLastError("Failed to open shader file [" + m_filename + "]");
+		return false;
+	}
+	insertDefines(source, defines);
+
+	// the compile status isn't queried here, so the driver is free to compile in the background
+	compileSource(source);
+	return true;
+}
+
+void Shader::compileSource(const std::string& source) {
+	m_sourceHash = hashSource(source);
+
+	const char* string = source.c_str();
+	glShaderSource(m_handle, 1, &string, 0);
 	glCompileShader(m_handle);
-	
+}
+
+bool Shader::checkCompileStatus() {
 	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
+	glGetShaderiv(m_handle, GL_COMPILE_STATUS, &success);
 	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
-
-		delete[] m_lastError;
-		m_lastError = new char[infoLogLength];
-		glGetShaderInfoLog(m_handle, infoLogLength, 0, m_lastError);
+		setLastError(getInfoLog());
 		return false;
 	}
-
 	return true;
 }
 
+bool Shader::isCompileComplete() const {
+	// without the extension the only option is to assume it's done, and let the status query wait
+	if (ShaderProgram::hasParallelCompile() == false)
+		return true;
+
+	int complete = GL_FALSE;
+	glGetShaderiv(m_handle, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+std::string Shader::getInfoLog() const {
+	int infoLogLength = 0;
+	glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+	if (infoLogLength <= 1)
+		return "";
+
+	std::string log(infoLogLength, 0);
+	glGetShaderInfoLog(m_handle, infoLogLength, 0, &log[0]);
+	log.resize(infoLogLength - 1);
+	return log;
+}
+
+void Shader::setLastError(const std::string& error) {
+	delete[] m_lastError;
+	m_lastError = new char[error.size() + 1];
+	memcpy(m_lastError, error.c_str(), error.size() + 1);
+}
+
 ShaderProgram::~ShaderProgram() {
 	delete[] m_lastError;
 	glDeleteProgram(m_program);
 }
 
-bool ShaderProgram::loadShader(unsigned int stage, const char* filename) {
+bool ShaderProgram::loadShader(unsigned int stage, const char* filename, const std::vector<std::string>& defines) {
+	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+	m_shaders[stage] = std::make_shared<Shader>();
+	return m_shaders[stage]->loadShader(stage, filename, defines);
+}
+
+bool ShaderProgram::createShader(unsigned int stage, const char* string, const std::vector<std::string>& defines) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
 	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->loadShader(stage, filename);
+	return m_shaders[stage]->createShader(stage, string, defines);
 }
 
-bool ShaderProgram::createShader(unsigned int stage, const char* string) {
+bool ShaderProgram::submitShader(unsigned int stage, const char* filename, const std::vector<std::string>& defines) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
 	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->createShader(stage, string);
+	if (m_shaders[stage]->submitShader(stage, filename, defines) == false) {
+		// keep the error so it's reported when the link fails
+		const char* error = m_shaders[stage]->getLastError();
+		size_t length = strlen(error) + 1;
+		delete[] m_lastError;
+		m_lastError = new char[length];
+		memcpy(m_lastError, error, length);
+		return false;
+	}
+	return true;
 }
 
 void ShaderProgram::attachShader(const std::shared_ptr<Shader>& shader) {
@@ -118,29 +235,259 @@ bool ShaderProgram::link() {
 	int success = GL_TRUE;
 	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
 	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
-
-		delete[] m_lastError;
-		m_lastError = new char[infoLogLength + 1];
-		glGetProgramInfoLog(m_program, infoLogLength, 0, m_lastError);
+		storeLinkError();
+		m_status = LINK_FAILED;
 		return false;
 	}
+	m_status = LINKED;
+	reflect();
 	return true;
 }
 
+void ShaderProgram::linkAsync() {
+	m_program = glCreateProgram();
+	for (auto& s : m_shaders)
+		if (s != nullptr)
+			glAttachShader(m_program, s->getHandle());
+	glLinkProgram(m_program);
+
+	m_status = LINKING;
+}
+
+ShaderProgram::eLinkStatus ShaderProgram::pollStatus() {
+	if (m_status != LINKING)
+		return m_status;
+
+	// without the extension querying the link status is the only option, and it will block
+	if (hasParallelCompile()) {
+		int complete = GL_FALSE;
+		glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &complete);
+		if (complete == GL_FALSE)
+			return m_status;
+	}
+
+	int success = GL_TRUE;
+	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE) {
+		// a missing file is more useful than the link error it caused
+		if (m_lastError == nullptr)
+			storeLinkError();
+		m_status = LINK_FAILED;
+	}
+	else {
+		m_status = LINKED;
+		reflect();
+	}
+
+	return m_status;
+}
+
+void ShaderProgram::swap(ShaderProgram& other) {
+	std::swap(m_program, other.m_program);
+	std::swap(m_status, other.m_status);
+	std::swap(m_lastError, other.m_lastError);
+	for (unsigned int i = 0; i < eShaderStage::SHADER_STAGE_Count; ++i)
+		std::swap(m_shaders[i], other.m_shaders[i]);
+
+	m_uniforms.swap(other.m_uniforms);
+	m_uniformBlocks.swap(other.m_uniformBlocks);
+	m_attributes.swap(other.m_attributes);
+	m_samplers.swap(other.m_samplers);
+	m_uniformLookup.swap(other.m_uniformLookup);
+	for (unsigned int i = 0; i < MATERIAL_UNIFORM_Count; ++i)
+		std::swap(m_materialUniforms[i], other.m_materialUniforms[i]);
+	std::swap(m_usesMaterial, other.m_usesMaterial);
+}
+
+bool ShaderProgram::hasParallelCompile() {
+	// the extension list won't change, so only search it once
+	static int supported = -1;
+	if (supported == -1) {
+		supported = 0;
+
+		int extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (int i = 0; i < extensionCount; ++i) {
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 ||
+				strcmp(name, "GL_ARB_parallel_shader_compile") == 0) {
+				// the default thread count is chosen by the driver, so nothing else needs to be set
+				supported = 1;
+				break;
+			}
+		}
+	}
+	return supported == 1;
+}
+
+std::string ShaderProgram::getInfoLog() const {
+	int infoLogLength = 0;
+	glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
+	if (infoLogLength <= 1)
+		return "";
+
+	std::string log(infoLogLength, 0);
+	glGetProgramInfoLog(m_program, infoLogLength, 0, &log[0]);
+	log.resize(infoLogLength - 1);
+	return log;
+}
+
+void ShaderProgram::storeLinkError() {
+	// a stage that failed to compile explains the problem better than the link log
+	std::string error;
+	for (auto& s : m_shaders) {
+		if (s != nullptr && s->checkCompileStatus() == false) {
+			error += s->getLastError();
+			error += "\n";
+		}
+	}
+	if (error.empty())
+		error = getInfoLog();
+
+	delete[] m_lastError;
+	m_lastError = new char[error.size() + 1];
+	memcpy(m_lastError, error.c_str(), error.size() + 1);
+}
+
+void ShaderProgram::reflect() {
+	m_uniforms.clear();
+	m_uniformBlocks.clear();
+	m_attributes.clear();
+	m_samplers.clear();
+	m_uniformLookup.clear();
+
+	// uniforms, including the ones inside blocks
+	int count = 0, maxLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> name(maxLength + 1);
+	for (int i = 0; i < count; ++i) {
+		UniformInfo info;
+		int length = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_program, i, maxLength + 1, &length, &info.arraySize, &type, name.data());
+		info.type = type;
+		info.name.assign(name.data(), length);
+		info.location = glGetUniformLocation(m_program, info.name.c_str());
+
+		// arrays are reported as name[0], but looked up without it
+		if (info.name.size() > 3 && info.name.compare(info.name.size() - 3, 3, "[0]") == 0)
+			info.name.resize(info.name.size() - 3);
+
+		GLuint index = i;
+		glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &info.blockIndex);
+		glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_OFFSET, &info.blockOffset);
+		glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &info.arrayStride);
+
+		if (isSamplerType(info.type))
+			m_samplers.push_back((unsigned int)m_uniforms.size());
+
+		m_uniformLookup[info.name] = (unsigned int)m_uniforms.size();
+		m_uniforms.push_back(info);
+	}
+
+	// uniform blocks
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	for (int i = 0; i < count; ++i) {
+		UniformBlockInfo info;
+		info.index = i;
+		glGetActiveUniformBlockiv(m_program, i, GL_UNIFORM_BLOCK_BINDING, &info.binding);
+		glGetActiveUniformBlockiv(m_program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &info.dataSize);
+
+		glGetActiveUniformBlockiv(m_program, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &maxLength);
+		name.resize(maxLength + 1);
+		int length = 0;
+		glGetActiveUniformBlockName(m_program, i, maxLength + 1, &length, name.data());
+		info.name.assign(name.data(), length);
+
+		m_uniformBlocks.push_back(info);
+	}
+
+	// vertex attributes
+	glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (int i = 0; i < count; ++i) {
+		AttributeInfo info;
+		int length = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(m_program, i, maxLength + 1, &length, &info.arraySize, &type, name.data());
+		info.type = type;
+		info.name.assign(name.data(), length);
+		info.location = glGetAttribLocation(m_program, info.name.c_str());
+
+		// skip built in inputs like gl_VertexID
+		if (info.location >= 0)
+			m_attributes.push_back(info);
+	}
+
+	// material uniforms, so meshes can skip anything the program doesn't read
+	m_usesMaterial = false;
+	for (unsigned int i = 0; i < MATERIAL_UNIFORM_Count; ++i) {
+		const UniformInfo* info = findUniform(materialUniformNames[i]);
+		m_materialUniforms[i] = info != nullptr ? info->location : -1;
+		m_usesMaterial = m_usesMaterial || m_materialUniforms[i] >= 0;
+	}
+
+	// texture slots never change, so they only need setting once
+	for (unsigned int i = MATERIAL_DIFFUSE_TEXTURE; i <= MATERIAL_DISPLACEMENT_TEXTURE; ++i)
+		if (m_materialUniforms[i] >= 0)
+			glProgramUniform1i(m_program, m_materialUniforms[i], i - MATERIAL_DIFFUSE_TEXTURE);
+}
+
+const ShaderProgram::UniformInfo* ShaderProgram::findUniform(const char* name) const {
+	auto iter = m_uniformLookup.find(name);
+	return iter != m_uniformLookup.end() ? &m_uniforms[iter->second] : nullptr;
+}
+
+const ShaderProgram::UniformBlockInfo* ShaderProgram::findUniformBlock(const char* name) const {
+	for (auto& block : m_uniformBlocks)
+		if (block.name == name)
+			return &block;
+	return nullptr;
+}
+
+const ShaderProgram::AttributeInfo* ShaderProgram::findAttribute(const char* name) const {
+	for (auto& attribute : m_attributes)
+		if (attribute.name == name)
+			return &attribute;
+	return nullptr;
+}
+
+bool ShaderProgram::usesAttribute(int location) const {
+	for (auto& attribute : m_attributes) {
+		// matrices and arrays take up more than one location
+		int size = attribute.arraySize;
+		if (attribute.type == GL_FLOAT_MAT4 || attribute.type == GL_FLOAT_MAT3 || attribute.type == GL_FLOAT_MAT2)
+			size *= attribute.type == GL_FLOAT_MAT4 ? 4 : attribute.type == GL_FLOAT_MAT3 ? 3 : 2;
+		if (location >= attribute.location && location < attribute.location + size)
+			return true;
+	}
+	return false;
+}
+
 void ShaderProgram::bind() {
 	assert(m_program > 0 && "Invalid shader program");
-	glUseProgram(m_program);
+	// through the pipeline state tracking, so binding the program already in use does nothing
+	PipelineState::useProgram(m_program);
 }
 
 int ShaderProgram::getUniform(const char* name) {
+	// use the reflection table once it exists, instead of asking opengl
+	if (m_status == LINKED) {
+		const UniformInfo* info = findUniform(name);
+		if (info != nullptr)
+			return info->location;
+		// only the first element of an array is in the table, so other elements are asked for
+		if (strchr(name, '[') == nullptr)
+			return -1;
+	}
 	return glGetUniformLocation(m_program, name);
 }
 
 bool ShaderProgram::bindUniform(const char* name, int value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -151,7 +498,7 @@ bool ShaderProgram::bindUniform(const char* name, int value) {
 
 bool ShaderProgram::bindUniform(const char* name, float value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -162,7 +509,7 @@ bool ShaderProgram::bindUniform(const char* name, float value) {
 
 bool ShaderProgram::bindUniform(const char* name, const glm::vec2& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -173,7 +520,7 @@ bool ShaderProgram::bindUniform(const char* name, const glm::vec2& value) {
 
 bool ShaderProgram::bindUniform(const char* name, const glm::vec3& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -184,7 +531,7 @@ bool ShaderProgram::bindUniform(const char* name, const glm::vec3& value) {
 
 bool ShaderProgram::bindUniform(const char* name, const glm::vec4& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -195,7 +542,7 @@ bool ShaderProgram::bindUniform(const char* name, const glm::vec4& value) {
 
 bool ShaderProgram::bindUniform(const char* name, const glm::mat2& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -206,7 +553,7 @@ bool ShaderProgram::bindUniform(const char* name, const glm::mat2& value) {
 
 bool ShaderProgram::bindUniform(const char* name, const glm::mat3& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -217,7 +564,7 @@ bool ShaderProgram::bindUniform(const char* name, const glm::mat3& value) {
 
 bool ShaderProgram::bindUniform(const char* name, const glm::mat4& value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -228,7 +575,7 @@ bool ShaderProgram::bindUniform(const char* name, const glm::mat4& value) {
 
 bool ShaderProgram::bindUniform(const char* name, int count, int* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -239,7 +586,7 @@ bool ShaderProgram::bindUniform(const char* name, int count, int* value) {
 
 bool ShaderProgram::bindUniform(const char* name, int count, float* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -250,7 +597,7 @@ bool ShaderProgram::bindUniform(const char* name, int count, float* value) {
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec2* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -261,7 +608,7 @@ bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec2* va
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec3* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -272,7 +619,7 @@ bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec3* va
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec4* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -283,7 +630,7 @@ bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec4* va
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat2* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -294,7 +641,7 @@ bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat2* va
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat3* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -305,7 +652,7 @@ bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat3* va
 
 bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat4* value) {
 	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
+	int i = getUniform(name);
 	if (i < 0) {
 		printf("Shader uniform [%s] not found! Is it being used?\n", name);
 		return false;
@@ -344,6 +691,12 @@ void ShaderProgram::bindUniform(int ID, const glm::vec4& value) {
 	glUniform4f(ID, value.x, value.y, value.z, value.w);
 }
 
+void ShaderProgram::bindUniform(int ID, const glm::uvec2& value) {
+	assert(m_program > 0 && "Invalid shader program");
+	assert(ID >= 0 && "Invalid shader uniform");
+	glUniform2ui(ID, value.x, value.y);
+}
+
 void ShaderProgram::bindUniform(int ID, const glm::mat2& value) {
 	assert(m_program > 0 && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
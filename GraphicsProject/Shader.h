@@ -7,6 +7,9 @@
 #include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
 #include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
 
 namespace aie {
 
@@ -19,52 +22,153 @@ enum eShaderStage : unsigned int {
 	TESSELLATION_CONTROL,
 	GEOMETRY,
 	FRAGMENT,
+	COMPUTE,	// only linked on its own, needs GL 4.3
 
 	SHADER_STAGE_Count,
 };
 
+// uniforms read by OBJMesh materials. their locations are found once when a program is reflected
+enum eMaterialUniform : unsigned int {
+	MATERIAL_AMBIENT = 0,	// Ka
+	MATERIAL_DIFFUSE,		// Kd
+	MATERIAL_SPECULAR,		// Ks
+	MATERIAL_EMISSIVE,		// Ke
+	MATERIAL_OPACITY,		// opacity
+	MATERIAL_SPECULAR_POWER,// Ns
+
+	// textures are in the same order as their texture slots
+	MATERIAL_DIFFUSE_TEXTURE,
+	MATERIAL_ALPHA_TEXTURE,
+	MATERIAL_AMBIENT_TEXTURE,
+	MATERIAL_SPECULAR_TEXTURE,
+	MATERIAL_SPECULAR_HIGHLIGHT_TEXTURE,
+	MATERIAL_NORMAL_TEXTURE,
+	MATERIAL_DISPLACEMENT_TEXTURE,
+
+	MATERIAL_UNIFORM_Count,
+};
+
 // individual sharable shader stages
 class Shader {
 public:
 
-	Shader() : m_stage(0), m_handle(0), m_lastError(nullptr) {}
+	Shader() : m_stage(0), m_handle(0), m_lastError(nullptr), m_sourceHash(0) {}
 	Shader(unsigned int stage, const char* filename)
-		: m_stage(0), m_handle(0), m_lastError(nullptr) {
+		: m_stage(0), m_handle(0), m_lastError(nullptr), m_sourceHash(0) {
 		loadShader(stage, filename);
 	}
 	~Shader();
 
-	bool loadShader(unsigned int stage, const char* filename);
-	bool createShader(unsigned int stage, const char* string);
+	// each define is added as a "#define" line after the #version line, to make variants
+	bool loadShader(unsigned int stage, const char* filename, const std::vector<std::string>& defines = {});
+	bool createShader(unsigned int stage, const char* string, const std::vector<std::string>& defines = {});
+
+	// starts compiling without waiting for the result, use checkCompileStatus() or link the program to find out
+	// only returns false if the file could not be read
+	bool submitShader(unsigned int stage, const char* filename, const std::vector<std::string>& defines = {});
+
+	// queries the compile result, which waits for the compile to finish
+	bool checkCompileStatus();
+	// true once the driver has finished compiling. only avoids stalling when parallel compilation is supported
+	bool isCompileComplete() const;
+	// can contain warnings even if the compile succeeded
+	std::string getInfoLog() const;
 
 	unsigned int getStage() const { return m_stage; }
 	unsigned int getHandle() const { return m_handle; }
 
+	const std::string& getFilename() const { return m_filename; }
+	const std::vector<std::string>& getDefines() const { return m_defines; }
+	// hash of the source given to the driver, including defines
+	unsigned long long getSourceHash() const { return m_sourceHash; }
+
 	const char* getLastError() const { return m_lastError; }
 
 protected:
 
+	void compileSource(const std::string& source);
+	void setLastError(const std::string& error);
+
 	unsigned int	m_stage;
 	unsigned int	m_handle;
 	char*			m_lastError;
+
+	std::string					m_filename;
+	std::vector<std::string>	m_defines;
+	unsigned long long			m_sourceHash;
 };
 
 // combines shaders together into a single program for the GPU
 class ShaderProgram {
 public:
 
-	ShaderProgram() : m_program(0), m_lastError(nullptr) {
+	enum eLinkStatus : unsigned int {
+		NOT_LINKED = 0,
+		LINKING,		// submitted with linkAsync() and not finished yet
+		LINKED,
+		LINK_FAILED,
+	};
+
+	// reflection data, filled in after a successful link
+	struct UniformInfo {
+		std::string		name;		// arrays have their [0] removed
+		unsigned int	type;
+		int				location;	// -1 for uniforms inside a block
+		int				arraySize;
+		int				blockIndex;	// -1 for uniforms outside a block
+		int				blockOffset;
+		int				arrayStride;
+	};
+	struct UniformBlockInfo {
+		std::string		name;
+		int				index;
+		int				binding;
+		int				dataSize;
+	};
+	struct AttributeInfo {
+		std::string		name;
+		unsigned int	type;
+		int				location;
+		int				arraySize;
+	};
+
+	ShaderProgram() : m_program(0), m_status(NOT_LINKED), m_lastError(nullptr) {
 		m_shaders[0] = m_shaders[1] = m_shaders[2] = m_shaders[3] = m_shaders[4] = 0;
+		for (auto& location : m_materialUniforms)
+			location = -1;
 	}
 	~ShaderProgram();
 
-	bool loadShader(unsigned int stage, const char* filename);
-	bool createShader(unsigned int stage, const char* string);
+	bool loadShader(unsigned int stage, const char* filename, const std::vector<std::string>& defines = {});
+	bool createShader(unsigned int stage, const char* string, const std::vector<std::string>& defines = {});
 	void attachShader(const std::shared_ptr<Shader>& shader);
 
+	// compiles a stage without waiting, to be used with linkAsync()
+	bool submitShader(unsigned int stage, const char* filename, const std::vector<std::string>& defines = {});
+
+	// nullptr if the stage isn't used
+	const std::shared_ptr<Shader>& getShader(unsigned int stage) const { return m_shaders[stage]; }
+
 	bool link();
 
+	// submits the link without querying the result, which would force the driver to finish
+	void linkAsync();
+	// checks on an async link. when parallel compilation is supported this never stalls,
+	// otherwise it waits for the link to finish the first time it is called
+	eLinkStatus pollStatus();
+
+	// exchanges everything with another program, used to replace a program in place after it's been rebuilt
+	void swap(ShaderProgram& other);
+
+	eLinkStatus getStatus() const { return m_status; }
+	bool isReady() const { return m_status == LINKED; }
+
+	// true if the driver exposes GL_KHR_parallel_shader_compile (or the ARB version)
+	static bool hasParallelCompile();
+
 	const char* getLastError() const { return m_lastError; }
+	// can contain warnings even if the link succeeded
+	std::string getInfoLog() const;
 
 	void bind();
 
@@ -72,11 +176,31 @@ public:
 
 	int getUniform(const char* name);
 
+	// reflection tables, empty until the program has linked
+	const std::vector<UniformInfo>& getUniforms() const { return m_uniforms; }
+	const std::vector<UniformBlockInfo>& getUniformBlocks() const { return m_uniformBlocks; }
+	const std::vector<AttributeInfo>& getAttributes() const { return m_attributes; }
+	// indices in to getUniforms() of every sampler
+	const std::vector<unsigned int>& getSamplers() const { return m_samplers; }
+
+	// finds reflected data without calling in to opengl, nullptr if the program doesn't use it
+	const UniformInfo* findUniform(const char* name) const;
+	const UniformBlockInfo* findUniformBlock(const char* name) const;
+	const AttributeInfo* findAttribute(const char* name) const;
+	// true if the vertex stage reads from the attribute location
+	bool usesAttribute(int location) const;
+
+	// -1 if the program doesn't read the material uniform
+	int getMaterialUniform(eMaterialUniform uniform) const { return m_materialUniforms[uniform]; }
+	// true if the program reads any material uniform
+	bool usesMaterial() const { return m_usesMaterial; }
+
 	void bindUniform(int ID, int value);
 	void bindUniform(int ID, float value);
 	void bindUniform(int ID, const glm::vec2& value);
 	void bindUniform(int ID, const glm::vec3& value);
 	void bindUniform(int ID, const glm::vec4& value);
+	void bindUniform(int ID, const glm::uvec2& value);
 	void bindUniform(int ID, const glm::mat2& value);
 	void bindUniform(int ID, const glm::mat3& value);
 	void bindUniform(int ID, const glm::mat4& value);
@@ -109,11 +233,25 @@ public:
 
 private:
 
+	void storeLinkError();
+	// fills in the reflection tables and assigns material samplers to their texture slots
+	void reflect();
+
 	unsigned int	m_program;
+	eLinkStatus		m_status;
 
 	std::shared_ptr<Shader> m_shaders[eShaderStage::SHADER_STAGE_Count];
 
 	char*			m_lastError;
+
+	std::vector<UniformInfo>		m_uniforms;
+	std::vector<UniformBlockInfo>	m_uniformBlocks;
+	std::vector<AttributeInfo>		m_attributes;
+	std::vector<unsigned int>		m_samplers;
+	std::unordered_map<std::string, unsigned int> m_uniformLookup;
+
+	int		m_materialUniforms[MATERIAL_UNIFORM_Count];
+	bool	m_usesMaterial = false;
 };
 
 }
\ No newline at end of file
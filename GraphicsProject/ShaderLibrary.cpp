@@ -0,0 +1,404 @@
+#include "ShaderLibrary.h"
+#include "Shader.h"
+#include <cstdio>
+#include <glm/common.hpp>
+
+
+ShaderLibrary* ShaderLibrary::m_instance = nullptr;
+
+//the fallback only needs to be cheap and use the same inputs as the scene shaders
+static const char* fallbackVertexSource = R"(
+#version 420
+layout(location = 0) in vec4 Position;
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 ProjectionView;
+    vec4 CameraPosition;
+};
+uniform mat4 ModelMatrix;
+
+void main()
+{
+    gl_Position = ProjectionView * ModelMatrix * Position;
+}
+)";
+static const char* fallbackFragmentSource = R"(
+#version 420
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(0.6, 0.6, 0.6, 1);
+}
+)";
+
+
+void ShaderLibrary::create()
+{
+	m_instance = new ShaderLibrary();
+}
+
+void ShaderLibrary::destroy()
+{
+	delete m_instance;
+	m_instance = nullptr;
+}
+
+ShaderLibrary::ShaderLibrary()
+{
+	m_startTime = std::chrono::high_resolution_clock::now();
+	m_pendingCount = 0;
+	m_reloadCount = 0;
+
+	//the fallback is needed straight away, so it is compiled synchronously
+	m_fallback = new aie::ShaderProgram();
+	m_fallback->createShader(aie::eShaderStage::VERTEX, fallbackVertexSource);
+	m_fallback->createShader(aie::eShaderStage::FRAGMENT, fallbackFragmentSource);
+	if (!m_fallback->link())
+	{
+		printf("Fallback shader has an error: %s\n", m_fallback->getLastError());
+	}
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+	for (auto& entry : m_entries)
+	{
+		delete entry.m_program;
+		delete entry.m_reloadProgram;
+	}
+	delete m_fallback;
+}
+
+
+aie::ShaderProgram* ShaderLibrary::load(const std::string& a_name, const char* a_vertexPath, const char* a_fragmentPath, const std::vector<std::string>& a_defines)
+{
+	return submitProgram(a_name, { aie::eShaderStage::VERTEX, aie::eShaderStage::FRAGMENT }, { a_vertexPath, a_fragmentPath }, a_defines);
+}
+
+aie::ShaderProgram* ShaderLibrary::loadCompute(const std::string& a_name, const char* a_computePath, const std::vector<std::string>& a_defines)
+{
+	return submitProgram(a_name, { aie::eShaderStage::COMPUTE }, { a_computePath }, a_defines);
+}
+
+aie::ShaderProgram* ShaderLibrary::submitProgram(const std::string& a_name, const std::vector<unsigned int>& a_stages, const std::vector<const char*>& a_paths, const std::vector<std::string>& a_defines)
+{
+	Entry entry;
+	entry.m_reloadProgram = nullptr;
+	ProgramDiagnostics& diagnostics = entry.m_diagnostics;
+	diagnostics.m_name = a_name;
+	diagnostics.m_defines = a_defines;
+	diagnostics.m_submitStart = getElapsedMS();
+	diagnostics.m_readyTime = -1;
+	diagnostics.m_linkMS = 0;
+	diagnostics.m_linked = false;
+
+	//submit every stage and the link, none of which wait for the driver
+	entry.m_program = new aie::ShaderProgram();
+	for (unsigned int i = 0; i < a_stages.size(); i++)
+	{
+		StageDiagnostics stage;
+		entry.m_program->attachShader(getStage(a_stages[i], a_paths[i], a_defines, stage));
+		diagnostics.m_stages.push_back(stage);
+
+		std::string key = a_paths[i];
+		for (auto& define : a_defines)
+		{
+			key += "|" + define;
+		}
+		entry.m_stageKeys.push_back(key);
+
+		m_watcher.addFile(a_paths[i]);
+	}
+	entry.m_program->linkAsync();
+
+	diagnostics.m_submitEnd = getElapsedMS();
+
+	m_entries.push_back(entry);
+	m_pendingCount++;
+	return entry.m_program;
+}
+
+std::shared_ptr<aie::Shader> ShaderLibrary::getStage(unsigned int a_stage, const std::string& a_path, const std::vector<std::string>& a_defines, StageDiagnostics& a_diagnostics)
+{
+	a_diagnostics.m_stage = a_stage;
+	a_diagnostics.m_filename = a_path;
+	a_diagnostics.m_isComplete = false;
+	a_diagnostics.m_compiled = false;
+	a_diagnostics.m_compileMS = 0;
+	a_diagnostics.m_readyTime = -1;
+	a_diagnostics.m_submitMS = 0;
+
+	std::string key = a_path;
+	for (auto& define : a_defines)
+	{
+		key += "|" + define;
+	}
+
+	//programs using the same file and defines share the compiled stage
+	auto iter = m_stages.find(key);
+	if (iter == m_stages.end())
+	{
+		float start = getElapsedMS();
+		std::shared_ptr<aie::Shader> shader = std::make_shared<aie::Shader>();
+		shader->submitShader(a_stage, a_path.c_str(), a_defines);
+		a_diagnostics.m_submitMS = getElapsedMS() - start;
+
+		iter = m_stages.insert(std::make_pair(key, shader)).first;
+	}
+
+	a_diagnostics.m_sourceHash = iter->second->getSourceHash();
+	return iter->second;
+}
+
+void ShaderLibrary::update()
+{
+	//rebuild anything using a shader file that was edited
+	for (auto& path : m_watcher.getChangedFiles())
+	{
+		reloadFile(path);
+	}
+
+	if (m_pendingCount == 0 && m_reloadCount == 0)
+	{
+		return;
+	}
+
+	bool wasCompiling = m_pendingCount > 0;
+	for (auto& entry : m_entries)
+	{
+		if (entry.m_reloadProgram != nullptr)
+		{
+			pollStages(entry.m_reloadProgram, entry.m_reloadDiagnostics);
+			if (entry.m_reloadProgram->pollStatus() != aie::ShaderProgram::LINKING)
+			{
+				finishReload(entry);
+			}
+		}
+
+		if (entry.m_program->getStatus() != aie::ShaderProgram::LINKING)
+		{
+			continue;
+		}
+
+		pollStages(entry.m_program, entry.m_diagnostics);
+
+		//still compiling, check again next frame
+		if (entry.m_program->pollStatus() == aie::ShaderProgram::LINKING)
+		{
+			continue;
+		}
+
+		finishDiagnostics(entry.m_program, entry.m_diagnostics);
+		m_pendingCount--;
+	}
+
+	//report once everything submitted so far is done
+	if (wasCompiling && m_pendingCount == 0)
+	{
+		printTimeline();
+	}
+}
+
+void ShaderLibrary::pollStages(aie::ShaderProgram* a_program, ProgramDiagnostics& a_diagnostics)
+{
+	for (auto& stage : a_diagnostics.m_stages)
+	{
+		if (stage.m_isComplete)
+		{
+			continue;
+		}
+
+		//without parallel compilation this is always true, and the time is measured by the status query instead
+		const std::shared_ptr<aie::Shader>& shader = a_program->getShader(stage.m_stage);
+		if (shader->isCompileComplete())
+		{
+			float start = getElapsedMS();
+			stage.m_compiled = shader->checkCompileStatus();
+			stage.m_isComplete = true;
+			stage.m_readyTime = getElapsedMS();
+			//when serial, the status query is where the compile time is spent
+			stage.m_compileMS = aie::ShaderProgram::hasParallelCompile() ? stage.m_readyTime - a_diagnostics.m_submitStart : stage.m_readyTime - start;
+			stage.m_infoLog = shader->getInfoLog();
+		}
+	}
+}
+
+void ShaderLibrary::finishDiagnostics(aie::ShaderProgram* a_program, ProgramDiagnostics& a_diagnostics)
+{
+	//make sure every stage has a result, even if the link finished first
+	float lastStage = a_diagnostics.m_submitEnd;
+	for (auto& stage : a_diagnostics.m_stages)
+	{
+		if (!stage.m_isComplete)
+		{
+			stage.m_compiled = a_program->getShader(stage.m_stage)->checkCompileStatus();
+			stage.m_isComplete = true;
+			stage.m_readyTime = getElapsedMS();
+			stage.m_compileMS = stage.m_readyTime - a_diagnostics.m_submitStart;
+			stage.m_infoLog = a_program->getShader(stage.m_stage)->getInfoLog();
+		}
+		lastStage = glm::max(lastStage, stage.m_readyTime);
+	}
+
+	a_diagnostics.m_readyTime = getElapsedMS();
+	a_diagnostics.m_linkMS = glm::max(0.f, a_diagnostics.m_readyTime - lastStage);
+	a_diagnostics.m_linked = a_program->isReady();
+	a_diagnostics.m_linkLog = a_program->getInfoLog();
+
+	if (!a_diagnostics.m_linked)
+	{
+		printf("%s shader has an error: %s\n", a_diagnostics.m_name.c_str(), a_program->getLastError());
+	}
+}
+
+
+void ShaderLibrary::reloadFile(const std::string& a_path)
+{
+	//each variant of the file is only compiled once, even if several programs use it
+	std::unordered_map<std::string, std::shared_ptr<aie::Shader>> newStages;
+
+	for (auto& entry : m_entries)
+	{
+		bool usesFile = false;
+		for (auto& stage : entry.m_diagnostics.m_stages)
+		{
+			usesFile = usesFile || stage.m_filename == a_path;
+		}
+		if (!usesFile)
+		{
+			continue;
+		}
+
+		//a newer edit replaces a reload that hasn't finished yet
+		if (entry.m_reloadProgram != nullptr)
+		{
+			delete entry.m_reloadProgram;
+			m_reloadCount--;
+		}
+
+		ProgramDiagnostics& diagnostics = entry.m_reloadDiagnostics;
+		diagnostics = entry.m_diagnostics;
+		diagnostics.m_submitStart = getElapsedMS();
+		diagnostics.m_readyTime = -1;
+		diagnostics.m_linked = false;
+
+		//only the stages from the changed file are recompiled, the rest are reused
+		entry.m_reloadProgram = new aie::ShaderProgram();
+		for (unsigned int i = 0; i < diagnostics.m_stages.size(); i++)
+		{
+			StageDiagnostics& stage = diagnostics.m_stages[i];
+			const std::string& key = entry.m_stageKeys[i];
+			if (stage.m_filename != a_path)
+			{
+				entry.m_reloadProgram->attachShader(m_stages[key]);
+				continue;
+			}
+
+			auto iter = newStages.find(key);
+			if (iter == newStages.end())
+			{
+				float start = getElapsedMS();
+				std::shared_ptr<aie::Shader> shader = std::make_shared<aie::Shader>();
+				shader->submitShader(stage.m_stage, a_path.c_str(), diagnostics.m_defines);
+				stage.m_submitMS = getElapsedMS() - start;
+				iter = newStages.insert(std::make_pair(key, shader)).first;
+			}
+			else
+			{
+				stage.m_submitMS = 0;
+			}
+
+			stage.m_sourceHash = iter->second->getSourceHash();
+			stage.m_isComplete = false;
+			stage.m_compiled = false;
+			stage.m_readyTime = -1;
+			entry.m_reloadProgram->attachShader(iter->second);
+		}
+		entry.m_reloadProgram->linkAsync();
+		diagnostics.m_submitEnd = getElapsedMS();
+
+		m_reloadCount++;
+	}
+}
+
+void ShaderLibrary::finishReload(Entry& a_entry)
+{
+	finishDiagnostics(a_entry.m_reloadProgram, a_entry.m_reloadDiagnostics);
+
+	if (a_entry.m_reloadProgram->isReady())
+	{
+		//the program object stays the same, so everything holding a pointer to it sees the new version
+		bool wasLinking = a_entry.m_program->getStatus() == aie::ShaderProgram::LINKING;
+		a_entry.m_program->swap(*a_entry.m_reloadProgram);
+		a_entry.m_diagnostics = a_entry.m_reloadDiagnostics;
+		if (wasLinking)
+		{
+			m_pendingCount--;
+		}
+
+		//the new stages are now the last working versions
+		for (unsigned int i = 0; i < a_entry.m_diagnostics.m_stages.size(); i++)
+		{
+			m_stages[a_entry.m_stageKeys[i]] = a_entry.m_program->getShader(a_entry.m_diagnostics.m_stages[i].m_stage);
+		}
+
+		printf("Reloaded %s shader in %.2fms\n", a_entry.m_diagnostics.m_name.c_str(),
+			a_entry.m_diagnostics.m_readyTime - a_entry.m_diagnostics.m_submitStart);
+	}
+	else
+	{
+		printf("Keeping the last working %s shader\n", a_entry.m_diagnostics.m_name.c_str());
+	}
+
+	//after a swap this holds the old program
+	delete a_entry.m_reloadProgram;
+	a_entry.m_reloadProgram = nullptr;
+	m_reloadCount--;
+}
+
+aie::ShaderProgram* ShaderLibrary::getDrawable(aie::ShaderProgram* a_program) const
+{
+	return a_program->isReady() ? a_program : m_fallback;
+}
+
+
+void ShaderLibrary::printTimeline() const
+{
+	printf("--- Shader compile timeline (%s) ---\n", aie::ShaderProgram::hasParallelCompile() ? "parallel" : "serial");
+
+	float submitTotal = 0;
+	float finished = 0;
+	for (auto& entry : m_entries)
+	{
+		const ProgramDiagnostics& diagnostics = entry.m_diagnostics;
+		//time spent on the main thread submitting, and time until the program could be used
+		printf("%-16s submit %7.2fms - %7.2fms  ready %7.2fms  link %6.2fms  %s\n", diagnostics.m_name.c_str(),
+			diagnostics.m_submitStart, diagnostics.m_submitEnd, diagnostics.m_readyTime, diagnostics.m_linkMS,
+			diagnostics.m_linked ? "" : "(failed)");
+
+		submitTotal += diagnostics.m_submitEnd - diagnostics.m_submitStart;
+		if (diagnostics.m_readyTime > finished)
+		{
+			finished = diagnostics.m_readyTime;
+		}
+	}
+	printf("%d programs, %.2fms spent submitting, all ready after %.2fms\n", (int)m_entries.size(), submitTotal, finished);
+}
+
+const ShaderLibrary::ProgramDiagnostics* ShaderLibrary::findDiagnostics(const aie::ShaderProgram* a_program) const
+{
+	for (auto& entry : m_entries)
+	{
+		if (entry.m_program == a_program)
+		{
+			return &entry.m_diagnostics;
+		}
+	}
+	return nullptr;
+}
+
+float ShaderLibrary::getElapsedMS() const
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - m_startTime).count();
+}
\ No newline at end of file
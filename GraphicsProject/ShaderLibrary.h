@@ -0,0 +1,136 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Singleton that owns every shader program. Programs are compiled and linked without
+ *	waiting on the driver, then polled each frame until they are done. Until a program is
+ *	ready, a cheap fallback program is drawn with in its place. Compile and link results are
+ *	kept for every program so regressions in compile time or new warnings are easy to spot.
+ *	Shader files are watched for changes, and only the stages and programs using a changed
+ *	file are rebuilt. A rebuilt program replaces the old one between frames if it links.
+ */
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include "FileWatcher.h"
+
+namespace aie
+{
+	class Shader;
+	class ShaderProgram;
+}
+
+
+class ShaderLibrary
+{
+public:
+	// Compile results for one stage of a program
+	struct StageDiagnostics
+	{
+		unsigned int m_stage;
+		std::string m_filename;
+		unsigned long long m_sourceHash;
+
+		float m_submitMS;	//time spent submitting on the main thread
+		float m_compileMS;	//time from submitting until the driver finished, measured when polled
+		float m_readyTime;	//milliseconds since the library was created
+		bool m_isComplete;
+		bool m_compiled;
+		std::string m_infoLog;
+	};
+	// Compile and link results for a program
+	struct ProgramDiagnostics
+	{
+		std::string m_name;
+		std::vector<std::string> m_defines;
+		std::vector<StageDiagnostics> m_stages;
+
+		//times are in milliseconds since the library was created
+		float m_submitStart;
+		float m_submitEnd;
+		float m_readyTime;
+		//time from the last stage compiling until the program linked
+		float m_linkMS;
+		bool m_linked;
+		std::string m_linkLog;
+	};
+
+	static void create();
+	static void destroy();
+	static ShaderLibrary* getInstance() { return m_instance; }
+
+	// Submit a program for compilation without waiting for it. The library owns the program
+	// Defines are added to both stages to create a variant of the shader
+	aie::ShaderProgram* load(const std::string& a_name, const char* a_vertexPath, const char* a_fragmentPath, const std::vector<std::string>& a_defines = {});
+	// Submit a compute program, the same way as load()
+	aie::ShaderProgram* loadCompute(const std::string& a_name, const char* a_computePath, const std::vector<std::string>& a_defines = {});
+
+	// Check on programs that are still compiling and reload any changed shader files
+	// Called once per frame, before anything is drawn
+	void update();
+
+	// Get the program to draw with. This is the fallback until a_program has finished linking
+	aie::ShaderProgram* getDrawable(aie::ShaderProgram* a_program) const;
+	aie::ShaderProgram* getFallback() const { return m_fallback; }
+
+	// Are any programs still compiling?
+	bool isCompiling() const { return m_pendingCount > 0; }
+
+	// Print when each program was submitted and finished
+	void printTimeline() const;
+
+	// Compile results for every program, in the order they were loaded
+	const ProgramDiagnostics& getDiagnostics(unsigned int a_index) const { return m_entries[a_index].m_diagnostics; }
+	unsigned int getProgramCount() const { return (unsigned int)m_entries.size(); }
+	// Find the diagnostics for a program, nullptr if the library doesn't own it
+	const ProgramDiagnostics* findDiagnostics(const aie::ShaderProgram* a_program) const;
+
+protected:
+	ShaderLibrary();
+	~ShaderLibrary();
+
+	struct Entry
+	{
+		aie::ShaderProgram* m_program;
+		ProgramDiagnostics m_diagnostics;
+		// Key in to m_stages for each stage, in the same order as the diagnostics
+		std::vector<std::string> m_stageKeys;
+
+		// Rebuilt program that replaces m_program once it links, nullptr when not reloading
+		aie::ShaderProgram* m_reloadProgram;
+		ProgramDiagnostics m_reloadDiagnostics;
+	};
+
+	float getElapsedMS() const;
+	// Submit every stage of a new program and its link
+	aie::ShaderProgram* submitProgram(const std::string& a_name, const std::vector<unsigned int>& a_stages, const std::vector<const char*>& a_paths, const std::vector<std::string>& a_defines);
+	// Get a compiled stage, submitting it if no program has used it yet
+	std::shared_ptr<aie::Shader> getStage(unsigned int a_stage, const std::string& a_path, const std::vector<std::string>& a_defines, StageDiagnostics& a_diagnostics);
+	// Check on each stage of a program, recording when they finish compiling
+	void pollStages(aie::ShaderProgram* a_program, ProgramDiagnostics& a_diagnostics);
+	// Record the compile and link results once a program has finished
+	void finishDiagnostics(aie::ShaderProgram* a_program, ProgramDiagnostics& a_diagnostics);
+
+	// Recompile a changed file and relink every program that uses it
+	void reloadFile(const std::string& a_path);
+	// Swap in a reloaded program if it linked, otherwise keep the old one
+	void finishReload(Entry& a_entry);
+
+
+	static ShaderLibrary* m_instance;
+
+	std::vector<Entry> m_entries;
+	unsigned int m_pendingCount;
+	unsigned int m_reloadCount;
+
+	// Compiled stages, shared between programs. Keyed by file and defines
+	std::unordered_map<std::string, std::shared_ptr<aie::Shader>> m_stages;
+	FileWatcher m_watcher;
+
+	aie::ShaderProgram* m_fallback;
+	std::chrono::high_resolution_clock::time_point m_startTime;
+};
\ No newline at end of file
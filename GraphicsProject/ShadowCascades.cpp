@@ -0,0 +1,436 @@
+#include "ShadowCascades.h"
+#include "Scene.h"
+#include "ShaderLibrary.h"
+#include "Shader.h"
+#include <gl_core_4_4.h>
+#include <glm/ext.hpp>
+#include <algorithm>
+#include <chrono>
+
+//frames a caster must stay still before it's drawn in to the static tiles
+#define STATIC_FRAMES 60
+//how much bigger than the view's sphere a tile is made, so small camera movements don't move it
+#define CASCADE_MARGIN 1.25f
+//blend between logarithmic and even splits, more logarithmic puts more detail close to the camera
+#define SPLIT_LAMBDA 0.75f
+
+
+ShadowCascades::ShadowCascades()
+{
+	m_program = ShaderLibrary::getInstance()->load("Shadow Depth", "./shaders/shadow.vert", "./shaders/shadow.frag");
+	aie::PipelineState::Desc state;
+	state.blend = aie::PipelineState::BLEND_NONE;
+	state.depthClamp = true;
+	state.scissorTest = true;
+	state.offsetFactor = 2;
+	state.offsetUnits = 4;
+	m_state = aie::PipelineState(state);
+	m_active = false;
+	m_cachingEnabled = true;
+	m_shadowDistance = 100;
+	m_casterDistance = 100;
+
+	for (auto& cascade : m_cascades)
+	{
+		cascade.m_fitted = false;
+		cascade.m_staticValid = false;
+		cascade.m_dynamicCount = 0;
+	}
+	for (auto& matrix : m_matrices)
+	{
+		matrix = glm::mat4(0);
+	}
+	m_splits = glm::vec4(0);
+	m_texelSizes = glm::vec4(0);
+	m_lightDirection = glm::vec3(0);
+	m_layoutVersion = 0;
+	m_frameIndex = 1;
+
+	//the sampled atlas compares depths when filtered, giving a little softening for free
+	glGenTextures(1, &m_atlas);
+	glBindTexture(GL_TEXTURE_2D, m_atlas);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, SHADOW_TILE_SIZE * 2, SHADOW_TILE_SIZE * 2);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glGenTextures(1, &m_staticAtlas);
+	glBindTexture(GL_TEXTURE_2D, m_staticAtlas);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, SHADOW_TILE_SIZE * 2, SHADOW_TILE_SIZE * 2);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//depth only, so neither framebuffer has a color target
+	unsigned int atlases[] = { m_staticAtlas, m_atlas };
+	unsigned int* framebuffers[] = { &m_staticFramebuffer, &m_framebuffer };
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	for (int i = 0; i < 2; i++)
+	{
+		glGenFramebuffers(1, framebuffers[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, *framebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlases[i], 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("Shadow atlas framebuffer incomplete\n");
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+	//allocated once there are casters to draw
+	glGenBuffers(1, &m_instanceBuffer);
+	m_instanceCapacity = 0;
+	glGenBuffers(1, &m_commandBuffer);
+	m_commandCapacity = 0;
+
+	m_staticTileCount = 0;
+	m_dynamicTileCount = 0;
+	m_casterCount = 0;
+	m_drawCallCount = 0;
+	m_updateMS = 0;
+}
+
+ShadowCascades::~ShadowCascades()
+{
+	glDeleteTextures(1, &m_atlas);
+	glDeleteTextures(1, &m_staticAtlas);
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteFramebuffers(1, &m_staticFramebuffer);
+	glDeleteBuffers(1, &m_instanceBuffer);
+	glDeleteBuffers(1, &m_commandBuffer);
+}
+
+bool ShadowCascades::isReady() const
+{
+	return m_program->isReady();
+}
+
+
+void ShadowCascades::markMoved(const InstanceStore& a_instances, const std::vector<unsigned int>& a_moved)
+{
+	for (auto index : a_moved)
+	{
+		unsigned int slot = a_instances.getHandle(index).m_slot;
+		if (slot >= m_movedFrames.size())
+		{
+			m_movedFrames.resize(slot + 1, 0);
+		}
+
+		//a static caster is in the static tiles where it used to be, so they all need redrawing without it
+		if (!isDynamic(slot))
+		{
+			m_dynamicSlots.push_back(slot);
+			for (auto& cascade : m_cascades)
+			{
+				cascade.m_staticValid = false;
+			}
+		}
+		//the next update's frame
+		m_movedFrames[slot] = m_frameIndex + 1;
+	}
+}
+
+void ShadowCascades::update(const FrameContext& a_frame, const DirectionalLight* a_light, const InstanceStore& a_instances, const AABBTree& a_tree, const MeshPool& a_meshPool)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	m_frameIndex++;
+	m_staticTileCount = 0;
+	m_dynamicTileCount = 0;
+	m_casterCount = 0;
+	m_drawCallCount = 0;
+	m_active = a_light != nullptr && isReady();
+	if (!m_active)
+	{
+		m_updateMS = 0;
+		return;
+	}
+
+	//added and removed instances aren't reported as moving, so any change to the layout redraws everything
+	bool layoutChanged = m_layoutVersion != a_instances.getLayoutVersion();
+	m_layoutVersion = a_instances.getLayoutVersion();
+	const std::vector<AABB>& bounds = a_instances.getWorldBounds();
+
+	//casters that have settled join the static tiles they touch
+	for (unsigned int i = 0; i < m_dynamicSlots.size();)
+	{
+		unsigned int slot = m_dynamicSlots[i];
+		if (m_frameIndex - m_movedFrames[slot] < STATIC_FRAMES)
+		{
+			i++;
+			continue;
+		}
+		m_movedFrames[slot] = 0;
+		m_dynamicSlots[i] = m_dynamicSlots.back();
+		m_dynamicSlots.pop_back();
+
+		//removed instances leave their slot behind, but then the layout has changed anyway
+		unsigned int index = a_instances.getSlotIndex(slot);
+		if (!layoutChanged && index < a_instances.getCount() && a_instances.getHandle(index).m_slot == slot)
+		{
+			for (auto& cascade : m_cascades)
+			{
+				if (cascade.m_fitted && cascade.m_frustum.intersects(bounds[index]))
+				{
+					cascade.m_staticValid = false;
+				}
+			}
+		}
+	}
+
+	glm::vec3 direction = glm::normalize(a_light->m_direction);
+	bool lightChanged = direction != m_lightDirection;
+	m_lightDirection = direction;
+
+	//corners of the view on the near and far planes, whose edges are interpolated to find each cascade's corners
+	glm::vec3 nearCorners[4];
+	glm::vec3 farCorners[4];
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec2 ndc((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f);
+		glm::vec4 nearCorner = a_frame.m_inverseProjectionView * glm::vec4(ndc, -1, 1);
+		glm::vec4 farCorner = a_frame.m_inverseProjectionView * glm::vec4(ndc, 1, 1);
+		nearCorners[i] = glm::vec3(nearCorner) / nearCorner.w;
+		farCorners[i] = glm::vec3(farCorner) / farCorner.w;
+	}
+	float nearPlane = a_frame.m_nearPlane;
+	float farPlane = glm::min(m_shadowDistance, a_frame.m_farPlane);
+
+	m_passes.clear();
+	m_transforms.clear();
+	m_commands.clear();
+	const std::vector<unsigned int>& flags = a_instances.getFlags();
+	float splitNear = nearPlane;
+	for (unsigned int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+	{
+		Cascade& cascade = m_cascades[c];
+
+		float ratio = (c + 1) / (float)SHADOW_CASCADE_COUNT;
+		float splitFar = glm::mix(nearPlane + (farPlane - nearPlane) * ratio, nearPlane * glm::pow(farPlane / nearPlane, ratio), SPLIT_LAMBDA);
+		m_splits[c] = splitFar;
+
+		//sphere around the cascade's part of the view, which stays the same size however the camera turns
+		glm::vec3 corners[8];
+		glm::vec3 center(0);
+		for (int i = 0; i < 4; i++)
+		{
+			glm::vec3 edge = farCorners[i] - nearCorners[i];
+			corners[i] = nearCorners[i] + edge * ((splitNear - a_frame.m_nearPlane) / (a_frame.m_farPlane - a_frame.m_nearPlane));
+			corners[i + 4] = nearCorners[i] + edge * ((splitFar - a_frame.m_nearPlane) / (a_frame.m_farPlane - a_frame.m_nearPlane));
+			center += corners[i] + corners[i + 4];
+		}
+		center /= 8.f;
+		float radius = 0;
+		for (auto& corner : corners)
+		{
+			radius = glm::max(radius, glm::distance(center, corner));
+		}
+		splitNear = splitFar;
+
+		//the tile only moves once the sphere leaves the room it was given
+		if (!cascade.m_fitted || lightChanged || glm::distance(center, cascade.m_center) + radius > cascade.m_radius)
+		{
+			fit(cascade, center, radius * CASCADE_MARGIN);
+		}
+		if (layoutChanged || !m_cachingEnabled)
+		{
+			cascade.m_staticValid = false;
+		}
+
+		//from world space to the cascade's quarter of the atlas
+		glm::vec2 tile = glm::vec2(c % 2, c / 2) * 0.5f;
+		m_matrices[c] = glm::scale(glm::translate(glm::mat4(1), glm::vec3(tile + 0.25f, 0.5f)), glm::vec3(0.25f, 0.25f, 0.5f)) * cascade.m_projectionView;
+		m_texelSizes[c] = cascade.m_radius * 2 / SHADOW_TILE_SIZE;
+
+		//every caster touching the tile, split by whether it moved recently
+		m_queryResults.clear();
+		a_tree.queryFrustum(cascade.m_frustum, m_queryResults);
+		m_staticCasters.clear();
+		m_dynamicCasters.clear();
+		bool dynamicMoved = false;
+		for (auto slot : m_queryResults)
+		{
+			unsigned int index = a_instances.getSlotIndex(slot);
+			if ((flags[index] & INSTANCE_VISIBLE) == 0 || !cascade.m_frustum.intersects(bounds[index]))
+			{
+				continue;
+			}
+			if (isDynamic(slot))
+			{
+				m_dynamicCasters.push_back(index);
+				dynamicMoved = dynamicMoved || m_movedFrames[slot] == m_frameIndex;
+			}
+			else
+			{
+				m_staticCasters.push_back(index);
+			}
+		}
+
+		if (!m_cachingEnabled)
+		{
+			m_staticCasters.insert(m_staticCasters.end(), m_dynamicCasters.begin(), m_dynamicCasters.end());
+			addPass(c, false, false, m_staticCasters, a_instances, a_meshPool);
+			m_dynamicTileCount++;
+			continue;
+		}
+
+		bool staticDrawn = !cascade.m_staticValid;
+		if (staticDrawn)
+		{
+			addPass(c, true, false, m_staticCasters, a_instances, a_meshPool);
+			cascade.m_staticValid = true;
+			m_staticTileCount++;
+		}
+		//dynamic casters leaving the tile change the count, since they have to move to leave
+		if (staticDrawn || dynamicMoved || m_dynamicCasters.size() != cascade.m_dynamicCount)
+		{
+			addPass(c, false, true, m_dynamicCasters, a_instances, a_meshPool);
+			cascade.m_dynamicCount = (unsigned int)m_dynamicCasters.size();
+			m_dynamicTileCount++;
+		}
+	}
+
+	if (m_passes.empty())
+	{
+		m_updateMS = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return;
+	}
+
+	//casters are only known once every tile has been checked, so everything is uploaded at once
+	if (!m_transforms.empty())
+	{
+		unsigned int size = (unsigned int)(m_transforms.size() * sizeof(glm::mat4));
+		m_instanceCapacity = glm::max(m_instanceCapacity, size);
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, m_transforms.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		size = (unsigned int)(m_commands.size() * sizeof(DrawElementsIndirectCommand));
+		m_commandCapacity = glm::max(m_commandCapacity, size);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commandCapacity, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, m_commands.data());
+	}
+
+	GLint framebuffer;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	m_program->bind();
+	int lightProjectionView = m_program->getUniform("LightProjectionView");
+	a_meshPool.bindDepth(m_instanceBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	m_state.apply();
+	for (auto& pass : m_passes)
+	{
+		int x = (pass.m_cascade % 2) * SHADOW_TILE_SIZE;
+		int y = (pass.m_cascade / 2) * SHADOW_TILE_SIZE;
+		if (pass.m_copyStatic)
+		{
+			glCopyImageSubData(m_staticAtlas, GL_TEXTURE_2D, 0, x, y, 0, m_atlas, GL_TEXTURE_2D, 0, x, y, 0, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE, 1);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, pass.m_static ? m_staticFramebuffer : m_framebuffer);
+		glViewport(x, y, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+		glScissor(x, y, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+		if (!pass.m_copyStatic)
+		{
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		if (pass.m_commandCount > 0)
+		{
+			m_program->bindUniform(lightProjectionView, m_cascades[pass.m_cascade].m_projectionView);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(pass.m_firstCommand * sizeof(DrawElementsIndirectCommand)), pass.m_commandCount, 0);
+			m_drawCallCount++;
+		}
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	m_updateMS = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void ShadowCascades::bind() const
+{
+	glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_atlas);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+
+void ShadowCascades::fit(Cascade& a_cascade, const glm::vec3& a_center, float a_radius)
+{
+	//rounded up so texels stay the same size each time the tile moves
+	a_cascade.m_radius = glm::ceil(a_radius * 16) / 16;
+
+	//the center moves in whole texels across the light's view, so the texels of static casters line up
+	glm::vec3 up = glm::abs(m_lightDirection.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+	glm::mat4 rotation = glm::lookAt(glm::vec3(0), m_lightDirection, up);
+	float texelSize = a_cascade.m_radius * 2 / SHADOW_TILE_SIZE;
+	glm::vec3 lightCenter = glm::vec3(rotation * glm::vec4(a_center, 1));
+	lightCenter.x = glm::floor(lightCenter.x / texelSize) * texelSize;
+	lightCenter.y = glm::floor(lightCenter.y / texelSize) * texelSize;
+	a_cascade.m_center = glm::vec3(glm::transpose(rotation) * glm::vec4(lightCenter, 1));
+
+	//the light sits back far enough to see casters outside the sphere
+	float distance = a_cascade.m_radius + m_casterDistance;
+	glm::mat4 view = glm::lookAt(a_cascade.m_center - m_lightDirection * distance, a_cascade.m_center, up);
+	glm::mat4 projection = glm::ortho(-a_cascade.m_radius, a_cascade.m_radius, -a_cascade.m_radius, a_cascade.m_radius, 0.f, distance + a_cascade.m_radius);
+	a_cascade.m_projectionView = projection * view;
+	a_cascade.m_frustum = Frustum(a_cascade.m_projectionView);
+	a_cascade.m_fitted = true;
+	a_cascade.m_staticValid = false;
+}
+
+void ShadowCascades::addPass(unsigned int a_cascade, bool a_static, bool a_copyStatic, std::vector<unsigned int>& a_casters, const InstanceStore& a_instances, const MeshPool& a_meshPool)
+{
+	TilePass pass;
+	pass.m_cascade = a_cascade;
+	pass.m_static = a_static;
+	pass.m_copyStatic = a_copyStatic;
+	pass.m_firstCommand = (unsigned int)m_commands.size();
+
+	//casters sharing a mesh are drawn as one instanced command per chunk
+	const std::vector<unsigned short>& meshIDs = a_instances.getMeshIDs();
+	const std::vector<glm::mat4>& transforms = a_instances.getTransforms();
+	std::sort(a_casters.begin(), a_casters.end(), [&meshIDs](unsigned int a_left, unsigned int a_right) { return meshIDs[a_left] < meshIDs[a_right]; });
+	for (unsigned int i = 0; i < a_casters.size();)
+	{
+		unsigned short meshID = meshIDs[a_casters[i]];
+		unsigned int baseInstance = (unsigned int)m_transforms.size();
+		for (; i < a_casters.size() && meshIDs[a_casters[i]] == meshID; i++)
+		{
+			m_transforms.push_back(transforms[a_casters[i]]);
+		}
+
+		//meshes are pooled when their batch is first built, anything newer waits a frame
+		aie::OBJMesh* mesh = a_instances.getMesh(meshID);
+		if (!a_meshPool.contains(mesh))
+		{
+			m_transforms.resize(baseInstance);
+			continue;
+		}
+		unsigned int instanceCount = (unsigned int)m_transforms.size() - baseInstance;
+		for (unsigned int chunk = 0; chunk < mesh->getChunkCount(); chunk++)
+		{
+			m_commands.push_back(a_meshPool.getDrawCommand(mesh, chunk, instanceCount, baseInstance));
+		}
+		m_casterCount += instanceCount;
+	}
+
+	pass.m_commandCount = (unsigned int)m_commands.size() - pass.m_firstCommand;
+	m_passes.push_back(pass);
+}
+
+bool ShadowCascades::isDynamic(unsigned int a_slot) const
+{
+	return a_slot < m_movedFrames.size() && m_movedFrames[a_slot] != 0;
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Cascaded shadow maps for one directional light. The camera's view is split in to depth
+ *	ranges, and each is covered by an orthographic tile of a shadow atlas, fitted around a
+ *	sphere bounding the range with some room to spare. Tiles only move once the view leaves
+ *	that room, so most frames nothing needs redrawing. Casters that haven't moved recently
+ *	are static, and drawn in to a persistent static atlas only when their tile moves, the
+ *	light turns, or the static casters change. Recently moved casters are dynamic, and are
+ *	drawn over a copy of the static tile whenever any of them move. Casters are drawn
+ *	depth only from the mesh pool's position stream, one multi draw per tile.
+ */
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "MeshPool.h"
+#include "PipelineState.h"
+
+struct FrameContext;
+struct DirectionalLight;
+class InstanceStore;
+class AABBTree;
+namespace aie
+{
+	class ShaderProgram;
+}
+
+// Must match SHADOW_CASCADE_COUNT in the lit shaders, which also expect the tiles in a 2x2 grid
+#define SHADOW_CASCADE_COUNT 4
+// Size of each cascade's tile in texels
+#define SHADOW_TILE_SIZE 1024
+// Texture unit the atlas is bound to for the lit shaders
+#define SHADOW_TEXTURE_UNIT 8
+
+
+class ShadowCascades
+{
+public:
+	ShadowCascades();
+	~ShadowCascades();
+
+	// The depth program is compiled through the shader library, nothing is drawn until it links
+	bool isReady() const;
+
+	// Record instances whose bounds changed, by index in a_instances. Called before the tree forgets them
+	void markMoved(const InstanceStore& a_instances, const std::vector<unsigned int>& a_moved);
+	// Fit the cascades to a_frame's view and redraw the tiles whose casters or light changed
+	// Does nothing if a_light is nullptr. Leaves the framebuffer and viewport as they were
+	void update(const FrameContext& a_frame, const DirectionalLight* a_light, const InstanceStore& a_instances, const AABBTree& a_tree, const MeshPool& a_meshPool);
+	// Bind the atlas to SHADOW_TEXTURE_UNIT
+	void bind() const;
+
+	// Were shadows drawn by the last update?
+	bool isActive() const { return m_active; }
+	// World space to each cascade's tile of the atlas, with depth from 0 to 1
+	const glm::mat4* getMatrices() const { return m_matrices; }
+	// View depth each cascade reaches
+	glm::vec4 getSplits() const { return m_splits; }
+	// World space size of a texel in each cascade, used to offset lookups along the normal
+	glm::vec4 getTexelSizes() const { return m_texelSizes; }
+
+	// Only shadows within this view depth are drawn. The cascades are spread over it
+	void setShadowDistance(float a_distance) { m_shadowDistance = a_distance; }
+	float getShadowDistance() const { return m_shadowDistance; }
+	// With caching off every tile is redrawn with every caster each frame, to compare against
+	void setCachingEnabled(bool a_enabled) { m_cachingEnabled = a_enabled; }
+	bool isCachingEnabled() const { return m_cachingEnabled; }
+
+	///stats of the last update
+	// Tiles drawn in to the static atlas, and tiles composed from a static tile and the dynamic casters
+	unsigned int getStaticTileCount() const { return m_staticTileCount; }
+	unsigned int getDynamicTileCount() const { return m_dynamicTileCount; }
+	// Caster instances drawn in every tile combined, and the multi draws they took
+	unsigned int getCasterCount() const { return m_casterCount; }
+	unsigned int getDrawCallCount() const { return m_drawCallCount; }
+	// Instances that moved recently enough to be drawn as dynamic casters
+	unsigned int getDynamicCasterCount() const { return (unsigned int)m_dynamicSlots.size(); }
+	float getUpdateTime() const { return m_updateMS; }
+
+protected:
+	struct Cascade
+	{
+		// Sphere the tile covers, which the cascade's part of the view must stay inside
+		glm::vec3 m_center;
+		float m_radius;
+		bool m_fitted;
+		glm::mat4 m_projectionView;
+		Frustum m_frustum;
+		// Is the tile in the static atlas up to date?
+		bool m_staticValid;
+		// Dynamic casters drawn in to the tile the last time it was composed
+		unsigned int m_dynamicCount;
+	};
+	// Casters drawn in to one tile, as a range of m_commands
+	struct TilePass
+	{
+		unsigned int m_cascade;
+		// Drawn in to the static atlas instead of the sampled one
+		bool m_static;
+		// Start from a copy of the static tile instead of clearing
+		bool m_copyStatic;
+		unsigned int m_firstCommand;
+		unsigned int m_commandCount;
+	};
+
+	// Move a cascade's tile to cover a sphere, snapping to whole texels so static edges don't shimmer
+	void fit(Cascade& a_cascade, const glm::vec3& a_center, float a_radius);
+	// Add a pass drawing a_casters, by index in a_instances, grouped by mesh
+	void addPass(unsigned int a_cascade, bool a_static, bool a_copyStatic, std::vector<unsigned int>& a_casters, const InstanceStore& a_instances, const MeshPool& a_meshPool);
+	// Has the instance in a slot moved recently?
+	bool isDynamic(unsigned int a_slot) const;
+
+
+	aie::ShaderProgram* m_program;
+	// Casters between the light and a tile are flattened on to its near plane instead of clipped, and
+	// drawing is kept inside the tile
+	aie::PipelineState m_state;
+	bool m_active;
+	bool m_cachingEnabled;
+	float m_shadowDistance;
+	// How far towards the light casters are searched for past a tile's sphere
+	float m_casterDistance;
+
+	Cascade m_cascades[SHADOW_CASCADE_COUNT];
+	glm::mat4 m_matrices[SHADOW_CASCADE_COUNT];
+	glm::vec4 m_splits;
+	glm::vec4 m_texelSizes;
+	glm::vec3 m_lightDirection;
+	// Instance layout version the static tiles were drawn with, adding or removing instances changes it
+	unsigned int m_layoutVersion;
+
+	///caster tracking, by instance slot
+	// Frame each slot last moved in, 0 if it hasn't moved or has settled since
+	std::vector<unsigned int> m_movedFrames;
+	std::vector<unsigned int> m_dynamicSlots;
+	unsigned int m_frameIndex;
+
+	///draw data, kept to reuse their memory
+	std::vector<TilePass> m_passes;
+	std::vector<glm::mat4> m_transforms;
+	std::vector<DrawElementsIndirectCommand> m_commands;
+	std::vector<unsigned int> m_queryResults;
+	std::vector<unsigned int> m_staticCasters;
+	std::vector<unsigned int> m_dynamicCasters;
+
+	///gl objects
+	// Static casters only, copied in to the sampled atlas before dynamic casters are drawn over them
+	unsigned int m_staticAtlas;
+	unsigned int m_atlas;
+	unsigned int m_staticFramebuffer;
+	unsigned int m_framebuffer;
+	unsigned int m_instanceBuffer;
+	unsigned int m_instanceCapacity;
+	unsigned int m_commandBuffer;
+	unsigned int m_commandCapacity;
+
+	unsigned int m_staticTileCount;
+	unsigned int m_dynamicTileCount;
+	unsigned int m_casterCount;
+	unsigned int m_drawCallCount;
+	float m_updateMS;
+};
\ No newline at end of file
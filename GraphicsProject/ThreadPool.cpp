@@ -0,0 +1,119 @@
+#include "ThreadPool.h"
+
+
+ThreadPool::ThreadPool(unsigned int a_threadCount)
+{
+	m_job = nullptr;
+	m_jobID = 0;
+	m_runningCount = 0;
+	m_stopping = false;
+	startWorkers(a_threadCount);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stopWorkers();
+}
+
+
+void ThreadPool::run(const std::function<void(unsigned int)>& a_job)
+{
+	if (m_workers.empty())
+	{
+		a_job(0);
+		return;
+	}
+
+	//hand the job to every worker
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &a_job;
+		m_jobID++;
+		m_runningCount = (unsigned int)m_workers.size();
+	}
+	m_jobReady.notify_all();
+
+	//this thread does its share instead of waiting
+	a_job(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_jobDone.wait(lock, [this]() { return m_runningCount == 0; });
+	m_job = nullptr;
+}
+
+void ThreadPool::setThreadCount(unsigned int a_threadCount)
+{
+	unsigned int count = a_threadCount == 0 ? getCoreCount() : a_threadCount;
+	if (count == getThreadCount())
+	{
+		return;
+	}
+
+	stopWorkers();
+	startWorkers(count);
+}
+
+unsigned int ThreadPool::getCoreCount()
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores == 0 ? 1 : cores;
+}
+
+
+void ThreadPool::startWorkers(unsigned int a_threadCount)
+{
+	unsigned int count = a_threadCount == 0 ? getCoreCount() : a_threadCount;
+	m_stopping = false;
+	//the calling thread is thread 0, so one less worker is needed
+	for (unsigned int i = 1; i < count; i++)
+	{
+		m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, i, m_jobID));
+	}
+}
+
+void ThreadPool::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobReady.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+void ThreadPool::workerLoop(unsigned int a_threadIndex, unsigned int a_lastJob)
+{
+	unsigned int lastJob = a_lastJob;
+	while (true)
+	{
+		const std::function<void(unsigned int)>* job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobReady.wait(lock, [this, lastJob]() { return m_stopping || m_jobID != lastJob; });
+			if (m_stopping)
+			{
+				return;
+			}
+			lastJob = m_jobID;
+			job = m_job;
+		}
+
+		(*job)(a_threadIndex);
+
+		//the last worker to finish wakes the calling thread
+		bool finished;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			finished = --m_runningCount == 0;
+		}
+		if (finished)
+		{
+			m_jobDone.notify_one();
+		}
+	}
+}
\ No newline at end of file
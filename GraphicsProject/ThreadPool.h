@@ -0,0 +1,56 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Fixed set of worker threads for splitting a job across cores. run() hands the same job
+ *	to every thread, including the calling one, and returns once they have all finished.
+ */
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+
+class ThreadPool
+{
+public:
+	// a_threadCount includes the calling thread, 0 uses every core
+	ThreadPool(unsigned int a_threadCount = 0);
+	~ThreadPool();
+
+	// Run a_job(threadIndex) on every thread and wait for all of them to finish
+	// The calling thread is thread 0
+	void run(const std::function<void(unsigned int)>& a_job);
+
+	// Replace the workers with a new number of threads, 0 uses every core
+	void setThreadCount(unsigned int a_threadCount);
+	unsigned int getThreadCount() const { return (unsigned int)m_workers.size() + 1; }
+
+	// Number of cores, or 1 if it can't be found
+	static unsigned int getCoreCount();
+
+protected:
+	void startWorkers(unsigned int a_threadCount);
+	void stopWorkers();
+	// Wait for jobs newer than a_lastJob and run them until the pool is stopped
+	// The starting job is passed in so a job submitted before the thread starts isn't missed
+	void workerLoop(unsigned int a_threadIndex, unsigned int a_lastJob);
+
+
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	// Signals workers that a job has started, or that they should stop
+	std::condition_variable m_jobReady;
+	// Signals the calling thread that the last worker has finished
+	std::condition_variable m_jobDone;
+
+	const std::function<void(unsigned int)>* m_job;
+	// Incremented for each job, so workers can tell a new job from the one they just finished
+	unsigned int m_jobID;
+	unsigned int m_runningCount;
+	bool m_stopping;
+};
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+//depths with fewer dirty nodes than this aren't worth waking the workers for
+#define PARALLEL_NODE_COUNT 512
+
+
+TransformHierarchy::TransformHierarchy()
+{
+}
+
+unsigned int TransformHierarchy::create(const glm::vec3& a_position, const glm::quat& a_rotation, const glm::vec3& a_scale, unsigned int a_parent)
+{
+	unsigned int node;
+	if (!m_freeNodes.empty())
+	{
+		node = m_freeNodes.back();
+		m_freeNodes.pop_back();
+	}
+	else
+	{
+		node = (unsigned int)m_flags.size();
+		m_positions.emplace_back();
+		m_rotations.emplace_back();
+		m_scales.emplace_back();
+		m_worldMatrices.emplace_back();
+		m_parents.push_back(NO_NODE);
+		m_firstChildren.push_back(NO_NODE);
+		m_nextSiblings.push_back(NO_NODE);
+		m_depths.push_back(0);
+		m_flags.push_back(0);
+	}
+
+	m_positions[node] = a_position;
+	m_rotations[node] = a_rotation;
+	m_scales[node] = a_scale;
+	m_worldMatrices[node] = glm::mat4(1);
+	m_parents[node] = NO_NODE;
+	m_firstChildren[node] = NO_NODE;
+	m_nextSiblings[node] = NO_NODE;
+	m_depths[node] = 0;
+	m_flags[node] = NODE_ALIVE;
+
+	//linking to the parent also sets the depth and marks the node dirty
+	if (!setParent(node, a_parent))
+	{
+		setParent(node, NO_NODE);
+	}
+	return node;
+}
+
+void TransformHierarchy::destroy(unsigned int a_node)
+{
+	if (!isValid(a_node))
+	{
+		return;
+	}
+
+	unlink(a_node);
+	m_subtree.clear();
+	getSubtree(a_node, m_subtree);
+	for (auto node : m_subtree)
+	{
+		clearDirty(node);
+		m_flags[node] = 0;
+		m_freeNodes.push_back(node);
+	}
+}
+
+bool TransformHierarchy::setParent(unsigned int a_node, unsigned int a_parent)
+{
+	//a node can't be moved under itself
+	for (unsigned int ancestor = a_parent; ancestor != NO_NODE; ancestor = m_parents[ancestor])
+	{
+		if (ancestor == a_node)
+		{
+			return false;
+		}
+	}
+	if (a_parent != NO_NODE && !isValid(a_parent))
+	{
+		return false;
+	}
+
+	//dirty nodes are queued by depth, so they are taken out while the depths change
+	unlink(a_node);
+	m_subtree.clear();
+	getSubtree(a_node, m_subtree);
+	for (auto node : m_subtree)
+	{
+		clearDirty(node);
+	}
+
+	m_parents[a_node] = a_parent;
+	if (a_parent != NO_NODE)
+	{
+		m_nextSiblings[a_node] = m_firstChildren[a_parent];
+		m_firstChildren[a_parent] = a_node;
+	}
+
+	//the subtree is listed parents first, so each parent's depth is set before its children's
+	for (auto node : m_subtree)
+	{
+		m_depths[node] = m_parents[node] == NO_NODE ? 0 : m_depths[m_parents[node]] + 1;
+	}
+
+	//the whole subtree is recalculated from its root
+	markDirty(a_node);
+	return true;
+}
+
+void TransformHierarchy::setLocal(unsigned int a_node, const glm::vec3& a_position, const glm::quat& a_rotation, const glm::vec3& a_scale)
+{
+	m_positions[a_node] = a_position;
+	m_rotations[a_node] = a_rotation;
+	m_scales[a_node] = a_scale;
+	markDirty(a_node);
+}
+
+
+void TransformHierarchy::update(ThreadPool* a_threadPool)
+{
+	m_changed.clear();
+	for (unsigned int level = 0; level < m_dirtyLevels.size(); level++)
+	{
+		if (m_dirtyLevels[level].empty())
+		{
+			continue;
+		}
+		//the next level is made before taking a reference, since growing the outer vector would move this one
+		if (m_dirtyLevels.size() < level + 2)
+		{
+			m_dirtyLevels.resize(level + 2);
+		}
+		std::vector<unsigned int>& nodes = m_dirtyLevels[level];
+		std::vector<unsigned int>& nextNodes = m_dirtyLevels[level + 1];
+
+		//every parent is already done, so nodes at the same depth can be updated in any order
+		if (a_threadPool != nullptr && nodes.size() >= PARALLEL_NODE_COUNT)
+		{
+			unsigned int threadCount = a_threadPool->getThreadCount();
+			a_threadPool->run([&](unsigned int a_thread)
+			{
+				size_t begin = nodes.size() * a_thread / threadCount;
+				size_t end = nodes.size() * (a_thread + 1) / threadCount;
+				for (size_t i = begin; i < end; i++)
+				{
+					updateNode(nodes[i]);
+				}
+			});
+		}
+		else
+		{
+			for (auto node : nodes)
+			{
+				updateNode(node);
+			}
+		}
+
+		//children of every changed node change too
+		for (auto node : nodes)
+		{
+			m_flags[node] &= ~NODE_DIRTY;
+			m_changed.push_back(node);
+			for (unsigned int child = m_firstChildren[node]; child != NO_NODE; child = m_nextSiblings[child])
+			{
+				if ((m_flags[child] & NODE_DIRTY) == 0)
+				{
+					m_flags[child] |= NODE_DIRTY;
+					nextNodes.push_back(child);
+				}
+			}
+		}
+		nodes.clear();
+	}
+}
+
+void TransformHierarchy::updateNode(unsigned int a_node)
+{
+	glm::mat4 local = compose(m_positions[a_node], m_rotations[a_node], m_scales[a_node]);
+	unsigned int parent = m_parents[a_node];
+	m_worldMatrices[a_node] = parent == NO_NODE ? local : multiplyAffine(m_worldMatrices[parent], local);
+}
+
+
+void TransformHierarchy::markDirty(unsigned int a_node)
+{
+	if ((m_flags[a_node] & NODE_DIRTY) != 0)
+	{
+		return;
+	}
+	m_flags[a_node] |= NODE_DIRTY;
+	if (m_dirtyLevels.size() <= m_depths[a_node])
+	{
+		m_dirtyLevels.resize(m_depths[a_node] + 1);
+	}
+	m_dirtyLevels[m_depths[a_node]].push_back(a_node);
+}
+
+void TransformHierarchy::clearDirty(unsigned int a_node)
+{
+	if ((m_flags[a_node] & NODE_DIRTY) == 0)
+	{
+		return;
+	}
+	m_flags[a_node] &= ~NODE_DIRTY;
+	std::vector<unsigned int>& nodes = m_dirtyLevels[m_depths[a_node]];
+	nodes.erase(std::find(nodes.begin(), nodes.end(), a_node));
+}
+
+void TransformHierarchy::unlink(unsigned int a_node)
+{
+	unsigned int parent = m_parents[a_node];
+	if (parent == NO_NODE)
+	{
+		return;
+	}
+
+	//walk the sibling list to the link pointing at this node
+	unsigned int* link = &m_firstChildren[parent];
+	while (*link != a_node)
+	{
+		link = &m_nextSiblings[*link];
+	}
+	*link = m_nextSiblings[a_node];
+	m_nextSiblings[a_node] = NO_NODE;
+	m_parents[a_node] = NO_NODE;
+}
+
+void TransformHierarchy::getSubtree(unsigned int a_node, std::vector<unsigned int>& a_nodes) const
+{
+	//breadth first, so parents are always listed before their children
+	size_t first = a_nodes.size();
+	a_nodes.push_back(a_node);
+	for (size_t i = first; i < a_nodes.size(); i++)
+	{
+		for (unsigned int child = m_firstChildren[a_nodes[i]]; child != NO_NODE; child = m_nextSiblings[child])
+		{
+			a_nodes.push_back(child);
+		}
+	}
+}
+
+
+glm::mat4 TransformHierarchy::compose(const glm::vec3& a_position, const glm::quat& a_rotation, const glm::vec3& a_scale)
+{
+	//rotation matrix columns from the quaternion, each multiplied by its axis' scale
+	float xx = a_rotation.x * a_rotation.x;
+	float yy = a_rotation.y * a_rotation.y;
+	float zz = a_rotation.z * a_rotation.z;
+	float xy = a_rotation.x * a_rotation.y;
+	float xz = a_rotation.x * a_rotation.z;
+	float yz = a_rotation.y * a_rotation.z;
+	float wx = a_rotation.w * a_rotation.x;
+	float wy = a_rotation.w * a_rotation.y;
+	float wz = a_rotation.w * a_rotation.z;
+
+	glm::mat4 result;
+	result[0] = glm::vec4(1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0) * a_scale.x;
+	result[1] = glm::vec4(2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0) * a_scale.y;
+	result[2] = glm::vec4(2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0) * a_scale.z;
+	result[3] = glm::vec4(a_position, 1);
+	return result;
+}
+
+glm::mat4 TransformHierarchy::multiplyAffine(const glm::mat4& a_parent, const glm::mat4& a_child)
+{
+	//the bottom rows are known, so only the upper 3x4 is multiplied. The parent's w column
+	//is 0 for the first three, so the results keep their 0 and 1 bottom rows
+	glm::mat4 result;
+	for (int i = 0; i < 4; i++)
+	{
+		result[i] = a_parent[0] * a_child[i].x + a_parent[1] * a_child[i].y + a_parent[2] * a_child[i].z;
+	}
+	result[3] += a_parent[3];
+	return result;
+}
+
+glm::quat TransformHierarchy::fromEulerAngles(const glm::vec3& a_degrees)
+{
+	glm::vec3 radians = glm::radians(a_degrees);
+	return glm::angleAxis(radians.z, glm::vec3(0, 0, 1)) * glm::angleAxis(radians.y, glm::vec3(0, 1, 0)) * glm::angleAxis(radians.x, glm::vec3(1, 0, 0));
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Parent and child transforms stored as position, rotation, and scale. Editing a node only
+ *	marks it dirty, and update() recalculates the world matrices of dirty nodes and their
+ *	children one depth at a time, so every parent is finished before its children read it.
+ *	Nodes at the same depth don't depend on each other and can be split between threads.
+ *	Matrices are built straight from position, rotation, and scale, and only the affine part
+ *	is multiplied with the parent's.
+ */
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class ThreadPool;
+
+// Parent of nodes at the root of the hierarchy
+#define NO_NODE 0xffffffff
+
+
+class TransformHierarchy
+{
+public:
+	TransformHierarchy();
+	~TransformHierarchy() {};
+
+	// Add a node, returning its ID. IDs of destroyed nodes are reused
+	unsigned int create(const glm::vec3& a_position = glm::vec3(0), const glm::quat& a_rotation = glm::quat(1, 0, 0, 0), const glm::vec3& a_scale = glm::vec3(1),
+		unsigned int a_parent = NO_NODE);
+	// Remove a node and all of its children
+	void destroy(unsigned int a_node);
+	bool isValid(unsigned int a_node) const { return a_node < m_flags.size() && (m_flags[a_node] & NODE_ALIVE) != 0; }
+
+	// Move a node and its children under a new parent, or to the root with NO_NODE
+	// Returns false if a_parent is the node or one of its children
+	bool setParent(unsigned int a_node, unsigned int a_parent);
+	unsigned int getParent(unsigned int a_node) const { return m_parents[a_node]; }
+	// Children are linked through their siblings, ending with NO_NODE
+	unsigned int getFirstChild(unsigned int a_node) const { return m_firstChildren[a_node]; }
+	unsigned int getNextSibling(unsigned int a_node) const { return m_nextSiblings[a_node]; }
+	unsigned int getDepth(unsigned int a_node) const { return m_depths[a_node]; }
+
+	///local transform, relative to the parent
+	const glm::vec3& getPosition(unsigned int a_node) const { return m_positions[a_node]; }
+	const glm::quat& getRotation(unsigned int a_node) const { return m_rotations[a_node]; }
+	const glm::vec3& getScale(unsigned int a_node) const { return m_scales[a_node]; }
+	void setPosition(unsigned int a_node, const glm::vec3& a_position) { m_positions[a_node] = a_position; markDirty(a_node); }
+	void setRotation(unsigned int a_node, const glm::quat& a_rotation) { m_rotations[a_node] = a_rotation; markDirty(a_node); }
+	void setScale(unsigned int a_node, const glm::vec3& a_scale) { m_scales[a_node] = a_scale; markDirty(a_node); }
+	void setLocal(unsigned int a_node, const glm::vec3& a_position, const glm::quat& a_rotation, const glm::vec3& a_scale);
+
+	// Recalculate the world matrices of dirty nodes and their children
+	// Depths with enough dirty nodes are split between a_threadPool's threads if it isn't nullptr
+	void update(ThreadPool* a_threadPool = nullptr);
+	// World matrix as of the last update
+	const glm::mat4& getWorldMatrix(unsigned int a_node) const { return m_worldMatrices[a_node]; }
+	// Nodes whose world matrix was recalculated by the last update, parents before children
+	const std::vector<unsigned int>& getChanged() const { return m_changed; }
+	// Number of node IDs in use or free, every ID is less than this
+	unsigned int getCapacity() const { return (unsigned int)m_flags.size(); }
+
+	// Matrix that scales, then rotates, then translates, without multiplying matrices
+	static glm::mat4 compose(const glm::vec3& a_position, const glm::quat& a_rotation, const glm::vec3& a_scale);
+	// a_parent * a_child for matrices whose bottom rows are 0, 0, 0, 1
+	static glm::mat4 multiplyAffine(const glm::mat4& a_parent, const glm::mat4& a_child);
+	// Rotation around z, then y, then x, in degrees. The same order Instance::createTransform has always used
+	static glm::quat fromEulerAngles(const glm::vec3& a_degrees);
+
+protected:
+	enum NodeFlags : unsigned char
+	{
+		NODE_ALIVE = 1 << 0,
+		// In m_dirtyLevels, waiting for its world matrix to be recalculated
+		NODE_DIRTY = 1 << 1
+	};
+
+	// Queue a node to be recalculated at its depth, if it isn't already
+	void markDirty(unsigned int a_node);
+	// Take a dirty node back out of its depth's queue
+	void clearDirty(unsigned int a_node);
+	// Remove a node from its parent's children
+	void unlink(unsigned int a_node);
+	// Add every node under a_node, including itself, to a_nodes
+	void getSubtree(unsigned int a_node, std::vector<unsigned int>& a_nodes) const;
+	// Recalculate a single node's world matrix from its parent's
+	void updateNode(unsigned int a_node);
+
+
+	///per node arrays, indexed by ID
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::quat> m_rotations;
+	std::vector<glm::vec3> m_scales;
+	std::vector<glm::mat4> m_worldMatrices;
+	std::vector<unsigned int> m_parents;
+	std::vector<unsigned int> m_firstChildren;
+	std::vector<unsigned int> m_nextSiblings;
+	std::vector<unsigned int> m_depths;
+	std::vector<unsigned char> m_flags;
+
+	std::vector<unsigned int> m_freeNodes;
+	// Dirty nodes at each depth. Kept between updates to reuse their memory
+	std::vector<std::vector<unsigned int>> m_dirtyLevels;
+	std::vector<unsigned int> m_changed;
+	// Kept to reuse its memory when walking subtrees
+	std::vector<unsigned int> m_subtree;
+};
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "UniformBuffer.h"
+#include <gl_core_4_4.h>
+#include <cstring>
+
+
+UniformBuffer::UniformBuffer(unsigned int a_bindingPoint, unsigned int a_size)
+{
+	m_bindingPoint = a_bindingPoint;
+	m_size = a_size;
+	m_lastData.resize(a_size);
+	m_hasData = false;
+
+	//create the buffer with enough storage for the whole block
+	glGenBuffers(1, &m_handle);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_handle);
+	glBufferData(GL_UNIFORM_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	//binding points are fixed, so this only needs to be done once
+	bind();
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	glDeleteBuffers(1, &m_handle);
+}
+
+
+bool UniformBuffer::update(const void* a_data)
+{
+	//nothing has changed since the last upload
+	if (m_hasData && memcmp(m_lastData.data(), a_data, m_size) == 0)
+	{
+		return false;
+	}
+
+	memcpy(m_lastData.data(), a_data, m_size);
+	m_hasData = true;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_handle);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, m_size, a_data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	return true;
+}
+
+void UniformBuffer::bind() const
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, m_bindingPoint, m_handle);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Wrapper for a uniform buffer object bound to a fixed binding point. The last uploaded
+ *	data is kept on the CPU so the buffer is only written to when its contents change.
+ */
+#pragma once
+#include <vector>
+
+
+class UniformBuffer
+{
+public:
+	UniformBuffer(unsigned int a_bindingPoint, unsigned int a_size);
+	~UniformBuffer();
+
+	// Upload data to the buffer if it is different from the last upload
+	// Returns true if the buffer was written to
+	bool update(const void* a_data);
+	// Bind the buffer to its binding point
+	void bind() const;
+
+	unsigned int getBindingPoint() const { return m_bindingPoint; }
+	unsigned int getSize() const { return m_size; }
+	unsigned int getHandle() const { return m_handle; }
+
+protected:
+	unsigned int m_handle;
+	unsigned int m_bindingPoint;
+	unsigned int m_size;
+
+	// Copy of the last uploaded data, used to skip redundant uploads
+	std::vector<char> m_lastData;
+	bool m_hasData;
+};
\ No newline at end of file
@@ -1,15 +1,25 @@
 #include "GraphicsProjectApp.h"
+#include <cstring>
 
-int main()
+int main(int argc, char* argv[])
 {
 	// allocation
 	auto app = new GraphicsProjectApp();
 
-	// initialise and loop
-	app->run("AIE", 1280, 720, false);
+	int result = 0;
+	if (argc > 1 && strcmp(argv[1], "--verify-gpu-culling") == 0)
+	{
+		// check GPU culling in a hidden window, failing if it differs from the CPU or never ran
+		result = app->runTest("AIE", 1280, 720) == 0 ? 0 : 1;
+	}
+	else
+	{
+		// initialise and loop
+		app->run("AIE", 1280, 720, false);
+	}
 
 	// deallocation
 	delete app;
 
-	return 0;
+	return result;
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+/*  Created: 19/10/2026
+ *  Author: Thomas Dufresne
+ *
+ *  Last Modified: 19/10/2026
+ *
+ *	Console checks for the software occlusion rasterizer, which needs no window or OpenGL.
+ *	Boxes in front of, behind, and around known occluders are tested, the simd depth buffer is
+ *	compared with the scalar one, and binning and rasterizing are timed. Returns 1 if a check fails.
+ */
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+#include "OcclusionRasterizer.h"
+#include <glm/ext.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+//resolution the scene rasterizes at
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 180
+
+static int s_failures = 0;
+
+// Print a failed check and remember it for the exit code
+static void check(bool a_passed, const char* a_description)
+{
+	if (!a_passed)
+	{
+		printf("FAILED: %s\n", a_description);
+		s_failures++;
+	}
+}
+
+static float randomFloat(float a_min, float a_max)
+{
+	return a_min + (a_max - a_min) * (rand() / (float)RAND_MAX);
+}
+
+// Random boxes in front of a camera at the origin looking down -z, some crossing the screen edges
+static std::vector<OccluderMesh> randomBoxes(unsigned int a_count)
+{
+	std::vector<OccluderMesh> boxes;
+	for (unsigned int i = 0; i < a_count; i++)
+	{
+		float depth = randomFloat(2, 60);
+		glm::vec3 center(randomFloat(-depth, depth), randomFloat(-depth, depth) * 0.6f, -depth);
+		glm::vec3 extents(randomFloat(0.2f, 4), randomFloat(0.2f, 4), randomFloat(0.2f, 4));
+		boxes.push_back(OccluderMesh::box(AABB(center - extents, center + extents)));
+	}
+	return boxes;
+}
+
+static void rasterizeBoxes(OcclusionRasterizer& a_rasterizer, const glm::mat4& a_projectionView, const std::vector<OccluderMesh>& a_boxes,
+	unsigned int a_threadCount)
+{
+	a_rasterizer.begin(a_projectionView, a_threadCount);
+	for (auto& box : a_boxes)
+	{
+		a_rasterizer.addOccluder(box, glm::mat4(1));
+	}
+	a_rasterizer.rasterizeAll();
+}
+
+static void testOcclusion(const glm::mat4& a_projectionView)
+{
+	//a wall 10 units in front of the camera, and a rotated box to the side of it
+	OccluderMesh wall = OccluderMesh::box(AABB(glm::vec3(-5, -5, -11), glm::vec3(5, 5, -10)));
+	OccluderMesh pillar = OccluderMesh::box(AABB(glm::vec3(-1, -3, -1), glm::vec3(1, 3, 1)));
+	glm::mat4 pillarTransform = glm::rotate(glm::translate(glm::mat4(1), glm::vec3(-17, 0, -30)), glm::pi<float>() * 0.25f, glm::vec3(0, 1, 0));
+
+	OcclusionRasterizer rasterizer(TEST_WIDTH, TEST_HEIGHT);
+	rasterizer.begin(a_projectionView);
+	rasterizer.addOccluder(wall, glm::mat4(1));
+	rasterizer.addOccluder(pillar, pillarTransform);
+	rasterizer.rasterizeAll();
+
+	check(rasterizer.getOccluderCount() == 2, "both occluders are counted");
+	check(rasterizer.getTriangleCount() > 0, "occluders bin triangles on screen");
+
+	check(!rasterizer.isOccluded(AABB(glm::vec3(-1, -1, -6), glm::vec3(1, 1, -5))), "box in front of the wall is visible");
+	check(rasterizer.isOccluded(AABB(glm::vec3(-1, -1, -20), glm::vec3(1, 1, -18))), "box behind the wall is occluded");
+	check(rasterizer.isOccluded(AABB(glm::vec3(-4, -4, -40), glm::vec3(4, 4, -30))), "large box far behind the wall is occluded");
+	check(!rasterizer.isOccluded(AABB(glm::vec3(-1, -1, -12), glm::vec3(1, 1, -8))), "box straddling the wall's depth is visible");
+	check(!rasterizer.isOccluded(AABB(glm::vec3(8, -1, -20), glm::vec3(14, 1, -18))), "box behind the wall's edge is visible");
+	check(!rasterizer.isOccluded(AABB(glm::vec3(12, -1, -22), glm::vec3(16, 1, -20))), "box beside the wall is visible");
+	check(rasterizer.isOccluded(AABB(glm::vec3(-22.8f, -0.5f, -41), glm::vec3(-22.4f, 0.5f, -40))), "thin box behind the pillar is occluded");
+	check(!rasterizer.isOccluded(AABB(glm::vec3(-19, -4, -32), glm::vec3(-15, 4, -28))), "box around the pillar is visible");
+	check(!rasterizer.isOccluded(AABB(glm::vec3(-1, -1, -1), glm::vec3(1, 1, 1))), "box around the camera is visible");
+	check(!rasterizer.isOccluded(AABB(glm::vec3(-1, -1, 5), glm::vec3(1, 1, 8))), "box behind the camera is visible");
+	check(!rasterizer.isOccluded(AABB(glm::vec3(-200, -1, -30), glm::vec3(-190, 1, -20))), "box off the screen is visible");
+
+	//an empty frame hides nothing
+	rasterizer.begin(a_projectionView);
+	rasterizer.rasterizeAll();
+	check(!rasterizer.isOccluded(AABB(glm::vec3(-1, -1, -20), glm::vec3(1, 1, -18))), "nothing is occluded without occluders");
+}
+
+static void testSimdMatchesScalar(const glm::mat4& a_projectionView)
+{
+	std::vector<OccluderMesh> boxes = randomBoxes(60);
+	OcclusionRasterizer rasterizer(TEST_WIDTH, TEST_HEIGHT);
+
+	rasterizer.setSimdEnabled(false);
+	rasterizeBoxes(rasterizer, a_projectionView, boxes, 1);
+	std::vector<float> reference = rasterizer.getDepth();
+
+	//threads split the bins and tiles differently, but the closest depth should win all the same
+	unsigned int threadCounts[] = { 1, 3, 8 };
+	for (auto threadCount : threadCounts)
+	{
+		rasterizer.setSimdEnabled(true);
+		rasterizeBoxes(rasterizer, a_projectionView, boxes, threadCount);
+		const std::vector<float>& depth = rasterizer.getDepth();
+		unsigned int differences = 0;
+		unsigned int covered = 0;
+		for (size_t i = 0; i < depth.size(); i++)
+		{
+			differences += depth[i] != reference[i] ? 1 : 0;
+			covered += reference[i] < 1 ? 1 : 0;
+		}
+		printf("simd against scalar, %d threads: %d of %d pixels differ, %d covered\n", threadCount, differences, (int)depth.size(), covered);
+		check(differences == 0, "simd depth matches the scalar reference");
+		check(covered > 0, "random boxes cover some of the screen");
+	}
+}
+
+static void timeRasterizer(const glm::mat4& a_projectionView)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const int runs = 50;
+
+	unsigned int counts[] = { 100, 1000 };
+	for (auto count : counts)
+	{
+		std::vector<OccluderMesh> boxes = randomBoxes(count);
+		OcclusionRasterizer rasterizer(TEST_WIDTH, TEST_HEIGHT);
+		for (int simd = 1; simd >= 0; simd--)
+		{
+			rasterizer.setSimdEnabled(simd == 1);
+			float binMS = 0;
+			float rasterizeMS = 0;
+			for (int i = 0; i < runs; i++)
+			{
+				rasterizer.begin(a_projectionView);
+				for (auto& box : boxes)
+				{
+					rasterizer.addOccluder(box, glm::mat4(1));
+				}
+				auto start = Clock::now();
+				rasterizer.bin(0);
+				auto binned = Clock::now();
+				rasterizer.rasterize(0);
+				auto end = Clock::now();
+				binMS += std::chrono::duration<float, std::milli>(binned - start).count() / runs;
+				rasterizeMS += std::chrono::duration<float, std::milli>(end - binned).count() / runs;
+			}
+			printf("%d boxes, %s: bin %.3fms, rasterize %.3fms, %d triangles\n", count, simd ? "simd" : "scalar", binMS, rasterizeMS,
+				rasterizer.getTriangleCount());
+		}
+	}
+}
+
+int main()
+{
+	srand(1);
+	glm::mat4 projection = glm::perspective(glm::pi<float>() * 0.25f, TEST_WIDTH / (float)TEST_HEIGHT, 0.1f, 1000.f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+	glm::mat4 projectionView = projection * view;
+
+	testOcclusion(projectionView);
+	testSimdMatchesScalar(projectionView);
+	timeRasterizer(projectionView);
+
+	if (s_failures > 0)
+	{
+		printf("%d checks failed\n", s_failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
\ No newline at end of file
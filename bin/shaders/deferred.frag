@@ -0,0 +1,192 @@
+// deferred lighting shader, lighting each pixel of the g-buffer once
+#version 430
+
+in vec2 vTexCoord;
+
+uniform sampler2D AlbedoTexture;
+uniform sampler2D SpecularTexture;
+uniform sampler2D NormalTexture;
+uniform sampler2D EmissiveTexture;
+uniform sampler2D DepthTexture;
+//turns a pixel's depth back in to its world position
+uniform mat4 InverseProjectionView;
+
+struct DirectionalLight
+{
+    vec3 Direction;
+    vec3 Color;
+};
+struct PointLight
+{
+    vec3 Position;
+    float Range;
+    vec3 Color;
+    float Brightness;
+};
+//lighting, shared by all shaders and only updated when a light changes
+#define MAX_DIRECTIONAL_LIGHTS 32
+//must match ShadowCascades.h and PointShadows.h
+#define SHADOW_CASCADE_COUNT 4
+#define SHADOW_TILE_SIZE 1024
+#define POINT_SHADOW_SIZE 256
+layout(std140, binding = 1) uniform LightData
+{
+    vec4 AmbientColor;
+    int DirectionalLightCount;
+    //index of the directional light casting shadows, -1 if none do
+    int ShadowLight;
+    DirectionalLight DirectionalLights[MAX_DIRECTIONAL_LIGHTS];
+    //world space to each cascade's tile of the shadow atlas, see ShadowCascades
+    mat4 ShadowMatrices[SHADOW_CASCADE_COUNT];
+    //view depth each cascade reaches, and the world space size of its texels
+    vec4 ShadowSplits;
+    vec4 ShadowTexelSizes;
+};
+layout(binding = 8) uniform sampler2DShadow ShadowAtlas;
+//point lights binned in to clusters of the view by Scene each frame
+layout(std430, binding = 0) readonly buffer PointLights
+{
+    PointLight pointLights[];
+};
+//offset in to lightIndices and number of lights of each cluster
+layout(std430, binding = 1) readonly buffer LightClusters
+{
+    uvec2 lightClusters[];
+};
+layout(std430, binding = 2) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+//cube of each point light's shadows, -1 if it has none, see PointShadows
+layout(std430, binding = 4) readonly buffer PointShadowSlots
+{
+    int pointShadowSlots[];
+};
+layout(binding = 9) uniform samplerCubeArrayShadow PointShadowAtlas;
+
+//shared camera data, updated once per frame by Scene
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 ProjectionView;
+    vec4 CameraPosition;
+    vec4 CameraForward;
+    //pixel * xy and log(view depth) * z + w give a fragment's light cluster
+    vec4 ClusterScale;
+    ivec4 ClusterCounts;
+};
+
+out vec4 FragColor;
+
+
+//unfold a normal written by encodeNormal in the lit shaders
+vec3 decodeNormal(vec2 a_encoded)
+{
+    vec3 normal = vec3(a_encoded, 1 - abs(a_encoded.x) - abs(a_encoded.y));
+    if (normal.z < 0)
+    {
+        vec2 signs = vec2(normal.x >= 0 ? 1 : -1, normal.y >= 0 ? 1 : -1);
+        normal.xy = (1 - abs(normal.yx)) * signs;
+    }
+    return normalize(normal);
+}
+
+//how much of the shadow light reaches a point, from the cascade covering its view depth
+float getShadow(vec3 a_position, vec3 a_normal, float a_viewDepth)
+{
+    if (a_viewDepth >= ShadowSplits.w)
+    {
+        return 1;
+    }
+    int cascade = a_viewDepth < ShadowSplits.x ? 0 : a_viewDepth < ShadowSplits.y ? 1 : a_viewDepth < ShadowSplits.z ? 2 : 3;
+    //pushed out along the normal so surfaces don't shadow themselves
+    vec4 shadowPosition = ShadowMatrices[cascade] * vec4(a_position + a_normal * ShadowTexelSizes[cascade] * 2, 1);
+    //kept inside the cascade's tile so filtering doesn't read its neighbours
+    vec2 tile = vec2(cascade % 2, cascade / 2) * 0.5;
+    float halfTexel = 0.5 / (SHADOW_TILE_SIZE * 2);
+    shadowPosition.xy = clamp(shadowPosition.xy, tile + halfTexel, tile + 0.5 - halfTexel);
+    return texture(ShadowAtlas, shadowPosition.xyz);
+}
+
+//how much of a point light reaches a point, from the cube its distance was drawn in to
+float getPointShadow(int a_slot, vec3 a_position, vec3 a_normal, PointLight a_light)
+{
+    //pushed out along the normal by a couple of texels at this distance, so surfaces don't shadow themselves
+    vec3 offset = a_position - a_light.Position;
+    offset += a_normal * length(offset) * (4.0 / POINT_SHADOW_SIZE);
+    return texture(PointShadowAtlas, vec4(offset, a_slot), length(offset) / a_light.Range);
+}
+
+
+void main()
+{
+    //nothing was drawn here, so whatever is already on screen is kept
+    float depth = texture(DepthTexture, vTexCoord).r;
+    if (depth >= 1)
+    {
+        discard;
+    }
+    gl_FragDepth = depth;
+
+    //unpack the g-buffer
+    vec4 albedo = texture(AlbedoTexture, vTexCoord);
+    vec3 specularColor = texture(SpecularTexture, vTexCoord).rgb;
+    vec3 normal = decodeNormal(texture(NormalTexture, vTexCoord).rg);
+    vec3 emissive = texture(EmissiveTexture, vTexCoord).rgb;
+    float Ns = exp2(albedo.a * 10) - 1;
+    vec4 position = InverseProjectionView * vec4(vec3(vTexCoord, depth) * 2 - 1, 1);
+    position /= position.w;
+
+    //find view vector
+    vec3 view = normalize(CameraPosition.xyz - position.xyz);
+
+
+    //find the total diffuse and specular of all lights, the same way as the forward shaders
+    vec3 diffuseTotal = vec3(0);
+    vec3 specularTotal = vec3(0);
+    // --- Directional lights ---
+    float viewDepth = max(dot(position.xyz - CameraPosition.xyz, CameraForward.xyz), 0.0001);
+    float shadow = ShadowLight >= 0 ? getShadow(position.xyz, normal, viewDepth) : 1;
+    for (int i = 0; i < DirectionalLightCount; i++)
+    {
+        vec3 directionalLightDir = normalize(DirectionalLights[i].Direction);
+        vec3 directionalLightReflection = reflect(directionalLightDir, normal);
+        vec3 directionalLightColor = DirectionalLights[i].Color * (i == ShadowLight ? shadow : 1);
+
+        diffuseTotal += max(0, min(1, dot(normal, -directionalLightDir))) * directionalLightColor;
+        specularTotal += pow(max(0, dot(directionalLightReflection, view)), Ns) * directionalLightColor;
+    }
+    // --- Point lights ---
+    //only lights binned in to this pixel's cluster can reach it
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * ClusterScale.xy), int(log(viewDepth) * ClusterScale.z + ClusterScale.w));
+    cluster = clamp(cluster, ivec3(0), ClusterCounts.xyz - 1);
+    uvec2 clusterLights = lightClusters[(cluster.z * ClusterCounts.y + cluster.y) * ClusterCounts.x + cluster.x];
+    for (uint i = 0; i < clusterLights.y; i++)
+    {
+        uint lightIndex = lightIndices[clusterLights.x + i];
+        PointLight light = pointLights[lightIndex];
+
+        vec3 pointLightDir = position.xyz - light.Position;
+        float distToLight = length(pointLightDir);
+        if (distToLight > light.Range)
+        {
+            continue;
+        }
+        pointLightDir /= distToLight;
+        vec3 pointLightReflection = reflect(pointLightDir, normal);
+
+        //intensity decreases with distance
+        float intensity = (1 - (distToLight / light.Range)) * light.Brightness;
+        //the lights ranked highest on screen have shadows
+        int shadowSlot = pointShadowSlots[lightIndex];
+        if (shadowSlot >= 0)
+        {
+            intensity *= getPointShadow(shadowSlot, position.xyz, normal, light);
+        }
+        diffuseTotal += max(0, min(1, dot(normal, -pointLightDir))) * light.Color * intensity;
+        specularTotal += pow(max(0, dot(pointLightReflection, view)), Ns) * light.Color * intensity;
+    }
+
+
+    //ambient and emissive were added when drawing the g-buffer
+    FragColor = vec4(emissive + diffuseTotal * albedo.rgb + specularTotal * specularColor, 1);
+}
\ No newline at end of file
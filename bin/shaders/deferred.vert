@@ -0,0 +1,13 @@
+// deferred lighting shader, covering the screen with one triangle
+#version 430
+
+out vec2 vTexCoord;
+
+
+void main()
+{
+    //vertices 0, 1, and 2 become (-1, -1), (3, -1), and (-1, 3)
+    vec2 position = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID >> 1) * 4 - 1);
+    vTexCoord = position * 0.5 + 0.5;
+    gl_Position = vec4(position, 0, 1);
+}
\ No newline at end of file
@@ -1,12 +1,60 @@
 // textured shader for simple game lighting
-#version 410
+#version 430
 
 in vec4 vPosition;
+flat in uvec2 vLights;
 in vec3 vNormal;
+flat in vec4 vDiffuseTint;
 in vec2 vTexCoord;
 in vec3 vTangent;
 in vec3 vBiTangent;
 
+#ifdef MATERIAL_TABLE
+//every material of the scene's pooled meshes, indexed by the vertices. Must match MaterialTable.h
+#define MATERIAL_ARRAY_COUNT 8
+struct Material
+{
+    vec4 Ambient;   //opacity in w
+    vec4 Diffuse;   //specular power in w
+    vec4 Specular;
+    vec4 Emissive;
+    uvec4 Textures; //array << 16 | layer of the diffuse, specular, and normal textures
+};
+layout(std430, binding = 5) readonly buffer MaterialData
+{
+    Material Materials[];
+};
+flat in uint vMaterial;
+//textures of each size and format, a layer each
+layout(binding = 10) uniform sampler2DArray MaterialArrays[MATERIAL_ARRAY_COUNT];
+
+//filled in from the table at the start of main, then read like the uniforms
+vec3 Ka;
+vec3 Kd;
+vec3 Ks;
+vec3 Ke;
+float Ns;
+float opacity;
+
+//a texture from the arrays, black without one like an unbound sampler
+//the array is picked with a branch, so gradients are found before it
+vec4 sampleMaterial(uint a_texture, vec2 a_dx, vec2 a_dy)
+{
+    vec3 coord = vec3(vTexCoord, a_texture & 0xffffu);
+    switch (a_texture >> 16)
+    {
+    case 0: return textureGrad(MaterialArrays[0], coord, a_dx, a_dy);
+    case 1: return textureGrad(MaterialArrays[1], coord, a_dx, a_dy);
+    case 2: return textureGrad(MaterialArrays[2], coord, a_dx, a_dy);
+    case 3: return textureGrad(MaterialArrays[3], coord, a_dx, a_dy);
+    case 4: return textureGrad(MaterialArrays[4], coord, a_dx, a_dy);
+    case 5: return textureGrad(MaterialArrays[5], coord, a_dx, a_dy);
+    case 6: return textureGrad(MaterialArrays[6], coord, a_dx, a_dy);
+    case 7: return textureGrad(MaterialArrays[7], coord, a_dx, a_dy);
+    }
+    return vec4(0, 0, 0, 1);
+}
+#else
 uniform sampler2D diffuseTexture;
 uniform sampler2D specularTexture;
 uniform sampler2D normalTexture;
@@ -17,6 +65,7 @@ uniform vec3 Ks;    //specular color
 uniform vec3 Ke;    //emissive color
 uniform float Ns;   //specular power
 uniform float opacity;
+#endif
 
 struct DirectionalLight
 {
@@ -27,29 +76,137 @@ struct PointLight
 {
     vec3 Position;
     float Range;
-    float Brightness;
     vec3 Color;
+    float Brightness;
+};
+//lighting, shared by all shaders and only updated when a light changes
+#define MAX_DIRECTIONAL_LIGHTS 32
+//must match ShadowCascades.h and PointShadows.h
+#define SHADOW_CASCADE_COUNT 4
+#define SHADOW_TILE_SIZE 1024
+#define POINT_SHADOW_SIZE 256
+layout(std140, binding = 1) uniform LightData
+{
+    vec4 AmbientColor;
+    int DirectionalLightCount;
+    //index of the directional light casting shadows, -1 if none do
+    int ShadowLight;
+    DirectionalLight DirectionalLights[MAX_DIRECTIONAL_LIGHTS];
+    //world space to each cascade's tile of the shadow atlas, see ShadowCascades
+    mat4 ShadowMatrices[SHADOW_CASCADE_COUNT];
+    //view depth each cascade reaches, and the world space size of its texels
+    vec4 ShadowSplits;
+    vec4 ShadowTexelSizes;
+};
+layout(binding = 8) uniform sampler2DShadow ShadowAtlas;
+//point lights binned in to clusters of the view by Scene each frame
+layout(std430, binding = 0) readonly buffer PointLights
+{
+    PointLight pointLights[];
+};
+//offset in to lightIndices and number of lights of each cluster
+layout(std430, binding = 1) readonly buffer LightClusters
+{
+    uvec2 lightClusters[];
+};
+layout(std430, binding = 2) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+//cube of each point light's shadows, -1 if it has none, see PointShadows
+layout(std430, binding = 4) readonly buffer PointShadowSlots
+{
+    int pointShadowSlots[];
+};
+layout(binding = 9) uniform samplerCubeArrayShadow PointShadowAtlas;
+//lists of the lights touching each instance, see InstanceLights
+layout(std430, binding = 3) readonly buffer InstanceLightIndices
+{
+    uint instanceLightIndices[];
+};
+
+//shared camera data, updated once per frame by Scene
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 ProjectionView;
+    vec4 CameraPosition;
+    vec4 CameraForward;
+    //pixel * xy and log(view depth) * z + w give a fragment's light cluster
+    vec4 ClusterScale;
+    //w is 1 when instances have their own light lists
+    ivec4 ClusterCounts;
 };
-//lighting
-uniform vec3 AmbientColor;
-#define MAX_LIGHTS 16
-uniform int DirectionalLightCount;
-uniform DirectionalLight DirectionalLights[MAX_LIGHTS];
-uniform int PointLightCount;
-uniform PointLight PointLights[MAX_LIGHTS];
 
-//used for specular
-uniform vec3 CameraPosition;
+#ifdef DEFERRED
+//opaque surfaces are written to the g-buffer and lit later, see deferred.frag
+layout(location = 0) out vec4 GBufferAlbedo;
+layout(location = 1) out vec4 GBufferSpecular;
+layout(location = 2) out vec2 GBufferNormal;
+layout(location = 3) out vec3 GBufferEmissive;
 
+//fold the normal on to an octahedron, so it fits in two channels
+vec2 encodeNormal(vec3 a_normal)
+{
+    a_normal /= abs(a_normal.x) + abs(a_normal.y) + abs(a_normal.z);
+    if (a_normal.z < 0)
+    {
+        vec2 signs = vec2(a_normal.x >= 0 ? 1 : -1, a_normal.y >= 0 ? 1 : -1);
+        a_normal.xy = (1 - abs(a_normal.yx)) * signs;
+    }
+    return a_normal.xy;
+}
+#else
 out vec4 FragColor;
+#endif
+
+//how much of the shadow light reaches a point, from the cascade covering its view depth
+float getShadow(vec3 a_position, vec3 a_normal, float a_viewDepth)
+{
+    if (a_viewDepth >= ShadowSplits.w)
+    {
+        return 1;
+    }
+    int cascade = a_viewDepth < ShadowSplits.x ? 0 : a_viewDepth < ShadowSplits.y ? 1 : a_viewDepth < ShadowSplits.z ? 2 : 3;
+    //pushed out along the normal so surfaces don't shadow themselves
+    vec4 shadowPosition = ShadowMatrices[cascade] * vec4(a_position + a_normal * ShadowTexelSizes[cascade] * 2, 1);
+    //kept inside the cascade's tile so filtering doesn't read its neighbours
+    vec2 tile = vec2(cascade % 2, cascade / 2) * 0.5;
+    float halfTexel = 0.5 / (SHADOW_TILE_SIZE * 2);
+    shadowPosition.xy = clamp(shadowPosition.xy, tile + halfTexel, tile + 0.5 - halfTexel);
+    return texture(ShadowAtlas, shadowPosition.xyz);
+}
+
+//how much of a point light reaches a point, from the cube its distance was drawn in to
+float getPointShadow(int a_slot, vec3 a_position, vec3 a_normal, PointLight a_light)
+{
+    //pushed out along the normal by a couple of texels at this distance, so surfaces don't shadow themselves
+    vec3 offset = a_position - a_light.Position;
+    offset += a_normal * length(offset) * (4.0 / POINT_SHADOW_SIZE);
+    return texture(PointShadowAtlas, vec4(offset, a_slot), length(offset) / a_light.Range);
+}
 
 
 void main()
 {
+#ifdef MATERIAL_TABLE
+    Material material = Materials[vMaterial];
+    Ka = material.Ambient.rgb;
+    opacity = material.Ambient.w;
+    Kd = material.Diffuse.rgb;
+    Ns = material.Diffuse.w;
+    Ks = material.Specular.rgb;
+    Ke = material.Emissive.rgb;
+    vec2 dx = dFdx(vTexCoord);
+    vec2 dy = dFdy(vTexCoord);
+    vec3 texDiffuse = sampleMaterial(material.Textures.x, dx, dy).rgb;
+    vec3 texSpecular = sampleMaterial(material.Textures.y, dx, dy).rgb;
+    vec3 texNormal = sampleMaterial(material.Textures.z, dx, dy).rgb;
+#else
     //get pixel from textures
     vec3 texDiffuse = texture(diffuseTexture, vTexCoord).rgb;
     vec3 texSpecular = texture(specularTexture, vTexCoord).rgb;
     vec3 texNormal = texture(normalTexture, vTexCoord).rgb;
+#endif
 
     //normalize vectors
     vec3 normal = normalize(vNormal);
@@ -59,35 +216,59 @@ void main()
     //apply normal map to vertex normal
     normal = mat3(tangent, biTangent, normal) * (texNormal * 2 - 1);
     //find view vector
-    vec3 view = normalize(CameraPosition - vPosition.xyz);
+    vec3 view = normalize(CameraPosition.xyz - vPosition.xyz);
+
 
+#ifdef DEFERRED
+    //specular power is stored as log2(Ns + 1) / 10, enough for powers up to 1023
+    GBufferAlbedo = vec4(Kd * vDiffuseTint.rgb * texDiffuse, log2(Ns + 1) / 10);
+    GBufferSpecular = vec4(Ks * texSpecular, 1);
+    GBufferNormal = encodeNormal(normal);
+    GBufferEmissive = AmbientColor.rgb * Ka * texDiffuse + Ke;
+#else
 
     //find the total diffuse and specular of all lights
     vec3 diffuseTotal = vec3(0);
     vec3 specularTotal = vec3(0);
     // --- Directional lights ---
+    float viewDepth = max(dot(vPosition.xyz - CameraPosition.xyz, CameraForward.xyz), 0.0001);
+    float shadow = ShadowLight >= 0 ? getShadow(vPosition.xyz, normal, viewDepth) : 1;
     for (int i = 0; i < DirectionalLightCount; i++)
     {
         //normalise the direction vectors
         vec3 directionalLightDir = normalize(DirectionalLights[i].Direction);
         //find the reflection vector
         vec3 directionalLightReflection = reflect(directionalLightDir, normal);
+        vec3 directionalLightColor = DirectionalLights[i].Color * (i == ShadowLight ? shadow : 1);
 
         //lambert term * light color
-        diffuseTotal += max(0, min(1, dot(normal, -directionalLightDir))) * DirectionalLights[i].Color;
+        diffuseTotal += max(0, min(1, dot(normal, -directionalLightDir))) * directionalLightColor;
         //specular term * light color
-        specularTotal += pow(max(0, dot(directionalLightReflection, view)), Ns) * DirectionalLights[i].Color;
+        specularTotal += pow(max(0, dot(directionalLightReflection, view)), Ns) * directionalLightColor;
     }
     // --- Point lights ---
-    for (int i = 0; i < PointLightCount; i++)
+    //only lights in the instance's list, or binned in to this fragment's cluster, can reach it
+    //instances culled on the gpu have no list of their own
+    bool instanceList = ClusterCounts.w != 0 && vLights.y != 0xffffffffu;
+    uvec2 lightRange = vLights;
+    if (!instanceList)
     {
+        ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * ClusterScale.xy), int(log(viewDepth) * ClusterScale.z + ClusterScale.w));
+        cluster = clamp(cluster, ivec3(0), ClusterCounts.xyz - 1);
+        lightRange = lightClusters[(cluster.z * ClusterCounts.y + cluster.y) * ClusterCounts.x + cluster.x];
+    }
+    for (uint i = 0; i < lightRange.y; i++)
+    {
+        uint lightIndex = instanceList ? instanceLightIndices[lightRange.x + i] : lightIndices[lightRange.x + i];
+        PointLight light = pointLights[lightIndex];
+
         //find direction from point light to position
-        vec3 pointLightDir = vPosition.xyz - PointLights[i].Position;
+        vec3 pointLightDir = vPosition.xyz - light.Position;
 
         //find the magnitude of the direction to get the distance
         float distToLight = sqrt((pointLightDir.x * pointLightDir.x) + (pointLightDir.y * pointLightDir.y) + (pointLightDir.z * pointLightDir.z));
         //if out of range of the point light, skip it
-        if (distToLight > PointLights[i].Range)
+        if (distToLight > light.Range)
         {
             continue;
         }
@@ -98,21 +279,28 @@ void main()
         vec3 pointLightReflection = reflect(pointLightDir, normal);
 
         //intensity decreases with distance
-        float intensity = 1 - (distToLight / PointLights[i].Range);
-        intensity *= PointLights[i].Brightness;
+        float intensity = 1 - (distToLight / light.Range);
+        intensity *= light.Brightness;
+        //the lights ranked highest on screen have shadows
+        int shadowSlot = pointShadowSlots[lightIndex];
+        if (shadowSlot >= 0)
+        {
+            intensity *= getPointShadow(shadowSlot, vPosition.xyz, normal, light);
+        }
 
         //lambert term * light color * intensity
-        diffuseTotal += max(0, min(1, dot(normal, -pointLightDir))) * PointLights[i].Color * intensity;
+        diffuseTotal += max(0, min(1, dot(normal, -pointLightDir))) * light.Color * intensity;
         //specular term * light color * intensity
-        specularTotal += pow(max(0, dot(pointLightReflection, view)), Ns) * PointLights[i].Color * intensity;
+        specularTotal += pow(max(0, dot(pointLightReflection, view)), Ns) * light.Color * intensity;
     }
 
 
     //find the ambient, diffuse, and specular colors
-    vec3 ambient = AmbientColor * Ka * texDiffuse;
-    vec3 diffuse = diffuseTotal * Kd * texDiffuse;
+    vec3 ambient = AmbientColor.rgb * Ka * texDiffuse;
+    vec3 diffuse = diffuseTotal * Kd * vDiffuseTint.rgb * texDiffuse;
     vec3 specular = specularTotal * Ks * texSpecular;
 
     //output the final color
     FragColor = vec4(ambient + diffuse + specular + Ke, opacity);
+#endif
 }
\ No newline at end of file
@@ -1,12 +1,20 @@
 // a particle shader with billboarding
-#version 410
+#version 420
 
 layout(location = 0) in vec4 Position;
 layout(location = 1) in vec4 ParticlePos;   //position.xyz, scale
 layout(location = 2) in vec4 ParticleColor;
 
-uniform vec3 CameraPosition;
-uniform mat4 ProjectionViewMatrix;
+//shared camera data, updated once per frame by Scene
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 ProjectionView;
+    vec4 CameraPosition;
+    vec4 CameraForward;
+    //pixel * xy and log(view depth) * z + w give a fragment's light cluster
+    vec4 ClusterScale;
+    ivec4 ClusterCounts;
+};
 
 out vec4 vParticleColor;
 
@@ -14,7 +22,7 @@ out vec4 vParticleColor;
 void main()
 {
     //create billboard transform to face towards the camera
-	vec3 zAxis= normalize(ParticlePos.xyz - CameraPosition);
+	vec3 zAxis= normalize(ParticlePos.xyz - CameraPosition.xyz);
 	vec3 xAxis= cross(vec3(0, 1, 0), zAxis);
 	vec3 yAxis= cross(zAxis, xAxis);
 	mat4 billboard = mat4(vec4(xAxis, 0), vec4(yAxis, 0), vec4(zAxis, 0), vec4(ParticlePos.xyz, 1));
@@ -26,5 +34,5 @@ void main()
 	billboard *= scale;
 
     vParticleColor = ParticleColor;
-    gl_Position = ProjectionViewMatrix * billboard * Position;
+    gl_Position = ProjectionView * billboard * Position;
 }
\ No newline at end of file
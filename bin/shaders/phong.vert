@@ -1,20 +1,55 @@
 // phong shader
-#version 410
+#version 420
 
 layout(location = 0) in vec4 Position;
 layout(location = 1) in vec4 Normal;
 
 out vec4 vPosition;
 out vec3 vNormal;
+flat out vec4 vDiffuseTint;
+flat out uvec2 vLights;
 
-uniform mat4 ProjectionViewModel;
+//shared camera data, updated once per frame by Scene
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 ProjectionView;
+    vec4 CameraPosition;
+    vec4 CameraForward;
+    //pixel * xy and log(view depth) * z + w give a fragment's light cluster
+    vec4 ClusterScale;
+    ivec4 ClusterCounts;
+};
+//depth is computed the same way as the depth pre-pass, so drawing after it can test for equal depth
+invariant gl_Position;
+
+#ifdef MATERIAL_TABLE
+//index in to the scene's material table, from the mesh pool's material stream
+layout(location = 10) in uint MaterialIndex;
+flat out uint vMaterial;
+#endif
+
+#ifdef INSTANCED
+//per instance data from the scene's instance buffer
+layout(location = 4) in mat4 ModelMatrix;
+layout(location = 8) in vec4 DiffuseTint;
+layout(location = 9) in uvec2 InstanceLights;
+#else
 //this is for the transform normal
 uniform mat4 ModelMatrix;
+uniform vec4 DiffuseTint = vec4(1);
+//offset in to the instance light lists and number of lights, only read when ClusterCounts.w is set
+uniform uvec2 InstanceLights;
+#endif
 
 
 void main()
 {
     vPosition = ModelMatrix * Position;
     vNormal = (ModelMatrix * Normal).xyz;
-    gl_Position = ProjectionViewModel * Position;
+    vDiffuseTint = DiffuseTint;
+    vLights = InstanceLights;
+#ifdef MATERIAL_TABLE
+    vMaterial = MaterialIndex;
+#endif
+    gl_Position = ProjectionView * vPosition;
 }
\ No newline at end of file
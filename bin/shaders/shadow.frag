@@ -0,0 +1,18 @@
+// shadow depth shader
+#version 420
+
+#ifdef POINT_LIGHT
+in vec3 vPosition;
+
+uniform vec3 LightPosition;
+uniform float LightRange;
+#endif
+
+
+void main()
+{
+    //directional lights only need depth, point lights store distance over range so every face compares the same way
+#ifdef POINT_LIGHT
+    gl_FragDepth = distance(vPosition, LightPosition) / LightRange;
+#endif
+}
@@ -0,0 +1,33 @@
+// shadow depth shader
+#version 420
+
+//positions only, from the mesh pool's depth vertex array
+layout(location = 0) in vec4 Position;
+layout(location = 4) in mat4 ModelMatrix;
+
+#ifdef CAMERA
+//the depth pre-pass draws from the camera, and must match the lit shaders' depth exactly for them to test equal
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 LightProjectionView;
+};
+invariant gl_Position;
+#else
+//the cascade or cube face being drawn
+uniform mat4 LightProjectionView;
+#endif
+
+#ifdef POINT_LIGHT
+//point light faces store distance from the light, see shadow.frag
+out vec3 vPosition;
+#endif
+
+
+void main()
+{
+    vec4 position = ModelMatrix * Position;
+#ifdef POINT_LIGHT
+    vPosition = position.xyz;
+#endif
+    gl_Position = LightProjectionView * position;
+}
@@ -10,6 +10,7 @@ namespace aie {
 
 Application::Application()
 	: m_window(nullptr),
+	m_windowVisible(true),
 	m_gameOver(false),
 	m_fps(0) {
 }
@@ -22,6 +23,8 @@ bool Application::createWindow(const char* title, int width, int height, bool fu
 	if (glfwInit() == GL_FALSE)
 		return false;
 
+	glfwWindowHint(GLFW_VISIBLE, m_windowVisible ? GLFW_TRUE : GLFW_FALSE);
+
 	m_window = glfwCreateWindow(width, height, title, (fullscreen ? glfwGetPrimaryMonitor() : nullptr), nullptr);
 	if (m_window == nullptr) {
 		glfwTerminate();
@@ -40,11 +43,9 @@ bool Application::createWindow(const char* title, int width, int height, bool fu
 
 	glClearColor(0, 0, 0, 1);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// a new context has its own state, so every part of the default state is set
+	PipelineState::invalidate();
+	m_defaultState.apply();
 
 	// start input manager
 	Input::create();
@@ -130,11 +131,27 @@ void Application::run(const char* title, int width, int height, bool fullscreen)
 	destroyWindow();
 }
 
+int Application::runTest(const char* title, int width, int height) {
+
+	m_windowVisible = false;
+	if (!createWindow(title, width, height, false))
+		return -1;
+
+	int result = startup() ? test() : -1;
+
+	// cleanup
+	shutdown();
+	destroyWindow();
+	return result;
+}
+
 bool Application::hasWindowClosed() {
 	return glfwWindowShouldClose(m_window) == GL_TRUE;
 }
 
 void Application::clearScreen() {
+	// the last state applied may not write depth or colour, which would stop them clearing
+	m_defaultState.apply();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "PipelineState.h"
+
 // forward declared structure for access to GLFW window
 struct GLFWwindow;
 
@@ -18,13 +20,20 @@ public:
 	// ending with shutdown() if m_gameOver is true
 	void run(const char* title, int width, int height, bool fullscreen);
 
+	// creates a hidden window and calls startup(), then test() once in place of the game loop,
+	// ending with shutdown(). returns test()'s result, or -1 if the window or startup() failed
+	int runTest(const char* title, int width, int height);
+
 	// these functions must be implemented by a derived class
 	virtual bool startup() = 0;
 	virtual void shutdown() = 0;
 	virtual void update(float deltaTime) = 0;
 	virtual void draw() = 0;
 
-	// wipes the screen clear to begin a frame of drawing
+	// checks run by runTest() with a context but nothing shown. 0 means they passed
+	virtual int test() { return 0; }
+
+	// wipes the screen clear to begin a frame of drawing, after applying the default state
 	void clearScreen();
 
 	// sets the colour that the sceen is cleared to
@@ -62,11 +71,17 @@ protected:
 
 	GLFWwindow*		m_window;
 
+	// if set to false, createWindow() makes a window that is never shown
+	bool			m_windowVisible;
+
 	// if set to false, the main game loop will exit
 	bool			m_gameOver;
 	
 	unsigned int	m_fps;
 
+	// the state the window starts with, applied again before clearing
+	PipelineState	m_defaultState;
+
 };
 
 } // namespace aie
\ No newline at end of file
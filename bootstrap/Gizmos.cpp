@@ -69,6 +69,12 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 
 	glDeleteShader(vs);
 	glDeleteShader(fs);
+
+	PipelineState::Desc desc;
+	desc.program = m_shader;
+	m_opaqueState = PipelineState(desc);
+	desc.depthWrite = false;
+	m_transparentState = PipelineState(desc);
     
     // create VBOs
 	glGenBuffers( 1, &m_lineVBO );
@@ -941,10 +947,8 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 		(sm_singleton->m_lineCount > 0 || 
 		 sm_singleton->m_triCount > 0 || 
 		 sm_singleton->m_transparentTriCount > 0)) {
-		int shader = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
-
-		glUseProgram(sm_singleton->m_shader);
+		// states are applied against the last one, so nothing needs restoring afterwards
+		sm_singleton->m_opaqueState.apply();
 		
 		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
 		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projectionView));
@@ -966,35 +970,14 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 		}
 		
 		if (sm_singleton->m_transparentTriCount > 0) {
-			// not ideal to store these, but Gizmos must work stand-alone
-			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-			GLboolean depthMask = GL_TRUE;
-			glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
-			int src, dst;
-			glGetIntegerv(GL_BLEND_SRC, &src);
-			glGetIntegerv(GL_BLEND_DST, &dst);
-			
-			// setup blend states
-			if (blendEnabled == GL_FALSE)
-				glEnable(GL_BLEND);
-			
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glDepthMask(GL_FALSE);
+			sm_singleton->m_transparentState.apply();
 
 			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_transparentTriVBO);
 			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_transparentTriCount * sizeof(GizmoTri), sm_singleton->m_transparentTris);
 
 			glBindVertexArray(sm_singleton->m_transparentTriVAO);
 			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_transparentTriCount * 3);
-
-			// reset state
-			glDepthMask(depthMask);
-			glBlendFunc(src, dst);
-			if (blendEnabled == GL_FALSE)
-				glDisable(GL_BLEND);
 		}
-
-		glUseProgram(shader);
 	}
 }
 
@@ -1006,10 +989,7 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 	if ( sm_singleton != nullptr && 
 		(sm_singleton->m_2DlineCount > 0 || 
 		 sm_singleton->m_2DtriCount > 0)) {
-		int shader = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
-
-		glUseProgram(sm_singleton->m_shader);
+		sm_singleton->m_opaqueState.apply();
 		
 		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
 		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projection));
@@ -1023,37 +1003,14 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 		}
 
 		if (sm_singleton->m_2DtriCount > 0) {
-			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-
-			GLboolean depthMask = GL_TRUE;
-			glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
-
-			int src, dst;
-			glGetIntegerv(GL_BLEND_SRC, &src);
-			glGetIntegerv(GL_BLEND_DST, &dst);
-
-			if (blendEnabled == GL_FALSE)
-				glEnable(GL_BLEND);
-
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-			glDepthMask(GL_FALSE);
+			sm_singleton->m_transparentState.apply();
 
 			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DtriVBO);
 			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DtriCount * sizeof(GizmoTri), sm_singleton->m_2Dtris);
 
 			glBindVertexArray(sm_singleton->m_2DtriVAO);
 			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_2DtriCount * 3);
-
-			glDepthMask(depthMask);
-
-			glBlendFunc(src, dst);
-
-			if (blendEnabled == GL_FALSE)
-				glDisable(GL_BLEND);
 		}
-
-		glUseProgram(shader);
 	}
 }
 
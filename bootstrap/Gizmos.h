@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm/fwd.hpp>
+#include "PipelineState.h"
 
 namespace aie {
 
@@ -115,6 +116,11 @@ private:
 
 	unsigned int	m_shader;
 
+	// lines and filled shapes are drawn like anything else, transparent
+	// triangles blend without writing depth
+	PipelineState	m_opaqueState;
+	PipelineState	m_transparentState;
+
 	// line data
 	unsigned int	m_maxLines;
 	unsigned int	m_lineCount;
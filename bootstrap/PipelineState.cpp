@@ -0,0 +1,206 @@
+#include "gl_core_4_4.h"
+#include "PipelineState.h"
+#include <vector>
+
+namespace aie {
+
+// program value meaning the program in use isn't known
+#define UNKNOWN_PROGRAM 0xffffffff
+
+// what opengl was last set to. blend, depth and cull modes are kept apart from whether they
+// are enabled, so turning one off and on again doesn't set its mode again
+struct AppliedState {
+	unsigned int			program;
+	bool					blend;
+	PipelineState::Blend	blendMode;
+	bool					depthTest;
+	PipelineState::DepthTest depthFunc;
+	bool					depthWrite;
+	bool					colorWrite;
+	bool					cull;
+	PipelineState::Cull		cullFace;
+	bool					depthClamp;
+	bool					scissorTest;
+	bool					offset;
+	float					offsetFactor;
+	float					offsetUnits;
+};
+
+static AppliedState g_applied;
+// false until the first apply, and after an invalidate
+static bool g_appliedValid = false;
+static unsigned int g_applyCount = 0;
+static unsigned int g_changeCount = 0;
+
+// descs of every state created, their index is their id.
+// states can be made before main, so this is made on first use
+static std::vector<PipelineState::Desc>& getDescs() {
+	static std::vector<PipelineState::Desc> descs;
+	return descs;
+}
+
+static void setCapability(GLenum capability, bool enabled) {
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+	g_changeCount++;
+}
+
+static void setBlendMode(PipelineState::Blend mode) {
+	if (mode == PipelineState::BLEND_ADDITIVE)
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	else
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	g_changeCount++;
+}
+
+static void setDepthFunc(PipelineState::DepthTest test) {
+	static const GLenum funcs[] = { GL_LESS, GL_LESS, GL_LEQUAL, GL_EQUAL, GL_ALWAYS };
+	glDepthFunc(funcs[test]);
+	g_changeCount++;
+}
+
+PipelineState::Desc::Desc()
+	: program(0),
+	blend(BLEND_ALPHA),
+	depthTest(DEPTH_LESS),
+	depthWrite(true),
+	colorWrite(true),
+	cull(CULL_BACK),
+	depthClamp(false),
+	scissorTest(false),
+	offsetFactor(0),
+	offsetUnits(0) {
+}
+
+bool PipelineState::Desc::operator == (const Desc& other) const {
+	return program == other.program &&
+		blend == other.blend &&
+		depthTest == other.depthTest &&
+		depthWrite == other.depthWrite &&
+		colorWrite == other.colorWrite &&
+		cull == other.cull &&
+		depthClamp == other.depthClamp &&
+		scissorTest == other.scissorTest &&
+		offsetFactor == other.offsetFactor &&
+		offsetUnits == other.offsetUnits;
+}
+
+PipelineState::PipelineState()
+	: PipelineState(Desc()) {
+}
+
+PipelineState::PipelineState(const Desc& desc)
+	: m_desc(desc) {
+
+	// states are only made up front, so a linear search is fine
+	auto& descs = getDescs();
+	m_id = 0;
+	while (m_id < descs.size() && descs[m_id] != desc)
+		m_id++;
+	if (m_id == descs.size())
+		descs.push_back(desc);
+}
+
+void PipelineState::apply() const {
+	g_applyCount++;
+	bool force = !g_appliedValid;
+	g_appliedValid = true;
+
+	if (m_desc.program != 0)
+		useProgram(m_desc.program);
+
+	bool blend = m_desc.blend != BLEND_NONE;
+	if (force || blend != g_applied.blend)
+		setCapability(GL_BLEND, blend);
+	if (blend && (force || m_desc.blend != g_applied.blendMode)) {
+		setBlendMode(m_desc.blend);
+		g_applied.blendMode = m_desc.blend;
+	}
+	g_applied.blend = blend;
+
+	bool depthTest = m_desc.depthTest != DEPTH_NONE;
+	if (force || depthTest != g_applied.depthTest)
+		setCapability(GL_DEPTH_TEST, depthTest);
+	if (depthTest && (force || m_desc.depthTest != g_applied.depthFunc)) {
+		setDepthFunc(m_desc.depthTest);
+		g_applied.depthFunc = m_desc.depthTest;
+	}
+	g_applied.depthTest = depthTest;
+
+	if (force || m_desc.depthWrite != g_applied.depthWrite) {
+		glDepthMask(m_desc.depthWrite ? GL_TRUE : GL_FALSE);
+		g_applied.depthWrite = m_desc.depthWrite;
+		g_changeCount++;
+	}
+	if (force || m_desc.colorWrite != g_applied.colorWrite) {
+		GLboolean write = m_desc.colorWrite ? GL_TRUE : GL_FALSE;
+		glColorMask(write, write, write, write);
+		g_applied.colorWrite = m_desc.colorWrite;
+		g_changeCount++;
+	}
+
+	bool cull = m_desc.cull != CULL_NONE;
+	if (force || cull != g_applied.cull)
+		setCapability(GL_CULL_FACE, cull);
+	if (cull && (force || m_desc.cull != g_applied.cullFace)) {
+		glCullFace(m_desc.cull == CULL_FRONT ? GL_FRONT : GL_BACK);
+		g_applied.cullFace = m_desc.cull;
+		g_changeCount++;
+	}
+	g_applied.cull = cull;
+
+	if (force || m_desc.depthClamp != g_applied.depthClamp)
+		setCapability(GL_DEPTH_CLAMP, m_desc.depthClamp);
+	g_applied.depthClamp = m_desc.depthClamp;
+	if (force || m_desc.scissorTest != g_applied.scissorTest)
+		setCapability(GL_SCISSOR_TEST, m_desc.scissorTest);
+	g_applied.scissorTest = m_desc.scissorTest;
+
+	bool offset = m_desc.offsetFactor != 0 || m_desc.offsetUnits != 0;
+	if (force || offset != g_applied.offset)
+		setCapability(GL_POLYGON_OFFSET_FILL, offset);
+	if (offset && (force || m_desc.offsetFactor != g_applied.offsetFactor || m_desc.offsetUnits != g_applied.offsetUnits)) {
+		glPolygonOffset(m_desc.offsetFactor, m_desc.offsetUnits);
+		g_applied.offsetFactor = m_desc.offsetFactor;
+		g_applied.offsetUnits = m_desc.offsetUnits;
+		g_changeCount++;
+	}
+	g_applied.offset = offset;
+}
+
+void PipelineState::useProgram(unsigned int program) {
+	if (program == g_applied.program)
+		return;
+	glUseProgram(program);
+	g_applied.program = program;
+	g_changeCount++;
+}
+
+void PipelineState::invalidate() {
+	g_appliedValid = false;
+	g_applied.program = UNKNOWN_PROGRAM;
+
+	// modes of anything left disabled by the next apply are set once they're enabled
+	g_applied.blendMode = BLEND_NONE;
+	g_applied.depthFunc = DEPTH_NONE;
+	g_applied.cullFace = CULL_NONE;
+	g_applied.offsetFactor = 0;
+	g_applied.offsetUnits = 0;
+}
+
+unsigned int PipelineState::getApplyCount() {
+	return g_applyCount;
+}
+
+unsigned int PipelineState::getChangeCount() {
+	return g_changeCount;
+}
+
+void PipelineState::resetCounts() {
+	g_applyCount = 0;
+	g_changeCount = 0;
+}
+
+} // namespace aie
\ No newline at end of file
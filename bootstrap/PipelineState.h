@@ -0,0 +1,89 @@
+#pragma once
+
+namespace aie {
+
+// an immutable bundle of the program, blend, depth and raster state a draw needs.
+// states are created up front, and applying one only changes the opengl state that
+// differs from the state applied before it
+class PipelineState {
+public:
+
+	enum Blend : unsigned int {
+		BLEND_NONE = 0,
+		// source alpha over what is already drawn
+		BLEND_ALPHA,
+		BLEND_ADDITIVE
+	};
+
+	enum DepthTest : unsigned int {
+		// with the test off nothing is written to depth either
+		DEPTH_NONE = 0,
+		DEPTH_LESS,
+		DEPTH_LEQUAL,
+		DEPTH_EQUAL,
+		// passes everything, but still writes depth
+		DEPTH_ALWAYS
+	};
+
+	enum Cull : unsigned int {
+		CULL_NONE = 0,
+		CULL_BACK,
+		CULL_FRONT
+	};
+
+	// everything a state sets. defaults are what Application sets up the window with
+	struct Desc {
+		Desc();
+
+		// 0 leaves whatever program is in use, for programs that are bound separately
+		unsigned int	program;
+
+		Blend			blend;
+		DepthTest		depthTest;
+		bool			depthWrite;
+		bool			colorWrite;
+		Cull			cull;
+		// primitives past the near and far planes are clamped to them instead of clipped
+		bool			depthClamp;
+		bool			scissorTest;
+		// polygon offset is off while both are 0
+		float			offsetFactor;
+		float			offsetUnits;
+
+		bool operator == (const Desc& other) const;
+		bool operator != (const Desc& other) const { return !(*this == other); }
+	};
+
+	// a state with the default desc
+	PipelineState();
+	PipelineState(const Desc& desc);
+
+	// make this the current state, changing only what differs from the last applied state
+	void apply() const;
+
+	const Desc& getDesc() const { return m_desc; }
+
+	// states with the same desc share an id, given out in the order they were first created.
+	// draws sorted by id are grouped by state
+	unsigned int getID() const { return m_id; }
+
+	// use a program through the state tracking, so the next apply knows it is in use.
+	// anything binding programs between applies should use this instead of glUseProgram
+	static void useProgram(unsigned int program);
+
+	// forget what was last applied, so the next apply sets everything.
+	// used after opengl state is changed without a state, or a context is created
+	static void invalidate();
+
+	// applies, and the opengl calls they made, since the last reset
+	static unsigned int getApplyCount();
+	static unsigned int getChangeCount();
+	static void resetCounts();
+
+protected:
+
+	Desc			m_desc;
+	unsigned int	m_id;
+};
+
+} // namespace aie
\ No newline at end of file
@@ -92,7 +92,7 @@ Renderer2D::Renderer2D() {
 		delete[] infoLog;
 	}
 
-	glUseProgram(m_shader);
+	PipelineState::useProgram(m_shader);
 
 	// set texture locations
 	char buf[32];
@@ -101,10 +101,15 @@ Renderer2D::Renderer2D() {
 		glUniform1i(glGetUniformLocation(m_shader, buf), i);
 	}
 
-	glUseProgram(0);
-
 	glDeleteShader(vs);
 	glDeleteShader(fs);
+
+	// sprites blend over each other, and pass at the same depth so later sprites draw on top
+	PipelineState::Desc desc;
+	desc.program = m_shader;
+	desc.blend = PipelineState::BLEND_ALPHA;
+	desc.depthTest = PipelineState::DEPTH_LEQUAL;
+	m_state = PipelineState(desc);
 	
 	// pre calculate the indices... they will always be the same
 	int index = 0;
@@ -155,14 +160,11 @@ void Renderer2D::begin() {
 	auto window = glfwGetCurrentContext();
 	glfwGetWindowSize(window, &width, &height);
 	
-	glUseProgram(m_shader);
+	m_state.apply();
 
 	auto projection = glm::ortho(m_cameraX, m_cameraX + (float)width, m_cameraY, m_cameraY + (float)height, 1.0f, -101.0f);
 	glUniformMatrix4fv(glGetUniformLocation(m_shader, "projectionMatrix"), 1, false, &projection[0][0]);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
 	setRenderColour(1,1,1,1);
 }
 
@@ -172,8 +174,6 @@ void Renderer2D::end() {
 
 	flushBatch();
 
-	glUseProgram(0);
-
 	m_renderBegun = false;
 }
 
@@ -648,15 +648,14 @@ void Renderer2D::flushBatch() {
 	if (m_currentVertex == 0 || m_currentIndex == 0 || m_renderBegun == false)
 		return; char buf[32];
 
+	// applied again in case anything else was drawn since begin()
+	m_state.apply();
+
 	for (int i = 0; i < TEXTURE_STACK_SIZE; ++i) {
 		sprintf_s(buf, "isFontTexture[%i]", i);
 		glUniform1i(glGetUniformLocation(m_shader, buf), m_fontTexture[i]);
 	}
 
-	int depthFunc = GL_LESS;
-	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
-	glDepthFunc(GL_LEQUAL);
-
 	glBindVertexArray(m_vao);
 	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
@@ -668,8 +667,6 @@ void Renderer2D::flushBatch() {
 
 	glBindVertexArray(0);
 
-	glDepthFunc(depthFunc);
-
 	// clear the active textures
 	for (unsigned int i = 0; i < m_currentTexture; i++) {
 		m_textureStack[i] = nullptr;
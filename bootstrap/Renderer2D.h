@@ -1,5 +1,7 @@
 #pragma once
 
+#include "PipelineState.h"
+
 namespace aie {
 
 class Texture;
@@ -88,6 +90,7 @@ protected:
 
 	// shader used to render sprites
 	unsigned int		m_shader;
+	PipelineState		m_state;
 
 	// helper method used to rotate sprites around a pivot
 	void	rotateAround(float inX, float inY, float& outX, float& outY, float sin, float cos);